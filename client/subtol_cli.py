@@ -42,6 +42,9 @@ class SubtolCli:
 		# ubiquitously required
 		self.session_cookie = {'Cookie' : 'session-id=' + self.context.SESSION_ID}
 		
+		# persistent connection, the server keeps it alive between queries
+		self.http = requests.Session()
+		
 		# to map characters to integers
 		self.mapstr = None
 		self.mapper = None
@@ -54,6 +57,46 @@ class SubtolCli:
 		self.oram_type = None
 		self.filename = None
 
+	# binary transport for substring and suffix:
+	# <payload length: 4 bytes little endian> <iv: 12 bytes> <mac: 16 bytes> <payload>
+	
+	def __bin_call(self, resource, body=None):
+		headers = dict(self.session_cookie)
+		headers['Accept'] = 'application/octet-stream'
+		
+		if body != None:
+			headers['Content-Type'] = 'application/octet-stream'
+		
+		req = self.http.get(self.url_base + resource, headers=headers, data=body)
+		
+		if req.status_code != 200:
+			print(req.json()['error'])
+			return None
+		
+		frame = req.content
+		paylen = int.from_bytes(frame[0:4], byteorder='little')
+		
+		if len(frame) != 32 + paylen:
+			print('Malformed binary reply')
+			return None
+		
+		# iv, mac, payload
+		return frame[4:16], frame[16:32], frame[32:]
+	
+	def __substring_call(self, iv, mac, enc_query):
+		return self.__bin_call('/substring', len(enc_query).to_bytes(4, byteorder='little') + iv + mac + enc_query)
+	
+	# the cursor (first entry wanted) travels encrypted, the enclave keeps none per session
+	def __suffix_call(self, cursor):
+		iv = os.urandom(12)
+		temp = max(cursor, 0).to_bytes(4, byteorder='little')
+		enc_cursor_mac = AESGCM(self.context.SK).encrypt(iv, temp, None)
+		
+		mac = enc_cursor_mac[-16:]
+		enc_cursor = enc_cursor_mac[0:-16]
+		
+		return self.__bin_call('/suffix', len(enc_cursor).to_bytes(4, byteorder='little') + iv + mac + enc_cursor)
+	
 	# subtol-cli commands
 
 	def __clear(self, args):
@@ -67,12 +110,15 @@ class SubtolCli:
 		print('\nSETUP:')
 		print('config\t\t configure enclave parameters')
 		print('load\t\t init the ORAM for substring search with file')
+		print('cancel\t\t stop the load in progress')
 		print('dump\t\t dump the session to restore it after client is closed')
 		print('close\t\t closes the session (invoked along with exit if not dumped)')
 		print('\nQUERY:')
 		print('query\t\t query the subtol server')
+		print('batch\t\t run several queries with a single request')
 		print('benchmark\t automatically query to gather benchmarks')
 		print('suffix\t\t progressively fetch portions of the suffix array')
+		print('range\t\t stream the suffix array entries of the last query')
 		print('\nCONSOLE:')
 		print('clear\t\t clear the screen')
 		print('help\t\t print this help')
@@ -85,7 +131,7 @@ class SubtolCli:
 
 	def __poll(self, args):
 		if len(args) == 0:
-			req = requests.get(self.url_base + '/poll', headers=self.session_cookie)
+			req = self.http.get(self.url_base + '/poll', headers=self.session_cookie)
 			
 			if req.status_code == 404:
 				print('Error: attestation context not found')
@@ -96,18 +142,28 @@ class SubtolCli:
 			else:
 				print(req.json()['error'])
 			
+			# progress of the last load, if any
+			if req.status_code in (200, 409) and 'load' in req.json():
+				prog = req.json()
+				percent = 100 * prog['bytes_decrypted'] // max(prog['bytes_total'], 1)
+				print('Load ' + prog['load'] + ': ' + str(prog['bytes_decrypted']) + '/' + str(prog['bytes_total']) +
+					' bytes decrypted (' + str(percent) + '%), ' + str(prog['blocks_inserted']) + ' blocks inserted')
+			
 		else:
 			print('poll requires no parameters')
 	
 	def __print_config_help(self):
-		print('config <oram_type> <Z> <stash> [S A] [rec_map_size] [sa_block_size]\n')
-		print('oram_type\t [circuit | ring | path]')
+		print('config <oram_type> <Z> <stash> [S A] [rec_map_size] [sa_block_size] [huge=<off|thp|2m|1g>] [mem=<MB>] [threads=<n>]\n')
+		print('oram_type\t [circuit | ring | path | ro_circuit | adaptive]')
 		print('Z\t\t number of valid records per bucket')
-		print('stash\t\t size of the stash')
+		print('stash\t\t size of the stash, ro_circuit needs at least 24 with Z = 2 and 16 otherwise')
 		print('[S]\t\t only for RingORAM - number of dummy blocks per bucket')
 		print('[A]\t\t only for RingORAM - eviction rate')
 		print('[rec_map_size]\t #pointers into recursive position map block - default 4')
 		print('[sa_block_size]\t #suffix-array entries into each block - default 256')
+		print('[huge]\t\t pages backing circuit ORAM trees, falls back to smaller ones - default off')
+		print('[mem]\t\t only for adaptive - memory budget in MB, 0 for none - default 0')
+		print('[threads]\t only for adaptive - worker threads of the engines - default 1')
 	
 	def __load(self, args):
 		if len(args) != 2:
@@ -149,13 +205,29 @@ class SubtolCli:
 		msg['payload'] = base64.b64encode(payload).decode('utf-8')
 		
 		jmsg = json.dumps(msg)
-		req = requests.post(self.url_base + '/load', headers=self.session_cookie, data=jmsg)
+		req = self.http.post(self.url_base + '/load', headers=self.session_cookie, data=jmsg)
 		
-		if req.status_code != 202:
+		if req.status_code == 503:
+			print('Server busy loading other indexes, try again later')
+		elif req.status_code != 202:
 			print(req.json()['error'])
 		else:
 			self.filename = args[0]
 	
+	def __cancel(self, args):
+		if len(args) != 0:
+			print('cancel requires no parameters')
+			return
+		
+		req = self.http.delete(self.url_base + '/load', headers=self.session_cookie)
+		
+		if req.status_code == 202:
+			print('Load cancelled, poll to see when it stops')
+		elif req.status_code == 409:
+			print('Load already over')
+		else:
+			print(req.json()['error'])
+	
 	def __benchmark(self, args):
 		if len(args) < 2 or len(args) > 3:
 			print('benchmark <string> <reps> <max_occ>' )
@@ -192,27 +264,15 @@ class SubtolCli:
 			# get encrypted password
 			enc_query = enc_query_mac[0:-16]
 			
-			# build json
-			msg = {}
-			msg['iv'] = base64.b64encode(iv).decode('utf-8')
-			msg['mac'] = base64.b64encode(mac).decode('utf-8')
-			msg['payload'] = base64.b64encode(enc_query).decode('utf-8')
-			
-			jmsg = json.dumps(msg)
-			req = requests.get(self.url_base + '/substring', headers=self.session_cookie, data=jmsg)
+			reply = self.__substring_call(iv, mac, enc_query)
 			
-			if req.status_code != 200:
-				print(req.json()['error'])
-			
-			else:
-				iv = base64.b64decode(req.json()['iv'])
-				data = base64.b64decode(req.json()['payload'])
+			if reply != None:
+				iv, mac, data = reply
 				
 				timediff = data[8:16]
 				timediff = int.from_bytes(timediff, byteorder='little', signed=True)
 				
-				data = data[0:8] + base64.b64decode(req.json()['mac'])
-				#data = base64.b64decode(req.json()['payload']) + base64.b64decode(req.json()['mac'])
+				data = data[0:8] + mac
 
 				try:
 					out = gcm.decrypt(iv, data, None)
@@ -232,21 +292,14 @@ class SubtolCli:
 			num_occ = timedelta = 0
 			while num_occ != max_occ and start < end:
 				num_occ += 1
-				req = requests.get(self.url_base + '/suffix', headers=self.session_cookie)
-			
+				reply = self.__suffix_call(start)
 			
-				if req.status_code != 200:
-					print(req.json()['error'])
-				else:
-					iv = base64.b64decode(req.json()['iv'])
-					data = base64.b64decode(req.json()['payload'])
-					
+				if reply != None:
+					iv, mac, data = reply
 					
 					timedelta += int.from_bytes(data[-8:], byteorder='little', signed=True)
 									
-					data = data[0:-8] + base64.b64decode(req.json()['mac'])
-				
-					#data = base64.b64decode(req.json()['payload']) + base64.b64decode(req.json()['mac'])
+					data = data[0:-8] + mac
 				
 					gcm = AESGCM(self.context.SK)
 					
@@ -275,22 +328,16 @@ class SubtolCli:
 			print('suffix requires no args')
 			return
 		
-		req = requests.get(self.url_base + '/suffix', headers=self.session_cookie)
-		
+		reply = self.__suffix_call(self.start)
 		
-		if req.status_code != 200:
-			print(req.json()['error'])
-		else:
-			iv = base64.b64decode(req.json()['iv'])
-			data = base64.b64decode(req.json()['payload'])
+		if reply != None:
+			iv, mac, data = reply
 			
 			timediff = data[-8:]
 			timediff = int.from_bytes(timediff, byteorder='little', signed=True)
 			print(timediff)
 			
-			data = data[0:-8] + base64.b64decode(req.json()['mac'])
-		
-			#data = base64.b64decode(req.json()['payload']) + base64.b64decode(req.json()['mac'])
+			data = data[0:-8] + mac
 		
 			gcm = AESGCM(self.context.SK)
 			
@@ -328,6 +375,59 @@ class SubtolCli:
 					print(str(suffix[i]))
 			
 
+	def __range(self, args):
+		if len(args) != 1 or not args[0].isdigit() or int(args[0]) == 0:
+			print('range <bound>: bound entries are returned, -1 past the last occurrence')
+			return
+		
+		gcm = AESGCM(self.context.SK)
+		
+		# the range of the last query travels encrypted, the bound does not
+		iv = os.urandom(12)
+		temp = self.start.to_bytes(4, byteorder='little', signed=True) + self.end.to_bytes(4, byteorder='little', signed=True)
+		enc_range_mac = gcm.encrypt(iv, temp, None)
+		mac = enc_range_mac[-16:]
+		enc_range = enc_range_mac[0:-16]
+		
+		headers = dict(self.session_cookie)
+		headers['Accept'] = 'application/octet-stream'
+		headers['Content-Type'] = 'application/octet-stream'
+		
+		body = len(enc_range).to_bytes(4, byteorder='little') + iv + mac + enc_range
+		req = self.http.get(self.url_base + '/suffix/range/' + args[0], headers=headers, data=body, stream=True)
+		
+		if req.status_code != 200:
+			print(req.json()['error'])
+			return
+		
+		# a sequence of binary frames, one per chunk
+		buf = b''
+		
+		for part in req.iter_content(chunk_size=None):
+			buf += part
+			
+			while len(buf) >= 32:
+				paylen = int.from_bytes(buf[0:4], byteorder='little')
+				
+				if len(buf) < 32 + paylen:
+					break
+				
+				try:
+					sa = gcm.decrypt(buf[4:16], buf[32:32 + paylen] + buf[16:32], None)
+				except InvalidTag:
+					print('MAC mismatch')
+					return
+				
+				buf = buf[32 + paylen:]
+				
+				for i in range(0, len(sa) // 4):
+					entry = int.from_bytes(sa[i*4:(i+1)*4], "little", signed=True)
+					if entry != -1:
+						print(entry)
+		
+		if len(buf) != 0:
+			print('Malformed binary reply')
+	
 	def __query(self, args):
 		if len(args) != 1:
 			print('query <string>')
@@ -352,27 +452,15 @@ class SubtolCli:
 		# get encrypted password
 		enc_query = enc_query_mac[0:-16]
 		
-		# build json
-		msg = {}
-		msg['iv'] = base64.b64encode(iv).decode('utf-8')
-		msg['mac'] = base64.b64encode(mac).decode('utf-8')
-		msg['payload'] = base64.b64encode(enc_query).decode('utf-8')
+		reply = self.__substring_call(iv, mac, enc_query)
 		
-		jmsg = json.dumps(msg)
-		req = requests.get(self.url_base + '/substring', headers=self.session_cookie, data=jmsg)
-		
-		if req.status_code != 200:
-			print(req.json()['error'])
-		
-		else:
-			iv = base64.b64decode(req.json()['iv'])
-			data = base64.b64decode(req.json()['payload'])
+		if reply != None:
+			iv, mac, data = reply
 			
 			timediff = data[8:16]
 			timediff = int.from_bytes(timediff, byteorder='little', signed=True)
 			
-			data = data[0:8] + base64.b64decode(req.json()['mac'])
-			#data = base64.b64decode(req.json()['payload']) + base64.b64decode(req.json()['mac'])
+			data = data[0:8] + mac
 
 			try:
 				out = gcm.decrypt(iv, data, None)
@@ -391,7 +479,85 @@ class SubtolCli:
 			
 			print(self.filename + ',' + self.oram_type + ',' + str(len(args[0])) + ',' + str(start) + ',' + str(end) + ',' + str(timediff))
 	
+	def __batch(self, args):
+		if len(args) == 0:
+			print('batch <string> [<string> ...]')
+			return
+		
+		if self.mapper == None:
+			if self.mapstr != None:
+				self.mapper = lambda x: self.mapstr.find(x).to_bytes(1, byteorder='little', signed=True)
+			else:
+				print('Cannot query the server: no character map defined')
+				return
+		
+		# <n> <length of each query> <queries back to back>, all encrypted at once
+		temp = len(args).to_bytes(4, byteorder='little')
+		temp += b''.join([len(a).to_bytes(4, byteorder='little') for a in args])
+		temp += b''.join([b''.join(list(map(self.mapper, a))) for a in args])
+		
+		iv = os.urandom(12)
+		
+		gcm = AESGCM(self.context.SK)
+		enc_query_mac = gcm.encrypt(iv, temp, None)
+		mac = enc_query_mac[-16:]
+		enc_query = enc_query_mac[0:-16]
+		
+		reply = self.__bin_call('/substring/batch', len(enc_query).to_bytes(4, byteorder='little') + iv + mac + enc_query)
+		
+		if reply != None:
+			iv, mac, data = reply
+			
+			timediff = int.from_bytes(data[-8:], byteorder='little', signed=True)
+			
+			try:
+				out = gcm.decrypt(iv, data[0:-8] + mac, None)
+			except InvalidTag:
+				print('MAC mismatch')
+				return
+			
+			for i in range(0, len(args)):
+				start = int.from_bytes(out[8*i:8*i+4], byteorder='little', signed=True)
+				end = int.from_bytes(out[8*i+4:8*i+8], byteorder='little', signed=True)
+				print(args[i] + ',' + str(start) + ',' + str(end))
+			
+			# the suffix array is then fetched for the last query
+			self.start = start
+			self.end = end
+			
+			print(self.filename + ',' + self.oram_type + ',' + str(len(args)) + ',' + str(timediff))
+	
 	def __config(self, args):
+		# optional huge=<page size> for the circuit ORAM trees, anywhere on the line
+		huge_pages = 0
+		huge_modes = ['off', 'thp', '2m', '1g']
+		
+		for arg in [a for a in args if a.startswith('huge=')]:
+			if arg[5:] not in huge_modes:
+				self.__print_config_help()
+				print('\nWrong huge page size')
+				return
+			
+			huge_pages = huge_modes.index(arg[5:])
+			args.remove(arg)
+		
+		# optional mem=<MB> and threads=<n> budgets of the adaptive ORAM
+		mem_budget = 0
+		threads = 1
+		
+		for arg in [a for a in args if a.startswith('mem=') or a.startswith('threads=')]:
+			try:
+				if arg.startswith('mem='):
+					mem_budget = int(arg[4:])
+				else:
+					threads = int(arg[8:])
+			except ValueError:
+				self.__print_config_help()
+				print('\nError parsing integers (mem and/or threads)')
+				return
+			
+			args.remove(arg)
+		
 		if len(args) < 3:
 			self.__print_config_help()
 			print('\nMissing arguments')
@@ -411,6 +577,10 @@ class SubtolCli:
 			oram_type =  4
 		elif args[0] == 'so_path':
 			oram_type =  5
+		elif args[0] == 'ro_circuit':
+			oram_type =  8
+		elif args[0] == 'adaptive':
+			oram_type =  9
 		else:
 			self.__print_config_help()
 			print('\nWrong ORAM type')
@@ -499,6 +669,9 @@ class SubtolCli:
 		blob += A.to_bytes(4, byteorder='little', signed=False)
 		blob += csize.to_bytes(4, byteorder='little', signed=False)
 		blob += sa_block.to_bytes(4, byteorder='little', signed=False)
+		blob += huge_pages.to_bytes(4, byteorder='little', signed=False)
+		blob += mem_budget.to_bytes(4, byteorder='little', signed=False)
+		blob += threads.to_bytes(4, byteorder='little', signed=False)
 		
 		s_blob = bytes(blob)
 		
@@ -514,7 +687,7 @@ class SubtolCli:
 		conf['mac'] = base64.b64encode(mac).decode('utf-8')
 		
 		jconf = json.dumps(conf)
-		req = requests.post(self.url_base + '/configure', headers=self.session_cookie, data=jconf)
+		req = self.http.post(self.url_base + '/configure', headers=self.session_cookie, data=jconf)
 		
 		if req.status_code != 200:
 			print(req.json()['error'])
@@ -523,7 +696,7 @@ class SubtolCli:
 	
 	def __exit(self, args):
 		if self.close_context:
-			req = requests.delete(self.url_base + '/close', headers=self.session_cookie)
+			req = self.http.delete(self.url_base + '/close', headers=self.session_cookie)
 		
 			if req.status_code != 200:
 				print(req.json()['error'])
@@ -559,13 +732,16 @@ class SubtolCli:
 		"clear": _SubtolCli__clear,
 		"poll": _SubtolCli__poll,
 		"load": _SubtolCli__load,
+		"cancel": _SubtolCli__cancel,
 		"query": _SubtolCli__query,
+		"batch": _SubtolCli__batch,
 		"benchmark": _SubtolCli__benchmark,
 		"info": _SubtolCli__info,
 		"help": _SubtolCli__help,
 		"close": _SubtolCli__exit,
 		"dump": _SubtolCli__dump,
 		"suffix": _SubtolCli__suffix,
+		"range": _SubtolCli__range,
 		"exit": None
 	}
 
@@ -612,5 +788,5 @@ class SubtolCli:
 			command(self, args)
 	
 	def qpoll(self):
-		req = requests.get(self.url_base + '/poll', headers=self.session_cookie)
+		req = self.http.get(self.url_base + '/poll', headers=self.session_cookie)
 		return req.status_code
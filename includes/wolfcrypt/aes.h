@@ -59,10 +59,16 @@ extern "C"
     word32 invokeCtr[2];
     word32 nonceSz;
     __attribute__ ((aligned (16))) byte H[AES_BLOCK_SIZE];
+    /* libs/libwolfssl.a is built with GCM_TABLE_4BIT */
+    __attribute__ ((aligned (16))) byte M0[32][AES_BLOCK_SIZE];
     byte use_aesni;
     word32 left;
     void *heap;
   } Aes;
+  /* offsets used by the bundled library: wc_AesInit stores heap at 0x348 */
+  static_assert (__builtin_offsetof (Aes, use_aesni) == 0x340
+		 && __builtin_offsetof (Aes, heap) == 0x348,
+		 "Aes does not match the layout of libs/libwolfssl.a");
   typedef struct Gmac
   {
     Aes aes;
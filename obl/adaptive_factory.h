@@ -0,0 +1,94 @@
+#ifndef ADAPTIVE_FACTORY_H
+#define ADAPTIVE_FACTORY_H
+
+#include "obl/oram.h"
+
+#include <cstddef>
+
+namespace obl
+{
+	// constants of the latency model, in nanoseconds
+	struct oram_cost_model_t
+	{
+		double bucket_fixed; // decrypt + re-encrypt of one bucket, size independent part
+		double bucket_byte;	 // same, per byte of bucket payload
+		double scan_fixed;	 // constant-time scan of one block (linear ORAM, stash)
+		double scan_byte;	 // same, per byte of block
+		double thread_sync;	 // dispatch + barrier of one MOSE worker
+	};
+
+	enum oram_engine_t
+	{
+		ENGINE_LINEAR = 0,
+		ENGINE_CIRCUIT,
+		ENGINE_MOSE
+	};
+
+	struct oram_shape_t
+	{
+		oram_engine_t engine;
+		unsigned int Z, S, T;
+		double latency;		// predicted time per access, ns
+		std::size_t memory; // predicted footprint, bytes
+	};
+
+	// predicted time of a circuit ORAM access (ns) and footprint of its tree and stash (bytes)
+	double circuit_latency(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S);
+	std::size_t circuit_memory(std::size_t N, std::size_t B, unsigned int Z, unsigned int S);
+
+	/*
+		Worker count in 1 ... max_T with the lowest predicted latency, 1 when parallelism
+		does not pay off. MOSE splits every block in T slices, each one its own circuit
+		ORAM; TaoStore overlaps the whole paths of concurrent requests.
+	*/
+	unsigned int mose_threads(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int max_T);
+	unsigned int taostore_threads(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int max_T);
+
+	/*
+		Factory choosing, for every spawned ORAM, the engine shape (linear, circuit with
+		its Z/S, MOSE with its thread count) with the lowest predicted access latency.
+		The prediction comes from a per-host cost model, either measured by calibrate()
+		or loaded from a previous calibration; the enclave cannot time itself, so there
+		the model must be loaded (or the built-in defaults are used).
+		Memory and threads are budgets for all the ORAMs spawned by the factory: each
+		spawn charges its predicted footprint and its MOSE workers. When no shape fits
+		in the residual memory, the smallest one is used.
+		This subsumes opt_allocator, whose threshold is linear_cutoff() here.
+	*/
+	class adaptive_factory : public oram_factory
+	{
+	private:
+		oram_cost_model_t model;
+		std::size_t mem_budget;
+		unsigned int thr_budget;
+
+	public:
+		adaptive_factory(std::size_t mem_budget, unsigned int thr_budget);
+		adaptive_factory(const oram_cost_model_t &model, std::size_t mem_budget, unsigned int thr_budget);
+
+		static oram_cost_model_t default_model();
+
+		// fit the model with a short microbenchmark of each engine, host only
+		static bool calibrate(oram_cost_model_t &model);
+
+		// "key value" text, one constant per line
+		static bool parse_model(const char *text, oram_cost_model_t &model);
+		static int dump_model(const oram_cost_model_t &model, char *text, std::size_t len);
+
+#ifndef SGX_ENCLAVE_ENABLED
+		static bool load_model(const char *path, oram_cost_model_t &model);
+		static bool save_model(const char *path, const oram_cost_model_t &model);
+#endif
+
+		// best shape under the residual budget, without spawning anything
+		oram_shape_t choose(std::size_t N, std::size_t B);
+		// largest N for which linear ORAM is still the fastest choice
+		std::size_t linear_cutoff(std::size_t B);
+
+		tree_oram *spawn_oram(std::size_t N, std::size_t B);
+		bool is_taostore() { return false; }
+	};
+
+} // namespace obl
+
+#endif // ADAPTIVE_FACTORY_H
@@ -0,0 +1,38 @@
+#ifndef OBL_BITSLICE_H
+#define OBL_BITSLICE_H
+
+#include <cstdint>
+
+#include "obl/primitives.h"
+
+namespace obl
+{
+	/*
+		Constant-time rank over a block of enc_bit-wide symbols stored bit-sliced: plane b
+		holds bit b of every symbol, 64 symbols per word, and planes are `words` words
+		apart. A symbol matches the target when all of its planes XNOR the target bits,
+		so a whole word of symbols is compared with enc_bit ANDs, then counted with a
+		popcount under the prefix mask. With AVX2 four words are processed at a time.
+	*/
+
+	// occurrences of target among the first limit symbols
+	int bitslice_rank(const std::uint64_t *planes, unsigned int words, unsigned int enc_bit, std::uint64_t target, unsigned int limit);
+
+	// bits of word w of a block that fall before limit
+	inline std::uint64_t prefix_mask(unsigned int w, unsigned int limit)
+	{
+		std::int64_t rem = (std::int64_t)limit - ((std::int64_t)w << 6);
+		std::uint64_t partial = ~0ULL >> ((64 - rem) & 63);
+
+		partial = ternary_op(rem >= 64, ~0ULL, partial);
+		return ternary_op(rem <= 0, 0ULL, partial);
+	}
+
+	inline unsigned int bitslice_words(unsigned int symbols)
+	{
+		return (symbols + 63) >> 6;
+	}
+
+} // namespace obl
+
+#endif // OBL_BITSLICE_H
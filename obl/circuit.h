@@ -10,6 +10,8 @@
 
 #include <wolfcrypt/aes.h>
 
+#include "obl/huge_allocator.h"
+
 #ifdef SGX_ENCLAVE_ENABLED
 #include "obl/sgx_host_allocator.hpp"
 #endif
@@ -22,26 +24,35 @@ namespace obl
 
 	class circuit_oram : public tree_oram
 	{
-	private:
+	protected:
 		typedef circuit_block_t block_t;
 		typedef circuit_bucket_t bucket_t;
 
 		std::size_t block_size;	 // aligned block size
 		std::size_t bucket_size; // aligned/padded encrypted bucket size
 
-		// stash
-		flexible_array<block_t> stash;
-		unsigned int S; // stash size
-
-// content of the ORAM
+		/*
+			The stash is kept in SoA layout: bids and leaf ids in two contiguous arrays
+			scanned by the stash_scan kernels, payloads apart and only swapped according
+			to the resulting masks. Entries from S to S_pad are padding.
+		*/
 #ifdef SGX_ENCLAVE_ENABLED
+		flexible_array<block_id> stash_bid;
+		flexible_array<leaf_id> stash_lid;
+		flexible_array<std::uint8_t> stash;
 		flexible_array<bucket_t, sgx_host_allocator> tree;
+		flexible_array<block_t> fetched_path;
 #else
-		flexible_array<bucket_t> tree;
+		flexible_array<block_id, huge_allocator> stash_bid;
+		flexible_array<leaf_id, huge_allocator> stash_lid;
+		flexible_array<std::uint8_t, huge_allocator> stash;
+		flexible_array<bucket_t, huge_allocator> tree;
+		flexible_array<block_t, huge_allocator> fetched_path;
 #endif
-
-		// fetched_path
-		flexible_array<block_t> fetched_path;
+		unsigned int S; // stash size
+		unsigned int S_pad;
+		std::size_t payload_size; // block_size without the bid/lid header
+		std::uint64_t *stash_mask;
 
 		// crypto stuff
 		void *_crypt_buffer;
@@ -69,11 +80,20 @@ namespace obl
 		bool has_free_block(block_t *bl, int len);
 		std::int64_t get_max_depth_bucket(block_t *bl, int len, leaf_id path);
 
+		// move blocks between the AoS block bl and the SoA stash
+		void stash_swap(bool cond, block_t *bl, unsigned int i);
+		void stash_extract(block_id bid, block_t *bl); // bl must be a dummy block
+		bool stash_insert(block_t *bl);
+
 		// split operation variables
 		std::int64_t leaf_idx_split;
 
+		// kept to re-apply the placement after grow
+		numa_policy_t numa;
+
 	public:
-		circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S);
+		// huge selects the pages backing the tree, see obl/huge_allocator.h
+		circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, huge_page_t huge = HUGE_OFF);
 		~circuit_oram();
 
 		void access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif);
@@ -85,23 +105,37 @@ namespace obl
 		// only write block into the stash and perfom evictions
 		void write(block_id bid, std::uint8_t *data_in, leaf_id next_lif);
 
+		// add tree levels in place, the new buckets are filled lazily by evictions
+		bool grow(std::size_t new_N);
+		bool can_grow() const { return true; }
+
+		// number of real blocks currently in the stash, used to size S
+		unsigned int stash_occupancy();
+
+		void numa_bind(const numa_policy_t &policy);
+
+		// page size the tree actually got, it may be smaller than the one requested
+		std::size_t tree_page_size();
+
 	};
 
 	class coram_factory : public oram_factory
 	{
 	private:
 		unsigned int Z, S;
+		huge_page_t huge;
 
 	public:
-		coram_factory(unsigned int Z, unsigned int S)
+		coram_factory(unsigned int Z, unsigned int S, huge_page_t huge = HUGE_OFF)
 		{
 			this->Z = Z;
 			this->S = S;
+			this->huge = huge;
 		}
 
 		tree_oram *spawn_oram(std::size_t N, std::size_t B)
 		{
-			return new circuit_oram(N, B, Z, S);
+			return new circuit_oram(N, B, Z, S, huge);
 		}
 		bool is_taostore() { return false; }
 	};
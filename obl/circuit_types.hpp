@@ -0,0 +1,28 @@
+#ifndef CIRCUIT_TYPES_H
+#define CIRCUIT_TYPES_H
+
+#include "obl/types.h"
+
+#include <cstdint>
+
+namespace obl
+{
+	// layouts of circuit_oram and of the variants sharing its tree (ro_circuit_oram)
+	struct circuit_block_t
+	{
+		block_id bid;
+		leaf_id lid;
+		std::uint8_t payload[];
+	};
+
+	struct circuit_bucket_t
+	{
+		obl_aes_gcm_128bit_iv_t iv;
+		bool reach_l, reach_r;
+		obl_aes_gcm_128bit_tag_t mac __attribute__((aligned(8)));
+		// since payload is going to be a multiple of 16 bytes, the struct will be memory aligned!
+		uint8_t payload[];
+	};
+}
+
+#endif // CIRCUIT_TYPES_H
@@ -49,6 +49,10 @@ public:
 	void reserve(std::size_t n);
 	void clear();
 
+	const alloc& get_allocator() const {
+		return mem;
+	}
+
 	// implicitly inlined
 	T& operator[](int idx) {
 		T *ptr = (T*)(raw_mem + idx * Tsize);
@@ -0,0 +1,48 @@
+#ifndef HUGE_ALLOCATOR_H
+#define HUGE_ALLOCATOR_H
+
+#include <cstddef>
+
+namespace obl
+{
+
+	// page size requested for an ORAM's tree, passed to the ORAM (or its factory) on creation
+	enum huge_page_t {
+		HUGE_OFF = 0, // plain malloc, base pages
+		HUGE_THP,     // anonymous mapping aligned to 2 MB + madvise(MADV_HUGEPAGE)
+		HUGE_2M,      // hugetlbfs 2 MB pages, falls back to THP
+		HUGE_1G,      // hugetlbfs 1 GB pages, falls back to 2 MB
+		HUGE_ALIGNED  // base pages, but page aligned and padded, for NUMA binding
+	};
+
+} // namespace obl
+
+/*
+	Allocator for flexible_array backing big trees/stashes with huge pages, so that a
+	random path fetch does not pay one dTLB miss per level.
+	HUGE_OFF is plain malloc with a small header, as line_allocator. Any other mode falls
+	back to the next smaller page size when the kernel refuses it (no reserved hugetlb
+	pages, THP disabled), down to page-aligned base pages. page_size() reports what the
+	last allocation actually got. Page-aligned payloads start and end on a page boundary,
+	with their header out of band, so they can be NUMA-bound without touching their
+	neighbours.
+	Host only: inside the enclave the tree lives in host memory through sgx_host_allocator,
+	which forwards the mode to the host_alloc ocall, served by this same allocator.
+*/
+class huge_allocator {
+private:
+	obl::huge_page_t mode;
+	std::size_t pg_size;
+
+public:
+	huge_allocator(obl::huge_page_t mode = obl::HUGE_OFF);
+
+	void* allocate(std::size_t s);
+	void deallocate(void *ptr);
+
+	std::size_t page_size() const {
+		return pg_size;
+	}
+};
+
+#endif // HUGE_ALLOCATOR_H
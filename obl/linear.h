@@ -10,26 +10,46 @@
 namespace obl
 {
 
-	struct linear_block_t;
+	// cache-line aligned storage, so that payload slots never straddle two lines
+	class line_allocator
+	{
+	public:
+		void *allocate(std::size_t s);
+		void deallocate(void *ptr);
+	};
 
+	/*
+		Every access scans the whole ORAM. Block ids are kept apart from the payloads
+		(SoA) so that the slot of the requested block is found with a SIMD compare over
+		the id array only; the payload pass then blends every slot against a single
+		buffer with full-width masked moves. Blocks are updated in place, a block that
+		is not there yet takes the first free slot.
+	*/
 	class linear_oram : public tree_oram
 	{
 	private:
-		typedef linear_block_t block_t;
+		flexible_array<block_id> bids;
+		flexible_array<std::uint8_t, line_allocator> payloads;
+
+		unsigned int S;		// number of slots, N
+		unsigned int S_pad; // slots rounded up to the SIMD width
+		std::size_t slot_size;
+
+		std::uint64_t *match_mask;
+		std::uint64_t *free_mask;
 
-		// stash
-		flexible_array<block_t> stash;
-		unsigned int S; // stash size
-		std::size_t block_size;
+		void scan(block_id bid, std::uint8_t *data_in, std::uint8_t *data_out);
 
 	public:
 		linear_oram(std::size_t N, std::size_t B);
-		~linear_oram() {}
+		~linear_oram();
 
 		void access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif);
 		void access_r(block_id bid, leaf_id lif, std::uint8_t *data_out);
 		void access_w(block_id bid, leaf_id lif, std::uint8_t *data_in, leaf_id next_lif);
 		void write(block_id bid, std::uint8_t *data_in, leaf_id next_lif);
+		bool grow(std::size_t new_N);
+		bool can_grow() const { return true; }
 
 		int printrec(node *t, int L, int l_index) { return 0; };
 		void printstash(){};
@@ -33,8 +33,11 @@ namespace obl
 
         unsigned int T_NUM;
 
-        unsigned int *block_idx;
-        threadpool_t *thpool;
+        // one pool per NUMA node in use, sub-ORAM i is served by thpool[pool_of[i]]
+        threadpool_t **thpool;
+        unsigned int no_pools;
+        unsigned int *pool_of;
+        void init_pools();
 
         //global varbiable shared between threads:
         pthread_cond_t cond_sign = PTHREAD_COND_INITIALIZER;
@@ -86,6 +89,9 @@ namespace obl
 
         // only write block into the stash and perfom evictions
         void write(block_id bid, std::uint8_t *data_in, leaf_id next_lif);
+
+        // BIND keeps every slice on one node, SPREAD places slice i and its worker on node (node + i) % nodes
+        void numa_bind(const numa_policy_t &policy);
     };
 
     class mose_factory : public oram_factory
@@ -121,18 +127,19 @@ namespace obl
         taostore_circuit_factory* fact;
 
     public:
-        asynch_mose_factory(unsigned int Z, unsigned int S, unsigned int T_NUM)
+        asynch_mose_factory(unsigned int Z, unsigned int S, unsigned int T_NUM, const oram_cost_model_t &model = adaptive_factory::default_model())
         {
             this->Z = Z;
             this->S = S;
             this->T_NUM = T_NUM;
-            fact = new taostore_circuit_factory(Z,S,T_NUM);
+            fact = new taostore_circuit_factory(Z,S,T_NUM,model);
         }
 
+        // MOSE only where the cost model finds slicing the blocks worth the synchronization
         tree_oram *spawn_oram(std::size_t N, std::size_t B)
         {
             T_NUM = fact->getT_NUM();
-            if (B > (1 << 9))
+            if (mose_threads(fact->get_model(), N, B, Z, S, T_NUM) > 1)
             {
                 return new mose(N, B, Z, S, T_NUM, fact);
             }
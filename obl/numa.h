@@ -0,0 +1,40 @@
+#ifndef OBL_NUMA_H
+#define OBL_NUMA_H
+
+#include <cstddef>
+#include <pthread.h>
+
+namespace obl
+{
+
+	enum numa_mode_t {
+		NUMA_OFF = 0, // leave placement to first touch
+		NUMA_BIND,    // storage and workers on policy.node
+		NUMA_SPREAD   // independent sub-ORAMs round robin over nodes, starting from policy.node
+	};
+
+	struct numa_policy_t {
+		numa_mode_t mode;
+		// target node, -1 stands for the node of the calling thread
+		int node;
+		// number of top tree levels interleaved over all nodes, since every thread crosses them
+		int interleave_levels;
+	};
+
+	// all of these are no-ops returning false/0 inside the enclave, where EPC placement
+	// is up to the SGX driver and host memory is not ours to bind
+	int numa_node_count();
+	int numa_current_node();
+
+	// only the pages of "align" bytes (0: base pages) lying entirely inside the range are
+	// bound, so that data sharing a page with it is never moved; storage meant to be bound
+	// should start and end on a page boundary, as huge_allocator arrays do
+	bool numa_bind_memory(void *addr, std::size_t len, int node, std::size_t align = 0);
+	bool numa_interleave_memory(void *addr, std::size_t len, std::size_t align = 0);
+
+	// restrict thread to the CPUs of node
+	bool numa_bind_thread(pthread_t thread, int node);
+
+} // namespace obl
+
+#endif // OBL_NUMA_H
@@ -0,0 +1,58 @@
+#ifndef NUMA_FACTORY_HPP
+#define NUMA_FACTORY_HPP
+
+#include "obl/oram.h"
+#include "obl/numa.h"
+
+#include <cstddef>
+
+namespace obl
+{
+	/*
+		Decorator applying a NUMA placement policy to every ORAM spawned by the inner factory.
+		With NUMA_BIND everything goes to policy.node; with NUMA_SPREAD consecutive ORAMs
+		(e.g. the levels of a recursive position map) start on consecutive nodes, and
+		engines with independent sub-ORAMs (mose) spread those as well.
+	*/
+	class numa_factory : public oram_factory
+	{
+	private:
+		oram_factory *inner_allocator;
+		numa_policy_t policy;
+		int next_node;
+
+	public:
+		numa_factory(oram_factory *a, numa_policy_t policy)
+		{
+			inner_allocator = a;
+			this->policy = policy;
+			next_node = policy.node < 0 ? numa_current_node() : policy.node;
+		}
+
+		tree_oram *spawn_oram(std::size_t N, std::size_t B)
+		{
+			tree_oram *o = inner_allocator->spawn_oram(N, B);
+			numa_policy_t p = policy;
+
+			if (policy.mode == NUMA_SPREAD)
+			{
+				p.node = next_node;
+				next_node = (next_node + 1) % numa_node_count();
+			}
+
+			o->numa_bind(p);
+
+			return o;
+		}
+
+		bool is_taostore() { return inner_allocator->is_taostore(); }
+
+		~numa_factory()
+		{
+			delete inner_allocator;
+		}
+	};
+
+} // namespace obl
+
+#endif // NUMA_FACTORY_HPP
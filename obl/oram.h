@@ -2,6 +2,7 @@
 #define ORAM_H
 
 #include "obl/taostore_types.hpp"
+#include "obl/numa.h"
 #include <cstdint>
 #include <cstddef>
 
@@ -53,6 +54,16 @@ namespace obl
 		// only write block into the stash and perfom evictions
 		virtual void write(block_id bid, std::uint8_t *data_in, leaf_id next_lif) = 0;
 
+		// enlarge the ORAM to hold new_N blocks in place; blocks already stored keep their leaf
+		// returns false if the engine does not support online resizing
+		virtual bool grow(std::size_t new_N) { return false; }
+		// whether grow is supported, so that callers can check before changing anything
+		virtual bool can_grow() const { return false; }
+
+		// place storage (and workers, if any) according to the NUMA policy
+		// engines that do not override this keep first-touch placement
+		virtual void numa_bind(const numa_policy_t &policy) {}
+
 	};
 
 	// used to implement the abstract factory design pattern
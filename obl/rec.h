@@ -2,6 +2,7 @@
 #define OBL_REC_H
 
 #include "obl/oram.h"
+#include "obl/primitives.h"
 
 #include <cstddef>
 
@@ -14,8 +15,30 @@ namespace obl
 		virtual ~recursive_oram() { };
 
 		virtual void access(block_id bid, std::uint8_t *data_in, std::uint8_t *data_out) = 0;
+
+		// k distinct bids, all within a window of span consecutive ids (0: no assumption)
+		// data_in may be nullptr for a read-only batch; by default one access per bid
+		virtual void access_batch(const block_id *bids, unsigned int k, std::uint8_t **data_in, std::uint8_t **data_out, std::size_t span = 0)
+		{
+			for (unsigned int j = 0; j < k; j++)
+				access(bids[j], data_in == nullptr ? nullptr : data_in[j], data_out[j]);
+		}
+
+		// enlarge the recursive ORAM to new_N blocks without reloading it
+		// must not run concurrently with access; returns false if unsupported
+		virtual bool grow(std::size_t new_N) { return false; }
 	};
 
+	/*
+		First bid of a window of k <= N consecutive ids holding bid, moved back so that it
+		ends by N. A window wrapping around to 0 needs a larger span, and so more accesses
+		in access_batch, which would tell whether bid is close to the end.
+	*/
+	inline block_id batch_window(block_id bid, unsigned int k, std::size_t N)
+	{
+		return ternary_op((std::size_t) bid + k > N, N - k, bid);
+	}
+
 } // namespace obl
 
 #endif // OBL_REC_H
@@ -0,0 +1,39 @@
+#ifndef OBL_REC_GROW_H
+#define OBL_REC_GROW_H
+
+#include "obl/oram.h"
+
+#include <pthread.h>
+#include <cstddef>
+
+namespace obl
+{
+
+	/*
+		The fields of a recursive position map that growing rewrites, shared by
+		recursive_oram_standard and taostore_position_map. Members are bound by
+		reference, so the owner sees the new levels.
+	*/
+	struct rec_map_view_t
+	{
+		std::size_t &C;
+		int &rmap_levs;
+		int rmap_csize;
+		int rmap_bits;
+		int &top_bits;
+		int *&lev_bits;
+		tree_oram **&rmap;
+		pthread_mutex_t *&rmap_locks;
+		leaf_id *pos_map;
+		oram_factory *allocator;
+	};
+
+	// whether every level touched while doubling up to new_C can grow; no side effects
+	bool rec_map_can_grow(const rec_map_view_t &m, std::size_t new_C);
+
+	// double the capacity until it reaches new_C, rec_map_can_grow must hold
+	void rec_map_grow(rec_map_view_t &m, std::size_t new_C);
+
+} // namespace obl
+
+#endif // OBL_REC_GROW_H
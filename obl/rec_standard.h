@@ -10,6 +10,8 @@
 namespace obl
 {
 
+	struct rec_batch_entry_t;
+
 	class recursive_oram_standard : public recursive_oram
 	{
 	protected:
@@ -24,13 +26,21 @@ namespace obl
 		// for the very last level
 		int rmap_opt;
 
+		// bits consumed by the in-enclave pos_map and by each level of the recursion
+		int top_bits;
+		int *lev_bits;
+
 		tree_oram **rmap;
 		tree_oram *oram;
 		pthread_mutex_t* rmap_locks;
 
 		leaf_id *pos_map;
 
+		// needed to spawn new recursion levels while growing
+		oram_factory *allocator;
+
 		leaf_id scan_map(leaf_id *map, int idx, leaf_id replacement, bool to_init);
+		void scan_map_batch(leaf_id *map, rec_batch_entry_t *e, unsigned int k, block_id node, bool node_valid, bool to_init);
 
 	public:
 		recursive_oram_standard() {};
@@ -38,6 +48,14 @@ namespace obl
 		~recursive_oram_standard();
 
 		void access(block_id bid, std::uint8_t *data_in, std::uint8_t *data_out);
+
+		/*
+			Walk the position map once for the whole batch: each recursion level is
+			accessed once per distinct block among the bids, padded with dummy accesses
+			to a count that only depends on k, span and the level.
+		*/
+		void access_batch(const block_id *bids, unsigned int k, std::uint8_t **data_in, std::uint8_t **data_out, std::size_t span = 0);
+		bool grow(std::size_t new_N);
 	};
 
 } // namespace obl
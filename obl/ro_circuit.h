@@ -0,0 +1,68 @@
+#ifndef RO_CIRCUIT_ORAM_H
+#define RO_CIRCUIT_ORAM_H
+
+#include "obl/circuit.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace obl
+{
+
+	/*
+		Read-optimized circuit ORAM, meant for the static indexes (SA, sampled BWT,
+		cbbst levels) that are loaded once with write() and then only queried.
+		The path fetched by access_r is already public and was picked uniformly at random,
+		so instead of just re-encrypting it we run two circuit eviction passes on it before
+		writing it back (metadata scans only, no extra crypto). This replaces one of the
+		two deterministic evictions, cutting the path fetch/re-encryption passes per
+		access from 6 to 4. See benchmarks/stash_stress for the stash size it needs.
+		write() keeps the standard two evictions, since it has no read path to reuse.
+	*/
+	/*
+		Smallest stash accepted for a given Z. benchmarks/stash_stress measured a peak
+		occupancy of 13, 4 and 2 blocks for Z = 2, 3 and 4; that is one run, not a bound
+		with negligible overflow probability. The floor is the stash the adaptive factory
+		uses for circuit_oram (16, 8, 8) plus 8 slots for the eviction riding on the read
+		path, i.e. 24, 16 and 16: at least 11 slots above the measured peak.
+	*/
+	inline unsigned int ro_circuit_min_stash(unsigned int Z)
+	{
+		return Z <= 2 ? 24 : 16;
+	}
+
+	class ro_circuit_oram : public circuit_oram
+	{
+	public:
+		// an overflowing stash traps in the enclave and loses blocks on the host, S below the floor is rejected
+		ro_circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, huge_page_t huge = HUGE_OFF);
+
+		void access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif);
+		void access_w(block_id bid, leaf_id lif, std::uint8_t *data_in, leaf_id next_lif);
+	};
+
+	class ro_coram_factory : public oram_factory
+	{
+	private:
+		unsigned int Z, S;
+		huge_page_t huge;
+
+	public:
+		// S is taken as is: configurations below ro_circuit_min_stash are rejected before getting here
+		ro_coram_factory(unsigned int Z, unsigned int S, huge_page_t huge = HUGE_OFF)
+		{
+			this->Z = Z;
+			this->S = S;
+			this->huge = huge;
+		}
+
+		tree_oram *spawn_oram(std::size_t N, std::size_t B)
+		{
+			return new ro_circuit_oram(N, B, Z, S, huge);
+		}
+		bool is_taostore() { return false; }
+	};
+
+} // namespace obl
+
+#endif // RO_CIRCUIT_ORAM_H
@@ -0,0 +1,29 @@
+#ifndef OBL_SCAN_H
+#define OBL_SCAN_H
+
+#include <cstdint>
+
+namespace obl
+{
+	/*
+		Constant-time kernels over small int32 tables (C arrays, sampled occurrences,
+		position map chunks): every entry is touched and the secret index only feeds
+		compares. With AVX2 8 entries are processed at a time with compare-to-mask and
+		blends, otherwise the same branchless code runs one entry at a time.
+	*/
+
+	// v[idx], or -1 if idx is not in [0, n)
+	std::int32_t scan_select(const std::int32_t *v, unsigned int n, std::int32_t idx);
+
+	// sum of v[i] for i < idx, modulo 2^32; idx is unsigned, so anything >= n sums everything
+	std::uint32_t scan_prefix_sum(const std::int32_t *v, unsigned int n, std::uint32_t idx);
+
+	/*
+		returns v[idx] (-1 if out of range); then clears every entry to -1 if to_init,
+		and stores replacement into v[idx] if write
+	*/
+	std::int32_t scan_update(std::int32_t *v, unsigned int n, std::int32_t idx, std::int32_t replacement, bool to_init, bool write);
+
+} // namespace obl
+
+#endif // OBL_SCAN_H
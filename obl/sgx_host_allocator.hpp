@@ -5,16 +5,27 @@
 
 #include <sgx_error.h>
 
+#include "obl/huge_allocator.h"
+
 // extern declarations for host malloc and free
 extern "C" sgx_status_t host_alloc(void **out, std::size_t s);
+extern "C" void host_alloc_huge(void **out, std::size_t s, int huge);
 extern "C" sgx_status_t host_free(void *in);
 extern "C" sgx_status_t ocall_stdout(const char* format_str, const char *str);
 
+// the host backs the memory with huge_allocator, so huge is honoured there
 class sgx_host_allocator {
+private:
+	obl::huge_page_t huge;
+
 public:
+	sgx_host_allocator(obl::huge_page_t huge = obl::HUGE_OFF) {
+		this->huge = huge;
+	}
+
 	void* allocate(std::size_t s) {
 		void *ptr;
-		host_alloc(&ptr, s);
+		host_alloc_huge(&ptr, s, huge);
 		return ptr;
 	}
 
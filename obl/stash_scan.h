@@ -0,0 +1,44 @@
+#ifndef OBL_STASH_SCAN_H
+#define OBL_STASH_SCAN_H
+
+#include "obl/oram.h"
+
+#include <cstdint>
+
+namespace obl
+{
+	/*
+		Constant-time kernels over a stash kept in SoA layout, i.e. block ids and leaf ids
+		in two separate int32 arrays. n must be a multiple of STASH_LANES; padding entries
+		carry STASH_PAD as bid so that they are neither valid nor free.
+		Masks hold one bit per entry, 64 entries per word. With AVX2 every kernel works on
+		8 entries per iteration, otherwise it falls back to the same branchless scalar code.
+	*/
+	#define STASH_LANES 8
+	#define STASH_PAD -2
+
+	// max over valid entries of get_max_depth(lid, path, L), -1 if no valid entry
+	std::int64_t stash_max_depth(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L);
+
+	// valid entries whose max depth along path equals depth (none if depth < 0)
+	void stash_depth_mask(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L, std::int64_t depth, std::uint64_t *mask);
+
+	// entries whose bid equals target, target == -1 (DUMMY) yields the free entries
+	void stash_match_mask(const block_id *bid, unsigned int n, block_id target, std::uint64_t *mask);
+
+	// keep only the lowest set bit of the whole mask, returns whether there was one
+	bool mask_keep_first(std::uint64_t *mask, unsigned int words);
+
+	inline bool mask_bit(const std::uint64_t *mask, unsigned int i)
+	{
+		return (mask[i >> 6] >> (i & 63)) & 1;
+	}
+
+	inline unsigned int mask_words(unsigned int n)
+	{
+		return (n + 63) >> 6;
+	}
+
+} // namespace obl
+
+#endif // OBL_STASH_SCAN_H
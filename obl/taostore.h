@@ -63,7 +63,7 @@ namespace obl
 		void *_crypt_buffer;
 		Aes *crypt_handle;
 
-		std::atomic_int32_t evict_path;
+		std::atomic_uint64_t evict_path;
 		std::atomic_uint64_t access_counter;
 
 		//path variables
@@ -2,6 +2,7 @@
 #define TAOSTORE_FACTORY
 
 #include "obl/oram.h"
+#include "obl/adaptive_factory.h"
 #include "obl/taostore_circuit_1.h"
 #include "obl/taostore_circuit_2.h"
 #include "obl/circuit.h"
@@ -9,60 +10,43 @@
 
 namespace obl
 {
+    /*
+        TaoStore circuit engines, each getting the workers the cost model finds worth
+        it out of a budget of T_NUM threads shared by all the spawned ORAMs. The first
+        worker of an ORAM is not charged. The wider pools go to taostore_circuit_2.
+    */
     class taostore_circuit_factory : public oram_factory
     {
     private:
         unsigned int Z, S, T_NUM;
+        oram_cost_model_t model;
 
     public:
-        taostore_circuit_factory(unsigned int Z, unsigned int S, unsigned int T_NUM)
+        taostore_circuit_factory(unsigned int Z, unsigned int S, unsigned int T_NUM, const oram_cost_model_t &model = adaptive_factory::default_model())
         {
             this->Z = Z;
             this->S = S;
             this->T_NUM = T_NUM;
+            this->model = model;
         }
         unsigned int getT_NUM()
         {
             return this->T_NUM;
         }
+        const oram_cost_model_t &get_model()
+        {
+            return model;
+        }
 
         tree_oram *spawn_oram(std::size_t N, std::size_t B)
         {
-            if (N < (1 << 10))
-            {
-                return new taostore_circuit_1(N, B, Z, S, 1);
-            }
+            unsigned int T = taostore_threads(model, N, B, Z, S, T_NUM + 1);
+            T_NUM -= T - 1;
+
+            if (T <= 3)
+                return new taostore_circuit_1(N, B, Z, S, T);
             else
-            {
-                if (B < (1 << 10))
-                {
-                    if (T_NUM >= 2)
-                    {
-                        T_NUM = T_NUM - 2;
-                        return new taostore_circuit_1(N, B, Z, S, 3);
-                    }
-                    else
-                    {
-                        int tmp = T_NUM;
-                        T_NUM = 0;
-                        return new taostore_circuit_1(N, B, Z, S, tmp + 1);
-                    }
-                }
-                else
-                {
-                    if (T_NUM >= 4)
-                    {
-                        T_NUM = T_NUM - 4;
-                        return new taostore_circuit_2(N, B, Z, S, 5);
-                    }
-                    else
-                    {
-                        int tmp = T_NUM;
-                        T_NUM = 0;
-                        return new taostore_circuit_2(N, B, Z, S, tmp + 1);
-                    }
-                }
-            }
+                return new taostore_circuit_2(N, B, Z, S, T);
         }
 
         bool is_taostore() { return false; }
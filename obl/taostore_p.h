@@ -77,7 +77,7 @@ namespace obl
 
 		bool oram_alive;
 		std::atomic_int32_t thread_id;
-		std::atomic_int32_t evict_path;
+		std::atomic_uint64_t evict_path;
 		std::atomic_uint64_t access_counter;
 
 		//path variables
@@ -23,11 +23,18 @@ namespace obl
 		// for the very last level
 		int rmap_opt;
 
+		// bits consumed by the in-enclave pos_map and by each level of the recursion
+		int top_bits;
+		int *lev_bits;
+
 		tree_oram **rmap;
 		pthread_mutex_t *rmap_locks;
 
 		leaf_id *pos_map;
 
+		// needed to spawn new recursion levels while growing
+		oram_factory *allocator;
+
 		leaf_id scan_map(leaf_id *map, int idx, leaf_id replacement, bool to_init, bool fake);
 
 	public:
@@ -35,6 +42,9 @@ namespace obl
 		~taostore_position_map();
 
 		leaf_id access(block_id bid, bool fake, leaf_id *_ev_leef);
+
+		// enlarge the position map to new_N entries, must not run concurrently with access
+		bool grow(std::size_t new_N);
 	};
 
 } // namespace obl
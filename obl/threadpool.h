@@ -82,6 +82,16 @@ threadpool_t *threadpool_create(int thread_count, int queue_size, int flags);
 int threadpool_add(threadpool_t *pool, void (*routine)(void *),
                    void *arg, int flags);
 
+/**
+ * @function threadpool_bind_node
+ * @brief pin all the worker threads of a pool to the CPUs of a NUMA node
+ * @param pool  Thread pool to bind.
+ * @param node  NUMA node, -1 for the node of the calling thread.
+ * @return 0 if all goes well, threadpool_thread_failure if the affinity
+ * could not be set (e.g. inside the enclave).
+ */
+int threadpool_bind_node(threadpool_t *pool, int node);
+
 /**
  * @function threadpool_destroy
  * @brief Stops and destroys a thread pool.
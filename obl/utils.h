@@ -29,6 +29,15 @@ inline int get_max_depth(obl::leaf_id leaf, obl::leaf_id path, int L)
 	return __builtin_ctzll((leaf ^ path) | (1ULL << L));
 }
 
+// leaf of the g-th deterministic eviction path of circuit ORAM
+// paths are encoded LSB-first (bit i selects the child at depth i), so walking g modulo 2^L
+// with no further permutation already visits the leaves in reverse-lexicographic order,
+// i.e. the bit-reversal of the MSB-first enumeration used in the circuit ORAM paper
+inline obl::leaf_id rev_lex_leaf(std::uint64_t g, int L)
+{
+	return (obl::leaf_id) (g & ((1ULL << L) - 1));
+}
+
 inline std::size_t pad_bytes(std::size_t s, unsigned int align)
 {
 	return s + (align - (s % align)) % align;
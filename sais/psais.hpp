@@ -0,0 +1,609 @@
+#ifndef PSAIS_H
+#define PSAIS_H
+
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "sais.hpp"
+
+// max buckets of the counting sort that starts parallel_sa
+#define PSAIS_BUCKETS (1 << 16)
+// below this size sorting, merging and scanning are not worth a thread
+#define PSAIS_GRAIN (1 << 16)
+
+// Interface functions
+
+/*
+      Description: multi-threaded counterparts of the sais.hpp functions, for the strings
+      too long to be preprocessed in reasonable time by a single thread. Same arguments
+      as the single-threaded version, plus "threads", the number of threads to use
+      (1 runs everything in the calling thread); results are identical.
+*/
+
+/*
+      Description: build the suffix array of a given string by prefix doubling.
+      Suffixes are bucketed by their first few characters (counting sort, at most
+      PSAIS_BUCKETS buckets), each bucket is sorted by as many following characters as
+      a 64-bit word can pack, then the groups sharing a prefix of h characters are
+      sorted by the rank of the suffix starting h characters later, doubling h until
+      no two suffixes share a group.
+      O(n log n) work instead of the O(n) of sais, but every step is parallel: large
+      groups are sorted by a parallel merge sort, small ones are spread among threads.
+      Groups are sorted as (key, suffix) pairs, so that no comparison chases a pointer.
+
+      Memory: besides the string and sa, two more arrays of "length+1" Int, the list
+      of the groups still unsorted and two pairs of 8 + sizeof(Int) bytes for each row
+      of the largest group sorted by all threads (one pair for the other groups).
+*/
+template<typename Char, typename Int>
+inline
+void parallel_sa(Char *s, Int length, Int alphabet_size, Int *sa, int threads);
+
+template<typename Int>
+inline
+void parallel_inverse_sa(Int *sa, Int *isa, Int length, int threads);
+
+// as build_psi, sa might point to the same location of psi
+template<typename Int>
+inline
+void parallel_build_psi(Int *sa, Int *isa, Int *psi, Int length, int threads);
+
+template<typename Char, typename Int>
+inline
+void parallel_build_bwt(Char *s, Int *sa, Char *bwt, Int length, Int *dummy, int threads);
+
+// subtrees below the top log2(threads) levels are flattened by different threads
+template<typename Int>
+inline
+void parallel_flatten(Int *v, Int *heap, std::size_t idx, std::size_t N, int threads);
+
+/*
+      Description: samples are split among threads; the occurrences each thread starts
+      from are found by a first counting pass over the rows of the other threads
+*/
+template<typename Char, typename Int>
+inline
+void parallel_sampled_bwt(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, int threads);
+
+template<typename Char, typename Int>
+inline
+void parallel_sampled_kbwt(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, int threads);
+
+// Static functions
+
+// group of suffix-array rows sharing the same prefix
+struct psais_group_t {
+   std::size_t begin;
+   std::size_t end;
+};
+
+// suffix and the key it is being sorted by
+template<typename Int>
+struct psais_pair_t {
+   std::uint64_t key;
+   Int idx;
+};
+
+/*
+      parallel_chunks
+         Split 0 ... n-1 into "threads" contiguous chunks and call fn(t, begin, end) on
+         each of them, chunk 0 in the calling thread. Chunks only depend on n and threads.
+*/
+template<typename Fn>
+static void parallel_chunks(int threads, std::size_t n, Fn fn)
+{
+   std::vector<std::thread> workers;
+
+   if(threads < 1)
+      threads = 1;
+
+   for(int t = 1; t < threads; t++)
+      workers.emplace_back(fn, t, n * t / threads, n * (t+1) / threads);
+
+   fn(0, 0, n / threads);
+
+   for(auto &w: workers)
+      w.join();
+}
+
+// how many threads a job of n items deserves
+static inline int psais_threads(std::size_t n, int threads)
+{
+   std::size_t useful = n / PSAIS_GRAIN + 1;
+   return useful < (std::size_t) threads ? (int) useful : threads;
+}
+
+/*
+      parallel_merge
+         Merge a[0 ... n1-1] and b[0 ... n2-1] into out, splitting the longer run at its
+         middle and the other one where the middle element would go. Not stable.
+*/
+template<typename T, typename Less>
+static void parallel_merge(T *a, std::size_t n1, T *b, std::size_t n2, T *out, Less less, int threads)
+{
+   if(n1 < n2)
+   {
+      std::swap(a, b);
+      std::swap(n1, n2);
+   }
+
+   if(threads <= 1 || n1 + n2 < PSAIS_GRAIN)
+   {
+      std::merge(a, a + n1, b, b + n2, out, less);
+      return;
+   }
+
+   std::size_t m1 = n1 / 2;
+   std::size_t m2 = std::lower_bound(b, b + n2, a[m1], less) - b;
+
+   out[m1 + m2] = a[m1];
+
+   std::thread left(parallel_merge<T,Less>, a, m1, b, m2, out, less, threads / 2);
+   parallel_merge<T,Less>(a + m1 + 1, n1 - m1 - 1, b + m2, n2 - m2, out + m1 + m2 + 1, less, threads - threads / 2);
+   left.join();
+}
+
+/*
+      parallel_sort
+         Merge sort of v[0 ... n-1], buff being a scratch area of n elements
+*/
+template<typename T, typename Less>
+static void parallel_sort(T *v, T *buff, std::size_t n, Less less, int threads)
+{
+   if(threads <= 1 || n < PSAIS_GRAIN)
+   {
+      std::sort(v, v + n, less);
+      return;
+   }
+
+   std::size_t half = n / 2;
+
+   std::thread left(parallel_sort<T,Less>, v, buff, half, less, threads / 2);
+   parallel_sort<T,Less>(v + half, buff + half, n - half, less, threads - threads / 2);
+   left.join();
+
+   parallel_merge<T,Less>(v, half, v + half, n - half, buff, less, threads);
+
+   parallel_chunks(psais_threads(n, threads), n, [v, buff](int, std::size_t begin, std::size_t end) {
+      std::copy(buff + begin, buff + end, v + begin);
+   });
+}
+
+/*
+      sort_group
+         Sort the rows begin ... end-1 of a group by key(suffix), store the sorted
+         suffixes back into sa and, for each row, the first row of its new group into
+         heads. pairs is a scratch area of end-begin pairs, twice as much if threads > 1.
+*/
+template<typename Int, typename Key>
+static void sort_group(Int *sa, Int *heads, std::size_t begin, std::size_t end, Key key, psais_pair_t<Int> *pairs, int threads)
+{
+   std::size_t rows = end - begin;
+   int no_threads = psais_threads(rows, threads);
+
+   auto less = [](const psais_pair_t<Int> &a, const psais_pair_t<Int> &b) {
+      return a.key < b.key;
+   };
+
+   parallel_chunks(no_threads, rows, [&](int, std::size_t lo, std::size_t hi) {
+      for(std::size_t x = lo; x < hi; x++)
+      {
+         pairs[x].idx = sa[begin + x];
+         pairs[x].key = key(pairs[x].idx);
+      }
+   });
+
+   parallel_sort(pairs, pairs + rows, rows, less, no_threads);
+
+   parallel_chunks(no_threads, rows, [&](int, std::size_t lo, std::size_t hi) {
+      if(lo == hi)
+         return;
+
+      std::size_t head = lo;
+      while(head > 0 && pairs[head].key == pairs[head-1].key)
+         --head;
+
+      for(std::size_t x = lo; x < hi; x++)
+      {
+         if(x > 0 && pairs[x].key != pairs[x-1].key)
+            head = x;
+
+         sa[begin + x] = pairs[x].idx;
+         heads[begin + x] = begin + head;
+      }
+   });
+}
+
+/*
+      rank_rows
+         Given the rows begin ... end-1 of a group sorted by a finer key, with
+         same_prev(x) telling whether row x has the same key as row x-1, give the suffixes
+         of rows lo ... hi-1 the rank of the first row of their new group and append to
+         "unsorted" the new groups with more than one row beginning there
+*/
+template<typename Int, typename Same>
+static void rank_rows(Int *sa, Int *rank, std::size_t begin, std::size_t end, std::size_t lo, std::size_t hi, Same same_prev, std::vector<psais_group_t> &unsorted)
+{
+   if(lo == hi)
+      return;
+
+   // a group spanning two chunks is reported by the chunk where it begins
+   std::size_t head = lo;
+   while(head > begin && same_prev(head))
+      --head;
+
+   for(std::size_t x = lo; x < hi; x++)
+   {
+      if(x > begin && !same_prev(x))
+      {
+         if(head >= lo && x - head > 1)
+            unsorted.push_back({head, x});
+
+         head = x;
+      }
+
+      rank[sa[x]] = head;
+   }
+
+   if(head >= lo)
+   {
+      std::size_t x = hi;
+      while(x < end && same_prev(x))
+         ++x;
+
+      if(x - head > 1)
+         unsorted.push_back({head, x});
+   }
+}
+
+// rank_rows over a whole group, split among threads
+template<typename Int, typename Same>
+static void rank_group(Int *sa, Int *rank, std::size_t begin, std::size_t end, Same same_prev, std::vector<psais_group_t> &unsorted, int threads)
+{
+   int no_threads = psais_threads(end - begin, threads);
+   std::vector<std::vector<psais_group_t>> found(no_threads);
+
+   parallel_chunks(no_threads, end - begin, [&](int t, std::size_t lo, std::size_t hi) {
+      rank_rows(sa, rank, begin, end, begin + lo, begin + hi, same_prev, found[t]);
+   });
+
+   for(auto &f: found)
+      unsorted.insert(unsorted.end(), f.begin(), f.end());
+}
+
+// Implementation of interface functions
+
+/*
+      refine_groups
+         Sort every group of "unsorted" by key, then rank the suffixes by their new
+         groups and replace "unsorted" with the new groups having more than one row.
+         key may read rank: ranks only change once every group is sorted.
+*/
+template<typename Int, typename Key>
+static void refine_groups(Int *sa, Int *rank, Int *heads, std::vector<psais_group_t> &unsorted, Key key, int threads)
+{
+   std::vector<psais_group_t> next;
+   std::vector<psais_group_t> large, small;
+   std::size_t total = 0;
+   std::size_t small_total = 0;
+
+   for(auto &g: unsorted)
+      total += g.end - g.begin;
+
+   // large groups get every thread, one after the other, small ones a thread each
+   for(auto &g: unsorted)
+      if((g.end - g.begin) * threads >= total && g.end - g.begin >= PSAIS_GRAIN)
+         large.push_back(g);
+      else
+      {
+         small.push_back(g);
+         small_total += g.end - g.begin;
+      }
+
+   unsorted.clear();
+   unsorted.shrink_to_fit();
+
+   // the small groups are split into runs of about the same number of rows
+   int no_threads = psais_threads(small_total, threads);
+   std::vector<std::size_t> cut(no_threads + 1, small.size());
+   std::size_t acc = 0;
+
+   cut[0] = 0;
+   for(std::size_t g = 0, t = 1; g < small.size() && t < (std::size_t) no_threads; g++)
+   {
+      acc += small[g].end - small[g].begin;
+
+      while(t < (std::size_t) no_threads && acc * no_threads >= small_total * t)
+         cut[t++] = g + 1;
+   }
+
+   for(auto &g: large)
+   {
+      std::vector<psais_pair_t<Int>> pairs(2 * (g.end - g.begin));
+      sort_group(sa, heads, g.begin, g.end, key, pairs.data(), threads);
+   }
+
+   parallel_chunks(no_threads, no_threads, [&](int t, std::size_t, std::size_t) {
+      std::vector<psais_pair_t<Int>> pairs;
+
+      for(std::size_t g = cut[t]; g < cut[t+1]; g++)
+      {
+         if(pairs.size() < small[g].end - small[g].begin)
+            pairs.resize(small[g].end - small[g].begin);
+
+         sort_group(sa, heads, small[g].begin, small[g].end, key, pairs.data(), 1);
+      }
+   });
+
+   auto same_prev = [heads](std::size_t x) {
+      return heads[x-1] == heads[x];
+   };
+
+   for(auto &g: large)
+      rank_group(sa, rank, g.begin, g.end, same_prev, next, threads);
+
+   std::vector<std::vector<psais_group_t>> found(no_threads);
+
+   parallel_chunks(no_threads, no_threads, [&](int t, std::size_t, std::size_t) {
+      for(std::size_t g = cut[t]; g < cut[t+1]; g++)
+         rank_rows(sa, rank, small[g].begin, small[g].end, small[g].begin, small[g].end, same_prev, found[t]);
+   });
+
+   for(auto &f: found)
+      next.insert(next.end(), f.begin(), f.end());
+
+   unsorted.swap(next);
+}
+
+// Implementation of interface functions
+
+template<typename Char, typename Int>
+void parallel_sa(Char *s, Int length, Int alphabet_size, Int *sa, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+   std::size_t len = length;
+   // characters are coded 1 ... alphabet_size, the terminator (and anything past it) 0
+   std::size_t radix = (std::size_t) alphabet_size + 1;
+
+   // characters of the bucket codes and of the packed keys
+   std::size_t d = 0;
+   std::size_t no_buckets = 1;
+   std::size_t bits = 1;
+
+   while(no_buckets * radix <= PSAIS_BUCKETS)
+   {
+      no_buckets *= radix;
+      ++d;
+   }
+
+   while(((std::uint64_t) 1 << bits) < radix)
+      ++bits;
+
+   std::size_t packed = 64 / bits;
+
+   auto bucket = [s, len, d, radix](std::size_t i) {
+      std::size_t code = 0;
+
+      for(std::size_t j = 0; j < d; j++)
+         code = code * radix + (i + j < len ? (std::size_t) s[i + j] + 1 : 0);
+
+      return code;
+   };
+
+   auto text_key = [s, len, d, bits, packed](std::size_t i) {
+      std::uint64_t key = 0;
+
+      for(std::size_t j = d; j < d + packed; j++)
+         key = (key << bits) | (i + j < len ? (std::uint64_t) s[i + j] + 1 : 0);
+
+      return key;
+   };
+
+   // counting sort: bucket b of thread t goes after the buckets before b and after
+   // bucket b of the threads before t
+   int no_threads = psais_threads(n, threads);
+   std::vector<std::size_t> count(no_threads * no_buckets, 0);
+   std::vector<psais_group_t> unsorted;
+
+   parallel_chunks(no_threads, n, [&](int t, std::size_t begin, std::size_t end) {
+      for(std::size_t i = begin; i < end; i++)
+         ++count[t * no_buckets + bucket(i)];
+   });
+
+   for(std::size_t b = 0, acc = 0; b < no_buckets; b++)
+   {
+      std::size_t start = acc;
+
+      for(int t = 0; t < no_threads; t++)
+      {
+         std::size_t prev = count[t * no_buckets + b];
+         count[t * no_buckets + b] = acc;
+         acc += prev;
+      }
+
+      // singletons too, every suffix needs a rank
+      if(acc != start)
+         unsorted.push_back({start, acc});
+   }
+
+   parallel_chunks(no_threads, n, [&](int t, std::size_t begin, std::size_t end) {
+      for(std::size_t i = begin; i < end; i++)
+         sa[count[t * no_buckets + bucket(i)]++] = i;
+   });
+
+   count.clear();
+   count.shrink_to_fit();
+
+   Int * const rank = new Int[n];
+   Int * const heads = new Int[n];
+
+   refine_groups(sa, rank, heads, unsorted, text_key, threads);
+
+   // rows of a group share their first h characters, rank[i+h] sorts them by 2h;
+   // a suffix reaching the terminator within h characters is alone in its group,
+   // so i+h never goes past the end
+   for(std::size_t h = d + packed; !unsorted.empty(); h <<= 1)
+      refine_groups(sa, rank, heads, unsorted, [rank, h](std::size_t i) {
+         return (std::uint64_t) rank[i + h];
+      }, threads);
+
+   delete[] rank;
+   delete[] heads;
+}
+
+template<typename Int>
+void parallel_inverse_sa(Int *sa, Int *isa, Int length, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+
+   parallel_chunks(psais_threads(n, threads), n, [sa, isa](int, std::size_t begin, std::size_t end) {
+      for(std::size_t i = begin; i < end; i++)
+         isa[sa[i]] = i;
+   });
+}
+
+template<typename Int>
+void parallel_build_psi(Int *sa, Int *isa, Int *psi, Int length, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+
+   // psi[i] only depends on sa[i], so psi can overwrite sa
+   parallel_chunks(psais_threads(n, threads), n, [sa, isa, psi](int, std::size_t begin, std::size_t end) {
+      for(std::size_t i = begin > 0 ? begin : 1; i < end; i++)
+         psi[i] = isa[(std::size_t) sa[i] + 1];
+   });
+
+   psi[0] = (Int)-1;
+}
+
+template<typename Char, typename Int>
+void parallel_build_bwt(Char *s, Int *sa, Char *bwt, Int length, Int *dummy, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+
+   // a single row holds the terminator, only its thread writes dummy
+   parallel_chunks(psais_threads(n, threads), n, [s, sa, bwt, dummy](int, std::size_t begin, std::size_t end) {
+      for(std::size_t i = begin; i < end; i++)
+      {
+         if(sa[i])
+            bwt[i] = s[(std::size_t) sa[i] - 1];
+         else
+            *dummy = i;
+      }
+   });
+}
+
+template<typename Int>
+void parallel_flatten(Int *v, Int *heap, std::size_t idx, std::size_t N, int threads)
+{
+   if(threads <= 1 || N < PSAIS_GRAIN)
+   {
+      flatten(v, heap, idx, N);
+      return;
+   }
+
+   std::size_t middle = get_subroot(N);
+
+   heap[idx] = v[middle];
+
+   std::thread left(parallel_flatten<Int>, v, heap, (idx << 1) + 1, middle, threads / 2);
+   parallel_flatten(v + middle + 1, heap, (idx << 1) + 2, N - 1 - middle, threads - threads / 2);
+   left.join();
+}
+
+template<typename Char, typename Int>
+void parallel_sampled_bwt(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+   std::size_t alpha = alphabet_size;
+   std::size_t no_iters = n / s_rate + (n % s_rate == 0 ? 0 : 1);
+   int no_threads = psais_threads(n, threads);
+
+   if(no_threads > (int) no_iters)
+      no_threads = no_iters;
+
+   Int *ch_count = new Int[no_threads * alpha];
+
+   // occurrences in the rows of each thread
+   parallel_chunks(no_threads, no_iters, [&](int t, std::size_t first, std::size_t last) {
+      Int *count = ch_count + t * alpha;
+      std::size_t end = last * s_rate < n ? last * s_rate : n;
+
+      for(std::size_t a = 0; a < alpha; a++)
+         count[a] = 0;
+
+      for(std::size_t idx = first * s_rate; idx < end; idx++)
+         if(idx != (std::size_t) dummy)
+            ++count[(Int) bwt[idx]];
+   });
+
+   // occurrences before the rows of each thread
+   for(std::size_t a = 0; a < alpha; a++)
+   {
+      Int acc = 0;
+
+      for(int t = 0; t < no_threads; t++)
+      {
+         Int prev = ch_count[t * alpha + a];
+         ch_count[t * alpha + a] = acc;
+         acc += prev;
+      }
+   }
+
+   parallel_chunks(no_threads, no_iters, [&](int t, std::size_t first, std::size_t last) {
+      sampled_bwt_range<Char,Int>(bwt, length, alphabet_size, dummy, s_rate, bit_enc, sample_size, blob + first * sample_size, first, last, ch_count + t * alpha);
+   });
+
+   delete[] ch_count;
+}
+
+template<typename Char, typename Int>
+void parallel_sampled_kbwt(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, int threads)
+{
+   std::size_t n = (std::size_t) length + 1;
+   std::size_t table_size = kmer_table_size(alphabet_size, k);
+   std::size_t no_iters = n / s_rate + (n % s_rate == 0 ? 0 : 1);
+   int no_threads = psais_threads(n, threads);
+
+   if(no_threads > (int) no_iters)
+      no_threads = no_iters;
+
+   Int *ch_count = new Int[no_threads * table_size];
+
+   // occurrences in the rows of each thread, the codes are thrown away
+   parallel_chunks(no_threads, no_iters, [&](int t, std::size_t first, std::size_t last) {
+      Int *count = ch_count + t * table_size;
+      std::size_t end = last * s_rate < n ? last * s_rate : n;
+
+      for(std::size_t e = 0; e < table_size; e++)
+         count[e] = 0;
+
+      for(std::size_t idx = first * s_rate; idx < end; idx++)
+         kbwt_row<Char,Int>(s, sa, length, alphabet_size, k, bit_enc, idx, count);
+   });
+
+   // occurrences before the rows of each thread
+   for(std::size_t e = 0; e < table_size; e++)
+   {
+      Int acc = 0;
+
+      for(int t = 0; t < no_threads; t++)
+      {
+         Int prev = ch_count[t * table_size + e];
+         ch_count[t * table_size + e] = acc;
+         acc += prev;
+      }
+   }
+
+   parallel_chunks(no_threads, no_iters, [&](int t, std::size_t first, std::size_t last) {
+      sampled_kbwt_range<Char,Int>(s, sa, length, alphabet_size, k, s_rate, bit_enc, sample_size, blob + first * sample_size, first, last, ch_count + t * table_size);
+   });
+
+   delete[] ch_count;
+}
+
+#endif
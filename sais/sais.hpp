@@ -131,8 +131,10 @@ void write_index(Char *bwt, Int length, Int alphabet_size, Int dummy, Int **indi
 
 /*
       Description: creates the Vanilla BWT occurrences matrix sampling it every
-      "sample_size" rows. Moreover, it compresses each character in the bwt using
-      bit_enc bits in a bitarray composed of several 16-bit words.
+      "sample_size" rows. Moreover, it stores the bwt characters of each window
+      bit-sliced: bit_enc bitplanes, plane b holding bit b of every character,
+      64 characters per 64-bit word. Padding characters (past the end of the bwt and
+      the terminator) get the dummy code, all ones.
 
       bwt            -- BWT of the original string
       length         -- length of the original string
@@ -144,14 +146,69 @@ void write_index(Char *bwt, Int length, Int alphabet_size, Int dummy, Int **indi
       blob           -- raw memory to write data to
 
       N.B.: blob has a precise sizing:
-         sizeof(Int) * alphabet_size + sizeof(std::uint16_t) * A,
-         where A is the number of 16-bit words necessary to store s_rate bwt
-         characters encoded with bit_enc bits
+         sizeof(Int) * alphabet_size, rounded up to 8 bytes,
+         + sizeof(std::uint64_t) * bit_enc * W,
+         where W = ceil(s_rate / 64) is the number of words of each bitplane
 */
 template<typename Char, typename Int>
 inline
 void sampled_bwt(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob);
 
+/*
+      Description: number of entries of the k-mer tables, i.e. one entry for each m-mer
+      with 1 <= m <= k. m-mers are stored after all the (m-1)-mers, and inside their
+      section the m-mer whose last character is r_0, second last r_1, ... has index
+      r_0 + r_1 * alphabet_size + ... + r_(m-1) * alphabet_size^(m-1)
+*/
+inline
+std::size_t kmer_table_size(std::size_t alphabet_size, std::size_t k);
+
+/*
+      Description: k-mer version of bucket_index; for each m-mer (1 <= m <= k) report
+      the leading index of its range into the suffix array
+
+      Arguments:
+
+      s               -- original string
+      length          -- length of the string
+      alphabet_size   -- size of the alphabet - terminator NOT included!!!
+      k               -- maximum k-mer length
+      buckets         -- pointer to an array of "kmer_table_size(alphabet_size, k)" Int
+
+      N.B.: uses a temporary table of (alphabet_size + 1)^k entries
+*/
+template<typename Char, typename Int>
+inline
+void kmer_bucket_index(Char *s, Int length, Int alphabet_size, std::size_t k, Int *buckets);
+
+/*
+      Description: k-step version of sampled_bwt. Instead of the BWT character, each row
+      of the suffix array stores the k characters preceding its suffix, each one encoded
+      with bit_enc bits (the character right before the suffix in the lowest bits).
+      Characters before the beginning of the string get the dummy code (all ones).
+      Each sampled block starts with the occurrences of every m-mer (1 <= m <= k) in the
+      preceding rows, laid out as in kmer_table_size, then s_rate row codes packed into
+      64-bit words, 64 / (k * bit_enc) codes per word, none straddling two words.
+
+      s              -- original string
+      sa             -- suffix array of the string
+      length         -- length of the original string
+      alphabet_size  -- size of the alphabet (terminator excluded)
+      k              -- number of characters per row
+      s_rate         -- sampling rate
+      bit_enc        -- number of bits devoted to each character
+      sample_size    -- byte size of each sampled block of data
+      blob           -- raw memory to write data to
+
+      N.B.: blob has a precise sizing:
+         sizeof(Int) * kmer_table_size(alphabet_size, k), rounded up to 8 bytes,
+         + sizeof(std::uint64_t) * W,
+         where W is the number of 64-bit words necessary to store s_rate row codes
+*/
+template<typename Char, typename Int>
+inline
+void sampled_kbwt(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob);
+
 // Static functions
 
 template<typename Char, typename Int>
@@ -166,6 +223,15 @@ static void mod_place_LMS(Char *s, Int length, const Int *buckets, Int alphabet_
 template<typename Char, typename Int>
 static Int tag_LMS_prefix(Char *s, Int *LMS_positions, Int *induced_LMS_positions, Int no_LMS, Int *sa, Int length);
 
+template<typename Char, typename Int>
+static void sampled_bwt_range(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, std::size_t first, std::size_t last, Int *ch_count);
+
+template<typename Char, typename Int>
+static std::uint64_t kbwt_row(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t bit_enc, std::size_t idx, Int *ch_count);
+
+template<typename Char, typename Int>
+static void sampled_kbwt_range(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, std::size_t first, std::size_t last, Int *ch_count);
+
 // Implementation of static functions
 
 /*
@@ -440,6 +506,159 @@ static Int tag_LMS_prefix(Char *s, Int *LMS_positions, Int *induced_LMS_position
    return current_tag + 1;
 }
 
+/*
+      sampled_bwt_range
+         Write samples first ... last-1 of sampled_bwt, blob pointing to sample first.
+         ch_count holds the occurrences in the rows before the first sample, and the
+         ones up to the last sample on return.
+*/
+template<typename Char, typename Int>
+static void sampled_bwt_range(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, std::size_t first, std::size_t last, Int *ch_count)
+{
+   std::size_t idx = first * s_rate;
+   std::uint64_t dummy_ch = (1 << bit_enc) - 1;
+
+   // size of the sample of ch_count to be copied at the beginning of the sampling window
+   std::size_t ch_offset = sizeof(Int) * alphabet_size;
+   ch_offset = (ch_offset + 7) & ~((std::size_t) 7);
+
+   // words of each bitplane
+   std::size_t words = (s_rate + 63) / 64;
+
+   for(std::size_t i = first; i < last; i++)
+   {
+      // sample the vector of occurrences
+      std::memset(blob, 0x00, ch_offset);
+      std::memcpy(blob, ch_count, sizeof(Int) * alphabet_size);
+
+      std::uint64_t *planes = (std::uint64_t*)((std::uint8_t*)blob + ch_offset);
+
+      for(std::size_t w = 0; w < bit_enc * words; w++)
+         planes[w] = 0;
+
+      for(std::size_t j = 0; j < words * 64; j++)
+      {
+         std::uint64_t c;
+
+         // account for character, the tail of the last word is padding
+         if(j < s_rate && idx != (std::size_t) dummy && idx <= (std::size_t) length)
+         {
+            c = (Int) bwt[idx];
+            ++ch_count[c];
+         }
+         else
+            c = dummy_ch;
+
+         // scatter the character bits over the bitplanes
+         for(std::size_t b = 0; b < bit_enc; b++)
+            planes[b * words + j / 64] |= ((c >> b) & 1) << (j % 64);
+
+         if(j < s_rate)
+            ++idx;
+      }
+
+      // jump to the next sample
+      blob += sample_size;
+   }
+}
+
+/*
+      kbwt_row
+         Row code of sampled_kbwt for suffix-array row idx, accounting its m-mers into
+         ch_count
+*/
+template<typename Char, typename Int>
+static std::uint64_t kbwt_row(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t bit_enc, std::size_t idx, Int *ch_count)
+{
+   std::uint64_t dummy_ch = (1 << bit_enc) - 1;
+   std::uint64_t code = 0;
+
+   if(idx > (std::size_t) length)
+   {
+      for(std::size_t m = 0; m < k; m++)
+         code |= dummy_ch << (m * bit_enc);
+
+      return code;
+   }
+
+   Int pos = sa[idx];
+   std::size_t offset = 0;
+   std::size_t pw = 1;
+   std::size_t d = 0;
+
+   for(std::size_t m = 0; m < k; m++)
+   {
+      bool real = pos > (Int) m;
+      std::uint64_t c = real ? (std::uint64_t) s[pos - m - 1] : dummy_ch;
+
+      code |= c << (m * bit_enc);
+
+      // account for the (m+1)-mer ending right before the suffix
+      if(real)
+      {
+         d += c * pw;
+         ++ch_count[offset + d];
+      }
+
+      pw *= alphabet_size;
+      offset += pw;
+
+      // shorter prefix not available, neither is any longer one
+      if(!real)
+      {
+         for(std::size_t mm = m + 1; mm < k; mm++)
+            code |= dummy_ch << (mm * bit_enc);
+
+         break;
+      }
+   }
+
+   return code;
+}
+
+/*
+      sampled_kbwt_range
+         Same as sampled_bwt_range, for sampled_kbwt
+*/
+template<typename Char, typename Int>
+static void sampled_kbwt_range(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob, std::size_t first, std::size_t last, Int *ch_count)
+{
+   std::size_t table_size = kmer_table_size(alphabet_size, k);
+   std::size_t idx = first * s_rate;
+
+   std::size_t code_bits = k * bit_enc;
+   std::size_t per_word = 64 / code_bits;
+
+   // size of the sample of ch_count to be copied at the beginning of the sampling window
+   std::size_t ch_offset = sizeof(Int) * table_size;
+   ch_offset = (ch_offset + 7) & ~((std::size_t) 7);
+
+   for(std::size_t i = first; i < last; i++)
+   {
+      // sample the occurrences
+      std::memset(blob, 0x00, ch_offset);
+      std::memcpy(blob, ch_count, sizeof(Int) * table_size);
+
+      std::uint64_t *codes = (std::uint64_t*)(blob + ch_offset);
+      std::size_t no_words = (s_rate + per_word - 1) / per_word;
+
+      for(std::size_t w = 0; w < no_words; w++)
+         codes[w] = 0;
+
+      for(std::size_t j = 0; j < s_rate; j++)
+      {
+         std::uint64_t code = kbwt_row<Char,Int>(s, sa, length, alphabet_size, k, bit_enc, idx, ch_count);
+
+         codes[j / per_word] |= code << ((j % per_word) * code_bits);
+
+         ++idx;
+      }
+
+      // jump to the next sample
+      blob += sample_size;
+   }
+}
+
 // Implementation of interface functions
 
 template<typename Char, typename Int>
@@ -652,58 +871,110 @@ void write_index(Char *bwt, Int length, Int alphabet_size, Int dummy, Int **indi
 template<typename Char, typename Int>
 void sampled_bwt(Char *bwt, Int length, Int alphabet_size, Int dummy, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob)
 {
-   Int ch_count[alphabet_size];
-   Int idx = 0;
-   std::uint16_t dummy_ch = (1 << bit_enc) - 1;
-
-   // size of the sample of ch_count to be copied at the beginning of the sampling window
-   std::size_t ch_offset = sizeof(Int) * alphabet_size;
+   Int *ch_count = new Int[alphabet_size];
+   std::size_t no_iters = ((std::size_t) length+1) / s_rate + (((std::size_t) length+1) % s_rate == 0 ? 0 : 1);
 
    for(Int i = 0; i < alphabet_size; i++)
       ch_count[i] = 0;
 
-   Int no_iters = (length+1) / s_rate + ((length+1) % s_rate == 0 ? 0 : 1);
+   sampled_bwt_range<Char,Int>(bwt, length, alphabet_size, dummy, s_rate, bit_enc, sample_size, blob, 0, no_iters, ch_count);
+
+   delete[] ch_count;
+}
 
-   for(Int i = 0; i < no_iters; i++)
+std::size_t kmer_table_size(std::size_t alphabet_size, std::size_t k)
+{
+   std::size_t size = 0;
+   std::size_t pw = 1;
+
+   for(std::size_t m = 1; m <= k; m++)
    {
-      // sample the vector of occurrences
-      std::memcpy(blob, ch_count, ch_offset);
+      pw *= alphabet_size;
+      size += pw;
+   }
+
+   return size;
+}
+
+template<typename Char, typename Int>
+void kmer_bucket_index(Char *s, Int length, Int alphabet_size, std::size_t k, Int *buckets)
+{
+   std::size_t radix = alphabet_size + 1;
+   std::size_t keys = 1;
+
+   for(std::size_t m = 0; m < k; m++)
+      keys *= radix;
 
-      std::uint16_t *ch = (std::uint16_t*)((std::uint8_t*)blob + ch_offset);
-      int shift_left = 0;
-      int hword = 0;
-      ch[0] = 0;
+   std::size_t *less = new std::size_t[keys];
+   std::size_t offset = 0;
+   std::size_t no_mers = 1;
+   std::size_t m_keys = 1;
 
-      for(unsigned int j = 0; j < s_rate; j++)
+   for(std::size_t m = 1; m <= k; m++)
+   {
+      // key of the first m characters of each suffix, the terminator (and anything past
+      // it) being the smallest digit; keys compare like the suffixes they come from
+      m_keys *= radix;
+
+      for(std::size_t i = 0; i < m_keys; i++)
+         less[i] = 0;
+
+      // the terminator suffix is counted as well
+      for(Int i = 0; i <= length; i++)
       {
-         std::uint16_t c;
+         std::size_t key = 0;
 
-         // account for character
-         if(idx != dummy && idx <= length)
-         {
-            c = (Int) bwt[idx];
-            ++ch_count[c];
-         }
-         else
-            c = dummy_ch;
+         for(std::size_t j = 0; j < m; j++)
+            key = key * radix + (i + j < length ? (std::size_t) s[i + j] + 1 : 0);
 
-         // compress character into bitvector
-         ch[hword] = ch[hword] | (c << shift_left);
-         shift_left += bit_enc;
+         ++less[key];
+      }
+
+      for(std::size_t i = 0, acc = 0; i < m_keys; i++)
+      {
+         std::size_t prev = less[i];
+         less[i] = acc;
+         acc += prev;
+      }
+
+      no_mers *= alphabet_size;
 
-         if(shift_left >= 16 && j != s_rate - 1)
+      for(std::size_t d = 0; d < no_mers; d++)
+      {
+         // d has the last character in its lowest digit, the key has it in its lowest one too
+         std::size_t key = 0;
+         std::size_t pw = 1;
+         std::size_t tmp = d;
+
+         for(std::size_t j = 0; j < m; j++)
          {
-            ++hword;
-            shift_left -= 16;
-            ch[hword] = c >> (bit_enc - shift_left);
+            key += (tmp % alphabet_size + 1) * pw;
+            tmp /= alphabet_size;
+            pw *= radix;
          }
 
-         ++idx;
+         buckets[offset + d] = less[key];
       }
 
-      // jump to the next sample
-      blob += sample_size;
+      offset += no_mers;
    }
+
+   delete[] less;
+}
+
+template<typename Char, typename Int>
+void sampled_kbwt(Char *s, Int *sa, Int length, Int alphabet_size, std::size_t k, std::size_t s_rate, std::size_t bit_enc, std::size_t sample_size, std::uint8_t *blob)
+{
+   std::size_t table_size = kmer_table_size(alphabet_size, k);
+   Int *ch_count = new Int[table_size];
+   std::size_t no_iters = ((std::size_t) length+1) / s_rate + (((std::size_t) length+1) % s_rate == 0 ? 0 : 1);
+
+   for(std::size_t i = 0; i < table_size; i++)
+      ch_count[i] = 0;
+
+   sampled_kbwt_range<Char,Int>(s, sa, length, alphabet_size, k, s_rate, bit_enc, sample_size, blob, 0, no_iters, ch_count);
+
+   delete[] ch_count;
 }
 
 #endif
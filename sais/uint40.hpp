@@ -0,0 +1,55 @@
+#ifndef UINT40_H
+#define UINT40_H
+
+#include <cstdint>
+
+/*
+      Description: 40-bit unsigned integer, packed in 5 bytes, to be used as the Int of
+      sais and friends when a string is too long for 32-bit indices but 64-bit ones
+      would waste 3 bytes per entry (e.g. a 4 GB text: 1 TB is the limit).
+      Arithmetic is carried out on std::uint64_t and truncated back to 40 bits on
+      assignment, so (uint40_t)-1 is all ones, as 0xFF...FF memsets expect.
+      The default constructor leaves the value uninitialized like a built-in, so large
+      arrays cost nothing to allocate.
+*/
+struct __attribute__((packed)) uint40_t {
+   std::uint32_t lo;
+   std::uint8_t hi;
+
+   uint40_t() = default;
+
+   uint40_t(std::uint64_t v)
+   {
+      lo = (std::uint32_t) v;
+      hi = (std::uint8_t) (v >> 32);
+   }
+
+   operator std::uint64_t() const
+   {
+      return ((std::uint64_t) hi << 32) | lo;
+   }
+
+   uint40_t& operator+=(std::uint64_t v) { return *this = (std::uint64_t) *this + v; }
+   uint40_t& operator-=(std::uint64_t v) { return *this = (std::uint64_t) *this - v; }
+
+   uint40_t& operator++() { return *this += 1; }
+   uint40_t& operator--() { return *this -= 1; }
+
+   uint40_t operator++(int)
+   {
+      uint40_t old = *this;
+      *this += 1;
+      return old;
+   }
+
+   uint40_t operator--(int)
+   {
+      uint40_t old = *this;
+      *this -= 1;
+      return old;
+   }
+};
+
+static_assert(sizeof(uint40_t) == 5, "uint40_t must be packed");
+
+#endif
@@ -32,10 +32,10 @@ public:
 		return ret;
 	}
 	
-	sgx_status_t call_loader(sgx_ra_context_t ctx, void *fp, std::uint8_t *passphrase, std::uint8_t *iv, std::uint8_t *mac)
+	sgx_status_t call_loader(sgx_ra_context_t ctx, void *fp, void *progress, std::uint8_t *passphrase, std::uint8_t *iv, std::uint8_t *mac)
 	{
 		sgx_status_t ret;
-		loader(eid, &ret, ctx, fp, passphrase, iv, mac);
+		loader(eid, &ret, ctx, fp, progress, passphrase, iv, mac);
 		
 		return ret;
 	}
@@ -56,10 +56,26 @@ public:
 		return ret;
 	}
 	
-	sgx_status_t call_fetch_sa(sgx_ra_context_t ctx, std::int32_t **sa, std::size_t *len, std::uint8_t *iv, std::uint8_t *mac)
+	sgx_status_t call_query_batch(sgx_ra_context_t ctx, std::uint8_t *q, std::size_t len, std::uint8_t *iv, std::uint8_t *mac, std::int32_t *res, std::size_t res_len, std::size_t *n)
 	{
 		sgx_status_t ret;
-		fetch_sa(eid, &ret, ctx, sa, len, iv, mac);
+		query_batch(eid, &ret, ctx, q, len, iv, mac, res, res_len, n);
+		
+		return ret;
+	}
+	
+	sgx_status_t call_fetch_sa(sgx_ra_context_t ctx, std::uint8_t *cursor, std::int32_t **sa, std::size_t *len, std::uint8_t *iv, std::uint8_t *mac)
+	{
+		sgx_status_t ret;
+		fetch_sa(eid, &ret, ctx, cursor, sa, len, iv, mac);
+		
+		return ret;
+	}
+	
+	sgx_status_t call_fetch_sa_range(sgx_ra_context_t ctx, std::uint8_t *range, std::uint8_t *range_iv, std::uint8_t *range_mac, std::size_t offset, std::uint8_t *iv, std::uint8_t *mac, std::int32_t *sa, std::size_t len)
+	{
+		sgx_status_t ret;
+		fetch_sa_range(eid, &ret, ctx, range, range_iv, range_mac, offset, iv, mac, sa, len);
 		
 		return ret;
 	}
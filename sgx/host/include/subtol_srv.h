@@ -4,20 +4,81 @@
 #include "toy_server.h"
 
 #include <unordered_map>
+#include <list>
+#include <mutex>
+#include <thread>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <cstdio>
+#include <vector>
 
 #include "subtol_enclave.h"
 #include "toy_server_request.h"
 
 #include "sgx_key_exchange.h"
 
+// length, iv and mac of a binary frame
+#define BIN_FRAME_HEADER 32
+// max queries of a /substring/batch call, keep in sync with the enclave
+#define QUERY_BATCH_MAX 1024
+// suffix-array entries per chunk of /suffix/range, keep in sync with the enclave
+#define SA_RANGE_CHUNK_MAX 65536
+// loads running at once; a load takes up to LOAD_MAX_LANES + 2 enclave threads, which
+// along with the query threads must fit TCSNum
+#define LOADER_THREADS 1
+// estimated memory of a load per byte of index file: ORAM trees hold about twice
+// the blocks they store, plus block headers and position maps
+#define LOAD_MEMORY_FACTOR 3
+
 struct subtol_session_t {
 	sgx_ra_context_t attestation_context;
 	// book-keeping of the interactions between client and server
 	int phase;
 };
 
+// progress of a load, written by the enclave; keep in sync with the enclave
+struct load_progress_t {
+	std::atomic<std::uint64_t> bytes_decrypted;
+	std::atomic<std::uint64_t> blocks_inserted;
+	std::atomic<std::uint32_t> cancel;
+};
+
+enum load_phase_t {
+	LOAD_QUEUED,
+	LOAD_RUNNING,
+	LOAD_DONE,
+	LOAD_FAILED,
+	LOAD_CANCELLED
+};
+
+// last load of a session, kept until the next one or until the session is closed
+struct load_state_t {
+	load_progress_t progress;
+	std::atomic<int> phase;
+	std::uint64_t bytes_total;
+	// memory admitted for the load, given back when it ends
+	std::size_t reserved;
+
+	load_state_t(std::uint64_t bytes_total, std::size_t reserved): bytes_total(bytes_total), reserved(reserved) {
+		progress.bytes_decrypted.store(0);
+		progress.blocks_inserted.store(0);
+		progress.cancel.store(0);
+		phase.store(LOAD_QUEUED);
+	}
+};
+
+// state of a /suffix/range stream, the range itself stays encrypted
+struct sa_stream_t {
+	sgx_ra_context_t attestation_context;
+	std::uint8_t range[8];
+	std::uint8_t range_iv[12];
+	std::uint8_t range_mac[16];
+	// entries returned whatever the range, chosen by the client
+	std::size_t bound;
+	std::size_t offset;
+};
+
 class subtol_srv: public toy_server {
 private:
 	// embedded enclave
@@ -30,26 +91,43 @@ private:
 	// access methods for session store
 	std::unique_ptr<subtol_session_t> get_context_handle(const std::string &session_id, bool &found);
 	void restore_context_handle(const std::string &session_id, std::unique_ptr<subtol_session_t> &pl);
+	// queries run concurrently on a session, they only need a copy of it
+	bool share_context_handle(const std::string &session_id, bool &found, subtol_session_t &shared);
+	
+	/*
+		Loads run on a pool of their own, so that they never starve the queries of the
+		enclave pool. A load is admitted only if its estimated memory fits the budget
+		along with the loads already admitted (queued or running), or if it is alone;
+		the others get a 503.
+	*/
+	asio::thread_pool loader_pool;
+	std::mutex load_guard;
+	std::unordered_map<std::string, std::shared_ptr<load_state_t>> loads;
+	std::size_t load_budget;
+	std::size_t load_reserved;
+	
+	std::shared_ptr<load_state_t> get_load_state(const std::string &session_id);
 	
 	// http parsing
-	void process_headers(std::istream &request, http_request_t &proc);
 	std::list<std::string> parse_cookie_header(std::string &cookies);
 	
 	// API calls
-	void process_api_calls(http_request_t &proc, std::istream &request);
-	
 	void start_session(http_request_t &proc);
 	void attestation(http_request_t &proc, std::istream &request);
 	void poll(http_request_t &proc);
 	void configure(http_request_t &proc, std::istream &request);
 	void close(http_request_t &proc);
 	void load(http_request_t &proc, std::istream &request);
+	void cancel_load(http_request_t &proc);
 	void substring(http_request_t &proc, std::istream &request);
-	void suffix(http_request_t &proc);
+	void substring_batch(http_request_t &proc, std::istream &request);
+	void suffix(http_request_t &proc, std::istream &request);
+	void suffix_range(http_request_t &proc, std::istream &request);
+	// next chunk of a stream into the response body
+	sgx_status_t sa_range_chunk(http_request_t &proc, sa_stream_t &st);
 	
-	void async_loader(std::string sess_id, subtol_session_t *sess,
-		std::unique_ptr<std::uint8_t[]> payload, std::size_t payload_size,
-		std::unique_ptr<std::uint8_t[]> iv, std::unique_ptr<std::uint8_t[]> mac);
+	void async_loader(std::string sess_id, subtol_session_t *sess, FILE *fp, std::shared_ptr<load_state_t> st,
+		std::vector<std::uint8_t> passphrase, std::vector<std::uint8_t> iv, std::vector<std::uint8_t> mac);
 	
 	// message exchange
 	
@@ -61,16 +139,29 @@ private:
 	// common format for other exchanged data
 	void bin_msg_in(char *json_msg, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t **payload, std::size_t *size);
 	void bin_msg_out(asio::streambuf &response, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t *payload, std::size_t size);
+	
+	/*
+		application/octet-stream framing for substring and suffix, all integers little endian:
+		<payload length: uint32> <iv: 12 bytes> <mac: 16 bytes> <payload>
+		bin_frame_in does not copy, the payload points into the request body.
+	*/
+	void bin_frame_in(http_request_t &proc, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t **payload, std::size_t *size);
+	void bin_frame_out(http_request_t &proc, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t *payload, std::size_t size);
+	
+	// {"load": phase, "bytes_total", "bytes_decrypted", "blocks_inserted"}
+	void load_progress_out(asio::streambuf &response, load_state_t &st);
 
 protected:
-	void process_request(asio::ip::tcp::socket &client);
+	void process_headers(std::istream &request, http_request_t &proc);
+	void process_api_calls(http_request_t &proc, std::istream &request);
 
 public:
-	explicit subtol_srv(std::uint16_t port_number): toy_server(port_number) {
-		encl.init_enclave();
-	}
+	explicit subtol_srv(std::uint16_t port_number);
 
 	~subtol_srv() { }
+	
+	// bytes of memory the admitted loads may use at once, defaults to the physical memory
+	void set_load_budget(std::size_t bytes) { load_budget = bytes; }
 };
 
 #endif // SUBTOL_SRV_H
@@ -1,17 +1,87 @@
 #ifndef TOY_SERVER_H
 #define TOY_SERVER_H
 
-#include <list>
-
 #include <cstdint>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <istream>
+#include <deque>
+#include <string>
 
 #include "asio.hpp"
+#include "toy_server_request.h"
+
+// max requests of a connection read ahead of the one being served
+#define PIPELINE_DEPTH 16
+// default seconds after which an idle connection is closed
+#define IDLE_TIMEOUT 60
+
+class toy_server;
+
+/*
+	State of a single client connection. Requests are read ahead while the previous
+	ones are being served (HTTP/1.1 pipelining), but they are served and answered
+	strictly in order, one at a time, so that e.g. a /suffix follows the query it
+	refers to. Concurrent queries of a session come from concurrent connections.
+	All the handlers of a connection run in its strand, except
+	the API call itself which runs on the blocking executor of the server.
+	The object dies when the last handler releases it.
+*/
+class toy_connection: public std::enable_shared_from_this<toy_connection> {
+private:
+	toy_server *srv;
+	asio::ip::tcp::socket client;
+	asio::io_context::strand strand;
+	asio::steady_timer idle_timer;
+
+	// read-end of the socket, may hold bytes of the next requests
+	asio::streambuf socket_in;
+	// write-end of the socket
+	asio::streambuf socket_out;
+
+	// request whose body is being read
+	std::unique_ptr<http_request_t> incoming;
+	// requests waiting for the enclave
+	std::deque<std::unique_ptr<http_request_t>> pending;
+	// request being served
+	std::unique_ptr<http_request_t> serving;
+	// served requests waiting to be written
+	std::deque<std::unique_ptr<http_request_t>> replies;
+
+	// session of the last request, used when a request carries no cookie
+	std::string session_id;
+
+	bool reading, writing;
+	// no more requests will be read
+	bool closing;
+
+	bool idle() const;
+	void arm_timer();
+	void on_timer(const asio::error_code &error);
 
+	void read_headers();
+	void on_headers(const asio::error_code &error);
+	void on_body(const asio::error_code &error);
+	void resume_reading();
+
+	void serve_next();
+	void on_served();
+
+	void write_next();
+	void on_written(const asio::error_code &error);
+	void write_chunk(bool more);
+	void on_chunk_written(const asio::error_code &error, bool more);
+	void shutdown();
+
+public:
+	toy_connection(toy_server *srv, asio::ip::tcp::socket client);
+
+	void start();
+};
 
 class toy_server {
+	friend class toy_connection;
+
 private:
 	// killswitch
 	std::atomic<bool> run_server;
@@ -21,17 +91,20 @@ private:
 	asio::io_context cont;
 	asio::ip::tcp::acceptor server_socket;
 
-	// Pending HTTP requests
-	std::mutex requests_mutex;
-	std::condition_variable no_requests;
-	std::list<asio::ip::tcp::socket> pending_requests;
-	
+	// blocking executor for the enclave calls, never run on the network threads
+	std::unique_ptr<asio::thread_pool> enclave_pool;
+
+	// seconds a connection may stay without requests in flight
+	int idle_timeout;
+
 	// private methods
 	void accept_request();
 
 protected:
-	virtual void process_request(asio::ip::tcp::socket &client) = 0;
-	//virtual void cleanup() = 0;
+	// parse the request line and the headers, called on a network thread
+	virtual void process_headers(std::istream &request, http_request_t &proc) = 0;
+	// serve the request, called on the blocking executor
+	virtual void process_api_calls(http_request_t &proc, std::istream &request) = 0;
 
 public:
 	explicit toy_server(std::uint16_t port_number);
@@ -56,7 +129,10 @@ public:
 
 	void kill_switch();
 
-	void launch_server(int concurrency);
+	void set_idle_timeout(int seconds) { idle_timeout = seconds; }
+
+	// io_threads run the io_context, enclave_threads serve the requests
+	void launch_server(int io_threads, int enclave_threads);
 };
 
 #endif
@@ -2,6 +2,7 @@
 #define TOY_SERVER_REQUEST_H
 
 #include <string>
+#include <functional>
 #include "asio/streambuf.hpp"
 
 typedef enum{GET, POST, DELETE} http_method_t;
@@ -20,12 +21,31 @@ public:
 	http_method_t method;
 	std::string resource;
 	std::string session_id;
+	// false after a "Connection: close" header
+	bool keep_alive;
+	// application/octet-stream instead of JSON, from Content-Type and Accept respectively
+	bool binary_request;
+	bool binary_response;
+	const char *content_type;
+	// the body is detached from the socket so that the next request can be read meanwhile
+	asio::streambuf request_body;
 	asio::streambuf response_body;
+	/*
+		Set by the API call to stream the response with chunked transfer encoding:
+		response_body is the first chunk, then next_chunk is called on the blocking
+		executor to refill it after every chunk is written; it returns false once the
+		chunk it produced is the last one.
+	*/
+	std::function<bool(http_request_t&)> next_chunk;
 
 	//void set_http_response(http_request_t &req, int status_code);
 	http_request_t() {
 		status_code = 200;
 		content_length = -1;
+		keep_alive = true;
+		binary_request = false;
+		binary_response = false;
+		content_type = "application/json";
 	}
 	void set_http_response(int status_code);
 
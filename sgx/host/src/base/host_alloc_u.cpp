@@ -0,0 +1,25 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include "obl/huge_allocator.h"
+
+// host memory handed to the enclave, mostly ORAM trees: huge is an obl::huge_page_t
+extern "C" void ocall_host_alloc(void **out, size_t s, int huge)
+{
+	*out = huge_allocator((obl::huge_page_t) huge).allocate(s);
+}
+
+// huge_allocator releases whatever it mapped, whatever the page size
+extern "C" void host_free(void *in)
+{
+	huge_allocator().deallocate(in);
+}
+
+#define ENABLE_PRINT_STDOUT
+#ifdef ENABLE_PRINT_STDOUT
+extern "C" void ocall_stdout(const char* format_str, const char *str)
+{
+	printf(format_str,str);
+	fflush(stdout);
+}
+#endif
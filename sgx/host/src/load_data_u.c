@@ -2,6 +2,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 void ocall_get_file_size(void *fb, size_t *size)
 {
 	fseek((FILE*)fb, 0, SEEK_END);
@@ -15,3 +19,40 @@ void ocall_get_blob(void *fb, uint8_t *out, size_t len, size_t offset)
 
 	fread(out, sizeof(uint8_t), len, (FILE*)fb);
 }
+
+void ocall_map_blob(void *fb, uint8_t **base, size_t *size)
+{
+	struct stat st;
+	void *ptr;
+
+	*base = NULL;
+	*size = 0;
+
+	if(fstat(fileno((FILE*)fb), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+		return;
+
+	ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno((FILE*)fb), 0);
+
+	if(ptr == MAP_FAILED)
+		return;
+
+	// indexes are streamed front to back exactly once
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+	*base = (uint8_t*) ptr;
+	*size = st.st_size;
+}
+
+void ocall_advise_blob(uint8_t *base, size_t offset, size_t len)
+{
+	// madvise wants a page-aligned start
+	size_t pg = sysconf(_SC_PAGESIZE);
+	size_t start = offset & ~(pg - 1);
+
+	madvise(base + start, len + (offset - start), MADV_WILLNEED);
+}
+
+void ocall_unmap_blob(uint8_t *base, size_t size)
+{
+	munmap(base, size);
+}
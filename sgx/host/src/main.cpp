@@ -25,10 +25,14 @@ int main(int argc, char **argv)
 	// create server
 	subtol_srv srv(port);
 
+	// memory budget of the loads, in MB
+	if(argc > 2)
+		srv.set_load_budget((std::size_t) std::atol(argv[2]) << 20);
+
 	std::cout << "Launching server on port: " << port << std::endl;
 	std::cout << "Server PID: " << getpid() << std::endl;
 	// spawn listener
-	std::thread listener(&toy_server::launch_server, &srv, 4);
+	std::thread listener(&toy_server::launch_server, &srv, 4, 2);
 
 	// main will sigwait for SIGTERM, after which it softly kills the server
 	sigset_t w;
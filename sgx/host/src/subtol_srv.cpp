@@ -10,9 +10,14 @@
 #include <limits>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
 #include <exception>
 #include <stdexcept>
 
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "boost/algorithm/string.hpp"
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/document.h"
@@ -23,11 +28,22 @@ using hres = std::chrono::high_resolution_clock;
 using nano = std::chrono::nanoseconds;
 using tt = std::chrono::time_point<hres, nano>;
 
+subtol_srv::subtol_srv(std::uint16_t port_number): toy_server(port_number), loader_pool(LOADER_THREADS)
+{
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	load_budget = pages > 0 && page_size > 0 ? (std::size_t) pages * page_size : std::numeric_limits<std::size_t>::max();
+	load_reserved = 0;
+
+	encl.init_enclave();
+}
+
 void subtol_srv::process_headers(std::istream &request, http_request_t &proc)
 {
 	// use C++ initializer lists
 	static std::vector<const char*> supported_methods {"GET", "POST", "DELETE"};
-	static std::vector<const char*> supported_headers {"Content-Length:", "Cookie:", "Host:"};
+	static std::vector<const char*> supported_headers {"Content-Length:", "Cookie:", "Host:", "Connection:", "Content-Type:", "Accept:"};
 
 	// some other checks -- avoid repeated headers...
 	bool already_found_content_length = false;
@@ -113,6 +129,7 @@ void subtol_srv::process_headers(std::istream &request, http_request_t &proc)
 
 					/*
 						Lazy way, I can do that since I'm going to process only one cookie!
+						Without a valid cookie the session of the connection is kept.
 					*/
 					if(valid_cookie.size())
 					{
@@ -132,6 +149,32 @@ void subtol_srv::process_headers(std::istream &request, http_request_t &proc)
 				else
 					already_found_host = true;
 				break;
+			case 3: // Connection
+				{
+					// connections are persistent unless the client asks otherwise
+					std::string options;
+					std::getline(request, options);
+					boost::to_lower(options);
+					if(options.find("close") != std::string::npos)
+						proc.keep_alive = false;
+				}
+				break;
+			case 4: // Content-Type
+			case 5: // Accept
+				{
+					// binary framing is spoken by substring and suffix only, each direction on its own
+					std::string media;
+					std::getline(request, media);
+					boost::to_lower(media);
+					if(media.find("application/octet-stream") != std::string::npos)
+					{
+						if(header_num == 4)
+							proc.binary_request = true;
+						else
+							proc.binary_response = true;
+					}
+				}
+				break;
 			default:
 				// ignore line...
 				request.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
@@ -205,9 +248,29 @@ void subtol_srv::restore_context_handle(const std::string &session_id, std::uniq
 	session_store[session_id] = std::move(pl);
 }
 
+/*
+	Queries do not take the session out of the store, so that many of them can be in
+	the enclave at once. They still fail while the session is taken by load, configure
+	or close; the enclave itself refuses to close a session with queries in flight.
+*/
+bool subtol_srv::share_context_handle(const std::string &session_id, bool &found, subtol_session_t &shared)
+{
+	std::lock_guard<std::mutex> lck_context(session_guard);
+	auto it = session_store.find(session_id);
+
+	found = it != session_store.end();
+
+	if(!found || it->second.get() == nullptr)
+		return false;
+
+	shared = *it->second;
+	return true;
+}
+
 void subtol_srv::process_api_calls(http_request_t &proc, std::istream &request)
 {
-	static std::vector<const char*> api_calls {"/start_session", "/attestation", "/poll", "/configure", "/close", "/load", "/substring", "/suffix"};
+	// /substring/batch and /suffix/range must be matched before /substring and /suffix
+	static std::vector<const char*> api_calls {"/start_session", "/attestation", "/poll", "/configure", "/close", "/load", "/substring/batch", "/substring", "/suffix/range", "/suffix"};
 
 	unsigned int which_api_call = 0;
 
@@ -246,12 +309,20 @@ void subtol_srv::process_api_calls(http_request_t &proc, std::istream &request)
 			load(proc, request);
 			break;
 		
-		case 6: // substring
+		case 6: // substring/batch
+			substring_batch(proc, request);
+			break;
+		
+		case 7: // substring
 			substring(proc, request);
 			break;
 		
-		case 7: // suffix
-			suffix(proc);
+		case 8: // suffix/range
+			suffix_range(proc, request);
+			break;
+		
+		case 9: // suffix
+			suffix(proc, request);
 			break;
 			
 		default:
@@ -259,7 +330,12 @@ void subtol_srv::process_api_calls(http_request_t &proc, std::istream &request)
 	}
 }
 
-void subtol_srv::suffix(http_request_t &proc)
+/*
+	GET /suffix with the encrypted cursor, the first entry wanted, as body.
+	The bundle holding that entry is returned: the client keeps the cursor of each
+	query and moves it by a bundle, so concurrent queries of a session never share it.
+*/
+void subtol_srv::suffix(http_request_t &proc, std::istream &request)
 {
 	// wrong resource
 	if(proc.resource != "")
@@ -275,8 +351,17 @@ void subtol_srv::suffix(http_request_t &proc)
 		return;
 	}
 	
+	// empty body
+	if(proc.content_length <= 0)
+	{
+		proc.set_http_response(411);
+		return;
+	}
+	
 	bool found;
-	std::unique_ptr<subtol_session_t> sess = get_context_handle(proc.session_id, found);
+	subtol_session_t shared;
+	bool available = share_context_handle(proc.session_id, found, shared);
+	subtol_session_t *sess = &shared;
 	
 	// wrong session-id
 	if(!found)
@@ -285,8 +370,8 @@ void subtol_srv::suffix(http_request_t &proc)
 		return;
 	}
 	
-	// session already active
-	if(sess.get() == nullptr)
+	// session taken by a load, configure or close
+	if(!available)
 	{
 		proc.set_http_response(409);
 		return;
@@ -296,33 +381,187 @@ void subtol_srv::suffix(http_request_t &proc)
 	{
 		std::uint8_t mac[16];
 		std::uint8_t iv[12];
-		std::int32_t *payload;
-		std::size_t payload_size;
+		std::uint8_t *cursor;
+		std::size_t cursor_size;
+		std::unique_ptr<std::uint8_t[]> json_payload;
+		
+		if(proc.binary_request)
+			bin_frame_in(proc, iv, mac, &cursor, &cursor_size);
+		else {
+			std::unique_ptr<char[]> buff_array(new char[proc.content_length+1]);
+			request.read(&buff_array[0], proc.content_length);
+			buff_array[proc.content_length] = '\0';
+			
+			bin_msg_in(&buff_array[0], iv, mac, &cursor, &cursor_size);
+			json_payload.reset(cursor);
+		}
+		
+		if(cursor == nullptr || cursor_size != sizeof(std::uint32_t))
+		{
+			proc.set_http_response(400);
+			return;
+		}
+		
+		std::int32_t *payload = nullptr;
+		std::size_t payload_size = 0;
 		
 		tt start = hres::now();
-		encl.call_fetch_sa(sess->attestation_context, &payload, &payload_size, iv, mac);
-		tt end = hres::now();		
-
-		nano diff =  end - start;
-
-		std::int32_t *res = new std::int32_t[payload_size+2];
-		std::int64_t *time = (std::int64_t *) &res[payload_size];
-		std::memcpy(res,payload,payload_size*sizeof(std::int32_t));
-		host_free(payload);
-		*time = diff.count();
- 
-		if(payload_size != 0 && payload != nullptr)
+		sgx_status_t status = encl.call_fetch_sa(sess->attestation_context, cursor, &payload, &payload_size, iv, mac);
+		tt end = hres::now();
+		
+		nano diff = end - start;
+		
+		if(status == SGX_SUCCESS && payload_size != 0 && payload != nullptr)
 		{
-			bin_msg_out(proc.response_body, iv, mac, (std::uint8_t*) res, (payload_size+2) * sizeof(std::int32_t));
+			std::int32_t *res = new std::int32_t[payload_size+2];
+			std::int64_t *time = (std::int64_t *) &res[payload_size];
+			std::memcpy(res, payload, payload_size*sizeof(std::int32_t));
+			*time = diff.count();
+			
+			if(proc.binary_response)
+				bin_frame_out(proc, iv, mac, (std::uint8_t*) res, (payload_size+2) * sizeof(std::int32_t));
+			else
+				bin_msg_out(proc.response_body, iv, mac, (std::uint8_t*) res, (payload_size+2) * sizeof(std::int32_t));
 			delete[] res;
 		}
+		else if(status == SGX_ERROR_INVALID_STATE)
+			proc.set_http_response(409);
+		else if(status == SGX_ERROR_MAC_MISMATCH)
+			proc.set_http_response(400);
 		else
 			proc.set_http_response(404);
+		
+		if(payload != nullptr)
+			host_free(payload);
 	}
 	else
 		proc.set_http_response(401);
+}
+
+/*
+	GET /suffix/range/<bound> with the encrypted (s, e) as body.
+	Exactly bound entries are returned, -1 past e, so that the response does not tell
+	how many occurrences there are: bound is public and so are the ORAM accesses,
+	which only depend on it. Entries are streamed in chunks of SA_RANGE_CHUNK_MAX,
+	each one a binary frame of its own fetched by a single ECALL, and the bundles
+	of a chunk are read from the ORAM as one batch.
+*/
+void subtol_srv::suffix_range(http_request_t &proc, std::istream &request)
+{
+	// wrong method
+	if(proc.method != GET)
+	{
+		proc.set_http_response(405);
+		return;
+	}
 	
-	restore_context_handle(proc.session_id, sess);
+	// the bound follows the resource
+	char *bound_end = nullptr;
+	unsigned long long bound = 0;
+	
+	if(proc.resource.length() > 1 && proc.resource[0] == '/')
+		bound = std::strtoull(proc.resource.c_str() + 1, &bound_end, 10);
+	
+	if(bound == 0 || bound > UINT32_MAX || bound_end == nullptr || *bound_end != '\0')
+	{
+		proc.set_http_response(400);
+		return;
+	}
+	
+	// empty body
+	if(proc.content_length <= 0)
+	{
+		proc.set_http_response(411);
+		return;
+	}
+	
+	bool found;
+	subtol_session_t shared;
+	bool available = share_context_handle(proc.session_id, found, shared);
+	
+	// wrong session-id
+	if(!found)
+	{
+		proc.set_http_response(404);
+		return;
+	}
+	
+	// session taken by a load, configure or close
+	if(!available)
+	{
+		proc.set_http_response(409);
+		return;
+	}
+	
+	if(shared.phase != 2)
+	{
+		proc.set_http_response(401);
+		return;
+	}
+	
+	std::shared_ptr<sa_stream_t> st = std::make_shared<sa_stream_t>();
+	std::uint8_t *payload;
+	std::size_t payload_size;
+	std::unique_ptr<std::uint8_t[]> json_payload;
+	
+	if(proc.binary_request)
+		bin_frame_in(proc, st->range_iv, st->range_mac, &payload, &payload_size);
+	else {
+		std::unique_ptr<char[]> buff_array(new char[proc.content_length+1]);
+		request.read(&buff_array[0], proc.content_length);
+		buff_array[proc.content_length] = '\0';
+		
+		bin_msg_in(&buff_array[0], st->range_iv, st->range_mac, &payload, &payload_size);
+		json_payload.reset(payload);
+	}
+	
+	if(payload == nullptr || payload_size != sizeof(st->range))
+	{
+		proc.set_http_response(400);
+		return;
+	}
+	
+	std::memcpy(st->range, payload, sizeof(st->range));
+	st->attestation_context = shared.attestation_context;
+	st->bound = bound;
+	st->offset = 0;
+	
+	// the first chunk goes out with the headers, so errors still get a status code
+	sgx_status_t status = sa_range_chunk(proc, *st);
+	
+	if(status != SGX_SUCCESS)
+	{
+		proc.set_http_response(status == SGX_ERROR_INVALID_STATE ? 409 : 400);
+		return;
+	}
+	
+	if(st->offset < st->bound)
+		proc.next_chunk = [this, st](http_request_t &p) {
+			if(sa_range_chunk(p, *st) != SGX_SUCCESS)
+				throw std::runtime_error("/suffix/range: the session went away while streaming");
+			
+			return st->offset < st->bound;
+		};
+}
+
+sgx_status_t subtol_srv::sa_range_chunk(http_request_t &proc, sa_stream_t &st)
+{
+	std::uint8_t mac[16];
+	std::uint8_t iv[12];
+	std::size_t len = st.bound - st.offset;
+	len = len < SA_RANGE_CHUNK_MAX ? len : SA_RANGE_CHUNK_MAX;
+	
+	std::unique_ptr<std::int32_t[]> sa(new std::int32_t[len]);
+	
+	sgx_status_t status = encl.call_fetch_sa_range(st.attestation_context, st.range, st.range_iv, st.range_mac, st.offset, iv, mac, &sa[0], len);
+	
+	if(status == SGX_SUCCESS)
+	{
+		bin_frame_out(proc, iv, mac, (std::uint8_t*) &sa[0], len * sizeof(std::int32_t));
+		st.offset += len;
+	}
+	
+	return status;
 }
 
 void subtol_srv::substring(http_request_t &proc, std::istream &request)
@@ -346,7 +585,9 @@ void subtol_srv::substring(http_request_t &proc, std::istream &request)
 		proc.set_http_response(411);
 	
 	bool found;
-	std::unique_ptr<subtol_session_t> sess = get_context_handle(proc.session_id, found);
+	subtol_session_t shared;
+	bool available = share_context_handle(proc.session_id, found, shared);
+	subtol_session_t *sess = &shared;
 	
 	// wrong session-id
 	if(!found)
@@ -355,8 +596,8 @@ void subtol_srv::substring(http_request_t &proc, std::istream &request)
 		return;
 	}
 	
-	// session already active
-	if(sess.get() == nullptr)
+	// session taken by a load, configure or close
+	if(!available)
 	{
 		proc.set_http_response(409);
 		return;
@@ -364,18 +605,25 @@ void subtol_srv::substring(http_request_t &proc, std::istream &request)
 	
 	if(sess->phase == 2)
 	{
-		std::unique_ptr<char[]> buff_array(new char[proc.content_length+1]);
-		request.read(&buff_array[0], proc.content_length);
-		buff_array[proc.content_length] = '\0';
-
 		std::uint8_t mac[16];
 		std::uint8_t iv[12];
 		std::uint8_t *payload;
 		std::size_t payload_size;
+		std::unique_ptr<std::uint8_t[]> json_payload;
 
-		bin_msg_in(&buff_array[0], iv, mac, &payload, &payload_size);
+		if(proc.binary_request)
+			// payload points into the request body
+			bin_frame_in(proc, iv, mac, &payload, &payload_size);
+		else {
+			std::unique_ptr<char[]> buff_array(new char[proc.content_length+1]);
+			request.read(&buff_array[0], proc.content_length);
+			buff_array[proc.content_length] = '\0';
+
+			bin_msg_in(&buff_array[0], iv, mac, &payload, &payload_size);
+			// Fix memory leakage
+			json_payload.reset(payload);
+		}
 	
-		// Fix memory leakage
 		if(payload != nullptr)
 		{
 			// res[0] and res[1] keep start and end
@@ -390,16 +638,115 @@ void subtol_srv::substring(http_request_t &proc, std::istream &request)
 			nano diff = end - start;
 			res64[1] = diff.count();
 		
-			bin_msg_out(proc.response_body, iv, mac, (std::uint8_t*) res, 4 * sizeof(std::int32_t));
-			delete[] payload;
+			if(proc.binary_response)
+				bin_frame_out(proc, iv, mac, (std::uint8_t*) res, 4 * sizeof(std::int32_t));
+			else
+				bin_msg_out(proc.response_body, iv, mac, (std::uint8_t*) res, 4 * sizeof(std::int32_t));
 		}
 		else
 			proc.set_http_response(400);
 	}
 	else
 		proc.set_http_response(401);
+}
+
+void subtol_srv::substring_batch(http_request_t &proc, std::istream &request)
+{
+	// wrong resource
+	if(proc.resource != "")
+	{
+		proc.set_http_response(414);
+		return;
+	}
 	
-	restore_context_handle(proc.session_id, sess);
+	// wrong method
+	if(proc.method != GET)
+	{
+		proc.set_http_response(405);
+		return;
+	}
+	
+	// empty body
+	if(proc.content_length <= 0)
+	{
+		proc.set_http_response(411);
+		return;
+	}
+	
+	bool found;
+	subtol_session_t shared;
+	bool available = share_context_handle(proc.session_id, found, shared);
+	subtol_session_t *sess = &shared;
+	
+	// wrong session-id
+	if(!found)
+	{
+		proc.set_http_response(404);
+		return;
+	}
+	
+	// session taken by a load, configure or close
+	if(!available)
+	{
+		proc.set_http_response(409);
+		return;
+	}
+	
+	if(sess->phase == 2)
+	{
+		std::uint8_t mac[16];
+		std::uint8_t iv[12];
+		std::uint8_t *payload;
+		std::size_t payload_size;
+		std::unique_ptr<std::uint8_t[]> json_payload;
+
+		if(proc.binary_request)
+			bin_frame_in(proc, iv, mac, &payload, &payload_size);
+		else {
+			std::unique_ptr<char[]> buff_array(new char[proc.content_length+1]);
+			request.read(&buff_array[0], proc.content_length);
+			buff_array[proc.content_length] = '\0';
+
+			bin_msg_in(&buff_array[0], iv, mac, &payload, &payload_size);
+			json_payload.reset(payload);
+		}
+		
+		if(payload != nullptr)
+		{
+			// every query takes at least its length and one character
+			std::size_t max_queries = payload_size > sizeof(std::uint32_t) ? (payload_size - sizeof(std::uint32_t)) / (sizeof(std::uint32_t) + 1) : 0;
+			max_queries = max_queries < QUERY_BATCH_MAX ? max_queries : QUERY_BATCH_MAX;
+			max_queries = max_queries > 0 ? max_queries : 1;
+			
+			// n (start, end) pairs followed by 64-bit time
+			std::unique_ptr<std::int32_t[]> res(new std::int32_t[2 * max_queries + 2]);
+			std::size_t n;
+		
+			tt start = hres::now();
+			sgx_status_t status = encl.call_query_batch(sess->attestation_context, payload, payload_size, iv, mac, &res[0], 2 * max_queries, &n);
+			tt end = hres::now();
+		
+			if(status == SGX_SUCCESS)
+			{
+				nano diff = end - start;
+				std::int64_t elapsed = diff.count();
+				std::memcpy(&res[2 * n], &elapsed, sizeof(std::int64_t));
+			
+				if(proc.binary_response)
+					bin_frame_out(proc, iv, mac, (std::uint8_t*) &res[0], (2 * n + 2) * sizeof(std::int32_t));
+				else
+					bin_msg_out(proc.response_body, iv, mac, (std::uint8_t*) &res[0], (2 * n + 2) * sizeof(std::int32_t));
+			}
+			else if(status == SGX_ERROR_INVALID_STATE)
+				proc.set_http_response(409);
+			else
+				proc.set_http_response(400);
+		}
+		else
+			proc.set_http_response(400);
+	}
+	else
+		proc.set_http_response(401);
 }
 
 void subtol_srv::load(http_request_t &proc, std::istream &request)
@@ -411,6 +758,12 @@ void subtol_srv::load(http_request_t &proc, std::istream &request)
 		return;
 	}
 	
+	if(proc.method == DELETE)
+	{
+		cancel_load(proc);
+		return;
+	}
+	
 	// wrong method
 	if(proc.method != POST)
 	{
@@ -446,30 +799,69 @@ void subtol_srv::load(http_request_t &proc, std::istream &request)
 		request.read(&buff_array[0], proc.content_length);
 		buff_array[proc.content_length] = '\0';
 
-		std::unique_ptr<std::uint8_t[]> mac(new std::uint8_t[16]);
-		std::unique_ptr<std::uint8_t[]> iv(new std::uint8_t[12]);
+		std::vector<std::uint8_t> mac(16);
+		std::vector<std::uint8_t> iv(12);
 		std::uint8_t *payload;
 		std::size_t payload_size;
 
 		bin_msg_in(&buff_array[0], &iv[0], &mac[0], &payload, &payload_size);
+		std::unique_ptr<std::uint8_t[]> payload_guard(payload);
 	
-		if((int)payload_size <= 64)
+		if(payload == nullptr || (int)payload_size <= 64)
 		{
 			proc.set_http_response(400);
-			if(payload != nullptr)
-				delete[] payload;
+			restore_context_handle(proc.session_id, sess);
+			return;
 		}
 		
-		else {
-			proc.set_http_response(202);
-			// release ownership (to avoid deallocation) and returns handled pointer
-			subtol_session_t *temp = sess.release();
-			std::thread background_loading(&subtol_srv::async_loader, this, proc.session_id, temp,
-				std::unique_ptr<std::uint8_t[]>(payload), payload_size, std::unique_ptr<std::uint8_t[]>(std::move(iv)), std::unique_ptr<std::uint8_t[]>(std::move(mac)));
-			// it becomes non-joinable and the function can safely return to answer the client
-			// since the context will be a nullptr, it won't be usable until async_loader returns
-			background_loading.detach();
+		// the passphrase is encrypted, the filename follows in clear
+		std::string filename((char*) &payload[64], payload_size - 64);
+		FILE *fp = fopen(filename.c_str(), "rb");
+		struct stat file_info;
+		
+		if(fp == NULL || fstat(fileno(fp), &file_info) != 0)
+		{
+			if(fp != NULL)
+				fclose(fp);
+			
+			proc.set_http_response(422);
+			restore_context_handle(proc.session_id, sess);
+			return;
 		}
+		
+		std::size_t estimate = (std::size_t) file_info.st_size * LOAD_MEMORY_FACTOR;
+		std::shared_ptr<load_state_t> st;
+		
+		{
+			std::lock_guard<std::mutex> l_guard(load_guard);
+			
+			// a load larger than the whole budget still runs, alone
+			if(load_reserved == 0 || load_reserved + estimate <= load_budget)
+			{
+				load_reserved += estimate;
+				st = std::make_shared<load_state_t>(file_info.st_size, estimate);
+				loads[proc.session_id] = st;
+			}
+		}
+		
+		if(st == nullptr)
+		{
+			fclose(fp);
+			proc.set_http_response(503);
+			restore_context_handle(proc.session_id, sess);
+			return;
+		}
+		
+		proc.set_http_response(202);
+		
+		std::vector<std::uint8_t> passphrase(payload, payload + 64);
+		std::string sess_id = proc.session_id;
+		// release ownership (to avoid deallocation), the session is unusable until async_loader returns
+		subtol_session_t *temp = sess.release();
+		
+		asio::post(loader_pool, [this, sess_id, temp, fp, st, passphrase, iv, mac]() {
+			async_loader(sess_id, temp, fp, st, passphrase, iv, mac);
+		});
 	}
 	else {
 		proc.set_http_response(401);
@@ -477,27 +869,74 @@ void subtol_srv::load(http_request_t &proc, std::istream &request)
 	}
 }
 
-void subtol_srv::async_loader(std::string sess_id, subtol_session_t *sess, std::unique_ptr<std::uint8_t[]> payload, std::size_t payload_size, std::unique_ptr<std::uint8_t[]> iv, std::unique_ptr<std::uint8_t[]> mac)
+void subtol_srv::async_loader(std::string sess_id, subtol_session_t *sess, FILE *fp, std::shared_ptr<load_state_t> st,
+	std::vector<std::uint8_t> passphrase, std::vector<std::uint8_t> iv, std::vector<std::uint8_t> mac)
 {
-	FILE *fp;
-	char *filename = new char[payload_size - 64 + 1];
+	int phase = LOAD_QUEUED;
 	
-	// make filename a \0 terminated string
-	std::memcpy(filename, &payload[64], payload_size - 64);
-	filename[payload_size - 64] = '\0';
+	// cancelled while queued
+	if(st->progress.cancel.load() != 0)
+		phase = LOAD_CANCELLED;
+	else {
+		st->phase.store(LOAD_RUNNING);
+		
+		sgx_status_t ret = encl.call_loader(sess->attestation_context, fp, &st->progress, &passphrase[0], &iv[0], &mac[0]);
+		
+		if(ret == SGX_SUCCESS)
+			phase = LOAD_DONE;
+		else if(st->progress.cancel.load() != 0)
+			phase = LOAD_CANCELLED;
+		else
+			phase = LOAD_FAILED;
+	}
 	
-	fp = fopen(filename, "rb");
+	fclose(fp);
 	
-	if(fp != NULL)
 	{
-		encl.call_loader(sess->attestation_context, fp, &payload[0], &iv[0], &mac[0]);
-		fclose(fp);
+		std::lock_guard<std::mutex> l_guard(load_guard);
+		load_reserved -= st->reserved;
 	}
 	
+	// the outcome is there by the time the session is usable again
+	st->phase.store(phase);
+	
 	std::unique_ptr<subtol_session_t> temp_ptr(sess);
 	restore_context_handle(sess_id, temp_ptr);
+}
+
+std::shared_ptr<load_state_t> subtol_srv::get_load_state(const std::string &session_id)
+{
+	std::lock_guard<std::mutex> l_guard(load_guard);
+	auto it = loads.find(session_id);
+	
+	if(it == loads.end())
+		return nullptr;
 	
-	delete[] filename;
+	return it->second;
+}
+
+void subtol_srv::cancel_load(http_request_t &proc)
+{
+	std::shared_ptr<load_state_t> st = get_load_state(proc.session_id);
+	
+	if(st == nullptr)
+	{
+		proc.set_http_response(404);
+		return;
+	}
+	
+	int phase = st->phase.load();
+	
+	// too late
+	if(phase != LOAD_QUEUED && phase != LOAD_RUNNING)
+	{
+		proc.set_http_response(409);
+		return;
+	}
+	
+	// the enclave stops at the next chunk, poll tells when it is over
+	st->progress.cancel.store(1);
+	proc.set_http_response(202);
 }
 
 void subtol_srv::configure(http_request_t &proc, std::istream &request)
@@ -550,7 +989,7 @@ void subtol_srv::configure(http_request_t &proc, std::istream &request)
 
 		bin_msg_in(&buff_array[0], iv, mac, &payload, &payload_size);
 	
-		if(payload_size != 7 * sizeof(std::uint32_t))
+		if(payload_size != 10 * sizeof(std::uint32_t))
 		{
 			proc.set_http_response(400);
 		}
@@ -602,10 +1041,8 @@ void subtol_srv::close(http_request_t &proc)
 	else {
 		sgx_status_t ret;
 		
-		if(sess->phase == 2)
-			ret = encl.call_close_session(sess->attestation_context);
-		else
-			ret = encl.close_attestation_context(sess->attestation_context);
+		// also closes the attestation context
+		ret = encl.call_close_session(sess->attestation_context);
 			
 		if(ret != SGX_SUCCESS) // if attestation context was not cleaned-up...
 		{
@@ -625,8 +1062,13 @@ void subtol_srv::close(http_request_t &proc)
 	
 		if(!restore)
 		{
-			std::lock_guard<std::mutex> s_guard(session_guard);
-			session_store.erase(proc.session_id);
+			{
+				std::lock_guard<std::mutex> s_guard(session_guard);
+				session_store.erase(proc.session_id);
+			}
+			
+			std::lock_guard<std::mutex> l_guard(load_guard);
+			loads.erase(proc.session_id);
 		}
 		else
 			restore_context_handle(proc.session_id, sess);
@@ -647,22 +1089,48 @@ void subtol_srv::poll(http_request_t &proc)
 		return;
 	}
 	
-	// lock the required session
+	// only look at the session: taking it out of the store would fail concurrent queries
 	bool found;
-	std::unique_ptr<subtol_session_t> sess = get_context_handle(proc.session_id, found);
+	subtol_session_t shared;
+	bool available = share_context_handle(proc.session_id, found, shared);
+	std::shared_ptr<load_state_t> st = get_load_state(proc.session_id);
 	
 	if(!found)
 		proc.set_http_response(404);
 	
-	else if(sess.get() == nullptr)
-		proc.set_http_response(409);
-	
 	else {
-		proc.set_http_response(200);
-		restore_context_handle(proc.session_id, sess);
+		// still busy while loading, but with the progress of the load as body
+		proc.status_code = available ? 200 : 409;
+		
+		if(st == nullptr)
+			proc.set_http_response(proc.status_code);
+		else
+			load_progress_out(proc.response_body, *st);
 	}
 }
 
+void subtol_srv::load_progress_out(asio::streambuf &response, load_state_t &st)
+{
+	static const char * const phases[] = {"queued", "loading", "done", "failed", "cancelled"};
+	
+	rapidjson::Document doc;
+	
+	doc.SetObject();
+	rapidjson::Document::AllocatorType &allocator = doc.GetAllocator();
+	
+	doc.AddMember("load", rapidjson::StringRef(phases[st.phase.load()]), allocator);
+	doc.AddMember("bytes_total", (std::uint64_t) st.bytes_total, allocator);
+	doc.AddMember("bytes_decrypted", (std::uint64_t) st.progress.bytes_decrypted.load(), allocator);
+	doc.AddMember("blocks_inserted", (std::uint64_t) st.progress.blocks_inserted.load(), allocator);
+	
+	rapidjson::StringBuffer json_string;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(json_string);
+	doc.Accept(writer);
+	
+	std::ostream out(&response);
+	out << json_string.GetString();
+}
+
 void subtol_srv::start_session(http_request_t &proc)
 {
 	static const char * const _rnd_string = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -708,6 +1176,21 @@ void subtol_srv::start_session(http_request_t &proc)
 		return;
 	}
 	
+	// the enclave session is taken now, so that a full session table is reported here
+	status_code = encl.call_create_session(ctx);
+	
+	if(status_code != SGX_SUCCESS)
+	{
+		// SGX_ERROR_BUSY: all the session slots of the enclave are taken
+		proc.set_http_response(status_code == SGX_ERROR_BUSY ? 503 : 500);
+		
+		do {
+			status_code = encl.close_attestation_context(ctx);
+		} while(status_code != SGX_SUCCESS);
+		
+		return;
+	}
+	
 	// if I got here, everything went fine with enclaves!
 	char cookie[33];
 	bool inserted = true;
@@ -782,7 +1265,7 @@ void subtol_srv::attestation(http_request_t &proc, std::istream &request)
 	{
 		sgx_status_t status;
 		
-		status = encl.close_attestation_context(sess->attestation_context);
+		status = encl.call_close_session(sess->attestation_context);
 		
 		if(status == SGX_SUCCESS)
 		{
@@ -868,13 +1351,12 @@ void subtol_srv::attestation(http_request_t &proc, std::istream &request)
 				
 				if(res == SGX_SUCCESS)
 				{
-					res = encl.call_create_session(sess->attestation_context);
 					sess->phase = 2;
 					proc.set_http_response(200);
 				}
 
 				else {
-					res = encl.close_attestation_context(sess->attestation_context);
+					res = encl.call_close_session(sess->attestation_context);
 		
 					if(res == SGX_SUCCESS)
 					{
@@ -957,6 +1439,44 @@ void subtol_srv::bin_msg_in(char *json_msg, std::uint8_t *iv, std::uint8_t *mac,
 	else return;
 }
 
+void subtol_srv::bin_frame_in(http_request_t &proc, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t **payload, std::size_t *size)
+{
+	// the body is a single contiguous region of the streambuf
+	const std::uint8_t *body = asio::buffer_cast<const std::uint8_t*>(proc.request_body.data());
+	std::size_t body_size = proc.request_body.size();
+	std::uint32_t paylen;
+
+	*payload = nullptr;
+	*size = -1;
+
+	if(body_size < BIN_FRAME_HEADER)
+		return;
+
+	std::memcpy(&paylen, body, sizeof(std::uint32_t));
+
+	if(paylen == 0 || paylen != body_size - BIN_FRAME_HEADER)
+		return;
+
+	std::memcpy(iv, body + 4, 12);
+	std::memcpy(mac, body + 16, 16);
+
+	// the ECALL only reads the payload, so no need to copy it out of the body
+	*payload = const_cast<std::uint8_t*>(body + BIN_FRAME_HEADER);
+	*size = paylen;
+}
+
+void subtol_srv::bin_frame_out(http_request_t &proc, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t *payload, std::size_t size)
+{
+	std::uint32_t paylen = size;
+
+	proc.response_body.sputn((const char*) &paylen, sizeof(std::uint32_t));
+	proc.response_body.sputn((const char*) iv, 12);
+	proc.response_body.sputn((const char*) mac, 16);
+	proc.response_body.sputn((const char*) payload, size);
+
+	proc.content_type = "application/octet-stream";
+}
+
 void subtol_srv::bin_msg_out(asio::streambuf &response, std::uint8_t *iv, std::uint8_t *mac, std::uint8_t *payload, std::size_t size)
 {
 	rapidjson::Document doc;
@@ -1185,81 +1705,3 @@ void subtol_srv::msg3_marshalling(asio::streambuf &response, std::uint32_t msg3_
 	std::ostream out(&response);
 	out << json_string.GetString();
 }
-
-void subtol_srv::process_request(asio::ip::tcp::socket &client)
-{
-	// read-end of the socket
-	asio::streambuf socket_in;
-	std::istream request(&socket_in);
-	// write-end of the socket
-	asio::streambuf socket_out;
-	std::ostream response(&socket_out);
-	// request struct
-	http_request_t handle;
-
-	try {
-		asio::error_code read_error;
-		std::size_t amount = 1;
-
-		// read all the http headers
-		asio::read_until(client, socket_in, "\r\n\r\n", read_error);
-
-		while(read_error)
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(500));
-			if(client.available() == 0)
-				break;
-			asio::read_until(client, socket_in, "\r\n\r\n", read_error);
-		}
-
-		if(read_error)
-			throw asio::system_error(read_error);
-
-		process_headers(request, handle);
-
-		if(handle.status_code == 200) // this means the previous phase was successful!!!
-		{
-			// read the rest of the body...
-			int remaining = handle.content_length - socket_in.in_avail();
-
-			if(handle.content_length > 0)
-			{
-				amount = asio::read(client, socket_in, asio::transfer_exactly(remaining), read_error);
-				remaining -= amount;
-				amount = 1;
-
-				// >= was causing unwanted delays here!
-				while(remaining > 0 && amount)
-				{
-					std::this_thread::sleep_for(std::chrono::milliseconds(500));
-					amount = asio::read(client, socket_in, asio::transfer_exactly(remaining), read_error);
-					remaining -= amount;
-				}
-
-				if(remaining > 0)
-					throw asio::system_error(read_error);
-			}
-
-			process_api_calls(handle, request); // throws asio::system_error, which can be caught by the exception handler!
-		}
-
-		// later on...
-		response << "HTTP/1.1 " << handle.status_code << " \r\n"; // protocol requires space anyways
-		response << "Content-Type: application/json\r\n";
-		response << "Content-Length: " << handle.response_body.size() << "\r\n";
-		
-		if(handle.session_id.length())
-			response << "Set-Cookie: session-id=" << handle.session_id << "; HttpOnly\r\n";
-		
-		response << "Connection: close\r\n";
-		response << "Server: subtol ToyServer\r\n\r\n";
-
-		size_t purge_bytes1 = client.send(socket_out.data());
-		size_t purge_bytes2 = client.send(handle.response_body.data());
-
-		socket_out.consume(purge_bytes1);
-		handle.response_body.consume(purge_bytes2);
-	} catch(const asio::system_error &ase) {
-		std::cerr << ase.what() << std::endl;
-	}
-}
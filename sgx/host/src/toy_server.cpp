@@ -3,18 +3,22 @@
 #include <iostream>
 #include <cstddef>
 #include <cstdlib>
+#include <thread>
+#include <vector>
+#include <exception>
 
 toy_server::toy_server(std::uint16_t port_number): cont(), server_socket(cont)
 {
 	server_port = port_number;
+	idle_timeout = IDLE_TIMEOUT;
 }
 
-void toy_server::launch_server(int concurrency)
+void toy_server::launch_server(int io_threads, int enclave_threads)
 {
 	asio::error_code error;
-	std::thread *thread_pool;
+	std::vector<std::thread> thread_pool;
 
-	if(concurrency <= 0)
+	if(io_threads <= 0 || enclave_threads <= 0)
 	{
 		std::cerr << "Number of worker threads <= 0" << std::endl;
 		return;
@@ -35,55 +39,34 @@ void toy_server::launch_server(int concurrency)
 		server_socket.close(error);
 		return;
 	}
-	
+
 	server_socket.listen(asio::socket_base::max_listen_connections, error);
 	run_server.store(true);
 
-	// instantiate an array of worker threads, default constructed (not representing any real thread of execution)
-	thread_pool = new std::thread[concurrency];
-
-	for(int i = 0; i < concurrency; i++)
-		// move assignment
-		thread_pool[i] = std::thread(&toy_server::accept_request, this);
-
-	while(true)
-	{
-		try {
-			// create socket without opening it
-			asio::ip::tcp::socket connection(cont);
-			// connection here passed by reference... [blocking]
-			server_socket.accept(connection);
+	enclave_pool.reset(new asio::thread_pool(enclave_threads));
 
-			if(!run_server.load())
-				break;
+	// the pending accept keeps the io_context busy until kill_switch stops it
+	accept_request();
 
+	for(int i = 0; i < io_threads; i++)
+		thread_pool.emplace_back([this]() {
+			while(true)
 			{
-				std::lock_guard<std::mutex> lck_list(requests_mutex);
-				// invokes the version of push_back with move constructor, so that now new connection is empty
-				pending_requests.push_back(std::move(connection));
-				no_requests.notify_one();
+				try {
+					cont.run();
+					break;
+				} catch(const std::exception &e) {
+					std::cerr << "While running server => " << e.what() << std::endl;
+				}
 			}
-			// connection is killed here since we are exiting the scope, so no leaks!
-		} catch(const asio::system_error &ase) {
-			std::cerr << "While running server => " << ase.what() << std::endl;
-		}
-	}
-
-	// now it's time to kill all the working threads...
-	// if I got here, run_server.load() evaluates to false, so no need to set it to false again!
-	{
-		// push_back dummy socket to make sure no thread will stumble in pending_requests.empty()!
-		std::lock_guard<std::mutex> lck_list(requests_mutex);
-		pending_requests.push_back(asio::ip::tcp::socket(cont));
-		no_requests.notify_all();
-	}
+		});
 
-	for(int i = 0; i < concurrency; i++)
+	for(int i = 0; i < io_threads; i++)
 		thread_pool[i].join();
-	delete[] thread_pool;
 
-	// destroys all pending connections...
-	pending_requests.clear();
+	// let the enclave calls in flight complete, their replies are dropped
+	enclave_pool->join();
+
 	server_socket.close(error);
 }
 
@@ -92,39 +75,357 @@ void toy_server::kill_switch()
 	// activate kill switch
 	run_server.store(false);
 
-	// wake-up listening server socket
-	if(server_socket.is_open())
+	// every io_context::run returns, pending handlers are destroyed with the context
+	cont.stop();
+}
+
+void toy_server::accept_request()
+{
+	server_socket.async_accept([this](const asio::error_code &error, asio::ip::tcp::socket client) {
+		if(!run_server.load())
+			return;
+
+		if(error)
+			std::cerr << "While running server => " << error.message() << std::endl;
+		else
+			std::make_shared<toy_connection>(this, std::move(client))->start();
+
+		accept_request();
+	});
+}
+
+toy_connection::toy_connection(toy_server *srv, asio::ip::tcp::socket client):
+	srv(srv), client(std::move(client)), strand(srv->cont), idle_timer(srv->cont)
+{
+	reading = writing = closing = false;
+}
+
+void toy_connection::start()
+{
+	asio::error_code error;
+	client.set_option(asio::ip::tcp::no_delay(true), error);
+
+	read_headers();
+}
+
+bool toy_connection::idle() const
+{
+	return !writing && serving == nullptr && pending.empty() && replies.empty();
+}
+
+void toy_connection::arm_timer()
+{
+	auto self = shared_from_this();
+
+	// re-arming cancels the previous wait
+	idle_timer.expires_after(std::chrono::seconds(srv->idle_timeout));
+	idle_timer.async_wait(asio::bind_executor(strand, [self](const asio::error_code &error) {
+		self->on_timer(error);
+	}));
+}
+
+void toy_connection::on_timer(const asio::error_code &error)
+{
+	if(error == asio::error::operation_aborted)
+		return;
+
+	// a long enclave call is not idleness
+	if(!idle())
 	{
-		asio::ip::tcp::socket shutdown(cont);
-		asio::ip::tcp::endpoint edp(asio::ip::make_address("127.0.0.1"), server_port);
-		shutdown.connect(edp);
-		shutdown.close();
+		arm_timer();
+		return;
 	}
+
+	// the pending read completes with an error and releases the connection
+	asio::error_code ignored;
+	client.close(ignored);
 }
 
-void toy_server::accept_request()
+void toy_connection::read_headers()
+{
+	auto self = shared_from_this();
+
+	reading = true;
+	arm_timer();
+
+	// completes immediately if a pipelined request is already buffered
+	asio::async_read_until(client, socket_in, "\r\n\r\n", asio::bind_executor(strand, [self](const asio::error_code &error, std::size_t) {
+		self->on_headers(error);
+	}));
+}
+
+void toy_connection::on_headers(const asio::error_code &error)
+{
+	// eof here is just the client closing an idle connection
+	if(error)
+	{
+		reading = false;
+		closing = true;
+		if(idle())
+			shutdown();
+		return;
+	}
+
+	std::istream request(&socket_in);
+
+	incoming.reset(new http_request_t);
+	incoming->session_id = session_id;
+	srv->process_headers(request, *incoming);
+
+	// after a bad request the framing of the stream is lost, so answer and close
+	if(incoming->status_code != 200)
+	{
+		incoming->keep_alive = false;
+		on_body(asio::error_code());
+		return;
+	}
+
+	std::size_t body = incoming->content_length > 0 ? incoming->content_length : 0;
+
+	if(socket_in.size() >= body)
+	{
+		on_body(asio::error_code());
+		return;
+	}
+
+	auto self = shared_from_this();
+
+	// read the rest of the body...
+	asio::async_read(client, socket_in, asio::transfer_exactly(body - socket_in.size()), asio::bind_executor(strand, [self](const asio::error_code &error, std::size_t) {
+		self->on_body(error);
+	}));
+}
+
+void toy_connection::on_body(const asio::error_code &error)
 {
-	while(true)
+	reading = false;
+
+	if(error)
 	{
-		// create empty socket
-		asio::ip::tcp::socket request(cont);
+		std::cerr << error.message() << std::endl;
+		closing = true;
+		if(idle())
+			shutdown();
+		return;
+	}
+
+	if(incoming->status_code == 200 && incoming->content_length > 0)
+	{
+		std::size_t body = incoming->content_length;
+
+		// move the body out of the socket buffer
+		asio::buffer_copy(incoming->request_body.prepare(body), socket_in.data(), body);
+		incoming->request_body.commit(body);
+		socket_in.consume(body);
+	}
 
-		{
-			std::unique_lock<std::mutex> lck_list(requests_mutex);
+	if(incoming->session_id.length())
+		session_id = incoming->session_id;
 
-			if(pending_requests.empty())
-				no_requests.wait(lck_list);
+	if(!incoming->keep_alive)
+		closing = true;
 
-			if(!run_server.load())
-				break;
+	pending.push_back(std::move(incoming));
 
-			// move assignment
-			request = std::move(pending_requests.front());
-			pending_requests.pop_front();
+	serve_next();
+	resume_reading();
+}
+
+void toy_connection::resume_reading()
+{
+	if(!reading && !closing && srv->run_server.load() && pending.size() < PIPELINE_DEPTH)
+		read_headers();
+}
+
+void toy_connection::serve_next()
+{
+	if(serving != nullptr || pending.empty())
+		return;
+
+	serving = std::move(pending.front());
+	pending.pop_front();
+
+	// a request that failed parsing is answered as it is
+	if(serving->status_code != 200)
+	{
+		on_served();
+		return;
+	}
+
+	auto self = shared_from_this();
+	http_request_t *proc = serving.get();
+
+	// ECALLs may take long, keep them away from the network threads
+	asio::post(*srv->enclave_pool, [self, proc]() {
+		std::istream request(&proc->request_body);
+
+		try {
+			self->srv->process_api_calls(*proc, request);
+		} catch(const std::exception &e) {
+			std::cerr << e.what() << std::endl;
+			proc->response_body.consume(proc->response_body.size());
+			proc->set_http_response(500);
 		}
 
-		// set O_NONBLOCK mode in order to allow non-blocking operations
-		request.non_blocking(true);
-		process_request(request);
+		asio::post(self->strand, [self]() {
+			self->on_served();
+		});
+	});
+}
+
+void toy_connection::on_served()
+{
+	// the API call may have opened a session
+	if(serving->session_id.length())
+		session_id = serving->session_id;
+
+	replies.push_back(std::move(serving));
+
+	serve_next();
+	write_next();
+	resume_reading();
+}
+
+void toy_connection::write_next()
+{
+	if(writing || replies.empty())
+		return;
+
+	http_request_t &proc = *replies.front();
+	std::ostream response(&socket_out);
+
+	response << "HTTP/1.1 " << proc.status_code << " \r\n"; // protocol requires space anyways
+	response << "Content-Type: " << proc.content_type << "\r\n";
+
+	if(proc.next_chunk)
+		response << "Transfer-Encoding: chunked\r\n";
+	else
+		response << "Content-Length: " << proc.response_body.size() << "\r\n";
+
+	if(proc.session_id.length())
+		response << "Set-Cookie: session-id=" << proc.session_id << "; HttpOnly\r\n";
+
+	response << "Connection: " << (proc.keep_alive ? "keep-alive" : "close") << "\r\n";
+	response << "Server: subtol ToyServer\r\n\r\n";
+
+	// the headers leave with the first chunk
+	if(proc.next_chunk)
+	{
+		write_chunk(true);
+		return;
 	}
+
+	std::vector<asio::const_buffer> out;
+	out.push_back(socket_out.data());
+	out.push_back(proc.response_body.data());
+
+	auto self = shared_from_this();
+	writing = true;
+
+	asio::async_write(client, out, asio::bind_executor(strand, [self](const asio::error_code &error, std::size_t) {
+		self->on_written(error);
+	}));
+}
+
+void toy_connection::on_written(const asio::error_code &error)
+{
+	writing = false;
+	socket_out.consume(socket_out.size());
+	replies.pop_front();
+
+	if(error)
+	{
+		std::cerr << error.message() << std::endl;
+		closing = true;
+		// drop the requests still queued, the ones in the enclave complete anyway
+		pending.clear();
+		replies.clear();
+		asio::error_code ignored;
+		client.close(ignored);
+		idle_timer.cancel();
+		return;
+	}
+
+	write_next();
+
+	if(closing && idle())
+		shutdown();
+	else
+		resume_reading();
+}
+
+void toy_connection::write_chunk(bool more)
+{
+	static const char crlf[] = "\r\n";
+	static const char last_chunk[] = "0\r\n\r\n";
+
+	http_request_t &proc = *replies.front();
+	std::ostream response(&socket_out);
+	std::size_t size = proc.response_body.size();
+
+	// an empty chunk would end the stream early
+	if(size > 0)
+		response << std::hex << size << std::dec << "\r\n";
+
+	std::vector<asio::const_buffer> out;
+	out.push_back(socket_out.data());
+	out.push_back(proc.response_body.data());
+
+	if(size > 0)
+		out.push_back(asio::buffer(crlf, 2));
+	if(!more)
+		out.push_back(asio::buffer(last_chunk, 5));
+
+	auto self = shared_from_this();
+	writing = true;
+
+	asio::async_write(client, out, asio::bind_executor(strand, [self, more](const asio::error_code &error, std::size_t) {
+		self->on_chunk_written(error, more);
+	}));
+}
+
+void toy_connection::on_chunk_written(const asio::error_code &error, bool more)
+{
+	if(error || !more)
+	{
+		on_written(error);
+		return;
+	}
+
+	socket_out.consume(socket_out.size());
+
+	// writing stays set, nothing else goes on the socket until the stream ends
+	auto self = shared_from_this();
+	http_request_t *proc = replies.front().get();
+
+	asio::post(*srv->enclave_pool, [self, proc]() {
+		bool next = false;
+		bool failed = false;
+
+		proc->response_body.consume(proc->response_body.size());
+
+		try {
+			next = proc->next_chunk(*proc);
+		} catch(const std::exception &e) {
+			std::cerr << e.what() << std::endl;
+			failed = true;
+		}
+
+		asio::post(self->strand, [self, next, failed]() {
+			// the status line is gone, dropping the connection is the only way to tell the client
+			if(failed)
+				self->on_written(asio::error::connection_aborted);
+			else
+				self->write_chunk(next);
+		});
+	});
+}
+
+void toy_connection::shutdown()
+{
+	asio::error_code ignored;
+
+	client.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+	client.close(ignored);
+	idle_timer.cancel();
 }
@@ -25,6 +25,7 @@ void http_request_t::init_strings()
 	response_bodies[422] = "{\"error\":\"Unprocessable Entity\"}";
 	response_bodies[500] = "{\"error\":\"Internal Server Error\"}";
 	response_bodies[501] = "{\"error\":\"Not Implemented\"}";
+	response_bodies[503] = "{\"error\":\"Service Unavailable\"}";
 
 	already_init = true;
 }
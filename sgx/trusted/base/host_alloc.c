@@ -3,7 +3,8 @@
 #include <sgx_trts.h>
 #include <assert.h>
 
-void host_alloc(void **out, size_t s)
+// huge is an obl::huge_page_t, the host falls back to smaller pages if it cannot grant it
+void host_alloc_huge(void **out, size_t s, int huge)
 {
 	void *buffer;
 
@@ -12,7 +13,7 @@ void host_alloc(void **out, size_t s)
 
 	// ocall_host_alloc basically wraps a call to malloc from the host (untrusted)
 	// portion of the code
-	ocall_host_alloc(&buffer, s);
+	ocall_host_alloc(&buffer, s, huge);
 
 	// now you want to check that the untrusted code actually allocated stuff
 	// in the untrusted memory
@@ -20,3 +21,8 @@ void host_alloc(void **out, size_t s)
 
 	*out = buffer;
 }
+
+void host_alloc(void **out, size_t s)
+{
+	host_alloc_huge(out, s, 0);
+}
@@ -0,0 +1,80 @@
+#ifndef BLOB_READER_H
+#define BLOB_READER_H
+
+#include <ipp/ippcp.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// progress of a load, in host memory; keep in sync with the host
+struct load_progress_t {
+	std::atomic<std::uint64_t> bytes_decrypted;
+	std::atomic<std::uint64_t> blocks_inserted;
+	// set by the host, never cleared
+	std::atomic<std::uint32_t> cancel;
+};
+
+/*
+	Sequential reader of an index file living on the host.
+	The host mmaps the file and hands back the (untrusted) address of the mapping, so
+	the enclave reads it in place: no ocall per chunk and no edger8r marshalling copy.
+	Every few MB the host is asked to read ahead the next window of the file.
+	Ciphertext is moved into a trusted slice buffer before GCM decryption, so the host
+	cannot change bytes between the tag computation and the decryption of a block.
+	If the file cannot be mapped, reads fall back to ocall_get_blob.
+	The host may follow a load through a load_progress_t and ask to cancel it: from
+	then on nothing is read or decrypted anymore, so the tag of the file fails to
+	verify and the half-built context is thrown away as a corrupted one would.
+*/
+class blob_reader_t {
+private:
+	void *fb;
+
+	const std::uint8_t *map;
+	std::size_t size;
+	std::size_t pos;
+	std::size_t advised; // end of the window already read ahead
+
+	std::uint8_t *slice;
+
+	load_progress_t *progress; // untrusted, may be null
+	bool stopped;
+
+	void fetch(std::uint8_t *out, std::size_t len);
+
+public:
+	blob_reader_t(void *fb, void *progress = nullptr);
+	~blob_reader_t();
+
+	std::size_t get_size() const {
+		return size;
+	}
+
+	void seek(std::size_t offset) {
+		pos = offset;
+	}
+
+	std::size_t tell() const {
+		return pos;
+	}
+
+	// plain read
+	void read(void *out, std::size_t len);
+	// read and decrypt with the running GCM state
+	void decrypt(void *out, std::size_t len, IppsAES_GCMState *cc);
+
+	// latched, so that the host cannot resume a load it cancelled
+	bool cancelled();
+
+	void count_decrypted(std::size_t bytes) {
+		if(progress != nullptr)
+			progress->bytes_decrypted.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	void count_inserted(std::size_t blocks) {
+		if(progress != nullptr)
+			progress->blocks_inserted.fetch_add(blocks, std::memory_order_relaxed);
+	}
+};
+
+#endif // BLOB_READER_H
@@ -6,9 +6,42 @@
 #include "obl/oram.h"
 
 #include <ipp/ippcp.h>
+#include <pthread.h>
+
+#include "obl/threadpool.h"
+
+// helper threads running traversals next to the caller, one pool shared by every cbbst
+#define CBBST_WALKERS 3
 
 namespace obl { namespace ods {
 
+	// loading state of one level, so that distinct levels can be filled concurrently
+	struct cbbst_cursor_t {
+		int lvl;
+		int subtree;
+		std::uint8_t evict_ctr[16];
+		std::uint8_t leaf_ctr[16];
+		obl::leaf_id ev_leaf;
+		std::int32_t lvl_index;
+		std::int32_t global_idx;
+	};
+
+	// state of one root-to-leaf traversal, so that several traversals can be in flight
+	struct cbbst_walk_t {
+		std::uint8_t *node_buffer;
+		leaf_id next_fetch, next_evict;
+		int subtree;
+		std::uint64_t ticket;
+
+		cbbst_walk_t(): node_buffer(nullptr) {}
+		~cbbst_walk_t() { delete[] node_buffer; }
+
+		cbbst_walk_t(const cbbst_walk_t&) = delete;
+		cbbst_walk_t& operator=(const cbbst_walk_t&) = delete;
+	};
+
+	typedef void (*cbbst_walk_fn)(void*);
+
 	class cbbst {
 	private:
 		std::size_t N;
@@ -27,17 +60,31 @@ namespace obl { namespace ods {
 		// utils to load data level-wise
 		IppsAESSpec *leafgen;
 		std::uint8_t dummy_ptx[16];
-		std::uint8_t evict_ctr[16];
 		std::uint8_t leaf_ctr[16];
-		std::uint8_t cur_evict_ctr[16];
-		std::uint8_t cur_leaf_ctr[16];
-		obl::leaf_id ev_leaf;
-		std::int32_t current_lvl, lvl_index;
 		std::int32_t global_idx;
+		cbbst_cursor_t cursor;
 
 		// pointer for depth-wise exploration
-		std::uint8_t *node_buffer;
-		leaf_id next_fetch, next_evict;
+		cbbst_walk_t cur_walk;
+
+		/*
+			Every traversal updates the pointers its successor follows, so traversals take
+			a ticket when started and are served in ticket order at every level. Levels are
+			distinct ORAMs, hence traversal k can access level l while k+1 is at level l-1.
+			Tickets are taken and traversals queued to the walkers under submit_lock, so
+			the FIFO order of the pool is the ticket order even with concurrent callers.
+			The pool is shared with the other cbbsts, whose traversals never wait for ours.
+		*/
+		std::uint64_t next_ticket;
+		std::uint64_t *lvl_turn;
+		pthread_mutex_t turn_lock;
+		pthread_cond_t turn_cond;
+		pthread_mutex_t submit_lock;
+
+		void init_walks();
+		void take_ticket(cbbst_walk_t &w);
+		void wait_turn(cbbst_walk_t &w, int lvl);
+		void pass_turn(cbbst_walk_t &w, int lvl);
 
 	public:
 		cbbst(std::size_t N, std::size_t B, oram_factory *allocator);
@@ -55,10 +102,25 @@ namespace obl { namespace ods {
 		void load_values(std::uint8_t *val, std::size_t N);
 		void load_values_with_dummies(std::uint8_t *val, std::size_t N, std::size_t M);
 
-		// methods for traversing the tree
+		// same as above, through an explicit cursor: levels have to be opened in file
+		// order, then each one can be loaded by its own thread
+		void init_level(int l, std::size_t size, cbbst_cursor_t &c);
+		void load_values_with_dummies(cbbst_cursor_t &c, std::uint8_t *val, std::size_t N, std::size_t M);
+
+		// methods for traversing the tree, not reentrant: concurrent queries go through walks
 		void select_subtree(int sbt);
 		void read(obl::block_id bid, std::uint8_t *data_o, int lvl);
 		void update(obl::block_id bid, std::uint8_t *data_i, bool go_left, int lvl);
+
+		// same as above, through an explicit traversal: a traversal must read and update
+		// every level, in order, once started by run_walks
+		void open_walk(cbbst_walk_t &w, int sbt);
+		void read(cbbst_walk_t &w, obl::block_id bid, std::uint8_t *data_o, int lvl);
+		void update(cbbst_walk_t &w, obl::block_id bid, std::uint8_t *data_i, bool go_left, int lvl);
+
+		// start n opened traversals, in the order of fn, concurrently with the caller;
+		// safe to call from several threads at once
+		void run_walks(cbbst_walk_fn *fn, void **args, cbbst_walk_t **walks, int n);
 	};
 
 } }
@@ -8,28 +8,33 @@
 struct bwt_context_t: public subtol_context_t {
 	unsigned int csize;
 	obl::recursive_oram *index;
+	pthread_mutex_t index_lock;
 
 	std::uint64_t sample_rate;
 	std::uint64_t no_bits;
 	std::uint64_t sample_size;
 
-	bwt_context_t(void *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc, unsigned int csize):
+	bwt_context_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc, unsigned int csize):
 		subtol_context_t(fb, N, alpha, allocator, cc)
 	{
 		this->csize = csize;
 		index = nullptr;
+		pthread_mutex_init(&index_lock, nullptr);
 	}
 
 	void init();
 	void load_meta();
 	void load_c();
 	void load_index(std::size_t buffer_size);
+	static void insert_samples(void *ctx, const load_job_t &job, std::uint8_t *plain);
 
 	void query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end);
 
 	~bwt_context_t() {
 		if(index != nullptr)
 			delete index;
+
+		pthread_mutex_destroy(&index_lock);
 	}
 };
 
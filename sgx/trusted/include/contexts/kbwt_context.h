@@ -0,0 +1,31 @@
+#ifndef KBWT_CONTEXT_H
+#define KBWT_CONTEXT_H
+
+#include <cstdint>
+#include "contexts/bwt_context.h"
+
+/*
+	Sampled BWT whose rows carry the k characters preceding their suffix, so that a
+	query advances k characters per pair of ORAM accesses. Samples live in the same
+	recursive ORAM as the vanilla BWT, C holds the k-mer tables instead of the
+	character buckets.
+*/
+struct kbwt_context_t: public bwt_context_t {
+	std::uint64_t k;
+	std::size_t table_size;
+
+	kbwt_context_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc, unsigned int csize):
+		bwt_context_t(fb, N, alpha, allocator, cc, csize)
+	{
+		k = 1;
+		table_size = 0;
+	}
+
+	void init();
+	void load_meta();
+	void load_c();
+
+	void query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end);
+};
+
+#endif // KBWT_CONTEXT_H
@@ -10,7 +10,7 @@ struct n_bwt_context_t: public subtol_context_t {
 	std::size_t max_occ;
 	int L;
 
-	n_bwt_context_t(void *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
+	n_bwt_context_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
 		subtol_context_t(fb, N, alpha, allocator, cc)
 	{
 		index = nullptr;
@@ -24,6 +24,7 @@ struct n_bwt_context_t: public subtol_context_t {
 	virtual void fill_levels(std::size_t buffer_size);
 
 	void query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end);
+	void query_batch(unsigned char **q, std::uint32_t *len, int n, std::uint32_t *start, std::uint32_t *end);
 
 	virtual ~n_bwt_context_t() {
 		if(index != nullptr)
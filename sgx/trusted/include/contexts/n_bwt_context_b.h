@@ -5,7 +5,7 @@
 
 struct n_bwt_context_b_t: public n_bwt_context_t {
 
-	n_bwt_context_b_t(void *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
+	n_bwt_context_b_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
 		n_bwt_context_t(fb, N, alpha, allocator, cc) { }
 
 	~n_bwt_context_b_t() { }
@@ -7,7 +7,7 @@
 struct sa_psi_context_t: public subtol_context_t {
 	obl::ods::cbbst *index;
 
-	sa_psi_context_t(void *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
+	sa_psi_context_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc):
 		subtol_context_t(fb, N, alpha, allocator, cc)
 	{
 		index = nullptr;
@@ -18,6 +18,7 @@ struct sa_psi_context_t: public subtol_context_t {
 	void load_index(std::size_t buffer_size);
 
 	void query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end);
+	void query_batch(unsigned char **q, std::uint32_t *len, int n, std::uint32_t *start, std::uint32_t *end);
 
 	~sa_psi_context_t() {
 		if(index != nullptr)
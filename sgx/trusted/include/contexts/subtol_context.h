@@ -6,7 +6,11 @@
 #include "obl/rec_taostore.h"
 #include "obl/rec_standard.h"
 
+#include "blob_reader.h"
+#include "load_pipeline.h"
+
 #include <ipp/ippcp.h>
+#include <pthread.h>
 #include <cstdint>
 #include <cstdlib>
 #include <cassert>
@@ -19,9 +23,13 @@
 	Since this struct is going to be used inside the enclave, in order to ease its
 	use, I prefer leaving everything public.
 	Wise use of public members is delegated to the programmer.
+
+	Once loaded, a context is shared by all the queries of its session, which may run
+	concurrently: queries keep their scratch state on their own stack, and the ORAMs
+	that are not thread-safe are guarded by a lock of their own.
 */
 struct subtol_context_t {
-	void *fb;
+	blob_reader_t *fb; // only valid while loading
 	std::size_t N;
 	unsigned int alpha;
 	std::uint32_t *C;
@@ -31,9 +39,12 @@ struct subtol_context_t {
 	obl::recursive_oram *suffix_array;
 	unsigned int sa_bundle_size;
 	unsigned int sa_total_blocks;
-	std::uint32_t current_start_index;
 
-	subtol_context_t(void *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc) {
+	// taostore recursive ORAMs serve concurrent clients, the standard ones do not
+	bool rec_concurrent;
+	pthread_mutex_t sa_lock;
+
+	subtol_context_t(blob_reader_t *fb, size_t N, unsigned int alpha, obl::oram_factory *allocator, IppsAES_GCMState *cc) {
 		this->fb = fb;
 		this->N = N;
 		this->alpha = alpha;
@@ -42,8 +53,9 @@ struct subtol_context_t {
 
 		suffix_array = nullptr;
 		C = nullptr;
-		
-		current_start_index = 0;
+
+		rec_concurrent = allocator->is_taostore();
+		pthread_mutex_init(&sa_lock, nullptr);
 	}
 
 	virtual ~subtol_context_t() {
@@ -62,10 +74,32 @@ struct subtol_context_t {
 
 		if(suffix_array != nullptr)
 			delete suffix_array;
+
+		pthread_mutex_destroy(&sa_lock);
 	}
 
 	void load_sa(unsigned int csize, unsigned int sa_block);
-	void fetch_sa(std::int32_t *sa_chunk);
+	// load_pipeline callbacks: cbbst level (target is the cursor), suffix array
+	static void insert_cbbst(void *ctx, const load_job_t &job, std::uint8_t *plain);
+	static void insert_sa(void *ctx, const load_job_t &job, std::uint8_t *plain);
+	// bundle holding entry cursor, which is then moved to the next bundle
+	void fetch_sa(std::int32_t *sa_chunk, std::uint32_t &cursor);
+	// blocks consecutive bundles from the one holding cursor, moved back so they do not
+	// run past the end; a single walk of the position map, returns the first entry fetched
+	std::uint32_t fetch_sa(std::int32_t *sa_chunk, std::uint32_t cursor, unsigned int blocks);
+	// entries first ... first + len - 1, -1 past last; accesses depend on len only
+	void fetch_sa_range(std::int32_t *out, std::uint32_t first, std::uint32_t last, std::size_t len);
+
+	// no-ops on concurrent ORAMs
+	void lock_rec(pthread_mutex_t *m) {
+		if(!rec_concurrent)
+			pthread_mutex_lock(m);
+	}
+
+	void unlock_rec(pthread_mutex_t *m) {
+		if(!rec_concurrent)
+			pthread_mutex_unlock(m);
+	}
 
 	bool verify_mac(std::uint8_t *mac) {
 		uint8_t final_mac[16];
@@ -85,8 +119,10 @@ struct subtol_context_t {
 	virtual void init() = 0;
 	virtual void load_index(std::size_t buffer_size) = 0;
 
-	// put the sauce here!!!
+	// put the sauce here!!! Must be reentrant
 	virtual void query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end) = 0;
+	// n independent queries, by default run back to back
+	virtual void query_batch(unsigned char **q, std::uint32_t *len, int n, std::uint32_t *start, std::uint32_t *end);
 };
 
 #endif // SUBTOL_CONTEXT_H
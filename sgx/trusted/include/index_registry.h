@@ -0,0 +1,58 @@
+#ifndef INDEX_REGISTRY_H
+#define INDEX_REGISTRY_H
+
+#include "subtol_config.h"
+#include "contexts/subtol_context.h"
+
+#include <pthread.h>
+#include <cstdint>
+#include <list>
+#include <memory>
+
+// loaded indexes kept in memory while no session is using them
+#define INDEX_IDLE_MAX 1
+
+struct index_entry_t {
+	std::uint8_t id[32];
+	// null while loading, and if loading failed
+	std::shared_ptr<subtol_context_t> ctx;
+	bool loading;
+	// the load was cancelled rather than failed, waiters try on their own
+	bool cancelled;
+	std::uint64_t last_use;
+};
+
+/*
+	Loaded indexes, shared by every session opening the same file with the same
+	passphrase and ORAM configuration (see index_file_t::id): a single set of ORAMs
+	serves all of them, concurrently. Sessions hold a reference to the context, the
+	registry holds one more so that an index survives its sessions; the least
+	recently opened idle indexes beyond INDEX_IDLE_MAX are evicted.
+	Session keys are only used for the transport, the index is decrypted with the key
+	of the file.
+*/
+class index_registry_t {
+private:
+	pthread_mutex_t lock;
+	pthread_cond_t done_loading;
+	std::list<std::shared_ptr<index_entry_t>> entries;
+	std::uint64_t clock;
+
+	// moves to dead the idle contexts beyond keep, oldest first; lock held
+	void evict(std::size_t keep, std::list<std::shared_ptr<subtol_context_t>> &dead);
+
+public:
+	index_registry_t();
+	~index_registry_t();
+
+	index_registry_t(const index_registry_t&) = delete;
+	index_registry_t& operator=(const index_registry_t&) = delete;
+
+	// loads the index unless already there, nullptr if the file does not authenticate
+	// or the load got cancelled through progress (a load_progress_t in host memory)
+	std::shared_ptr<subtol_context_t> open(void *fb, void *progress, char *pwd, subtol_config_t &cfg);
+	// to be called after a session dropped its reference
+	void trim();
+};
+
+#endif // INDEX_REGISTRY_H
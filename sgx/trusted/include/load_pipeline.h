@@ -0,0 +1,42 @@
+#ifndef LOAD_PIPELINE_H
+#define LOAD_PIPELINE_H
+
+#include "blob_reader.h"
+
+#include <ipp/ippcp.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// max number of inserter threads, counted in ENCLAVE_TCS_NUM
+#define LOAD_MAX_LANES 4
+
+// one chunk of the index file; jobs are listed in file order
+struct load_job_t {
+	std::size_t bytes;
+	int lane;		   // jobs of the same lane are inserted in order by the same thread
+	void *target;	   // loader specific, e.g. a cbbst cursor
+	std::size_t first; // loader specific, e.g. first block id of the chunk
+	std::size_t count; // records in the chunk
+	std::size_t valid; // non-dummy records in the chunk
+};
+
+typedef void (*load_insert_fn)(void *ctx, const load_job_t &job, std::uint8_t *plain);
+
+/*
+	Three-stage loader:
+	- a reader thread pulls the ciphertext of each job out of the blob reader
+	- the calling thread decrypts the jobs in file order, since GCM is sequential
+	- `lanes` inserter threads push the plaintext into the index
+	Stages are connected by bounded queues over a fixed set of chunk buffers (two for
+	the reader, two per lane for the inserters), so reading, decryption and insertion
+	of consecutive chunks overlap while memory stays bounded.
+	Lanes must partition the jobs so that no two lanes touch the same ORAM, unless the
+	ORAM itself is safe for concurrent access (taostore).
+	Once the load is cancelled (see blob_reader_t) the remaining jobs go through the
+	stages without being read, decrypted or inserted. Stages whose thread cannot be
+	created run on the calling thread.
+*/
+void run_load_pipeline(blob_reader_t *fb, IppsAES_GCMState *cc, const std::vector<load_job_t> &jobs, int lanes, load_insert_fn insert, void *ctx);
+
+#endif // LOAD_PIPELINE_H
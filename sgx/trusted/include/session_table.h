@@ -0,0 +1,125 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include "user_session.h"
+
+#include <sgx_error.h>
+#include <sgx_key_exchange.h>
+#include <sgx_spinlock.h>
+
+#include <atomic>
+#include <cstdint>
+
+// number of shards, power of two
+#define SESSION_SHARDS 16
+// sessions per shard, the enclave holds at most SESSION_SHARDS * SESSION_SHARD_SLOTS
+// sessions; the slots are part of the enclave image, size them with the heap in mind
+#ifndef SESSION_SHARD_SLOTS
+#define SESSION_SHARD_SLOTS 64
+#endif
+
+// returned by create when every slot is taken, the host answers 503
+#define SESSION_TABLE_FULL SGX_ERROR_BUSY
+
+/*
+	Slots are never freed, only recycled, so a reader can always touch refs and seq
+	of a slot it found, even if the session it was looking for got closed meanwhile.
+	seq is odd while a writer changes key, used or the session itself.
+*/
+struct session_slot_t {
+	std::atomic<std::uint32_t> seq;
+	std::atomic<sgx_ra_context_t> key;
+	std::atomic<bool> used;
+	// readers currently holding the session
+	std::atomic<int> refs;
+
+	user_session_t sess;
+
+	session_slot_t() {
+		seq.store(0);
+		key.store(0);
+		used.store(false);
+		refs.store(0);
+	}
+};
+
+struct session_shard_t {
+	// taken by writers only (create, close), lookups are lock-free
+	sgx_spinlock_t writer;
+	session_slot_t slots[SESSION_SHARD_SLOTS];
+
+	session_shard_t() {
+		writer = SGX_SPINLOCK_INITIALIZER;
+	}
+};
+
+// pin on a session: while alive, the session cannot be closed
+class session_ref_t {
+private:
+	session_slot_t *slot;
+
+public:
+	explicit session_ref_t(session_slot_t *slot = nullptr): slot(slot) {}
+	~session_ref_t() { release(); }
+
+	session_ref_t(const session_ref_t&) = delete;
+	session_ref_t& operator=(const session_ref_t&) = delete;
+
+	session_ref_t(session_ref_t &&o): slot(o.slot) { o.slot = nullptr; }
+
+	void release() {
+		if(slot != nullptr)
+			slot->refs.fetch_sub(1);
+		slot = nullptr;
+	}
+
+	explicit operator bool() const { return slot != nullptr; }
+	user_session_t* operator->() const { return &slot->sess; }
+	user_session_t& operator*() const { return slot->sess; }
+};
+
+/*
+	Sessions sharded by attestation context. Lookups never take a lock: they read
+	the slot under its seqlock, pin it by incrementing refs and validate that seq
+	did not change meanwhile. Writers bump seq before checking refs, so either the
+	reader sees the change and retries, or the writer sees the pin and backs off.
+	Queries on different sessions therefore share no lock and no written cache line
+	but the ones of their own slot.
+
+	A session lives in the shard of its context unless that shard is full, then it
+	spills into the next shard with a free slot. Spills are serialised by spill_lock,
+	and find and close only look past the home shard while spilled is not zero.
+*/
+class session_table_t {
+private:
+	session_shard_t shards[SESSION_SHARDS];
+	// taken before a shard lock, never the other way round
+	sgx_spinlock_t spill_lock;
+	// sessions living outside their home shard
+	std::atomic<int> spilled;
+
+	static int shard_index(sgx_ra_context_t ctx) { return ctx & (SESSION_SHARDS - 1); }
+	// slot where the probe sequence of ctx starts, in any shard
+	static int home_of(sgx_ra_context_t ctx) { return (ctx / SESSION_SHARDS) % SESSION_SHARD_SLOTS; }
+
+	// with the writer lock of sh: the slot of ctx, if any, and the first free slot
+	static session_slot_t* scan(session_shard_t &sh, sgx_ra_context_t ctx, session_slot_t **free_slot);
+	static void claim(session_slot_t *slot, sgx_ra_context_t ctx);
+	static sgx_status_t close_in(session_shard_t &sh, sgx_ra_context_t ctx, std::shared_ptr<subtol_context_t> &dead);
+	static session_ref_t find_in(session_shard_t &sh, sgx_ra_context_t ctx);
+
+public:
+	session_table_t() {
+		spill_lock = SGX_SPINLOCK_INITIALIZER;
+		spilled.store(0);
+	}
+
+	// SGX_ERROR_INVALID_PARAMETER if the session exists, SESSION_TABLE_FULL if no slot is free
+	sgx_status_t create(sgx_ra_context_t ctx);
+	// SGX_ERROR_INVALID_PARAMETER if missing, SGX_ERROR_INVALID_STATE if in use
+	sgx_status_t close(sgx_ra_context_t ctx);
+	// empty reference if missing
+	session_ref_t find(sgx_ra_context_t ctx);
+};
+
+#endif // SESSION_TABLE_H
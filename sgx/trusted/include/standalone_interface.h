@@ -3,7 +3,32 @@
 
 #include "subtol_config.h"
 #include "contexts/subtol_context.h"
+#include "blob_reader.h"
 
-subtol_context_t* init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg);
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// cleartext header and key of an index file, enough to tell whether it is already loaded
+struct index_file_t {
+	std::uint64_t algorithm_selection;
+	std::uint64_t header[4];
+	std::uint8_t iv[12];
+	std::vector<std::uint8_t> salt;
+	std::uint8_t mac[16];
+	std::uint8_t aes_key[16];
+
+	// digest of all of the above and of the ORAM configuration
+	std::uint8_t id[32];
+
+	~index_file_t() {
+		std::memset(aes_key, 0x00, 16);
+	}
+};
+
+// derives the key from pwd, which is wiped
+void open_index_file(blob_reader_t &reader, char *pwd, subtol_config_t &cfg, index_file_t &file);
+// nullptr if the file does not authenticate
+subtol_context_t* init_subtol_context(blob_reader_t &reader, index_file_t &file, subtol_config_t &cfg);
 
 #endif // SUBTOL_STANDALONE_INTERFACE_H
@@ -0,0 +1,142 @@
+#ifndef KBWT_HPP
+#define KBWT_HPP
+
+#include "obl/rec.h"
+#include "obl/primitives.h"
+#include "substring/substring_common.h"
+
+// Interface
+
+/*
+	Backward search advancing k characters per pair of ORAM accesses, over the index
+	written by sampled_kbwt. The query is split in ceil(qlen / k) chunks, the first one
+	being padded at the front with dummy characters, so the number of accesses only
+	depends on qlen. Dummy characters are skipped as in vbwt: the real characters of a
+	chunk are compacted into an m-mer, m <= k, and a chunk without real characters
+	leaves the range untouched.
+*/
+template<typename Int, typename Char>
+inline
+void kbwt_query(obl::recursive_oram *index, Int *C, std::size_t N,
+	Int s_rate, std::size_t s_size, std::uint64_t enc_bit, Int k, Int alpha,
+	Char *q, Int qlen,
+	Int *s, Int *e
+);
+
+// Static functions
+
+// occurrences of the m-mer with the given code among the first limit rows of the block
+static int partial_kmer_rank(std::uint64_t *codes, int limit, int sample_rate, std::uint64_t target, std::uint64_t mask, int code_bits)
+{
+	int p_rank = 0;
+	int per_word = 64 / code_bits;
+
+	for(int i = 0; i < sample_rate; i++)
+	{
+		// public indices, only the comparison is secret
+		std::uint64_t current = codes[i / per_word] >> ((i % per_word) * code_bits);
+		p_rank += obl::ternary_op(((current & mask) == target) & (i < limit), 1, 0);
+	}
+
+	return p_rank;
+}
+
+// Implementation
+
+template<typename Int, typename Char>
+void kbwt_query(obl::recursive_oram *index, Int *C, std::size_t N,
+	Int s_rate, std::size_t s_size, std::uint64_t enc_bit, Int k, Int alpha,
+	Char *q, Int qlen,
+	Int *s, Int *e)
+{
+	Int start, end;
+	std::uint8_t buffer[s_size];
+
+	// section of the k-mer tables devoted to the m-mers
+	Int mer_offset[k + 1];
+	Int table_size = 0;
+	Int pw = 1;
+
+	for(Int m = 0; m < k; m++)
+	{
+		mer_offset[m + 1] = table_size;
+		pw *= alpha;
+		table_size += pw;
+	}
+
+	mer_offset[0] = 0;
+
+	std::size_t ch_offset = (sizeof(Int) * table_size + 7) & ~((std::size_t) 7);
+	int code_bits = k * enc_bit;
+
+	// empty pattern: all the rows
+	start = 0;
+	end = N;
+
+	Int no_steps = qlen / k + (qlen % k == 0 ? 0 : 1);
+	std::int64_t hi = (std::int64_t) qlen - 1;
+
+	for(Int step = 0; step < no_steps; step++)
+	{
+		// compact the real characters of the chunk into an m-mer, last character first
+		Int m = 0;
+		Int mer = 0;
+		Int mer_pw = 1;
+		std::uint64_t code = 0;
+
+		for(Int j = 0; j < k; j++)
+		{
+			// the position is public, padding lives before the beginning of the query
+			std::int64_t pos = hi - j;
+			Int char_index = pos >= 0 ? (Int) q[pos] : -1;
+			bool real = (char_index >= 0) & (char_index < alpha);
+
+			mer = obl::ternary_op(real, mer + char_index * mer_pw, mer);
+			mer_pw = obl::ternary_op(real, mer_pw * alpha, mer_pw);
+			code = obl::ternary_op(real, code | ((std::uint64_t) char_index << (m * enc_bit)), code);
+			m = obl::ternary_op(real, m + 1, m);
+		}
+
+		hi -= k;
+
+		Int mer_index = linear_scan<Int>(mer_offset, m, k) + mer;
+		std::uint64_t mask = ((std::uint64_t) 1 << (m * enc_bit)) - 1;
+
+		// base offset
+		Int base_offset = linear_scan<Int>(C, mer_index, table_size - 1);
+
+		// process start
+		Int inner_offset = start % s_rate;
+		Int outer_offset = start / s_rate;
+
+		index->access(outer_offset, nullptr, buffer);
+
+		Int *acc = (Int*)buffer;
+		Int sample_offset = linear_scan<Int>(acc, mer_index, table_size - 1);
+
+		std::uint64_t *codes = (std::uint64_t*)(buffer + ch_offset);
+		Int next_start = base_offset + sample_offset + partial_kmer_rank(codes, inner_offset, s_rate, code, mask, code_bits);
+
+		// process end
+		inner_offset = (end % s_rate) + 1;
+		outer_offset = end / s_rate;
+
+		index->access(outer_offset, nullptr, buffer);
+
+		acc = (Int*)buffer;
+		sample_offset = linear_scan<Int>(acc, mer_index, table_size - 1);
+
+		codes = (std::uint64_t*)(buffer + ch_offset);
+		Int next_end = base_offset + sample_offset + partial_kmer_rank(codes, inner_offset, s_rate, code, mask, code_bits) - 1;
+
+		// support for dummy characters
+		bool dummy_mer = m == 0;
+		start = obl::ternary_op(dummy_mer, start, next_start);
+		end = obl::ternary_op(dummy_mer, end, next_end);
+	}
+
+	*s = start;
+	*e = end;
+}
+
+#endif // KBWT_HPP
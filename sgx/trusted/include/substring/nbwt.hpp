@@ -15,6 +15,15 @@ void nbwt_query(
 	Int *s, Int *e
 );
 
+// several independent queries, pipelined over the levels of the index
+template<typename Int, typename Char>
+inline
+void nbwt_query_batch(
+	obl::ods::cbbst *index, Int *C, Int alpha,
+	Char **q, Int *qlen,
+	Int *s, Int *e, int n
+);
+
 // since we have no buckets here
 // this is not inefficient since the scan of C will be linear in the final oblivious version
 template<typename Int>
@@ -31,102 +40,164 @@ static Int get_offset(Int *C, Int idx, Int alpha)
 	return ret;
 }
 
+template<>
+inline
+std::uint32_t get_offset<std::uint32_t>(std::uint32_t *C, std::uint32_t idx, std::uint32_t alpha)
+{
+	return 1 + obl::scan_prefix_sum((std::int32_t*) C, alpha, idx);
+}
+
 // Implementation
 
+/*
+	The start and end searches of every character are two independent traversals of
+	the same cbbst. Both count the entries below a key: strictly below key = start for
+	the start search, up to key = end included for the end search (inclusive), and run
+	concurrently through run_walks.
+*/
+template<typename Int>
+struct nbwt_walk_t {
+	obl::ods::cbbst *index;
+	obl::ods::cbbst_walk_t walk;
+
+	Int subtree, limit, key;
+	bool inclusive;
+	Int rank;
+};
+
+template<typename Int>
+static void nbwt_walk(void *arg)
+{
+	nbwt_walk_t<Int> *w = (nbwt_walk_t<Int>*) arg;
+	const Int L = w->index->get_L();
+
+	Int h = 0;
+	Int p_s = 0;
+	Int p_e = w->limit;
+
+	w->rank = 0;
+
+	for(int l = 0; l < L; l++)
+	{
+		// perform access to the dummy block!
+		Int heap_biased;
+		heap_biased = obl::ternary_op(h >= w->limit, -1, h + w->subtree);
+
+		Int real_idx = p_s + get_subroot(p_e - p_s);
+		Int curr_idx;
+		w->index->read(w->walk, heap_biased, (std::uint8_t*) &curr_idx, l);
+
+		bool below = (curr_idx < w->key) | (w->inclusive & (curr_idx == w->key));
+		bool go_left = !below;
+		bool to_update = below & (real_idx >= w->rank) & (heap_biased != -1);
+
+		w->rank = obl::ternary_op(to_update, real_idx + 1, w->rank);
+		w->index->update(w->walk, heap_biased, (std::uint8_t*) &curr_idx, go_left, l);
+
+		h = (h << 1) + 1 + obl::ternary_op(go_left, 0, 1);
+		p_s = obl::ternary_op(go_left, p_s, real_idx + 1);
+		p_e = obl::ternary_op(go_left, real_idx, p_e);
+	}
+}
+
+// n queries in lockstep: the traversals of one step form a wavefront over the levels
 template<typename Int, typename Char>
-void nbwt_query(obl::ods::cbbst *index, Int *C, Int alpha, Char *q, Int qlen, Int *s, Int *e)
+void nbwt_query_batch(obl::ods::cbbst *index, Int *C, Int alpha, Char **q, Int *qlen, Int *s, Int *e, int n)
 {
-	Int start, end;
 	const Int subtree_size = index->get_N();
-	const Int L = index->get_L();
 
-	--qlen;
+	Int *rem = new Int[n];
+	Int *offset = new Int[n];
+	bool *dummy_char = new bool[n];
+	nbwt_walk_t<Int> *walks = new nbwt_walk_t<Int>[2 * n];
+	obl::ods::cbbst_walk_fn *fn = new obl::ods::cbbst_walk_fn[2 * n];
+	void **args = new void*[2 * n];
+	obl::ods::cbbst_walk_t **opened = new obl::ods::cbbst_walk_t*[2 * n];
+	Int longest = 0;
+
+	for(int j = 0; j < n; j++)
+	{
+		rem[j] = qlen[j] - 1;
 
-	start = get_offset<Int>(C, (Int) q[qlen], alpha);
-	end = get_offset<Int>(C, (Int) q[qlen] + 1, alpha) - 1;
-	--qlen;
+		s[j] = get_offset<Int>(C, (Int) q[j][rem[j]], alpha);
+		e[j] = get_offset<Int>(C, (Int) q[j][rem[j]] + 1, alpha) - 1;
+		--rem[j];
+
+		longest = rem[j] + 1 > longest ? rem[j] + 1 : longest;
+	}
 
-	while(qlen != -1)
+	for(Int step = 0; step < longest; step++)
 	{
-		Int char_index = (Int) q[qlen];
-		Int offset = get_offset<Int>(C, char_index, alpha);
-
-		Int rank_f = 0;
-		Int rank_l = 0;
-		
-		//replace a dummy character with a random character in the alphabet	
-		bool dummy_char = (char_index < 0) | (char_index >= alpha);
-		uint64_t rnd;
-		obl::gen_rand((uint8_t *) &rnd,sizeof(uint64_t));
-		char_index = obl::ternary_op(dummy_char,rnd % alpha,char_index);
-
-		Int subtree = char_index * subtree_size;	
-		Int limit = linear_scan<Int>(C, char_index, alpha - 1);
-		
-	
-		index->select_subtree(char_index);
-
-		Int h = 0;
-		Int p_s = 0;
-		Int p_e = limit;
-		
-		for(int l = 0; l < L; l++)
+		int no_walks = 0;
+
+		for(int j = 0; j < n; j++)
 		{
-			// perform access to the dummy block!
-			Int heap_biased;
-			heap_biased = obl::ternary_op(h >= limit, -1, h + subtree);
-	
-			Int real_idx = p_s + get_subroot(p_e - p_s);
-			Int curr_idx;
-			index->read(heap_biased, (std::uint8_t*) &curr_idx, l);
-
-			bool go_left = curr_idx >= start;
-			bool to_update = (curr_idx < start) & (real_idx >= rank_f) & (heap_biased != -1);
-		
-			rank_f = obl::ternary_op(to_update, real_idx + 1, rank_f);
-			index->update(heap_biased, (std::uint8_t*) &curr_idx, go_left, l);
-	
-			h = (h << 1) + 1 + obl::ternary_op(go_left, 0, 1);
-			p_s = obl::ternary_op(go_left, p_s, real_idx + 1);
-			p_e = obl::ternary_op(go_left, real_idx, p_e);
+			if(rem[j] == -1)
+				continue;
+
+			Int char_index = (Int) q[j][rem[j]];
+			offset[j] = get_offset<Int>(C, char_index, alpha);
+
+			//replace a dummy character with a random character in the alphabet
+			dummy_char[j] = (char_index < 0) | (char_index >= alpha);
+			uint64_t rnd;
+			obl::gen_rand((uint8_t *) &rnd,sizeof(uint64_t));
+			char_index = obl::ternary_op(dummy_char[j],rnd % alpha,char_index);
+
+			Int subtree = char_index * subtree_size;
+			Int limit = linear_scan<Int>(C, char_index, alpha - 1);
+
+			for(int k = 0; k < 2; k++)
+			{
+				nbwt_walk_t<Int> *w = &walks[no_walks];
+
+				w->index = index;
+				w->subtree = subtree;
+				w->limit = limit;
+				w->key = k == 0 ? s[j] : e[j];
+				w->inclusive = k != 0;
+				index->open_walk(w->walk, char_index);
+
+				fn[no_walks] = nbwt_walk<Int>;
+				args[no_walks] = w;
+				opened[no_walks] = &w->walk;
+				++no_walks;
+			}
 		}
 
-		index->select_subtree(char_index);
-
-		h = 0;
-		p_s = 0;
-		p_e = limit;
+		index->run_walks(fn, args, opened, no_walks);
 
-		for(int l = 0; l < L; l++)
+		no_walks = 0;
+		for(int j = 0; j < n; j++)
 		{
-			// perform access to the dummy block!
-			Int heap_biased;
-			heap_biased = obl::ternary_op(h >= limit, -1, h + subtree);
-
-			Int real_idx = p_s + get_subroot(p_e - p_s);
-			Int curr_idx;
-			index->read(heap_biased, (std::uint8_t*) &curr_idx, l);
+			if(rem[j] == -1)
+				continue;
 
-			bool go_left = curr_idx > end;
-			bool to_update = (curr_idx <= end) & (real_idx >= rank_l) & (heap_biased != -1);
+			Int rank_f = walks[no_walks].rank;
+			Int rank_l = walks[no_walks + 1].rank;
+			no_walks += 2;
 
-			rank_l = obl::ternary_op(to_update, real_idx + 1, rank_l);
-			index->update(heap_biased, (std::uint8_t*) &curr_idx, go_left, l);
+			// support for dummy characters
+			s[j] = obl::ternary_op(dummy_char[j], s[j], offset[j] + rank_f);
+			e[j] = obl::ternary_op(dummy_char[j], e[j], offset[j] + rank_l - 1);
 
-			h = (h << 1) + 1 + obl::ternary_op(go_left, 0, 1);
-			p_s = obl::ternary_op(go_left, p_s, real_idx + 1);
-			p_e = obl::ternary_op(go_left, real_idx, p_e);
+			--rem[j];
 		}
-	
-		// support for dummy characters
-		start = obl::ternary_op(dummy_char, start, offset + rank_f);
-		end = obl::ternary_op(dummy_char, end, offset + rank_l - 1);
-
-		--qlen;
 	}
 
-	*s = start;
-	*e = end;
+	delete[] rem;
+	delete[] offset;
+	delete[] dummy_char;
+	delete[] walks;
+	delete[] fn;
+	delete[] args;
+	delete[] opened;
+}
+
+template<typename Int, typename Char>
+void nbwt_query(obl::ods::cbbst *index, Int *C, Int alpha, Char *q, Int qlen, Int *s, Int *e)
+{
+	nbwt_query_batch<Int, Char>(index, C, alpha, &q, &qlen, s, e, 1);
 }
 
 #endif // NBWT_HPP
@@ -16,97 +16,165 @@ void sapsi_query(
 	Int *s, Int *e
 );
 
+// several independent queries, pipelined over the levels of the index
+template<typename Int, typename Char>
+inline
+void sapsi_query_batch(
+	obl::ods::cbbst *psi, Int *C, Int alpha,
+	Char **q, Int *qlen,
+	Int *s, Int *e, int n
+);
+
 // Implementation
 
-template<typename Int, typename Char>
-void sapsi_query(obl::ods::cbbst *psi, Int *C, Int alpha, Char *q, Int qlen, Int *s, Int *e)
+/*
+	The searches for the new start and end of the range are independent traversals of
+	the same cbbst: they look for the first entry in [low_bound, upp_bound] whose value
+	is >= start, and the last one whose value is <= end.
+	They run concurrently through run_walks.
+*/
+template<typename Int>
+struct sapsi_walk_t {
+	obl::ods::cbbst *psi;
+	obl::ods::cbbst_walk_t walk;
+
+	Int low_bound, upp_bound;
+	Int start, end, key;
+	bool inclusive;
+	Int found;
+};
+
+template<typename Int>
+static void sapsi_walk(void *arg)
 {
-	Int start, end;
-	Int len = psi->get_N();
-	int L = psi->get_L();
+	sapsi_walk_t<Int> *w = (sapsi_walk_t<Int>*) arg;
+	const Int len = w->psi->get_N();
+	const int L = w->psi->get_L();
 
-	// index the last character of the query
-	--qlen;
+	// this is the current section of PSI array that is considered
+	Int psi_s = 0;
+	Int psi_e = len;
 
-	// process the last character of the query
-	start = linear_scan<Int>(C, (Int)q[qlen], alpha);
-	end = linear_scan<Int>(C, (Int)q[qlen] + 1, alpha) - 1;
-	--qlen;
+	Int h = 0; // position in the heap
+	w->found = -1;
 
-	while(qlen != -1)
+	for(int l = 0; l < L; l++)
 	{
-		// those are the ranges of the subtree where we are required to perform our search
-		Int char_index = (Int) q[qlen];
-		Int low_bound = linear_scan<Int>(C, char_index, alpha);
-		Int upp_bound = linear_scan<Int>(C, char_index + 1, alpha) - 1;
+		// perform access to the dummy block!
+		h = obl::ternary_op(h >= len, -1, h);
 
-		// this is the current section of PSI array that is considered
-		Int psi_s = 0;
-		Int psi_e = len;
+		Int real_idx = psi_s + get_subroot(psi_e - psi_s);
+		Int curr_psi;
+		w->psi->read(w->walk, h, (std::uint8_t*) &curr_psi, l);
 
-		Int h = 0; // position in the heap
-		Int next_start = -1;
+		bool right_range = (real_idx >= w->low_bound) & (real_idx <= w->upp_bound);
+		bool in_psi_range = (curr_psi >= w->start) & (curr_psi <= w->end);
+		bool below = (curr_psi < w->key) | (w->inclusive & (curr_psi == w->key));
+		bool go_right = (real_idx < w->low_bound) | (right_range & below);
 
-		for(int l = 0; l < L; l++)
-		{
-			// perform access to the dummy block!
-			h = obl::ternary_op(h >= len, -1, h);
-
-			Int real_idx = psi_s + get_subroot(psi_e - psi_s);
-			Int curr_psi;
-			psi->read(h, (std::uint8_t*) &curr_psi, l);
+		w->found = obl::ternary_op(right_range & in_psi_range & (h != -1), real_idx, w->found);
 
-			bool right_range = (real_idx >= low_bound) & (real_idx <= upp_bound);
-			bool in_psi_range = (curr_psi >= start) & (curr_psi <= end);
-			bool go_right = (real_idx < low_bound) | (right_range & (curr_psi < start));
+		w->psi->update(w->walk, h, (std::uint8_t*) &curr_psi, !go_right, l);
 
-			next_start = obl::ternary_op(right_range & in_psi_range & (h != -1), real_idx, next_start);
+		h = (h << 1) + 1 + obl::ternary_op(go_right, 1, 0);
+		psi_s = obl::ternary_op(go_right, real_idx + 1, psi_s);
+		psi_e = obl::ternary_op(go_right, psi_e, real_idx);
+	}
+}
 
-			psi->update(h, (std::uint8_t*) &curr_psi, !go_right, l);
+// n queries in lockstep: the traversals of one step form a wavefront over the levels
+template<typename Int, typename Char>
+void sapsi_query_batch(obl::ods::cbbst *psi, Int *C, Int alpha, Char **q, Int *qlen, Int *s, Int *e, int n)
+{
+	Int *rem = new Int[n];
+	bool *dummy_char = new bool[n];
+	sapsi_walk_t<Int> *walks = new sapsi_walk_t<Int>[2 * n];
+	obl::ods::cbbst_walk_fn *fn = new obl::ods::cbbst_walk_fn[2 * n];
+	void **args = new void*[2 * n];
+	obl::ods::cbbst_walk_t **opened = new obl::ods::cbbst_walk_t*[2 * n];
+	Int longest = 0;
+
+	for(int j = 0; j < n; j++)
+	{
+		// index the last character of the query
+		rem[j] = qlen[j] - 1;
 
-			h = (h << 1) + 1 + obl::ternary_op(go_right, 1, 0);
-			psi_s = obl::ternary_op(go_right, real_idx + 1, psi_s);
-			psi_e = obl::ternary_op(go_right, psi_e, real_idx);
-		}
+		// process the last character of the query
+		s[j] = linear_scan<Int>(C, (Int)q[j][rem[j]], alpha);
+		e[j] = linear_scan<Int>(C, (Int)q[j][rem[j]] + 1, alpha) - 1;
+		--rem[j];
 
-		// reset values
-		psi_s = 0;
-		psi_e = len;
+		longest = rem[j] + 1 > longest ? rem[j] + 1 : longest;
+	}
 
-		h = 0;
-		Int next_end = -1;
+	for(Int step = 0; step < longest; step++)
+	{
+		int no_walks = 0;
 
-		for(int l = 0; l < L; l++)
+		for(int j = 0; j < n; j++)
 		{
-			h = obl::ternary_op(h >= len, -1, h);
+			if(rem[j] == -1)
+				continue;
+
+			// those are the ranges of the subtree where we are required to perform our search
+			Int char_index = (Int) q[j][rem[j]];
+			Int low_bound = linear_scan<Int>(C, char_index, alpha);
+			Int upp_bound = linear_scan<Int>(C, char_index + 1, alpha) - 1;
+
+			dummy_char[j] = (char_index < 0) | (char_index >= alpha);
+
+			for(int k = 0; k < 2; k++)
+			{
+				sapsi_walk_t<Int> *w = &walks[no_walks];
+
+				w->psi = psi;
+				w->low_bound = low_bound;
+				w->upp_bound = upp_bound;
+				w->start = s[j];
+				w->end = e[j];
+				w->key = k == 0 ? s[j] : e[j];
+				w->inclusive = k != 0;
+				psi->open_walk(w->walk, 0);
+
+				fn[no_walks] = sapsi_walk<Int>;
+				args[no_walks] = w;
+				opened[no_walks] = &w->walk;
+				++no_walks;
+			}
+		}
 
-			Int real_idx = psi_s + get_subroot(psi_e - psi_s);
-			Int curr_psi;
-			psi->read(h, (std::uint8_t*) &curr_psi, l);
+		psi->run_walks(fn, args, opened, no_walks);
 
-			bool right_range = (real_idx >= low_bound) & (real_idx <= upp_bound);
-			bool in_psi_range = (curr_psi >= start) & (curr_psi <= end);
-			bool go_right = (real_idx < low_bound) | (right_range & (curr_psi <= end));
+		no_walks = 0;
+		for(int j = 0; j < n; j++)
+		{
+			if(rem[j] == -1)
+				continue;
 
-			next_end = obl::ternary_op(right_range & in_psi_range & (h != -1), real_idx, next_end);
+			Int next_start = walks[no_walks].found;
+			Int next_end = walks[no_walks + 1].found;
+			no_walks += 2;
 
-			psi->update(h, (std::uint8_t*) &curr_psi, !go_right, l);
+			// support for dummy characters
+			s[j] = obl::ternary_op(dummy_char[j], s[j], next_start);
+			e[j] = obl::ternary_op(dummy_char[j], e[j], next_end);
 
-			h = (h << 1) + 1 + obl::ternary_op(go_right, 1, 0);
-			psi_s = obl::ternary_op(go_right, real_idx + 1, psi_s);
-			psi_e = obl::ternary_op(go_right, psi_e, real_idx);
+			--rem[j];
 		}
-
-		// support for dummy characters
-		bool dummy_char = (char_index < 0) | (char_index >= alpha);
-		start = obl::ternary_op(dummy_char, start, next_start);
-		end = obl::ternary_op(dummy_char, end, next_end);
-
-		--qlen;
 	}
 
-	*s = start;
-	*e = end;
+	delete[] rem;
+	delete[] dummy_char;
+	delete[] walks;
+	delete[] fn;
+	delete[] args;
+	delete[] opened;
+}
+
+template<typename Int, typename Char>
+void sapsi_query(obl::ods::cbbst *psi, Int *C, Int alpha, Char *q, Int qlen, Int *s, Int *e)
+{
+	sapsi_query_batch<Int, Char>(psi, C, alpha, &q, &qlen, s, e, 1);
 }
 
 #endif // S3_PSI_HPP
@@ -2,6 +2,9 @@
 #define SUBSTRING_COMMON_H
 
 #include "obl/primitives.h"
+#include "obl/scan.h"
+
+#include <cstdint>
 
 template<typename Int>
 inline
@@ -15,6 +18,21 @@ Int linear_scan(Int *v, Int idx, Int limit)
 	return ret;
 }
 
+// 32-bit tables (C arrays and sampled occurrences) go through the SIMD kernel
+template<>
+inline
+std::uint32_t linear_scan<std::uint32_t>(std::uint32_t *v, std::uint32_t idx, std::uint32_t limit)
+{
+	return obl::scan_select((std::int32_t*) v, limit + 1, idx);
+}
+
+template<>
+inline
+std::int32_t linear_scan<std::int32_t>(std::int32_t *v, std::int32_t idx, std::int32_t limit)
+{
+	return obl::scan_select(v, limit + 1, idx);
+}
+
 inline std::size_t fill_with_ones(std::size_t v)
 {
 	// on x86-64, sizeof(std::size_t) = 8
@@ -3,6 +3,7 @@
 
 #include "obl/rec.h"
 #include "obl/primitives.h"
+#include "obl/bitslice.h"
 #include "substring/substring_common.h"
 
 // Interface
@@ -15,35 +16,6 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
 	Int *s, Int *e
 );
 
-// Static functions
-
-static int partial_rank(std::uint16_t *ch, int limit, int sample_rate, std::int16_t target, int enc_bit)
-{
-	int p_rank = 0;
-
-	int hword = 0;
-	int shift_right = 0;
-	std::uint16_t mask = (1 << enc_bit) - 1;
-
-	for(int i = 0; i < sample_rate; i++)
-	{
-		std::uint16_t current = (ch[hword] >> shift_right) & mask;
-
-		shift_right += enc_bit;
-		if(shift_right > 16) // this is a known, public parameter, so you don't need to hide this if
-		{
-			++hword;
-			shift_right -= 16;
-			current = current | (ch[hword] << (enc_bit - shift_right));
-			current = current & mask;
-		}
-
-		p_rank += obl::ternary_op((current == target) & (i < limit), 1, 0);
-	}
-
-	return p_rank;
-}
-
 // Implementation
 
 template<typename Int, typename Char>
@@ -55,6 +27,10 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
 	Int start, end;
 	std::uint8_t buffer[s_size];
 
+	// the bwt window follows the occurrences, bit-sliced
+	std::size_t ch_offset = (sizeof(Int) * alpha + 7) & ~((std::size_t) 7);
+	unsigned int words = obl::bitslice_words(s_rate);
+
 	--qlen;
 
 	start = linear_scan<Int>(C, (Int) q[qlen], alpha);
@@ -76,8 +52,8 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
 		Int *acc = (Int*)buffer;
 		Int sample_offset = linear_scan<Int>(acc, char_index, alpha-1);
 
-		std::uint16_t *ch = (std::uint16_t*)(acc + alpha);
-		Int next_start = base_offset + sample_offset + partial_rank(ch, inner_offset, s_rate, char_index, enc_bit);
+		std::uint64_t *planes = (std::uint64_t*)(buffer + ch_offset);
+		Int next_start = base_offset + sample_offset + obl::bitslice_rank(planes, words, enc_bit, char_index, inner_offset);
 
 		// process end
 		inner_offset = (end % s_rate) + 1;
@@ -88,8 +64,8 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
 		acc = (Int*)buffer;
 		sample_offset = linear_scan<Int>(acc, char_index, alpha-1);
 
-		ch = (std::uint16_t*)(acc + alpha);
-		Int next_end = base_offset + sample_offset + partial_rank(ch, inner_offset, s_rate, char_index, enc_bit) - 1;
+		planes = (std::uint64_t*)(buffer + ch_offset);
+		Int next_end = base_offset + sample_offset + obl::bitslice_rank(planes, words, enc_bit, char_index, inner_offset) - 1;
 		
 		// support for dummy characters
 		bool dummy_char = (char_index < 0) | (char_index >= alpha);
@@ -10,9 +10,22 @@ enum obl_oram_t {
 	RING_ORAM,
 	PATH_ORAM,
 	TAOSTORE_V1,
-	TAOSTORE_V2
+	TAOSTORE_V2,
+	RO_CIRCUIT_ORAM,
+	ADAPTIVE_ORAM
 };
 
+// max queries in a single query_batch call, keep in sync with the host
+#define QUERY_BATCH_MAX 1024
+// max suffix-array entries in a single fetch_sa_range call, keep in sync with the host
+#define SA_RANGE_CHUNK_MAX 65536
+// max worker threads of the ORAM engines of an index, they count against TCSNum
+#define ENGINE_THREADS_MAX 4
+// query ECALLs running at once, the enclave threads of the host's launch_server
+#define QUERY_ECALLS_MAX 2
+// TCSNum in subtol.config.xml, see load_pipeline.cpp for what it has to host
+#define ENCLAVE_TCS_NUM 16
+
 struct subtol_config_t {
 	// general params
 	obl_oram_t base_oram;
@@ -24,6 +37,11 @@ struct subtol_config_t {
 	// only for recursive oram
 	unsigned int csize;
 	unsigned int sa_block;
+	// pages backing the circuit ORAM trees in host memory, an obl::huge_page_t
+	unsigned int huge_pages;
+	// only for adaptive oram: memory budget in MB (0 = unbounded), engine worker threads
+	unsigned int mem_budget;
+	unsigned int threads;
 };
 
 #endif // SUBTOL_CONFIG_H
@@ -2,56 +2,47 @@
 #define USER_SESSION_H
 
 #include <memory>
+#include <atomic>
+#include <cstdint>
 
 #include "subtol_config.h"
 #include "contexts/subtol_context.h"
 
-// I used unique_ptr to automatically free memory when the entry is deleted from the user_sessions
+// contexts are shared among the sessions opening the same index (see index_registry_t)
+// sessions live in the slots of session_table_t and are never moved
 struct user_session_t {
 	subtol_config_t cfg;
-	std::unique_ptr<subtol_context_t> ctx;
-	int status;
-	bool busy; // if true, a pending operation is in execution
-	
+	std::shared_ptr<subtol_context_t> ctx;
+	// published after ctx, so that a reader seeing 3 sees the context as well
+	std::atomic<int> status;
+	std::atomic<bool> busy; // if true, a configure or load is in execution
+
 	user_session_t() {
-		status = 1;
-		busy = false;		
+		status.store(1);
+		busy.store(false);
 	}
-	
+
 	~user_session_t() { }
-	
+
 	user_session_t(const user_session_t&) = delete;
 	user_session_t& operator=(const user_session_t&) = delete;
-	
-	user_session_t(user_session_t &&o)
-	{
-		cfg = o.cfg;
-		status = o.status;
-		busy = o.busy;
-		ctx = std::move(o.ctx);
-		
-		o.status = 1;
-		o.busy = false;
+
+	// exclusive use of cfg, ctx and status; queries do not need it once status is 3,
+	// since a context is never replaced while the session is pinned
+	bool try_lock() {
+		bool expected = false;
+		return busy.compare_exchange_strong(expected, true, std::memory_order_acquire);
 	}
-	
-	user_session_t& operator=(user_session_t &&o)
-	{
-		cfg = o.cfg;
-		status = o.status;
-		busy = o.busy;
-		ctx = std::move(o.ctx);
-		
-		o.status = 1;
-		o.busy = false;
-		
-		return *this;
+
+	void unlock() {
+		busy.store(false, std::memory_order_release);
 	}
-	
+
 };
 
 /*
 	user_session_t.status conventions
-	
+
 	status = 1 => clean session
 	status = 2 => cfg provided
 	status = 3 => context built
@@ -0,0 +1,121 @@
+#include "blob_reader.h"
+
+#include "sgx_wrapper_t.h"
+
+#include <cstring>
+#include <sgx_trts.h>
+
+// decryption granularity
+static const std::size_t slice_size = 1 << 20;
+// read ahead granularity
+static const std::size_t window_size = 1 << 23;
+
+blob_reader_t::blob_reader_t(void *fb, void *progress)
+{
+	this->fb = fb;
+
+	// the host reads the counters anyway, they just must not land into the enclave
+	if(progress != nullptr && sgx_is_outside_enclave(progress, sizeof(load_progress_t)))
+		this->progress = (load_progress_t*) progress;
+	else
+		this->progress = nullptr;
+
+	stopped = false;
+
+	map = nullptr;
+	size = 0;
+	pos = 0;
+	advised = 0;
+
+	std::uint8_t *base = nullptr;
+	std::size_t map_size = 0;
+
+	ocall_map_blob(fb, &base, &map_size);
+
+	// the mapping must lie entirely in untrusted memory, or the host could make us
+	// read (and leak) enclave secrets
+	if(base != nullptr && sgx_is_outside_enclave(base, map_size))
+	{
+		map = base;
+		size = map_size;
+	}
+	else
+	{
+		if(base != nullptr)
+			ocall_unmap_blob(base, map_size);
+
+		ocall_get_file_size(fb, &size);
+	}
+
+	slice = new std::uint8_t[slice_size];
+}
+
+blob_reader_t::~blob_reader_t()
+{
+	if(map != nullptr)
+		ocall_unmap_blob((std::uint8_t*) map, size);
+
+	delete[] slice;
+}
+
+void blob_reader_t::fetch(std::uint8_t *out, std::size_t len)
+{
+	if(map == nullptr)
+	{
+		ocall_get_blob(fb, out, len, pos);
+		pos += len;
+		return;
+	}
+
+	// the file may be shorter than the host claims, never read past the mapping
+	std::size_t avail = pos < size ? size - pos : 0;
+	std::size_t copy = len < avail ? len : avail;
+
+	if(pos + copy > advised && advised < size)
+	{
+		advised = pos + copy > advised + window_size ? pos + copy : advised + window_size;
+		ocall_advise_blob((std::uint8_t*) map, pos, advised - pos);
+	}
+
+	std::memcpy(out, map + pos, copy);
+	std::memset(out + copy, 0x00, len - copy);
+	pos += len;
+}
+
+void blob_reader_t::read(void *out, std::size_t len)
+{
+	fetch((std::uint8_t*) out, len);
+}
+
+bool blob_reader_t::cancelled()
+{
+	if(!stopped && progress != nullptr)
+		stopped = progress->cancel.load(std::memory_order_relaxed) != 0;
+
+	return stopped;
+}
+
+void blob_reader_t::decrypt(void *out, std::size_t len, IppsAES_GCMState *cc)
+{
+	std::uint8_t *dst = (std::uint8_t*) out;
+
+	if(cancelled())
+	{
+		std::memset(out, 0x00, len);
+		pos += len;
+		return;
+	}
+
+	count_decrypted(len);
+
+	while(len != 0)
+	{
+		std::size_t chunk = len > slice_size ? slice_size : len;
+
+		fetch(slice, chunk);
+		ippsAES_GCMDecrypt(slice, dst, chunk, cc);
+
+		dst += chunk;
+		len -= chunk;
+	}
+}
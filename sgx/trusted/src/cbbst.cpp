@@ -17,6 +17,31 @@ namespace obl { namespace ods {
 		std::uint8_t data[];
 	};
 
+	/*
+		Walker pool of all the cbbsts, so that its threads take CBBST_WALKERS TCSs however
+		many indexes are resident. It is created by the first batch needing it and lives
+		as long as the enclave; if creation fails (no TCS left) every batch runs inline.
+	*/
+	static threadpool_t *walkers = nullptr;
+	static bool walkers_failed = false;
+	static pthread_mutex_t walkers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+	static threadpool_t *walker_pool()
+	{
+		pthread_mutex_lock(&walkers_lock);
+
+		if(walkers == nullptr && !walkers_failed)
+		{
+			walkers = threadpool_create(CBBST_WALKERS, QUEUE_SIZE, 0);
+			walkers_failed = walkers == nullptr;
+		}
+
+		threadpool_t *pool = walkers;
+		pthread_mutex_unlock(&walkers_lock);
+
+		return pool;
+	}
+
 	cbbst::cbbst(std::size_t N, std::size_t B, oram_factory *allocator)
 	{
 		this->N = N;
@@ -30,7 +55,7 @@ namespace obl { namespace ods {
 
 		this->B = B;
 		node_size = sizeof(node_t) + B;
-		node_buffer = new std::uint8_t[node_size];
+		init_walks();
 
 		s_tree = new tree_oram*[L];
 
@@ -57,7 +82,7 @@ namespace obl { namespace ods {
 
 		this->B = B;
 		node_size = sizeof(node_t) + B;
-		node_buffer = new std::uint8_t[node_size];
+		init_walks();
 
 		s_tree = new tree_oram*[L];
 
@@ -75,7 +100,25 @@ namespace obl { namespace ods {
 
 		delete[] s_tree;
 		delete[] subtree_roots;
-		delete[] node_buffer;
+		delete[] lvl_turn;
+
+		pthread_mutex_destroy(&turn_lock);
+		pthread_cond_destroy(&turn_cond);
+		pthread_mutex_destroy(&submit_lock);
+	}
+
+	void cbbst::init_walks()
+	{
+		cur_walk.node_buffer = new std::uint8_t[node_size];
+
+		next_ticket = 0;
+		lvl_turn = new std::uint64_t[L];
+		for(int i = 0; i < L; i++)
+			lvl_turn[i] = 0;
+
+		pthread_mutex_init(&turn_lock, nullptr);
+		pthread_cond_init(&turn_cond, nullptr);
+		pthread_mutex_init(&submit_lock, nullptr);
 	}
 
 	std::size_t cbbst::get_N() const
@@ -115,18 +158,33 @@ namespace obl { namespace ods {
 		std::free(leafgen);
 	}
 
-	void cbbst::init_level(int l)
+	void cbbst::init_level(int l, std::size_t size, cbbst_cursor_t &c)
 	{
-		std::memcpy(evict_ctr, leaf_ctr, 16);
+		// nodes of this level are evicted along the children pointers of the previous one
+		std::memcpy(c.evict_ctr, leaf_ctr, 16);
 		obl::gen_rand_seed(leaf_ctr, 16);
-		current_lvl = l;
-		lvl_index = 0;
+		std::memcpy(c.leaf_ctr, leaf_ctr, 16);
 
-		std::memcpy(cur_evict_ctr, evict_ctr, 16);
-		std::memcpy(cur_leaf_ctr, leaf_ctr, 16);
+		c.lvl = l;
+		c.subtree = current_subtree;
+		c.lvl_index = 0;
+		c.global_idx = global_idx;
+
+		global_idx += size;
+	}
+
+	void cbbst::init_level(int l)
+	{
+		init_level(l, 0, cursor);
 	}
 
 	void cbbst::load_values_with_dummies(std::uint8_t *val, std::size_t N, std::size_t M)
+	{
+		load_values_with_dummies(cursor, val, N, M);
+		global_idx = cursor.global_idx;
+	}
+
+	void cbbst::load_values_with_dummies(cbbst_cursor_t &c, std::uint8_t *val, std::size_t N, std::size_t M)
 	{
 		assert(N >= M);
 
@@ -136,13 +194,13 @@ namespace obl { namespace ods {
 		std::uint8_t payload[node_size];
 		node_t *to_load = (node_t*) payload;
 
-		if((lvl_index & 1) == 1)
-			ev_leaves[1] = ev_leaf;
+		if((c.lvl_index & 1) == 1)
+			ev_leaves[1] = c.ev_leaf;
 
 		for(unsigned int i = 0; i < N; i++)
 		{
 			// generate children pointers
-			ippsAESEncryptCTR(dummy_ptx, (std::uint8_t*) children, 2 * sizeof(obl::leaf_id), leafgen, cur_leaf_ctr, 128);
+			ippsAESEncryptCTR(dummy_ptx, (std::uint8_t*) children, 2 * sizeof(obl::leaf_id), leafgen, c.leaf_ctr, 128);
 			to_load->left_ch = children[0];
 			to_load->right_ch = children[1];
 
@@ -150,24 +208,24 @@ namespace obl { namespace ods {
 			std::memcpy(to_load->data, val, B);
 			val += B;
 
-			int eleef = lvl_index & 1;
+			int eleef = c.lvl_index & 1;
 
 			if(eleef == 0)
-				ippsAESEncryptCTR(dummy_ptx, (std::uint8_t*) ev_leaves, 2 * sizeof(obl::leaf_id), leafgen, cur_evict_ctr, 128);
+				ippsAESEncryptCTR(dummy_ptx, (std::uint8_t*) ev_leaves, 2 * sizeof(obl::leaf_id), leafgen, c.evict_ctr, 128);
 
-			block_id wr_bid = ternary_op(i < M, global_idx, DUMMY);
-			s_tree[current_lvl]->write(wr_bid, payload, ev_leaves[eleef]);
+			block_id wr_bid = ternary_op(i < M, c.global_idx, DUMMY);
+			s_tree[c.lvl]->write(wr_bid, payload, ev_leaves[eleef]);
 				
 			// addition to extend to multi subtrees cbbst
-			if(current_lvl == 0)
-				subtree_roots[current_subtree] = ev_leaves[eleef];
+			if(c.lvl == 0)
+				subtree_roots[c.subtree] = ev_leaves[eleef];
 
-			++lvl_index;
-			++global_idx;
+			++c.lvl_index;
+			++c.global_idx;
 		}
 
-		if((lvl_index & 1) == 1)
-			ev_leaf = ev_leaves[1];
+		if((c.lvl_index & 1) == 1)
+			c.ev_leaf = ev_leaves[1];
 	}
 
 	void cbbst::load_values(std::uint8_t *val, std::size_t N)
@@ -178,24 +236,81 @@ namespace obl { namespace ods {
 	void cbbst::select_subtree(int sbt)
 	{
 		//assert(sbt < no_subtree);
-	
-		for(int i = 0; i < no_subtree; i++)
-			next_fetch = ternary_op(i == sbt, subtree_roots[i], next_fetch);
-
 		current_subtree = sbt;
 	}
 
 	void cbbst::read(obl::block_id bid, std::uint8_t *data_o, int lvl)
 	{
-		node_t *n = (node_t*) node_buffer;
+		// a ticket is taken only by actual traversals, loading selects subtrees too
+		if(lvl == 0)
+		{
+			open_walk(cur_walk, current_subtree);
 
-		s_tree[lvl]->access_r(bid, next_fetch, node_buffer);
-		std::memcpy(data_o, n->data, B);
+			pthread_mutex_lock(&submit_lock);
+			take_ticket(cur_walk);
+			pthread_mutex_unlock(&submit_lock);
+		}
+
+		read(cur_walk, bid, data_o, lvl);
 	}
 
 	void cbbst::update(obl::block_id bid, std::uint8_t *data_i, bool go_left, int lvl)
 	{
-		node_t *n = (node_t*) node_buffer;
+		update(cur_walk, bid, data_i, go_left, lvl);
+	}
+
+	void cbbst::open_walk(cbbst_walk_t &w, int sbt)
+	{
+		if(w.node_buffer == nullptr)
+			w.node_buffer = new std::uint8_t[node_size];
+
+		w.subtree = sbt;
+		obl::gen_rand((std::uint8_t*) &w.next_evict, sizeof(leaf_id));
+	}
+
+	void cbbst::take_ticket(cbbst_walk_t &w)
+	{
+		pthread_mutex_lock(&turn_lock);
+		w.ticket = next_ticket++;
+		pthread_mutex_unlock(&turn_lock);
+	}
+
+	void cbbst::wait_turn(cbbst_walk_t &w, int lvl)
+	{
+		pthread_mutex_lock(&turn_lock);
+
+		while(lvl_turn[lvl] != w.ticket)
+			pthread_cond_wait(&turn_cond, &turn_lock);
+
+		pthread_mutex_unlock(&turn_lock);
+	}
+
+	void cbbst::pass_turn(cbbst_walk_t &w, int lvl)
+	{
+		pthread_mutex_lock(&turn_lock);
+		++lvl_turn[lvl];
+		pthread_cond_broadcast(&turn_cond);
+		pthread_mutex_unlock(&turn_lock);
+	}
+
+	void cbbst::read(cbbst_walk_t &w, obl::block_id bid, std::uint8_t *data_o, int lvl)
+	{
+		node_t *n = (node_t*) w.node_buffer;
+
+		wait_turn(w, lvl);
+
+		// the root has been moved by the previous traversal, fetch it only now
+		if(lvl == 0)
+			for(int i = 0; i < no_subtree; i++)
+				w.next_fetch = ternary_op(i == w.subtree, subtree_roots[i], w.next_fetch);
+
+		s_tree[lvl]->access_r(bid, w.next_fetch, w.node_buffer);
+		std::memcpy(data_o, n->data, B);
+	}
+
+	void cbbst::update(cbbst_walk_t &w, obl::block_id bid, std::uint8_t *data_i, bool go_left, int lvl)
+	{
+		node_t *n = (node_t*) w.node_buffer;
 		leaf_id next_next_evict;
 		leaf_id next_next_fetch;
 
@@ -207,14 +322,104 @@ namespace obl { namespace ods {
 		n->left_ch = ternary_op(go_left, next_next_evict, n->left_ch);
 		n->right_ch = ternary_op(go_left, n->right_ch, next_next_evict);
 
-		s_tree[lvl]->access_w(bid, next_fetch, node_buffer, next_evict);
+		s_tree[lvl]->access_w(bid, w.next_fetch, w.node_buffer, w.next_evict);
 
 		if(lvl == 0)
 			for(int i = 0; i < no_subtree; i++)
-				subtree_roots[i] = ternary_op(i == current_subtree, next_evict, subtree_roots[i]);
+				subtree_roots[i] = ternary_op(i == w.subtree, w.next_evict, subtree_roots[i]);
+
+		w.next_evict = next_next_evict;
+		w.next_fetch = next_next_fetch;
+
+		pass_turn(w, lvl);
+	}
+
+	struct walk_task_t {
+		void (*fn)(void*);
+		void *arg;
+
+		int *pending;
+		pthread_mutex_t *lock;
+		pthread_cond_t *cond;
+	};
+
+	static void walk_task(void *arg)
+	{
+		walk_task_t *t = (walk_task_t*) arg;
+
+		t->fn(t->arg);
+
+		pthread_mutex_lock(t->lock);
+		--(*t->pending);
+		pthread_cond_signal(t->cond);
+		pthread_mutex_unlock(t->lock);
+	}
+
+	void cbbst::run_walks(cbbst_walk_fn *fn, void **args, cbbst_walk_t **walks, int n)
+	{
+		if(n <= 0)
+			return;
+
+		threadpool_t *pool = n > 1 ? walker_pool() : nullptr;
+
+		pthread_mutex_lock(&submit_lock);
+
+		walk_task_t *tasks = new walk_task_t[n];
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+		int pending = 0;
+		int inline_from = n;
+
+		pthread_mutex_init(&lock, nullptr);
+		pthread_cond_init(&cond, nullptr);
+
+		/*
+			The pool is FIFO and traversals are submitted in ticket order, so whatever a
+			worker waits for is already running: no deadlock with any number of workers.
+			The caller takes the first traversal, plus the tail that did not fit the queue.
+			Tickets of the tail are taken anyway, the caller serves them in order.
+		*/
+		for(int i = 0; i < n; i++)
+			take_ticket(*walks[i]);
+
+		for(int i = 1; i < n; i++)
+		{
+			tasks[i].fn = fn[i];
+			tasks[i].arg = args[i];
+			tasks[i].pending = &pending;
+			tasks[i].lock = &lock;
+			tasks[i].cond = &cond;
+
+			pthread_mutex_lock(&lock);
+			++pending;
+			pthread_mutex_unlock(&lock);
+
+			if(pool == nullptr || threadpool_add(pool, walk_task, &tasks[i], 0) != 0)
+			{
+				pthread_mutex_lock(&lock);
+				--pending;
+				pthread_mutex_unlock(&lock);
+
+				inline_from = i;
+				break;
+			}
+		}
+
+		pthread_mutex_unlock(&submit_lock);
+
+		fn[0](args[0]);
+
+		for(int i = inline_from; i < n; i++)
+			fn[i](args[i]);
+
+		pthread_mutex_lock(&lock);
+		while(pending != 0)
+			pthread_cond_wait(&cond, &lock);
+		pthread_mutex_unlock(&lock);
 
-		next_evict = next_next_evict;
-		next_fetch = next_next_fetch;
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&cond);
+		delete[] tasks;
 	}
 
 } }
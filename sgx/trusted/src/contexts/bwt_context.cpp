@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 #include "sgx_wrapper_t.h"
 
 #include "substring/vbwt.hpp"
@@ -12,13 +13,13 @@ void bwt_context_t::init()
 {
 	load_meta();
 	load_c();
-	load_index(8);
+	load_index(1024);
 }
 
 void bwt_context_t::load_meta()
 {
 	std::uint64_t meta[3];
-	ocall_get_blob(fb, (std::uint8_t*) meta, 3 * sizeof(std::uint64_t), -1);
+	fb->read(meta, 3 * sizeof(std::uint64_t));
 	ippsAES_GCMProcessAAD((std::uint8_t*) meta, 3 * sizeof(std::uint64_t), cc);
 
 	sample_rate = meta[0];
@@ -29,54 +30,59 @@ void bwt_context_t::load_meta()
 void bwt_context_t::load_c()
 {
 	C = new std::uint32_t[alpha+1];
-	std::uint32_t *C_enc = new std::uint32_t[alpha+1];
 
-	ocall_get_blob(fb, (std::uint8_t*) C_enc, sizeof(std::int32_t) * (alpha + 1), -1);
-	ippsAES_GCMDecrypt((std::uint8_t*) C_enc, (std::uint8_t*) C, sizeof(std::int32_t) * (alpha + 1), cc);
+	fb->decrypt(C, sizeof(std::int32_t) * (alpha + 1), cc);
+}
+
+void bwt_context_t::insert_samples(void *ctx, const load_job_t &job, std::uint8_t *plain)
+{
+	bwt_context_t *bc = (bwt_context_t*) ctx;
+	std::vector<std::uint8_t> placeholder(bc->sample_size);
 
-	delete[] C_enc;
+	for(std::size_t i = 0; i < job.count; i++)
+		bc->index->access(job.first + i, plain + i * bc->sample_size, placeholder.data());
 }
 
 void bwt_context_t::load_index(std::size_t buffer_size)
 {
-	std::uint8_t *enc_buff = new std::uint8_t[buffer_size * sample_size];
-	std::uint8_t *dec_buff = new std::uint8_t[buffer_size * sample_size];
-
 	std::size_t no_samples = (N + 1) / sample_rate + ((N + 1) % sample_rate == 0 ? 0 : 1);
+	std::vector<load_job_t> jobs;
+	int lanes = 1;
 
 	obl::block_id idx = 0;
 	
 	if (allocator->is_taostore())
+	{
 		index = new obl::recursive_parallel(no_samples, sample_size, csize, allocator);
+		// taostore serves concurrent clients
+		lanes = LOAD_MAX_LANES;
+	}
 	else
 		index = new obl::recursive_oram_standard(no_samples, sample_size, csize, allocator);
 	
 	while(no_samples != 0)
 	{
 		std::size_t fetch_size = no_samples > buffer_size ? buffer_size : no_samples;
-		std::size_t fetch_size_bytes = fetch_size * sample_size;
-
-		ocall_get_blob(fb, enc_buff, fetch_size_bytes, -1);
-		ippsAES_GCMDecrypt(enc_buff, dec_buff, fetch_size_bytes, cc);
-
-		std::uint8_t *current_sample = dec_buff;
 
-		for(unsigned int i = 0; i < fetch_size; i++)
-		{
-			// enc_buf is a real placeholder
-			index->access(idx, current_sample, enc_buff);
-			current_sample += sample_size;
-			++idx;
-		}
+		load_job_t job;
+		job.bytes = fetch_size * sample_size;
+		job.lane = jobs.size() % lanes;
+		job.target = nullptr;
+		job.first = idx;
+		job.count = job.valid = fetch_size;
+		jobs.push_back(job);
 
+		idx += fetch_size;
 		no_samples -= fetch_size;
 	}
 
-	delete[] enc_buff;
-	delete[] dec_buff;
+	run_load_pipeline(fb, cc, jobs, lanes, insert_samples, this);
 }
 
 void bwt_context_t::query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end)
 {
+	// samples are fetched on the stack of the query, only the index has to be guarded
+	lock_rec(&index_lock);
 	vbwt_query<std::uint32_t, unsigned char>(index, C, sample_rate, sample_size, no_bits, alpha, q, len, &start, &end);
+	unlock_rec(&index_lock);
 }
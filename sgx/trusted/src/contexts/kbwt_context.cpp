@@ -0,0 +1,52 @@
+#include "contexts/kbwt_context.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "substring/kbwt.hpp"
+
+void kbwt_context_t::init()
+{
+	load_meta();
+	load_c();
+	load_index(1024);
+}
+
+void kbwt_context_t::load_meta()
+{
+	std::uint64_t meta[4];
+	fb->read(meta, 4 * sizeof(std::uint64_t));
+	ippsAES_GCMProcessAAD((std::uint8_t*) meta, 4 * sizeof(std::uint64_t), cc);
+
+	sample_rate = meta[0];
+	no_bits = meta[1];
+	sample_size = meta[2];
+	k = meta[3];
+
+	// one entry per m-mer, 1 <= m <= k
+	table_size = 0;
+	std::size_t pw = 1;
+
+	for(std::uint64_t m = 0; m < k; m++)
+	{
+		pw *= alpha;
+		table_size += pw;
+	}
+
+	// a row code must fit a word, see prep
+	assert(k >= 1 && k * no_bits <= 32);
+}
+
+void kbwt_context_t::load_c()
+{
+	C = new std::uint32_t[table_size];
+
+	fb->decrypt(C, sizeof(std::int32_t) * table_size, cc);
+}
+
+void kbwt_context_t::query(unsigned char *q, std::size_t len, std::uint32_t &start, std::uint32_t &end)
+{
+	lock_rec(&index_lock);
+	kbwt_query<std::uint32_t, unsigned char>(index, C, N, sample_rate, sample_size, no_bits, k, alpha, q, len, &start, &end);
+	unlock_rec(&index_lock);
+}
@@ -5,6 +5,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <vector>
 #include "sgx_wrapper_t.h"
 
 #include "substring/nbwt.hpp"
@@ -18,12 +19,8 @@ void n_bwt_context_t::init()
 void n_bwt_context_t::load_c()
 {
 	C = new std::uint32_t[alpha];
-	std::uint32_t *C_enc = new std::uint32_t[alpha];
 
-	ocall_get_blob(fb, (std::uint8_t*) C_enc, sizeof(std::int32_t) * alpha, -1);
-	ippsAES_GCMDecrypt((std::uint8_t*) C_enc, (std::uint8_t*) C, sizeof(std::int32_t) * alpha, cc);
-
-	delete[] C_enc;
+	fb->decrypt(C, sizeof(std::int32_t) * alpha, cc);
 }
 
 void n_bwt_context_t::load_index(std::size_t buffer_size)
@@ -62,11 +59,11 @@ void n_bwt_context_t::load_index(std::size_t buffer_size)
 
 void n_bwt_context_t::fill_levels(std::size_t buffer_size)
 {
-	std::uint32_t *enc_buff, *dec_buff;
-
-	// init encryption
-	enc_buff = new std::uint32_t[buffer_size];
-	dec_buff = new std::uint32_t[buffer_size];
+	std::vector<load_job_t> jobs;
+	// one cursor per level of every subtree
+	std::vector<obl::ods::cbbst_cursor_t> cursors(alpha * L);
+	// levels are separate ORAMs shared by all subtrees
+	int lanes = L < LOAD_MAX_LANES ? L : LOAD_MAX_LANES;
 
 	for(unsigned int a = 0; a < alpha; a++)
 	{
@@ -80,23 +77,26 @@ void n_bwt_context_t::fill_levels(std::size_t buffer_size)
 			rem -= lvl_amount;
 			lvl_size <<= 1;
 
-			index->init_level(l);
+			obl::ods::cbbst_cursor_t *cur = &cursors[a * L + l];
+			index->init_level(l, lvl_amount, *cur);
 
 			while(lvl_amount != 0)
 			{
 				std::size_t current_load = lvl_amount > buffer_size ? buffer_size : lvl_amount;
 				lvl_amount -= current_load;
 
-				ocall_get_blob(fb, (std::uint8_t*) enc_buff, current_load * sizeof(std::int32_t), -1);
-				ippsAES_GCMDecrypt((std::uint8_t*) enc_buff, (std::uint8_t*) dec_buff, current_load * sizeof(std::int32_t), cc);
-
-				index->load_values((std::uint8_t*) dec_buff, current_load);
+				load_job_t job;
+				job.bytes = current_load * sizeof(std::int32_t);
+				job.lane = l % lanes;
+				job.target = cur;
+				job.first = 0;
+				job.count = job.valid = current_load;
+				jobs.push_back(job);
 			}
 		}
 	}
 
-	delete[] enc_buff;
-	delete[] dec_buff;
+	run_load_pipeline(fb, cc, jobs, lanes, insert_cbbst, index);
 }
 
 void n_bwt_context_t::fill_level_size(std::size_t *lvl)
@@ -119,3 +119,9 @@ void n_bwt_context_t::query(unsigned char *q, std::size_t len, std::uint32_t &st
 {
 	nbwt_query<std::uint32_t, unsigned char>(index, C, alpha, q, len, &start, &end);
 }
+
+void n_bwt_context_t::query_batch(unsigned char **q, std::uint32_t *len, int n, std::uint32_t *start, std::uint32_t *end)
+{
+	// the walks of all the queries share the cbbst levels
+	nbwt_query_batch<std::uint32_t, unsigned char>(index, C, alpha, q, len, start, end, n);
+}
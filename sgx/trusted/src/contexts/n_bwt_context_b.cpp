@@ -2,6 +2,7 @@
 
 #include "sgx_wrapper_t.h"
 #include <cstdint>
+#include <vector>
 
 void n_bwt_context_b_t::fill_level_size(std::size_t *lvl)
 {
@@ -30,11 +31,11 @@ void n_bwt_context_b_t::fill_level_size(std::size_t *lvl)
 
 void n_bwt_context_b_t::fill_levels(std::size_t buffer_size)
 {
-	std::uint32_t *enc_buff, *dec_buff;
-
-	// init encryption
-	enc_buff = new std::uint32_t[buffer_size];
-	dec_buff = new std::uint32_t[buffer_size];
+	std::vector<load_job_t> jobs;
+	// one cursor per level of every subtree
+	std::vector<obl::ods::cbbst_cursor_t> cursors(alpha * L);
+	// levels are separate ORAMs shared by all subtrees
+	int lanes = L < LOAD_MAX_LANES ? L : LOAD_MAX_LANES;
 		
 	for(unsigned int a = 0; a < alpha; a++)
 	{
@@ -51,8 +52,8 @@ void n_bwt_context_b_t::fill_levels(std::size_t buffer_size)
 			Crem -= valid_amount;
 			lvl_size <<= 1;
 			
-			index->init_level(l);
-			
+			obl::ods::cbbst_cursor_t *cur = &cursors[a * L + l];
+			index->init_level(l, lvl_amount, *cur);
 
 			while(lvl_amount != 0)
 			{
@@ -61,14 +62,17 @@ void n_bwt_context_b_t::fill_levels(std::size_t buffer_size)
 				lvl_amount -= current_load;
 				valid_amount -= current_valid;
 
-				ocall_get_blob(fb, (std::uint8_t*) enc_buff, current_load * sizeof(std::int32_t), -1);
-				ippsAES_GCMDecrypt((std::uint8_t*) enc_buff, (std::uint8_t*) dec_buff, current_load * sizeof(std::int32_t), cc);
-							
-				index->load_values_with_dummies((std::uint8_t*) dec_buff, current_load, current_valid);
+				load_job_t job;
+				job.bytes = current_load * sizeof(std::int32_t);
+				job.lane = l % lanes;
+				job.target = cur;
+				job.first = 0;
+				job.count = current_load;
+				job.valid = current_valid;
+				jobs.push_back(job);
 			}
 		}
 	}
 
-	delete[] enc_buff;
-	delete[] dec_buff;
+	run_load_pipeline(fb, cc, jobs, lanes, insert_cbbst, index);
 }
@@ -1,45 +1,73 @@
 #include "contexts/subtol_context.h"
 #include "sgx_wrapper_t.h"
+#include "cbbst.h"
+#include "obl/primitives.h"
 #include <string>
+#include <vector>
 
 static const int buffer_size = 512;
 
+void subtol_context_t::insert_cbbst(void *ctx, const load_job_t &job, std::uint8_t *plain)
+{
+	obl::ods::cbbst *index = (obl::ods::cbbst*) ctx;
+	index->load_values_with_dummies(*(obl::ods::cbbst_cursor_t*) job.target, plain, job.count, job.valid);
+}
+
+void subtol_context_t::insert_sa(void *ctx, const load_job_t &job, std::uint8_t *plain)
+{
+	subtol_context_t *sc = (subtol_context_t*) ctx;
+	std::size_t block_bytes = sc->sa_bundle_size * sizeof(std::int32_t);
+	std::vector<std::uint8_t> placeholder(block_bytes);
+
+	// last, incomplete block
+	if(job.bytes < block_bytes)
+	{
+		std::vector<std::uint8_t> last(block_bytes, 0x00);
+		std::memcpy(last.data(), plain, job.bytes);
+		sc->suffix_array->access(job.first, last.data(), placeholder.data());
+		return;
+	}
+
+	for(std::size_t i = 0; i < job.count; i++)
+		sc->suffix_array->access(job.first + i, plain + i * block_bytes, placeholder.data());
+}
+
 void subtol_context_t::load_sa(unsigned int csize, unsigned int sa_block)
 {
-	std::int32_t idx;
 	std::size_t rec_oram_block_size = sa_block * sizeof(std::int32_t);
 	std::size_t rec_oram_blocks = (N + 1) / sa_block + ((N + 1) % sa_block ? 1 : 0);
-
-	std::int32_t *enc_buff = new std::int32_t[sa_block * buffer_size];
-	std::int32_t *dec_buff = new std::int32_t[sa_block];
-	
+	std::vector<load_job_t> jobs;
+	int lanes = 1;
 
 	if (allocator->is_taostore())
+	{
 		suffix_array = new obl::recursive_taoram(rec_oram_blocks, rec_oram_block_size, csize, allocator);
+		// taostore serves concurrent clients
+		lanes = LOAD_MAX_LANES;
+	}
 	else
 		suffix_array = new obl::recursive_oram_standard(rec_oram_blocks, rec_oram_block_size, csize, allocator);
 		
 	sa_bundle_size = sa_block;
 	sa_total_blocks = rec_oram_blocks;
-	current_start_index = 0;
 
 	// all but last and possibly incomplete block
 	--rec_oram_blocks;
-	idx = 0;
+	std::size_t idx = 0;
 		
 	while(rec_oram_blocks != 0)
 	{
 		std::size_t curr_blocks = rec_oram_blocks > buffer_size ? buffer_size : rec_oram_blocks;
 
-		ocall_get_blob(fb, (std::uint8_t*) enc_buff, curr_blocks * rec_oram_block_size, -1);
-
-		for(unsigned int i = 0; i < curr_blocks; i++)
-		{
-			ippsAES_GCMDecrypt((std::uint8_t*) &enc_buff[i * sa_block], (std::uint8_t*) dec_buff, rec_oram_block_size, cc);
-			suffix_array->access(idx, (std::uint8_t*) dec_buff, (std::uint8_t*) enc_buff); // enc_buff is a placeholder!
-			++idx;
-		}
+		load_job_t job;
+		job.bytes = curr_blocks * rec_oram_block_size;
+		job.lane = jobs.size() % lanes;
+		job.target = nullptr;
+		job.first = idx;
+		job.count = job.valid = curr_blocks;
+		jobs.push_back(job);
 
+		idx += curr_blocks;
 		rec_oram_blocks -= curr_blocks;
 	}
 
@@ -49,20 +77,104 @@ void subtol_context_t::load_sa(unsigned int csize, unsigned int sa_block)
 	if(rem == 0)
 		rem = sa_block;
 
-	ocall_get_blob(fb, (std::uint8_t*) enc_buff, rem * sizeof(std::int32_t), -1);
-	ippsAES_GCMDecrypt((std::uint8_t*) enc_buff, (std::uint8_t*) dec_buff, rem * sizeof(std::int32_t), cc);
-	suffix_array->access(idx, (std::uint8_t*) dec_buff, (std::uint8_t*) enc_buff); // enc_buff is a placeholder!
+	load_job_t job;
+	job.bytes = rem * sizeof(std::int32_t);
+	job.lane = jobs.size() % lanes;
+	job.target = nullptr;
+	job.first = idx;
+	job.count = job.valid = 1;
+	jobs.push_back(job);
+
+	run_load_pipeline(fb, cc, jobs, lanes, insert_sa, this);
+}
 
-	delete[] enc_buff;
-	delete[] dec_buff;
+void subtol_context_t::query_batch(unsigned char **q, std::uint32_t *len, int n, std::uint32_t *start, std::uint32_t *end)
+{
+	for(int i = 0; i < n; i++)
+		query(q[i], len[i], start[i], end[i]);
 }
 
-void subtol_context_t::fetch_sa(std::int32_t *sa_chunk)
+void subtol_context_t::fetch_sa(std::int32_t *sa_chunk, std::uint32_t &cursor)
 {
 	if(suffix_array != nullptr)
 	{
-		obl::block_id sa_bid = (current_start_index / sa_bundle_size) % sa_total_blocks;
-		current_start_index += sa_bundle_size;
+		obl::block_id sa_bid = (cursor / sa_bundle_size) % sa_total_blocks;
+		cursor += sa_bundle_size;
+
+		lock_rec(&sa_lock);
 		suffix_array->access(sa_bid, nullptr, (std::uint8_t*) sa_chunk);
+		unlock_rec(&sa_lock);
+	}
+}
+
+std::uint32_t subtol_context_t::fetch_sa(std::int32_t *sa_chunk, std::uint32_t cursor, unsigned int blocks)
+{
+	// bids of a batch must be distinct: the whole suffix array, one bundle at a time
+	if(blocks > sa_total_blocks)
+	{
+		std::uint32_t first = 0;
+
+		for(unsigned int i = 0; i < blocks; i++)
+			fetch_sa(&sa_chunk[i * sa_bundle_size], first);
+
+		return 0;
+	}
+	else if(suffix_array != nullptr && blocks > 0)
+	{
+		// the window never wraps around, so its span (and the number of accesses) is blocks
+		obl::block_id first = obl::batch_window(cursor / sa_bundle_size, blocks, sa_total_blocks);
+		// blocks is client controlled, keep the bid and output arrays off the enclave stack
+		std::vector<obl::block_id> sa_bids(blocks);
+		std::vector<std::uint8_t*> out(blocks);
+
+		for(unsigned int i = 0; i < blocks; i++)
+		{
+			sa_bids[i] = first + i;
+			out[i] = (std::uint8_t*) &sa_chunk[i * sa_bundle_size];
+		}
+
+		lock_rec(&sa_lock);
+		suffix_array->access_batch(sa_bids.data(), blocks, nullptr, out.data(), blocks);
+		unlock_rec(&sa_lock);
+
+		return first * sa_bundle_size;
+	}
+
+	return 0;
+}
+
+void subtol_context_t::fetch_sa_range(std::int32_t *out, std::uint32_t first, std::uint32_t last, std::size_t len)
+{
+	if(suffix_array == nullptr || len == 0)
+		return;
+
+	// enough bundles for len entries starting anywhere in the first one
+	unsigned int blocks = (len + 2 * sa_bundle_size - 2) / sa_bundle_size;
+	std::size_t fetched = blocks * sa_bundle_size;
+	std::vector<std::int32_t> buff(fetched);
+
+	std::uint32_t base = fetch_sa(buff.data(), first, blocks);
+
+	/*
+		Move entry first to the head of the buffer: the offset is secret, so the shift
+		goes through log(fetched) conditional passes over the whole buffer instead of
+		indexing with it. The window may have been moved back from the end of the suffix
+		array, then entries past it are beyond N and masked below.
+	*/
+	std::uint32_t offset = first - base;
+
+	for(std::uint32_t sh = 1; sh < fetched; sh <<= 1)
+	{
+		bool take = (offset & sh) != 0;
+
+		for(std::size_t i = 0; i + sh < fetched; i++)
+			buff[i] = obl::ternary_op(take, buff[i + sh], buff[i]);
+	}
+
+	for(std::size_t i = 0; i < len; i++)
+	{
+		std::uint64_t idx = (std::uint64_t) first + i;
+		bool valid = (idx <= last) & (idx <= N);
+		out[i] = obl::ternary_op(valid, buff[i], (std::int32_t) -1);
 	}
 }
@@ -0,0 +1,124 @@
+#include "index_registry.h"
+#include "standalone_interface.h"
+
+#include <cstring>
+
+index_registry_t::index_registry_t()
+{
+	pthread_mutex_init(&lock, nullptr);
+	pthread_cond_init(&done_loading, nullptr);
+	clock = 0;
+}
+
+index_registry_t::~index_registry_t()
+{
+	pthread_mutex_destroy(&lock);
+	pthread_cond_destroy(&done_loading);
+}
+
+void index_registry_t::evict(std::size_t keep, std::list<std::shared_ptr<subtol_context_t>> &dead)
+{
+	// only the registry can hand out new references, and it holds the lock
+	std::size_t idle = 0;
+
+	for(auto &e: entries)
+		idle += !e->loading && e->ctx.use_count() == 1;
+
+	while(idle > keep)
+	{
+		auto oldest = entries.end();
+
+		for(auto it = entries.begin(); it != entries.end(); ++it)
+			if(!(*it)->loading && (*it)->ctx.use_count() == 1 && (oldest == entries.end() || (*it)->last_use < (*oldest)->last_use))
+				oldest = it;
+
+		dead.push_back(std::move((*oldest)->ctx));
+		entries.erase(oldest);
+		--idle;
+	}
+}
+
+std::shared_ptr<subtol_context_t> index_registry_t::open(void *fb, void *progress, char *pwd, subtol_config_t &cfg)
+{
+	// fb is a void* pointer, that is meant to point to a FILE*
+	// since enclaves don't allow direct use of syscalls, some I/O structs are left unimplemented in the sgx_tlibc
+	// we don't need to check where that pointer belongs since it will just be handled to untrusted code to perform
+	// file operations; the reader checks instead the mapping it gets back from the host
+	blob_reader_t reader(fb, progress);
+	index_file_t file;
+	std::list<std::shared_ptr<subtol_context_t>> dead;
+	std::shared_ptr<index_entry_t> entry;
+	std::shared_ptr<subtol_context_t> ctx;
+
+	open_index_file(reader, pwd, cfg, file);
+
+	pthread_mutex_lock(&lock);
+
+	while(true)
+	{
+		entry = nullptr;
+
+		for(auto &e: entries)
+			if(std::memcmp(e->id, file.id, 32) == 0)
+				entry = e;
+
+		if(entry == nullptr)
+			break;
+
+		// someone else is loading the same index
+		while(entry->loading)
+			pthread_cond_wait(&done_loading, &lock);
+
+		// the entry is gone by now, load it ourselves
+		if(entry->cancelled)
+			continue;
+
+		ctx = entry->ctx;
+		entry->last_use = ++clock;
+		pthread_mutex_unlock(&lock);
+
+		return ctx;
+	}
+
+	entry = std::make_shared<index_entry_t>();
+	std::memcpy(entry->id, file.id, 32);
+	entry->loading = true;
+	entry->cancelled = false;
+	entry->last_use = ++clock;
+	entries.push_back(entry);
+
+	// make room, so that the new index fits the budget once idle
+	evict(INDEX_IDLE_MAX > 0 ? INDEX_IDLE_MAX - 1 : 0, dead);
+
+	pthread_mutex_unlock(&lock);
+
+	dead.clear();
+	ctx = std::shared_ptr<subtol_context_t>(init_subtol_context(reader, file, cfg));
+
+	pthread_mutex_lock(&lock);
+
+	entry->ctx = ctx;
+	entry->loading = false;
+	entry->cancelled = ctx == nullptr && reader.cancelled();
+
+	// waiters got their nullptr through entry, later sessions try again
+	if(ctx == nullptr)
+		entries.remove(entry);
+
+	pthread_cond_broadcast(&done_loading);
+	pthread_mutex_unlock(&lock);
+
+	return ctx;
+}
+
+void index_registry_t::trim()
+{
+	std::list<std::shared_ptr<subtol_context_t>> dead;
+
+	pthread_mutex_lock(&lock);
+	evict(INDEX_IDLE_MAX, dead);
+	pthread_mutex_unlock(&lock);
+
+	// tearing down the ORAMs may take a while, do it out of the lock
+	dead.clear();
+}
@@ -0,0 +1,258 @@
+#include "load_pipeline.h"
+#include "cbbst.h"
+#include "subtol_config.h"
+
+#include <pthread.h>
+#include <cassert>
+
+/*
+	Enclave threads at full load: the loader ECALL with its reader and lanes, the query
+	ECALLs, the shared cbbst walkers and the workers of the ORAM engines. A thread that
+	gets no TCS anyway is handled below, its stage runs inline.
+*/
+static_assert(2 + LOAD_MAX_LANES + QUERY_ECALLS_MAX + CBBST_WALKERS + ENGINE_THREADS_MAX <= ENCLAVE_TCS_NUM,
+	"TCSNum in subtol.config.xml cannot host every enclave thread");
+
+// slot of a queue: job index and chunk buffer, a job index past the end stops the consumer
+struct load_slot_t {
+	std::size_t job;
+	std::uint8_t *buff;
+	bool skip; // load cancelled, nothing was read
+};
+
+class slot_queue_t {
+private:
+	std::vector<load_slot_t> ring;
+	std::size_t head, count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty, not_full;
+
+public:
+	slot_queue_t(std::size_t capacity): ring(capacity) {
+		head = count = 0;
+		pthread_mutex_init(&lock, nullptr);
+		pthread_cond_init(&not_empty, nullptr);
+		pthread_cond_init(&not_full, nullptr);
+	}
+
+	~slot_queue_t() {
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&not_empty);
+		pthread_cond_destroy(&not_full);
+	}
+
+	void push(const load_slot_t &s) {
+		pthread_mutex_lock(&lock);
+
+		while(count == ring.size())
+			pthread_cond_wait(&not_full, &lock);
+
+		ring[(head + count) % ring.size()] = s;
+		++count;
+
+		pthread_cond_signal(&not_empty);
+		pthread_mutex_unlock(&lock);
+	}
+
+	load_slot_t pop() {
+		pthread_mutex_lock(&lock);
+
+		while(count == 0)
+			pthread_cond_wait(&not_empty, &lock);
+
+		load_slot_t s = ring[head];
+		head = (head + 1) % ring.size();
+		--count;
+
+		pthread_cond_signal(&not_full);
+		pthread_mutex_unlock(&lock);
+
+		return s;
+	}
+};
+
+struct load_pipeline_t {
+	blob_reader_t *fb;
+	const std::vector<load_job_t> *jobs;
+	load_insert_fn insert;
+	void *ctx;
+
+	slot_queue_t *cipher_free, *cipher_full;
+	slot_queue_t *plain_free;
+	std::vector<slot_queue_t*> lane_q;
+};
+
+struct load_lane_arg_t {
+	load_pipeline_t *p;
+	int lane;
+};
+
+static void read_job(load_pipeline_t *p, std::size_t j)
+{
+	load_slot_t s = p->cipher_free->pop();
+
+	// the slots keep flowing after a cancel, so that every stage ends as usual
+	s.skip = p->fb->cancelled();
+	if(s.skip)
+		p->fb->seek(p->fb->tell() + (*p->jobs)[j].bytes);
+	else
+		p->fb->read(s.buff, (*p->jobs)[j].bytes);
+	s.job = j;
+
+	p->cipher_full->push(s);
+}
+
+static void insert_job(load_pipeline_t *p, const load_slot_t &s)
+{
+	p->insert(p->ctx, (*p->jobs)[s.job], s.buff);
+	p->fb->count_inserted((*p->jobs)[s.job].count);
+	p->plain_free->push(s);
+}
+
+static void *reader_stage(void *arg)
+{
+	load_pipeline_t *p = (load_pipeline_t*) arg;
+
+	for(std::size_t j = 0; j < p->jobs->size(); j++)
+		read_job(p, j);
+
+	return nullptr;
+}
+
+static void *insert_stage(void *arg)
+{
+	load_lane_arg_t *a = (load_lane_arg_t*) arg;
+	load_pipeline_t *p = a->p;
+
+	while(true)
+	{
+		load_slot_t s = p->lane_q[a->lane]->pop();
+
+		if(s.job >= p->jobs->size())
+			break;
+
+		insert_job(p, s);
+	}
+
+	return nullptr;
+}
+
+void run_load_pipeline(blob_reader_t *fb, IppsAES_GCMState *cc, const std::vector<load_job_t> &jobs, int lanes, load_insert_fn insert, void *ctx)
+{
+	assert(lanes > 0 && lanes <= LOAD_MAX_LANES);
+
+	std::size_t max_bytes = 0;
+	for(std::size_t j = 0; j < jobs.size(); j++)
+		max_bytes = jobs[j].bytes > max_bytes ? jobs[j].bytes : max_bytes;
+
+	std::size_t no_cipher = 2;
+	std::size_t no_plain = 2 * lanes;
+
+	load_pipeline_t p;
+	p.fb = fb;
+	p.jobs = &jobs;
+	p.insert = insert;
+	p.ctx = ctx;
+
+	p.cipher_free = new slot_queue_t(no_cipher);
+	p.cipher_full = new slot_queue_t(no_cipher);
+	p.plain_free = new slot_queue_t(no_plain);
+
+	// a lane queue must be able to hold every plaintext buffer plus its stop slot
+	for(int l = 0; l < lanes; l++)
+		p.lane_q.push_back(new slot_queue_t(no_plain + 1));
+
+	std::vector<std::uint8_t*> buffers;
+
+	for(std::size_t i = 0; i < no_cipher + no_plain; i++)
+	{
+		load_slot_t s;
+		s.job = 0;
+		s.skip = false;
+		s.buff = new std::uint8_t[max_bytes];
+		buffers.push_back(s.buff);
+
+		if(i < no_cipher)
+			p.cipher_free->push(s);
+		else
+			p.plain_free->push(s);
+	}
+
+	pthread_t reader;
+	std::vector<pthread_t> inserters(lanes);
+	std::vector<load_lane_arg_t> lane_args(lanes);
+
+	/*
+		A stage whose thread cannot be created (typically no TCS left) runs inline on the
+		calling thread: the reader right before decrypting each job, an inserter right
+		after. Slower, but the jobs of a lane still go in order through a single thread.
+	*/
+	bool has_reader = pthread_create(&reader, nullptr, reader_stage, &p) == 0;
+	std::vector<bool> has_inserter(lanes);
+
+	for(int l = 0; l < lanes; l++)
+	{
+		lane_args[l].p = &p;
+		lane_args[l].lane = l;
+		has_inserter[l] = pthread_create(&inserters[l], nullptr, insert_stage, &lane_args[l]) == 0;
+	}
+
+	// decryption stage
+	for(std::size_t j = 0; j < jobs.size(); j++)
+	{
+		if(!has_reader)
+			read_job(&p, j);
+
+		load_slot_t c = p.cipher_full->pop();
+
+		assert(c.job == j);
+
+		// the tag will not match, no point in decrypting and inserting the rest
+		if(c.skip)
+		{
+			p.cipher_free->push(c);
+			continue;
+		}
+
+		load_slot_t d = p.plain_free->pop();
+
+		ippsAES_GCMDecrypt(c.buff, d.buff, jobs[j].bytes, cc);
+		fb->count_decrypted(jobs[j].bytes);
+		p.cipher_free->push(c);
+
+		d.job = j;
+		if(has_inserter[jobs[j].lane])
+			p.lane_q[jobs[j].lane]->push(d);
+		else
+			insert_job(&p, d);
+	}
+
+	for(int l = 0; l < lanes; l++)
+	{
+		if(!has_inserter[l])
+			continue;
+
+		load_slot_t stop;
+		stop.job = jobs.size();
+		stop.buff = nullptr;
+		stop.skip = false;
+		p.lane_q[l]->push(stop);
+	}
+
+	if(has_reader)
+		pthread_join(reader, nullptr);
+	for(int l = 0; l < lanes; l++)
+		if(has_inserter[l])
+			pthread_join(inserters[l], nullptr);
+
+	for(std::size_t i = 0; i < buffers.size(); i++)
+		delete[] buffers[i];
+
+	for(int l = 0; l < lanes; l++)
+		delete p.lane_q[l];
+
+	delete p.cipher_free;
+	delete p.cipher_full;
+	delete p.plain_free;
+}
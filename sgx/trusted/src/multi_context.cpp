@@ -1,73 +1,68 @@
 #include "sgx_wrapper_t.h"
 
-#include "standalone_interface.h"
+#include "index_registry.h"
 
 #include <sgx_error.h>
 #include <sgx_tcrypto.h>
 
 // sgx_ra_context_t is an uint32_t
 #include <sgx_key_exchange.h>
-#include <sgx_spinlock.h>
 
-#include "user_session.h"
-#include <unordered_map>
+#include "session_table.h"
 
 #include "obl/primitives.h"
+#include "obl/ro_circuit.h"
 
 #include <cstring>
 
 // instead of mutexes, which require OCALLs in order to work, I emply spinlocks, that don't require enclave exit.
-// I drew the idea from Intel's code in the SDK performing remote attestation, that seems to use them instead of
-// mutexes in order to manage concurrent access to a vector
-sgx_spinlock_t session_lock = SGX_SPINLOCK_INITIALIZER;
+// Only create and close take the spinlock of a shard, lookups are lock-free (see session_table.h)
+session_table_t sessions;
+// loaded indexes, shared among sessions
+index_registry_t indexes;
 
-std::unordered_map<sgx_ra_context_t, user_session_t> session;
+// pins the session and takes exclusive use of it, provided it is in the given status
+static session_ref_t lock_session(sgx_ra_context_t ctx, int status)
+{
+	session_ref_t ref = sessions.find(ctx);
+
+	if(ref && ref->try_lock())
+	{
+		if(ref->status == status)
+			return ref;
+
+		ref->unlock();
+	}
+
+	return session_ref_t();
+}
+
+// pins a loaded session without exclusive use of it: queries of a session run concurrently
+static session_ref_t share_session(sgx_ra_context_t ctx)
+{
+	session_ref_t ref = sessions.find(ctx);
+
+	if(ref && ref->status.load(std::memory_order_acquire) == 3)
+		return ref;
+
+	return session_ref_t();
+}
 
 void create_session(sgx_status_t *ret, sgx_ra_context_t ctx)
 {
-	sgx_status_t retval = SGX_SUCCESS;
-	
-	// create a fresh context
-	user_session_t clean_session;
-	
-	// acquire the lock
-	sgx_spin_lock(&session_lock);
-	
-		// check whether the session already exists
-		auto it = session.find(ctx);
-		if(it == session.end())
-		{
-			session[ctx] = std::move(clean_session);
-			sgx_spin_unlock(&session_lock);
-		}
-		else {
-			sgx_spin_unlock(&session_lock);
-			retval = SGX_ERROR_INVALID_PARAMETER;
-		}
-	
 	// write status code
-	*ret = retval;
+	*ret = sessions.create(ctx);
 }
 
 void close_session(sgx_status_t *ret, sgx_ra_context_t ctx)
 {
-	sgx_status_t retval = SGX_SUCCESS;
-	
-	sgx_spin_lock(&session_lock);
-	
-		auto it = session.find(ctx);
-		
-		if(it == session.end())
-			retval = SGX_ERROR_INVALID_PARAMETER;
-		else if(it->second.busy)
-			retval = SGX_ERROR_INVALID_STATE;
-		else
-			session.erase(it);
-	
-	sgx_spin_unlock(&session_lock);
+	sgx_status_t retval = sessions.close(ctx);
 	
 	if(retval == SGX_SUCCESS)
+	{
+		indexes.trim();
 		retval = sgx_ra_close(ctx);
+	}
 	
 	*ret = retval;
 }
@@ -83,7 +78,7 @@ void configure(sgx_status_t *ret, sgx_ra_context_t ctx, std::uint8_t *cfg, std::
 	
 	if(retval == SGX_SUCCESS) // if not, ctx is invalid argument
 	{
-		sgx_rijndael128_cmac_msg(&session_key, cfg, 7 * sizeof(unsigned int), &out_cmac);
+		sgx_rijndael128_cmac_msg(&session_key, cfg, 10 * sizeof(unsigned int), &out_cmac);
 		std::memset(session_key, 0x00, 16);
 		
 		if(memcmp(out_cmac, mac, 16) != 0)
@@ -92,36 +87,46 @@ void configure(sgx_status_t *ret, sgx_ra_context_t ctx, std::uint8_t *cfg, std::
 		else {
 			std::uint32_t *cfg32 = (std::uint32_t*) cfg;
 			
-			// it was not worth to set the busy flag for just 8 assignments
-			// I expect session.find to take a lot more than the if-else stuff
-			sgx_spin_lock(&session_lock);
-				
-				auto it = session.find(ctx);
-				
-				if(it == session.end())
-					retval = SGX_ERROR_INVALID_PARAMETER;
-				else if(it != session.end() && it->second.status == 1)
+			session_ref_t sess = sessions.find(ctx);
+			
+			if(!sess)
+				retval = SGX_ERROR_INVALID_PARAMETER;
+			else if(sess->try_lock())
+			{
+				if(sess->status == 1)
 				{
-					it->second.cfg.base_oram = (obl_oram_t) cfg32[0];
-					it->second.cfg.Z = cfg32[1];
-					it->second.cfg.stash_size = cfg32[2];
-					it->second.cfg.S = cfg32[3];
-					it->second.cfg.A = cfg32[4];
-					it->second.cfg.csize = cfg32[5];
-					it->second.cfg.sa_block = cfg32[6];
-					it->second.status = 2;
+					sess->cfg.base_oram = (obl_oram_t) cfg32[0];
+					sess->cfg.Z = cfg32[1];
+					sess->cfg.stash_size = cfg32[2];
+					sess->cfg.S = cfg32[3];
+					sess->cfg.A = cfg32[4];
+					sess->cfg.csize = cfg32[5];
+					sess->cfg.sa_block = cfg32[6];
+					sess->cfg.huge_pages = cfg32[7];
+					sess->cfg.mem_budget = cfg32[8];
+					// every worker needs a TCS of its own
+					sess->cfg.threads = cfg32[9] > ENGINE_THREADS_MAX ? ENGINE_THREADS_MAX : cfg32[9];
+					
+					// a read-optimized stash below its floor would overflow, the client has to pick a larger one
+					if(sess->cfg.base_oram == RO_CIRCUIT_ORAM && sess->cfg.stash_size < obl::ro_circuit_min_stash(sess->cfg.Z))
+						retval = SGX_ERROR_INVALID_PARAMETER;
+					else
+						sess->status = 2;
 				}
 				else
 					retval = SGX_ERROR_INVALID_STATE;
-			
-			sgx_spin_unlock(&session_lock);
+				
+				sess->unlock();
+			}
+			else
+				retval = SGX_ERROR_INVALID_STATE;
 		}
 	}
 	
 	*ret = retval;
 }
 
-void loader(sgx_status_t *ret, sgx_ra_context_t ctx, void *fp, std::uint8_t *passphrase, std::uint8_t *iv, std::uint8_t *mac)
+void loader(sgx_status_t *ret, sgx_ra_context_t ctx, void *fp, void *progress, std::uint8_t *passphrase, std::uint8_t *iv, std::uint8_t *mac)
 {
 	sgx_status_t retval = SGX_SUCCESS;
 	
@@ -141,38 +146,21 @@ void loader(sgx_status_t *ret, sgx_ra_context_t ctx, void *fp, std::uint8_t *pas
 		
 		if(retval == SGX_SUCCESS)
 		{
-			sgx_spin_lock(&session_lock);
+			session_ref_t sess = lock_session(ctx, 2);
 			
-				auto it = session.find(ctx);
+			if(!sess)
+				retval = SGX_ERROR_INVALID_STATE;
+			else {
+				// no lock held while building the context, lookups of the other sessions go on
+				sess->ctx = indexes.open(fp, progress, (char*) dec_passphrase, sess->cfg);
 				
-				if(it == session.end() || it->second.status != 2 || it->second.busy)
-				{
-					sgx_spin_unlock(&session_lock);
-					retval = SGX_ERROR_INVALID_STATE;
-				}
-				else {
-					// dump required stuff
-					it->second.busy = true;
-					subtol_config_t cfg = it->second.cfg;
-					sgx_spin_unlock(&session_lock);
-					
-					subtol_context_t *context = init_subtol_context(fp, (char*) dec_passphrase, cfg);
-					
-					sgx_spin_lock(&session_lock);
-					
-					// iterators may change due to modifications to the container
-					it = session.find(ctx);
-					
-					it->second.ctx = std::unique_ptr<subtol_context_t>(context);
-					it->second.busy = false;
-	
-					if(context != nullptr)
-						it->second.status = 3;
-					
-					sgx_spin_unlock(&session_lock);
-					
-					context = nullptr;
-				}
+				if(sess->ctx != nullptr)
+					sess->status.store(3, std::memory_order_release);
+				else
+					retval = SGX_ERROR_MAC_MISMATCH;
+				
+				sess->unlock();
+			}
 		}
 	}
 	
@@ -199,40 +187,129 @@ void query(sgx_status_t *ret, sgx_ra_context_t ctx, uint8_t *q, size_t len, uint
 		
 		if(retval == SGX_SUCCESS)
 		{
-			sgx_spin_lock(&session_lock);
+			session_ref_t sess = share_session(ctx);
+			
+			if(!sess)
+				retval = SGX_ERROR_INVALID_STATE;
+			else {
+				subtol_context_t *context = sess->ctx.get();
+				
+				std::uint32_t tmp_res[2];
+				context->query(qq, len, tmp_res[0], tmp_res[1]);
+				
+				sess.release();
+				
+				// encrypt results
+				obl::gen_rand(iv, 12);
+				retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) tmp_res, 2 * sizeof(std::int32_t), (std::uint8_t*) res, iv, 12, NULL, 0, &gcm_mac);
+				std::memcpy(mac, gcm_mac, 16);
+			}
+		}
+		
+		std::memset(qq, 0x00, len);
+		delete[] qq;
+	}
+
+	std::memset(session_key, 0x00, 16);
+	*ret = retval;
+}
+
+void query_batch(sgx_status_t *ret, sgx_ra_context_t ctx, uint8_t *q, size_t len, uint8_t *iv, uint8_t *mac, int32_t *res, size_t res_len, size_t *n)
+{
+	sgx_status_t retval = SGX_SUCCESS;
+	
+	sgx_ra_key_128_t session_key;
+	
+	*n = 0;
+	retval = sgx_ra_get_keys(ctx, SGX_RA_KEY_SK, &session_key);
+	
+	if(retval == SGX_SUCCESS) // session key correctly retrieved
+	{
+		unsigned char *qq = new unsigned char[len];
+		
+		sgx_aes_gcm_128bit_tag_t gcm_mac;
+		std::memcpy(gcm_mac, mac, 16);
+		
+		retval = sgx_rijndael128GCM_decrypt(&session_key, q, len, (std::uint8_t*) qq, iv, 12, NULL, 0, &gcm_mac);
+		
+		// validate the envelope: the number of queries and their lengths are not secret
+		std::uint32_t no_queries = 0;
+		std::size_t header_size = 0;
+		std::size_t total = 0;
+		
+		if(retval == SGX_SUCCESS && len >= sizeof(std::uint32_t))
+		{
+			std::memcpy(&no_queries, qq, sizeof(std::uint32_t));
+			header_size = sizeof(std::uint32_t) * (1 + (std::size_t) no_queries);
+		}
+		
+		if(retval == SGX_SUCCESS && (no_queries == 0 || no_queries > QUERY_BATCH_MAX || 2 * (std::size_t) no_queries > res_len || header_size > len))
+			retval = SGX_ERROR_INVALID_PARAMETER;
+		
+		std::uint32_t *qlen = nullptr;
+		unsigned char **qs = nullptr;
+		
+		if(retval == SGX_SUCCESS)
+		{
+			qlen = new std::uint32_t[no_queries];
+			qs = new unsigned char*[no_queries];
+			std::memcpy(qlen, qq + sizeof(std::uint32_t), sizeof(std::uint32_t) * no_queries);
 			
-				auto it = session.find(ctx);
+			for(std::uint32_t i = 0; i < no_queries && retval == SGX_SUCCESS; i++)
+			{
+				qs[i] = qq + header_size + total;
+				total += qlen[i];
 				
-				if(it == session.end() || it->second.status != 3 || it->second.busy)
+				if(qlen[i] == 0 || total > len - header_size)
+					retval = SGX_ERROR_INVALID_PARAMETER;
+			}
+			
+			if(retval == SGX_SUCCESS && total != len - header_size)
+				retval = SGX_ERROR_INVALID_PARAMETER;
+		}
+		
+		if(retval == SGX_SUCCESS)
+		{
+			// a single session lookup for the whole batch
+			session_ref_t sess = share_session(ctx);
+			
+			if(!sess)
+				retval = SGX_ERROR_INVALID_STATE;
+			else {
+				subtol_context_t *context = sess->ctx.get();
+				
+				std::uint32_t *tmp_res = new std::uint32_t[2 * no_queries];
+				std::uint32_t *start = new std::uint32_t[no_queries];
+				std::uint32_t *end = new std::uint32_t[no_queries];
+				
+				context->query_batch(qs, qlen, no_queries, start, end);
+				
+				for(std::uint32_t i = 0; i < no_queries; i++)
 				{
-					sgx_spin_unlock(&session_lock);
-					retval = SGX_ERROR_INVALID_STATE;
-				}
-				else {
-					// dump required stuff
-					it->second.busy = true;
-					std::unique_ptr<subtol_context_t> context = std::move(it->second.ctx);
-					sgx_spin_unlock(&session_lock);
-					
-					std::uint32_t tmp_res[2];
-					context->query(qq, len, tmp_res[0], tmp_res[1]);
-					// this is to later fetch suffix-array entries
-					context->current_start_index = obl::ternary_op((tmp_res[0] != -1) & (tmp_res[0] <= tmp_res[1]), tmp_res[0], 0);
-					
-					sgx_spin_lock(&session_lock);
-					// iterators may change due to modifications to the container
-					it = session.find(ctx);
-					it->second.busy = false;
-					it->second.ctx = std::move(context);
-					sgx_spin_unlock(&session_lock);
-					
-					// encrypt results
-					obl::gen_rand(iv, 12);
-					retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) tmp_res, 2 * sizeof(std::int32_t), (std::uint8_t*) res, iv, 12, NULL, 0, &gcm_mac);
-					std::memcpy(mac, gcm_mac, 16);
+					tmp_res[2 * i] = start[i];
+					tmp_res[2 * i + 1] = end[i];
 				}
+				
+				sess.release();
+				
+				// encrypt all the results at once
+				obl::gen_rand(iv, 12);
+				retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) tmp_res, 2 * no_queries * sizeof(std::int32_t), (std::uint8_t*) res, iv, 12, NULL, 0, &gcm_mac);
+				std::memcpy(mac, gcm_mac, 16);
+				*n = no_queries;
+				
+				std::memset(tmp_res, 0x00, 2 * no_queries * sizeof(std::uint32_t));
+				delete[] tmp_res;
+				delete[] start;
+				delete[] end;
+			}
 		}
 		
+		if(qlen != nullptr)
+			delete[] qlen;
+		if(qs != nullptr)
+			delete[] qs;
+		
 		std::memset(qq, 0x00, len);
 		delete[] qq;
 	}
@@ -241,7 +318,7 @@ void query(sgx_status_t *ret, sgx_ra_context_t ctx, uint8_t *q, size_t len, uint
 	*ret = retval;
 }
 
-void fetch_sa(sgx_status_t *ret, sgx_ra_context_t ctx, int32_t **sa, size_t *len, uint8_t *iv, uint8_t *mac)
+void fetch_sa(sgx_status_t *ret, sgx_ra_context_t ctx, uint8_t *cursor, int32_t **sa, size_t *len, uint8_t *iv, uint8_t *mac)
 {
 	sgx_status_t retval = SGX_SUCCESS;
 	
@@ -249,53 +326,103 @@ void fetch_sa(sgx_status_t *ret, sgx_ra_context_t ctx, int32_t **sa, size_t *len
 
 	sgx_ra_key_128_t session_key;
 	sgx_aes_gcm_128bit_tag_t gcm_mac;
+	std::uint32_t first = 0;
 	
+	*sa = nullptr;
+	*len = 0;
 	retval = sgx_ra_get_keys(ctx, SGX_RA_KEY_SK, &session_key);
 	
 	if(retval == SGX_SUCCESS) // session key correctly retrieved
 	{
-		sgx_spin_lock(&session_lock);
+		// the cursor comes with every call, so concurrent queries of a session do not mix their entries
+		std::memcpy(gcm_mac, mac, 16);
+		
+		retval = sgx_rijndael128GCM_decrypt(&session_key, cursor, sizeof(std::uint32_t), (std::uint8_t*) &first, iv, 12, NULL, 0, &gcm_mac);
+	}
+	
+	if(retval == SGX_SUCCESS)
+	{
+		session_ref_t sess = share_session(ctx);
 		
-			auto it = session.find(ctx);
+		if(!sess)
+			retval = SGX_ERROR_INVALID_STATE;
+		else {
+			subtol_context_t *context = sess->ctx.get();
 			
-			if(it == session.end() || it->second.status != 3 || it->second.busy)
+			if(context->suffix_array != nullptr)
 			{
-				sgx_spin_unlock(&session_lock);
-				retval = SGX_ERROR_INVALID_STATE;
+				std::int32_t buff[context->sa_bundle_size];
+				// the bundle holding entry first
+				context->fetch_sa(buff, first);
+				
+				host_alloc((void**) &outbuf, sizeof(std::int32_t) * context->sa_bundle_size);
+
+				obl::gen_rand(iv, 12);
+				retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) buff, context->sa_bundle_size *sizeof(std::int32_t),
+					(std::uint8_t*) outbuf, iv, 12, NULL, 0, &gcm_mac);
+				std::memcpy(mac, gcm_mac, 16);
+				
+				*sa = outbuf;
+				*len = context->sa_bundle_size;
 			}
+			else
+				retval = SGX_ERROR_INVALID_PARAMETER;
+		}
+	}
+	
+	first = 0;
+	std::memset(session_key, 0x00, 16);
+	*ret = retval;
+}
+
+void fetch_sa_range(sgx_status_t *ret, sgx_ra_context_t ctx, uint8_t *range, uint8_t *range_iv, uint8_t *range_mac, size_t offset, uint8_t *iv, uint8_t *mac, int32_t *sa, size_t len)
+{
+	sgx_status_t retval = SGX_SUCCESS;
+	
+	sgx_ra_key_128_t session_key;
+	sgx_aes_gcm_128bit_tag_t gcm_mac;
+	
+	// offset and len are public, they only depend on the padding bound of the client
+	if(len == 0 || len > SA_RANGE_CHUNK_MAX)
+	{
+		*ret = SGX_ERROR_INVALID_PARAMETER;
+		return;
+	}
+	
+	retval = sgx_ra_get_keys(ctx, SGX_RA_KEY_SK, &session_key);
+	
+	if(retval == SGX_SUCCESS) // session key correctly retrieved
+	{
+		// the same range comes with every chunk of a stream, the enclave keeps no state
+		std::uint32_t se[2];
+		std::memcpy(gcm_mac, range_mac, 16);
+		
+		retval = sgx_rijndael128GCM_decrypt(&session_key, range, 2 * sizeof(std::uint32_t), (std::uint8_t*) se, range_iv, 12, NULL, 0, &gcm_mac);
+		
+		if(retval == SGX_SUCCESS)
+		{
+			session_ref_t sess = share_session(ctx);
+			
+			if(!sess)
+				retval = SGX_ERROR_INVALID_STATE;
+			else if(sess->ctx->suffix_array == nullptr)
+				retval = SGX_ERROR_INVALID_PARAMETER;
 			else {
-				it->second.busy = true;
-				std::unique_ptr<subtol_context_t> context = std::move(it->second.ctx);
-				sgx_spin_unlock(&session_lock);
+				std::int32_t *buff = new std::int32_t[len];
 				
-				if(context->suffix_array != nullptr)
-				{
-					std::int32_t buff[context->sa_bundle_size];
-					context->fetch_sa(buff);
-					
-					host_alloc((void**) &outbuf, sizeof(std::int32_t) * context->sa_bundle_size);
-
-					obl::gen_rand(iv, 12);
-					retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) buff, context->sa_bundle_size *sizeof(std::int32_t),
-						(std::uint8_t*) outbuf, iv, 12, NULL, 0, &gcm_mac);
-					std::memcpy(mac, gcm_mac, 16);
-					
-					*sa = outbuf;
-					*len = context->sa_bundle_size;
-				}
-				else {
-					retval = SGX_ERROR_INVALID_PARAMETER;
-					*sa = nullptr;
-					*len = 0;
-				}
+				sess->ctx->fetch_sa_range(buff, se[0] + offset, se[1], len);
+				sess.release();
+				
+				obl::gen_rand(iv, 12);
+				retval = sgx_rijndael128GCM_encrypt(&session_key, (std::uint8_t*) buff, len * sizeof(std::int32_t), (std::uint8_t*) sa, iv, 12, NULL, 0, &gcm_mac);
+				std::memcpy(mac, gcm_mac, 16);
 				
-				sgx_spin_lock(&session_lock);
-				// iterators may change due to modifications to the container
-				it = session.find(ctx);
-				it->second.busy = false;
-				it->second.ctx = std::move(context);
-				sgx_spin_unlock(&session_lock);
+				std::memset(buff, 0x00, len * sizeof(std::int32_t));
+				delete[] buff;
 			}
+		}
+		
+		std::memset(se, 0x00, sizeof(se));
 	}
 	
 	std::memset(session_key, 0x00, 16);
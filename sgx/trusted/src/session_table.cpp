@@ -0,0 +1,207 @@
+#include "session_table.h"
+
+session_slot_t* session_table_t::scan(session_shard_t &sh, sgx_ra_context_t ctx, session_slot_t **free_slot)
+{
+	int home = home_of(ctx);
+
+	*free_slot = nullptr;
+
+	for(int p = 0; p < SESSION_SHARD_SLOTS; p++)
+	{
+		session_slot_t &s = sh.slots[(home + p) % SESSION_SHARD_SLOTS];
+
+		if(s.used.load() && s.key.load() == ctx)
+			return &s;
+
+		if(!s.used.load() && *free_slot == nullptr)
+			*free_slot = &s;
+	}
+
+	return nullptr;
+}
+
+void session_table_t::claim(session_slot_t *slot, sgx_ra_context_t ctx)
+{
+	// refs of a free slot may be non-zero due to readers about to fail validation
+	slot->seq.fetch_add(1);
+
+	slot->key.store(ctx);
+	slot->sess.cfg = subtol_config_t();
+	slot->sess.status = 1;
+	slot->sess.busy.store(false);
+	slot->used.store(true);
+
+	slot->seq.fetch_add(1);
+}
+
+sgx_status_t session_table_t::create(sgx_ra_context_t ctx)
+{
+	int first = shard_index(ctx);
+	session_shard_t &sh = shards[first];
+	session_slot_t *free_slot;
+
+	sgx_spin_lock(&sh.writer);
+
+		if(scan(sh, ctx, &free_slot) != nullptr)
+		{
+			sgx_spin_unlock(&sh.writer);
+			return SGX_ERROR_INVALID_PARAMETER;
+		}
+
+		if(free_slot != nullptr)
+		{
+			claim(free_slot, ctx);
+			sgx_spin_unlock(&sh.writer);
+			return SGX_SUCCESS;
+		}
+
+	sgx_spin_unlock(&sh.writer);
+
+	// the home shard is full, look for room in the others
+	sgx_status_t ret = SESSION_TABLE_FULL;
+
+	sgx_spin_lock(&spill_lock);
+
+		// a session spilled earlier may sit in any of them
+		for(int i = 1; i < SESSION_SHARDS && ret == SESSION_TABLE_FULL; i++)
+		{
+			session_shard_t &other = shards[(first + i) & (SESSION_SHARDS - 1)];
+
+			sgx_spin_lock(&other.writer);
+
+				if(scan(other, ctx, &free_slot) != nullptr)
+					ret = SGX_ERROR_INVALID_PARAMETER;
+
+			sgx_spin_unlock(&other.writer);
+		}
+
+		for(int i = 1; i < SESSION_SHARDS && ret == SESSION_TABLE_FULL; i++)
+		{
+			session_shard_t &other = shards[(first + i) & (SESSION_SHARDS - 1)];
+
+			sgx_spin_lock(&other.writer);
+
+				scan(other, ctx, &free_slot);
+
+				if(free_slot != nullptr)
+				{
+					// before the slot is published, so that find never misses it
+					spilled.fetch_add(1);
+					claim(free_slot, ctx);
+					ret = SGX_SUCCESS;
+				}
+
+			sgx_spin_unlock(&other.writer);
+		}
+
+	sgx_spin_unlock(&spill_lock);
+
+	return ret;
+}
+
+sgx_status_t session_table_t::close_in(session_shard_t &sh, sgx_ra_context_t ctx, std::shared_ptr<subtol_context_t> &dead)
+{
+	session_slot_t *free_slot;
+
+	sgx_spin_lock(&sh.writer);
+
+		session_slot_t *slot = scan(sh, ctx, &free_slot);
+
+		if(slot == nullptr)
+		{
+			sgx_spin_unlock(&sh.writer);
+			return SGX_ERROR_INVALID_PARAMETER;
+		}
+
+		// from now on no reader can validate a pin on this slot
+		slot->seq.fetch_add(1);
+
+		if(slot->refs.load() != 0 || slot->sess.busy.load())
+		{
+			slot->seq.fetch_add(1);
+			sgx_spin_unlock(&sh.writer);
+			return SGX_ERROR_INVALID_STATE;
+		}
+
+		dead = std::move(slot->sess.ctx);
+		slot->sess.status = 1;
+		slot->used.store(false);
+
+		slot->seq.fetch_add(1);
+
+	sgx_spin_unlock(&sh.writer);
+
+	return SGX_SUCCESS;
+}
+
+sgx_status_t session_table_t::close(sgx_ra_context_t ctx)
+{
+	int first = shard_index(ctx);
+	std::shared_ptr<subtol_context_t> dead;
+
+	sgx_status_t ret = close_in(shards[first], ctx, dead);
+
+	for(int i = 1; i < SESSION_SHARDS && ret == SGX_ERROR_INVALID_PARAMETER && spilled.load() != 0; i++)
+	{
+		ret = close_in(shards[(first + i) & (SESSION_SHARDS - 1)], ctx, dead);
+
+		if(ret == SGX_SUCCESS)
+			spilled.fetch_sub(1);
+	}
+
+	// the index may be torn down, which takes a while, do it out of the lock
+	dead.reset();
+
+	return ret;
+}
+
+session_ref_t session_table_t::find_in(session_shard_t &sh, sgx_ra_context_t ctx)
+{
+	int home = home_of(ctx);
+
+	// no tombstones, so a miss scans the whole shard
+	for(int p = 0; p < SESSION_SHARD_SLOTS; p++)
+	{
+		session_slot_t &s = sh.slots[(home + p) % SESSION_SHARD_SLOTS];
+
+		while(true)
+		{
+			std::uint32_t before = s.seq.load();
+
+			// a writer is working on this slot
+			if(before & 1)
+				continue;
+
+			if(!s.used.load() || s.key.load() != ctx)
+			{
+				if(s.seq.load() != before)
+					continue;
+				break;
+			}
+
+			s.refs.fetch_add(1);
+
+			if(s.seq.load() == before)
+				return session_ref_t(&s);
+
+			s.refs.fetch_sub(1);
+		}
+	}
+
+	return session_ref_t();
+}
+
+session_ref_t session_table_t::find(sgx_ra_context_t ctx)
+{
+	int first = shard_index(ctx);
+
+	for(int i = 0; i < SESSION_SHARDS && (i == 0 || spilled.load() != 0); i++)
+	{
+		session_ref_t ref = find_in(shards[(first + i) & (SESSION_SHARDS - 1)], ctx);
+
+		if(ref)
+			return ref;
+	}
+
+	return session_ref_t();
+}
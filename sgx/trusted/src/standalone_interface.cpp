@@ -8,8 +8,11 @@
 #include <sgx_trts.h>
 
 #include "cbbst.h"
+#include "blob_reader.h"
 #include "opt_allocator.hpp"
 #include "obl/circuit.h"
+#include "obl/ro_circuit.h"
+#include "obl/adaptive_factory.h"
 #include "obl/ring.h"
 #include "obl/path.h"
 #include "obl/so_path.h"
@@ -22,13 +25,17 @@
 
 #include "contexts/sa_psi_context.h"
 #include "contexts/bwt_context.h"
+#include "contexts/kbwt_context.h"
 #include "contexts/n_bwt_context.h"
 #include "contexts/n_bwt_context_b.h"
 
 #include <ipp/ippcp.h>
+#include <sgx_tcrypto.h>
 #include <wolfcrypt/pbkdf.h>
 
-const int linear_break_even = 256;
+// largest ORAM for which a linear scan beats circuit ORAM, see benchmarks/linear_bench
+// (2048 for position-map sized blocks, 1024 for 1 KB blocks)
+const int linear_break_even = 1024;
 
 static int obl_strlen(char *pwd)
 {
@@ -49,64 +56,74 @@ static int obl_strlen(char *pwd)
 	return 64 - zeroes;
 }
 
-subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
+void open_index_file(blob_reader_t &reader, char *pwd, subtol_config_t &cfg, index_file_t &file)
 {
 	size_t filesize;
-	uint8_t aes_key[16];
-	// AES-GCM material
-	uint8_t iv[12];
-	uint8_t mac[16];
-	uint8_t *salt;
-	IppsAES_GCMState *cc;
-	int gcm_state_size;
-	// header
-	bool has_sa;
-	uint64_t algorithm_selection, algo;
-	uint64_t header[4];
-
-	// fb is a void* pointer, that is meant to point to a FILE*
-	// since enclaves don't allow direct use of syscalls, some I/O structs are left unimplemented in the sgx_tlibc
-	// we don't need to check where that pointer belongs since it will just be handled to untrusted code to perform
-	// file operations
+	sgx_sha_state_handle_t sha;
 
 	// get MAC
-	ocall_get_file_size(fb, &filesize);
-	ocall_get_blob(fb, mac, 16, filesize - 16);
+	filesize = reader.get_size();
+	reader.seek(filesize - 16);
+	reader.read(file.mac, 16);
 
 	// get headers
-	ocall_get_blob(fb, (uint8_t *)&algorithm_selection, sizeof(uint64_t), 0);
-	has_sa = algorithm_selection >= 4;
-	algo = algorithm_selection % 4;
+	reader.seek(0);
+	reader.read(&file.algorithm_selection, sizeof(uint64_t));
 
-	ocall_get_blob(fb, (uint8_t *)header, 4 * sizeof(uint64_t), -1);
+	reader.read(file.header, 4 * sizeof(uint64_t));
 	// for now only 4-bytes integers are supported
-	assert(header[2] == sizeof(int32_t));
+	assert(file.header[2] == sizeof(int32_t));
 
 	// get aes-gcm IV which is suggested to be 12-bytes in size
-	ocall_get_blob(fb, iv, 12, -1);
+	reader.read(file.iv, 12);
 	// dump the salt
-	salt = new uint8_t[header[3]];
-	ocall_get_blob(fb, salt, header[3], -1);
-	wc_PBKDF2(aes_key, (unsigned char *)pwd, obl_strlen(pwd), salt, header[3], 16384, 16, WC_HASH_TYPE_SHA256);
+	file.salt.resize(file.header[3]);
+	reader.read(file.salt.data(), file.header[3]);
+	wc_PBKDF2(file.aes_key, (unsigned char *)pwd, obl_strlen(pwd), file.salt.data(), file.header[3], 16384, 16, WC_HASH_TYPE_SHA256);
 	std::memset(pwd, 0x00, 64);
 
+	/*
+		The tag authenticates the whole file under the derived key, so a session can
+		only match an index it would be able to decrypt itself. The key never leaves
+		the enclave, neither does the digest.
+	*/
+	sgx_sha256_init(&sha);
+	sgx_sha256_update((uint8_t *)&file.algorithm_selection, sizeof(uint64_t), sha);
+	sgx_sha256_update((uint8_t *)file.header, 4 * sizeof(uint64_t), sha);
+	sgx_sha256_update(file.iv, 12, sha);
+	sgx_sha256_update(file.salt.data(), file.salt.size(), sha);
+	sgx_sha256_update(file.mac, 16, sha);
+	sgx_sha256_update(file.aes_key, 16, sha);
+	sgx_sha256_update((uint8_t *)&cfg, sizeof(subtol_config_t), sha);
+	sgx_sha256_get_hash(sha, (sgx_sha256_hash_t *)file.id);
+	sgx_sha256_close(sha);
+}
+
+subtol_context_t *init_subtol_context(blob_reader_t &reader, index_file_t &file, subtol_config_t &cfg)
+{
+	IppsAES_GCMState *cc;
+	int gcm_state_size;
+	bool has_sa = file.algorithm_selection >= 4;
+	uint64_t algo = file.algorithm_selection % 4;
+	uint64_t *header = file.header;
+
+	// encrypted data follows the salt
+	reader.seek(sizeof(uint64_t) * 5 + 12 + file.header[3]);
+
 	// initialize crypto stuff and authenticate unencrypted data
 	// taken from sgx_tcrypto sdk code
 	ippsAES_GCMGetSize(&gcm_state_size);
 	cc = (IppsAES_GCMState *)malloc(gcm_state_size);
-	ippsAES_GCMInit(aes_key, 16, cc, gcm_state_size);
-	std::memset(aes_key, 0x00, 16);
+	ippsAES_GCMInit(file.aes_key, 16, cc, gcm_state_size);
 
 	ippsAES_GCMReset(cc);
-	ippsAES_GCMProcessIV(iv, 12, cc);
+	ippsAES_GCMProcessIV(file.iv, 12, cc);
 
 	// authenticate unencrypted data
-	ippsAES_GCMProcessAAD((uint8_t *)&algorithm_selection, sizeof(uint64_t), cc);
+	ippsAES_GCMProcessAAD((uint8_t *)&file.algorithm_selection, sizeof(uint64_t), cc);
 	ippsAES_GCMProcessAAD((uint8_t *)header, sizeof(uint64_t) * 4, cc);
-	ippsAES_GCMProcessAAD(iv, 12, cc);
-	ippsAES_GCMProcessAAD(salt, header[3], cc);
-
-	delete[] salt;
+	ippsAES_GCMProcessAAD(file.iv, 12, cc);
+	ippsAES_GCMProcessAAD(file.salt.data(), header[3], cc);
 
 	// UP TO HERE SUBTOL PREPARATION IS EXACTLY THE SAME!
 	// NOW DIFFERENTIATE ACCORDING TO THE ALGORITHM
@@ -118,7 +135,7 @@ subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
 	switch (cfg.base_oram)
 	{
 	case OBL_CIRCUIT_ORAM:
-		allocator = new obl::coram_factory(cfg.Z, cfg.stash_size);
+		allocator = new obl::coram_factory(cfg.Z, cfg.stash_size, (obl::huge_page_t)cfg.huge_pages);
 		break;
 
 	case OBL_RING_ORAM:
@@ -146,26 +163,51 @@ subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
 	case TAOSTORE_V2:
 		allocator = new obl::taostore_factory_v2(cfg.Z, cfg.stash_size, 4);
 		break;
+	case RO_CIRCUIT_ORAM:
+		// configure rejects a smaller stash already
+		if (cfg.stash_size < obl::ro_circuit_min_stash(cfg.Z))
+			invalid = true;
+		else
+			allocator = new obl::ro_coram_factory(cfg.Z, cfg.stash_size, (obl::huge_page_t)cfg.huge_pages);
+		break;
+	case ADAPTIVE_ORAM:
+		// no timer in here: built-in cost model
+		allocator = new obl::adaptive_factory(cfg.mem_budget == 0 ? (std::size_t)-1 : (std::size_t)cfg.mem_budget << 20,
+			cfg.threads == 0 ? 1 : cfg.threads);
+		break;
 	default:
 		invalid = true;
 	}
+
+	if (invalid)
+	{
+		free(cc);
+		return nullptr;
+	}
+
 	// create subtol context
 	subtol_context_t *session = nullptr;
 
 	switch (algo)
 	{
 	case 0: // SUBTOL_SA_PSI
-		allocator = new opt_allocator(allocator, linear_break_even);
-		session = new sa_psi_context_t(fb, header[0], header[1], allocator, cc);
+		if (cfg.base_oram != ADAPTIVE_ORAM)
+			allocator = new opt_allocator(allocator, linear_break_even);
+		session = new sa_psi_context_t(&reader, header[0], header[1], allocator, cc);
 		break;
 
 	case 1: // SUBTOL_NBWT -- alternate version
-		allocator = new opt_allocator(allocator, linear_break_even);
-		session = new n_bwt_context_b_t(fb, header[0], header[1], allocator, cc);
+		if (cfg.base_oram != ADAPTIVE_ORAM)
+			allocator = new opt_allocator(allocator, linear_break_even);
+		session = new n_bwt_context_b_t(&reader, header[0], header[1], allocator, cc);
 		break;
 
 	case 2: // SUBTOL_VBWT
-		session = new bwt_context_t(fb, header[0], header[1], allocator, cc, cfg.csize);
+		session = new bwt_context_t(&reader, header[0], header[1], allocator, cc, cfg.csize);
+		break;
+
+	case 3: // SUBTOL_KBWT
+		session = new kbwt_context_t(&reader, header[0], header[1], allocator, cc, cfg.csize);
 		break;
 
 	default:
@@ -179,7 +221,7 @@ subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
 
 		session->init();
 
-		bool success = session->verify_mac(mac);
+		bool success = session->verify_mac(file.mac);
 
 		if (!success)
 		{
@@ -0,0 +1,386 @@
+#include "obl/adaptive_factory.h"
+#include "obl/circuit.h"
+#include "obl/linear.h"
+#include "obl/mose.h"
+#include "obl/utils.h"
+#include "obl/primitives.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef SGX_ENCLAVE_ENABLED
+#include <chrono>
+#endif
+
+// bid + lid header of a block, iv/flags/mac header of an encrypted bucket
+#define BLOCK_HEADER 8
+#define BUCKET_HEADER 32
+
+// path passes per circuit access: fetch + write back, then two evictions
+#define CIRCUIT_PASSES 3
+// stash scans per circuit access: extract, insert, one per eviction
+#define CIRCUIT_SCANS 4
+
+#define MAX_MOSE_THREADS 8
+
+namespace obl
+{
+
+	// stash sizes giving a negligible overflow probability, see benchmarks/stash_stress
+	static const unsigned int z_candidates[] = {2, 3, 4};
+	static const unsigned int s_candidates[] = {16, 8, 8};
+
+	adaptive_factory::adaptive_factory(std::size_t mem_budget, unsigned int thr_budget)
+	{
+		this->model = default_model();
+		this->mem_budget = mem_budget;
+		this->thr_budget = thr_budget;
+	}
+
+	adaptive_factory::adaptive_factory(const oram_cost_model_t &model, std::size_t mem_budget, unsigned int thr_budget)
+	{
+		this->model = model;
+		this->mem_budget = mem_budget;
+		this->thr_budget = thr_budget;
+	}
+
+	oram_cost_model_t adaptive_factory::default_model()
+	{
+		// measured on a Skylake server with AES-NI, used when nothing better is available
+		oram_cost_model_t m;
+
+		m.bucket_fixed = 150.0;
+		m.bucket_byte = 0.45;
+		m.scan_fixed = 4.0;
+		m.scan_byte = 0.12;
+		m.thread_sync = 3000.0;
+
+		return m;
+	}
+
+	double circuit_latency(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S)
+	{
+		std::size_t blk = pad_bytes(B + BLOCK_HEADER, 8);
+		int levels = __builtin_ctzll(next_two_power(N < 2 ? 2 : N)) + 1;
+
+		double path = levels * (model.bucket_fixed + model.bucket_byte * Z * blk);
+		double stash = S * (model.scan_fixed + model.scan_byte * blk);
+
+		return CIRCUIT_PASSES * path + CIRCUIT_SCANS * stash;
+	}
+
+	std::size_t circuit_memory(std::size_t N, std::size_t B, unsigned int Z, unsigned int S)
+	{
+		std::size_t blk = pad_bytes(B + BLOCK_HEADER, 8);
+		std::size_t buckets = 2 * next_two_power(N < 2 ? 2 : N) - 1;
+
+		return buckets * (Z * blk + BUCKET_HEADER) + S * blk;
+	}
+
+	static double mose_latency(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int T)
+	{
+		if (T <= 1)
+			return circuit_latency(model, N, B, Z, S);
+
+		return circuit_latency(model, N, (B + T - 1) / T, Z, S) + T * model.thread_sync;
+	}
+
+	unsigned int mose_threads(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int max_T)
+	{
+		unsigned int best = 1;
+
+		for (unsigned int T = 2; T <= max_T && T <= B; T++)
+			if (mose_latency(model, N, B, Z, S, T) < mose_latency(model, N, B, Z, S, best))
+				best = T;
+
+		return best;
+	}
+
+	unsigned int taostore_threads(const oram_cost_model_t &model, std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int max_T)
+	{
+		double path = circuit_latency(model, N, B, Z, S);
+		double best_latency = path;
+		unsigned int best = 1;
+
+		for (unsigned int T = 2; T <= max_T; T++)
+		{
+			double l = path / T + T * model.thread_sync;
+
+			if (l < best_latency)
+			{
+				best = T;
+				best_latency = l;
+			}
+		}
+
+		return best;
+	}
+
+	oram_shape_t adaptive_factory::choose(std::size_t N, std::size_t B)
+	{
+		oram_shape_t best, smallest;
+		std::size_t blk = pad_bytes(B + BLOCK_HEADER, 8);
+
+		// linear ORAM
+		best.engine = ENGINE_LINEAR;
+		best.Z = best.S = 0;
+		best.T = 1;
+		best.latency = N * (model.scan_fixed + model.scan_byte * blk);
+		best.memory = N * blk;
+		smallest = best;
+
+		if (best.memory > mem_budget)
+			best.latency = -1.0;
+
+		auto consider = [&](const oram_shape_t &c) {
+			if (c.memory < smallest.memory)
+				smallest = c;
+
+			if (c.memory <= mem_budget && (best.latency < 0 || c.latency < best.latency))
+				best = c;
+		};
+
+		for (unsigned int i = 0; i < sizeof(z_candidates) / sizeof(z_candidates[0]); i++)
+		{
+			unsigned int Z = z_candidates[i];
+			unsigned int S = s_candidates[i];
+			oram_shape_t c;
+
+			c.engine = ENGINE_CIRCUIT;
+			c.Z = Z;
+			c.S = S;
+			c.T = 1;
+			c.latency = circuit_latency(model, N, B, Z, S);
+			c.memory = circuit_memory(N, B, Z, S);
+			consider(c);
+
+			// MOSE splits every block in T slices processed in parallel
+			for (unsigned int T = 2; T <= thr_budget && T <= MAX_MOSE_THREADS && T <= B; T++)
+			{
+				c.engine = ENGINE_MOSE;
+				c.T = T;
+				c.latency = mose_latency(model, N, B, Z, S, T);
+				c.memory = T * circuit_memory(N, (B + T - 1) / T, Z, S);
+				consider(c);
+			}
+		}
+
+		return best.latency < 0 ? smallest : best;
+	}
+
+	std::size_t adaptive_factory::linear_cutoff(std::size_t B)
+	{
+		std::size_t N = 1;
+
+		while (N < (1ULL << 30) && choose(N << 1, B).engine == ENGINE_LINEAR)
+			N <<= 1;
+
+		return choose(N, B).engine == ENGINE_LINEAR ? N : 0;
+	}
+
+	tree_oram *adaptive_factory::spawn_oram(std::size_t N, std::size_t B)
+	{
+		oram_shape_t s = choose(N, B);
+
+		mem_budget -= s.memory > mem_budget ? mem_budget : s.memory;
+
+		switch (s.engine)
+		{
+		case ENGINE_LINEAR:
+			return new linear_oram(N, B);
+
+		case ENGINE_MOSE:
+			thr_budget -= s.T;
+			return new mose(N, B, s.Z, s.S, s.T);
+
+		default:
+			return new circuit_oram(N, B, s.Z, s.S);
+		}
+	}
+
+	bool adaptive_factory::parse_model(const char *text, oram_cost_model_t &model)
+	{
+		struct
+		{
+			const char *key;
+			double *value;
+		} fields[] = {
+			{"bucket_fixed", &model.bucket_fixed},
+			{"bucket_byte", &model.bucket_byte},
+			{"scan_fixed", &model.scan_fixed},
+			{"scan_byte", &model.scan_byte},
+			{"thread_sync", &model.thread_sync}};
+
+		const int no_fields = sizeof(fields) / sizeof(fields[0]);
+		int found = 0;
+
+		while (*text != '\0')
+		{
+			// no sscanf in the enclave libc
+			for (int i = 0; i < no_fields; i++)
+			{
+				std::size_t len = std::strlen(fields[i].key);
+
+				if (std::strncmp(text, fields[i].key, len) == 0 && text[len] == ' ')
+				{
+					*fields[i].value = std::strtod(text + len, nullptr);
+					++found;
+				}
+			}
+
+			// next line
+			while (*text != '\0' && *text != '\n')
+				++text;
+			if (*text == '\n')
+				++text;
+		}
+
+		return found == no_fields;
+	}
+
+	int adaptive_factory::dump_model(const oram_cost_model_t &model, char *text, std::size_t len)
+	{
+		return std::snprintf(text, len,
+							 "bucket_fixed %f\nbucket_byte %f\nscan_fixed %f\nscan_byte %f\nthread_sync %f\n",
+							 model.bucket_fixed, model.bucket_byte, model.scan_fixed, model.scan_byte, model.thread_sync);
+	}
+
+#ifndef SGX_ENCLAVE_ENABLED
+
+	bool adaptive_factory::load_model(const char *path, oram_cost_model_t &model)
+	{
+		char text[1024];
+		FILE *fp = std::fopen(path, "r");
+
+		if (fp == nullptr)
+			return false;
+
+		std::size_t len = std::fread(text, 1, sizeof(text) - 1, fp);
+		std::fclose(fp);
+		text[len] = '\0';
+
+		return parse_model(text, model);
+	}
+
+	bool adaptive_factory::save_model(const char *path, const oram_cost_model_t &model)
+	{
+		char text[1024];
+		FILE *fp = std::fopen(path, "w");
+
+		if (fp == nullptr)
+			return false;
+
+		int len = dump_model(model, text, sizeof(text));
+		bool ok = std::fwrite(text, 1, len, fp) == (std::size_t)len;
+		std::fclose(fp);
+
+		return ok;
+	}
+
+	// average ns per access over a warm ORAM
+	static double time_engine(tree_oram *o, std::size_t N, std::size_t B, int accesses)
+	{
+		std::uint8_t buff[B];
+		leaf_id *map = new leaf_id[N];
+
+		for (std::size_t i = 0; i < N; i++)
+		{
+			gen_rand((std::uint8_t *)&map[i], sizeof(leaf_id));
+			gen_rand(buff, B);
+			o->write(i, buff, map[i]);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (int a = 0; a < accesses; a++)
+		{
+			std::uint32_t bid;
+			leaf_id next;
+
+			gen_rand((std::uint8_t *)&bid, sizeof(bid));
+			gen_rand((std::uint8_t *)&next, sizeof(leaf_id));
+			bid %= N;
+
+			o->access(bid, map[bid], nullptr, buff, next);
+			map[bid] = next;
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		delete[] map;
+
+		return std::chrono::duration<double, std::nano>(end - start).count() / accesses;
+	}
+
+	bool adaptive_factory::calibrate(oram_cost_model_t &model)
+	{
+		const std::size_t tree_N = 1 << 10;
+		const std::size_t lin_N = 1 << 8;
+		const std::size_t small_B = 8, large_B = 2048;
+		const int accesses = 512;
+		tree_oram *o;
+		double t_small, t_large;
+
+		// linear ORAM: N * (scan_fixed + scan_byte * blk)
+		o = new linear_oram(lin_N, small_B);
+		t_small = time_engine(o, lin_N, small_B, accesses) / lin_N;
+		delete o;
+
+		o = new linear_oram(lin_N, large_B);
+		t_large = time_engine(o, lin_N, large_B, accesses) / lin_N;
+		delete o;
+
+		double blk_small = pad_bytes(small_B + BLOCK_HEADER, 8);
+		double blk_large = pad_bytes(large_B + BLOCK_HEADER, 8);
+
+		model.scan_byte = (t_large - t_small) / (blk_large - blk_small);
+		model.scan_fixed = t_small - model.scan_byte * blk_small;
+
+		// circuit ORAM, Z = 3: subtract the stash scans and solve for the bucket constants
+		unsigned int Z = 3, S = 8;
+		double levels = __builtin_ctzll(tree_N) + 1;
+
+		o = new circuit_oram(tree_N, small_B, Z, S);
+		t_small = time_engine(o, tree_N, small_B, accesses);
+		delete o;
+
+		o = new circuit_oram(tree_N, large_B, Z, S);
+		t_large = time_engine(o, tree_N, large_B, accesses);
+		delete o;
+
+		t_small = (t_small - CIRCUIT_SCANS * S * (model.scan_fixed + model.scan_byte * blk_small)) / (CIRCUIT_PASSES * levels);
+		t_large = (t_large - CIRCUIT_SCANS * S * (model.scan_fixed + model.scan_byte * blk_large)) / (CIRCUIT_PASSES * levels);
+
+		model.bucket_byte = (t_large - t_small) / (Z * (blk_large - blk_small));
+		model.bucket_fixed = t_small - model.bucket_byte * Z * blk_small;
+
+		// MOSE: whatever exceeds the prediction of its slices is synchronization
+		unsigned int T = 4;
+
+		o = new mose(tree_N, large_B, Z, S, T);
+		t_large = time_engine(o, tree_N, large_B, accesses);
+		delete o;
+
+		model.thread_sync = (t_large - circuit_latency(model, tree_N, large_B / T, Z, S)) / T;
+
+		// noise may push some constant below zero
+		model.bucket_fixed = model.bucket_fixed < 0 ? 0 : model.bucket_fixed;
+		model.bucket_byte = model.bucket_byte < 0 ? 0 : model.bucket_byte;
+		model.scan_fixed = model.scan_fixed < 0 ? 0 : model.scan_fixed;
+		model.scan_byte = model.scan_byte < 0 ? 0 : model.scan_byte;
+		model.thread_sync = model.thread_sync < 0 ? 0 : model.thread_sync;
+
+		return true;
+	}
+
+#else
+
+	bool adaptive_factory::calibrate(oram_cost_model_t &model)
+	{
+		// no trusted time source in the enclave
+		return false;
+	}
+
+#endif
+
+} // namespace obl
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "obl/oram.h"
+#include "obl/adaptive_factory.h"
+#include "obl/primitives.h"
+
+// helpers for std::chrono which is INSANE!!!
+using hres = std::chrono::high_resolution_clock;
+using nano = std::chrono::nanoseconds;
+
+const int bench_size = 256;
+const char *engine_names[] = {"linear", "circuit", "mose"};
+
+double measure(obl::tree_oram *rram, std::size_t N, std::size_t B)
+{
+	std::vector<obl::leaf_id> map(N);
+	std::vector<std::uint8_t> buff(B);
+
+	for (std::size_t i = 0; i < N; i++)
+	{
+		obl::gen_rand((std::uint8_t *)&map[i], sizeof(obl::leaf_id));
+		rram->write(i, buff.data(), map[i]);
+	}
+
+	auto start = hres::now();
+
+	for (int i = 0; i < bench_size; i++)
+	{
+		unsigned int bid;
+		obl::leaf_id next;
+
+		obl::gen_rand((std::uint8_t *)&bid, sizeof(bid));
+		obl::gen_rand((std::uint8_t *)&next, sizeof(obl::leaf_id));
+		bid %= N;
+
+		rram->access(bid, map[bid], nullptr, buff.data(), next);
+		map[bid] = next;
+	}
+
+	nano elapsed = hres::now() - start;
+
+	return elapsed.count() / (double)bench_size;
+}
+
+// usage: adaptive_bench [calibration file]
+// loads the model if the file exists, otherwise calibrates and saves it there
+int main(int argc, char **argv)
+{
+	obl::oram_cost_model_t model;
+
+	if (argc < 2 || !obl::adaptive_factory::load_model(argv[1], model))
+	{
+		obl::adaptive_factory::calibrate(model);
+
+		if (argc >= 2)
+			obl::adaptive_factory::save_model(argv[1], model);
+	}
+
+	char text[512];
+	obl::adaptive_factory::dump_model(model, text, sizeof(text));
+	std::cerr << text;
+
+	std::cout << "N,B,engine,Z,S,T,predicted,measured" << std::endl;
+
+	for (std::size_t B : {8, 64, 1024, 4096})
+	{
+		obl::adaptive_factory probe(model, (std::size_t)-1, 8);
+		std::cerr << "linear cutoff for B=" << B << ": " << probe.linear_cutoff(B) << std::endl;
+
+		for (int p = 6; p <= 14; p += 4)
+		{
+			std::size_t N = 1 << p;
+			// fresh budgets for every point
+			obl::adaptive_factory of(model, (std::size_t)-1, 8);
+			obl::oram_shape_t s = of.choose(N, B);
+
+			obl::tree_oram *rram = of.spawn_oram(N, B);
+			double measured = measure(rram, N, B);
+			delete rram;
+
+			std::cout << N << "," << B << "," << engine_names[s.engine] << "," << s.Z << "," << s.S << "," << s.T << ","
+					  << (std::int64_t)s.latency << "," << (std::int64_t)measured << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include "obl/oram.h"
+#include "obl/linear.h"
+#include "obl/circuit.h"
+#include "obl/primitives.h"
+
+// helpers for std::chrono which is INSANE!!!
+using hres = std::chrono::high_resolution_clock;
+using nano = std::chrono::nanoseconds;
+
+const int bench_size = 1024;
+
+// circuit ORAM parameters of the default subtol configuration
+const unsigned int Z = 3;
+const unsigned int S = 8;
+
+double measure(obl::tree_oram *rram, std::size_t N, std::size_t B)
+{
+	std::vector<obl::leaf_id> map(N);
+	std::vector<std::uint8_t> buff(B);
+
+	for (std::size_t i = 0; i < N; i++)
+	{
+		obl::gen_rand((std::uint8_t *)&map[i], sizeof(obl::leaf_id));
+		rram->write(i, buff.data(), map[i]);
+	}
+
+	auto start = hres::now();
+
+	for (int i = 0; i < bench_size; i++)
+	{
+		unsigned int bid;
+		obl::leaf_id next;
+
+		obl::gen_rand((std::uint8_t *)&bid, sizeof(bid));
+		obl::gen_rand((std::uint8_t *)&next, sizeof(obl::leaf_id));
+		bid %= N;
+
+		rram->access(bid, map[bid], nullptr, buff.data(), next);
+		map[bid] = next;
+	}
+
+	nano elapsed = hres::now() - start;
+
+	return elapsed.count() / (double)bench_size;
+}
+
+// linear vs circuit ORAM access time, and the largest N where linear still wins
+// (this is the linear_break_even threshold of opt_allocator)
+int main()
+{
+	std::cout << "N,B,linear,circuit" << std::endl;
+
+	for (std::size_t B : {8, 16, 32, 64, 256, 1024})
+	{
+		std::size_t break_even = 0;
+
+		for (std::size_t N = 16; N <= 4096; N <<= 1)
+		{
+			obl::tree_oram *rram = new obl::linear_oram(N, B);
+			double linear = measure(rram, N, B);
+			delete rram;
+
+			rram = new obl::circuit_oram(N, B, Z, S);
+			double circuit = measure(rram, N, B);
+			delete rram;
+
+			if (linear < circuit)
+				break_even = N;
+
+			std::cout << N << "," << B << "," << (std::int64_t)linear << "," << (std::int64_t)circuit << std::endl;
+		}
+
+		std::cerr << "break even for B=" << B << ": " << break_even << std::endl;
+	}
+
+	return 0;
+}
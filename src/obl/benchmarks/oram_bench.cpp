@@ -11,6 +11,7 @@
 #include "obl/so_circuit.h"
 #include "obl/taostore_circuit_1.h"
 #include "obl/linear.h"
+#include "obl/huge_allocator.h"
 
 #include "obl/primitives.h"
 
@@ -83,6 +84,12 @@ int main()
 		test_oram("circuit", rram, mirror_data, position_map);
 		delete rram;
 
+		// circuit oram on huge pages (1 GB, then 2 MB, then THP, whatever the host grants)
+		rram = new obl::circuit_oram(N, sizeof(std::int64_t), 3, 8, obl::HUGE_1G);
+		std::cerr << "circuit_huge page size " << ((obl::circuit_oram *)rram)->tree_page_size() << std::endl;
+		test_oram("circuit_huge", rram, mirror_data, position_map);
+		delete rram;
+
 		// so circuit oram
 		// rram = new obl::so_circuit_oram(N, sizeof(std::int64_t), 3, 8);
 		// test_oram("so_circuit", rram, mirror_data, position_map);
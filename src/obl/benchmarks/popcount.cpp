@@ -8,6 +8,7 @@
 #include <cassert>
 
 #include "obl/primitives.h"
+#include "obl/bitslice.h"
 
 const int runs = 32;
 
@@ -20,6 +21,13 @@ using tt = std::chrono::time_point<hres, nano>;
 
 int rank(std::uint64_t*, std::size_t, int, int);
 int simple_popcount(std::uint64_t*, std::size_t);
+int packed_rank(std::uint16_t*, int, int, std::int16_t, int);
+void bitslice_bench(std::vector<nano>&);
+
+// vbwt sampling windows: enc_bit-wide symbols, from 2^min_rate to 2^max_rate of them
+const int enc_bit = 3;
+const int min_rate = 6;
+const int max_rate = 14;
 
 int main()
 {
@@ -66,20 +74,113 @@ int main()
 		for(int i = 0; i < runs; i++)
 		{
 			tt st = hres::now();
-			volatile int res = simple_popcount((std::uint64_t*) v, S >> 3);
+			int res = simple_popcount((std::uint64_t*) v, S >> 3);
 			tt nd = hres::now();
 
 			benchmarks[i] = nd - st;
+
+			// 0xAA has four bits set
+			assert(res == (int) S * 4);
 		}
 
 		for(int i = 0; i < runs; i++)
 			std::cout << "popcountll," << S << "," << benchmarks[i].count() << std::endl;
 	}
 
+	bitslice_bench(benchmarks);
+
 	delete[] v;
 	return 0;
 }
 
+// partial rank over a vbwt window, packed (former layout) vs bit-sliced
+void bitslice_bench(std::vector<nano> &benchmarks)
+{
+	const int alpha = (1 << enc_bit) - 1;
+
+	for(int r = min_rate; r <= max_rate; r++)
+	{
+		int s_rate = 1 << r;
+		unsigned int words = obl::bitslice_words(s_rate);
+
+		std::vector<std::uint16_t> packed((s_rate * enc_bit) / 16 + 1, 0);
+		std::vector<std::uint64_t> planes(enc_bit * words, 0);
+
+		for(int i = 0; i < s_rate; i++)
+		{
+			std::uint64_t c = rand() % alpha;
+			int bit = i * enc_bit;
+
+			packed[bit / 16] |= c << (bit % 16);
+			if(bit % 16 + enc_bit > 16)
+				packed[bit / 16 + 1] |= c >> (16 - bit % 16);
+
+			for(int b = 0; b < enc_bit; b++)
+				planes[b * words + i / 64] |= ((c >> b) & 1) << (i % 64);
+		}
+
+		std::int16_t target = rand() % alpha;
+		int limit = rand() % s_rate;
+		int expected = packed_rank(packed.data(), limit, s_rate, target, enc_bit);
+
+		for(int i = 0; i < runs; i++)
+		{
+			tt st = hres::now();
+			int res = packed_rank(packed.data(), limit, s_rate, target, enc_bit);
+			tt nd = hres::now();
+
+			benchmarks[i] = nd - st;
+
+			assert(res == expected);
+		}
+
+		for(int i = 0; i < runs; i++)
+			std::cout << "packed_rank," << s_rate << "," << benchmarks[i].count() << std::endl;
+
+		for(int i = 0; i < runs; i++)
+		{
+			tt st = hres::now();
+			int res = obl::bitslice_rank(planes.data(), words, enc_bit, target, limit);
+			tt nd = hres::now();
+
+			benchmarks[i] = nd - st;
+
+			assert(res == expected);
+		}
+
+		for(int i = 0; i < runs; i++)
+			std::cout << "bitslice_rank," << s_rate << "," << benchmarks[i].count() << std::endl;
+	}
+}
+
+// former vbwt kernel: one symbol at a time, across the whole window
+int __attribute__((noinline)) packed_rank(std::uint16_t *ch, int limit, int sample_rate, std::int16_t target, int enc_bit)
+{
+	int p_rank = 0;
+
+	int hword = 0;
+	int shift_right = 0;
+	std::uint16_t mask = (1 << enc_bit) - 1;
+
+	for(int i = 0; i < sample_rate; i++)
+	{
+		std::uint16_t current = (ch[hword] >> shift_right) & mask;
+
+		shift_right += enc_bit;
+		if(shift_right > 16)
+		{
+			++hword;
+			shift_right -= 16;
+			current = current | (ch[hword] << (enc_bit - shift_right));
+			current = current & mask;
+		}
+
+		p_rank += obl::ternary_op((current == target) & (i < limit), 1, 0);
+	}
+
+	return p_rank;
+}
+
 // avoid inlining to take into account function call latency
 int __attribute__((noinline)) simple_popcount(std::uint64_t *v, std::size_t S)
 {
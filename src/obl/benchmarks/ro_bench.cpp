@@ -0,0 +1,99 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "obl/oram.h"
+#include "obl/circuit.h"
+#include "obl/ro_circuit.h"
+
+#include "obl/primitives.h"
+
+/*
+	Compare standard circuit ORAM against the read-optimized variant on a
+	read-only workload (load once, then only access(..., nullptr, ...)),
+	which is the access pattern of the SA/BWT/PSI indexes after load_*.
+	Output is CSV: name,N,time(ns) per access
+*/
+
+using hres = std::chrono::high_resolution_clock;
+using nano = std::chrono::nanoseconds;
+using tt = std::chrono::time_point<hres, nano>;
+
+const int pow_lower = 16;
+const int pow_upper = 23;
+const int bench_size = 1024;
+
+void test_oram(std::string, obl::tree_oram *, std::vector<std::int64_t> &, std::vector<obl::leaf_id> &);
+
+int main()
+{
+	std::vector<std::int64_t> mirror_data;
+	std::vector<obl::leaf_id> position_map;
+
+	mirror_data.resize(1 << pow_upper);
+	position_map.resize(1 << pow_upper);
+
+	for (int i = 0; i < (1 << pow_upper); i++)
+	{
+		std::int64_t val;
+		obl::gen_rand((std::uint8_t *)&val, sizeof(std::int64_t));
+		mirror_data[i] = val;
+	}
+
+	for (int p = pow_lower; p < pow_upper; p++)
+	{
+		std::size_t N = 1 << p;
+		obl::tree_oram *rram;
+
+		rram = new obl::circuit_oram(N, sizeof(std::int64_t), 3, 8);
+		test_oram("circuit", rram, mirror_data, position_map);
+		delete rram;
+
+		rram = new obl::ro_circuit_oram(N, sizeof(std::int64_t), 3, obl::ro_circuit_min_stash(3));
+		test_oram("ro_circuit", rram, mirror_data, position_map);
+		delete rram;
+	}
+}
+
+void test_oram(std::string oname, obl::tree_oram *rram, std::vector<std::int64_t> &data, std::vector<obl::leaf_id> &map)
+{
+	std::vector<nano> times(bench_size);
+	std::size_t N = rram->get_N();
+
+	for (unsigned int i = 0; i < N; i++)
+	{
+		obl::leaf_id next_leef;
+		obl::gen_rand((std::uint8_t *)&next_leef, sizeof(obl::leaf_id));
+
+		rram->write(i, (std::uint8_t *)&data[i], next_leef);
+		map[i] = next_leef;
+	}
+
+	for (int i = 0; i < bench_size; i++)
+	{
+		std::int64_t value_out;
+		obl::leaf_id next_leef;
+		unsigned int rnd_bid;
+
+		obl::gen_rand((std::uint8_t *)&next_leef, sizeof(obl::leaf_id));
+		obl::gen_rand((std::uint8_t *)&rnd_bid, sizeof(obl::block_id));
+
+		rnd_bid = (rnd_bid >> 1) % N;
+
+		tt start = hres::now();
+		rram->access(rnd_bid, map[rnd_bid], nullptr, (std::uint8_t *)&value_out, next_leef);
+		tt end = hres::now();
+
+		assert(value_out == data[rnd_bid]);
+
+		times[i] = end - start;
+		map[rnd_bid] = next_leef;
+	}
+
+	for (int i = 0; i < bench_size; i++)
+		std::cout << oname << "," << N << "," << times[i].count() << std::endl;
+
+	std::cerr << oname << " tested for " << N << std::endl;
+}
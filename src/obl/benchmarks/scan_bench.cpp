@@ -0,0 +1,109 @@
+#include "obl/primitives.h"
+#include "obl/scan.h"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+
+using hres = std::chrono::high_resolution_clock;
+using nano = std::chrono::nanoseconds;
+using tt = std::chrono::time_point<hres, nano>;
+
+// calls per measurement, over tables of each size
+const int calls = 1 << 20;
+const unsigned int sizes[] = {5, 16, 26, 64, 128, 256, 1024};
+
+// former scalar kernels: one ternary_op (cmov) per entry
+std::int32_t __attribute__((noinline)) scalar_select(const std::int32_t *v, unsigned int n, std::int32_t idx)
+{
+	std::int32_t ret = -1;
+
+	for(unsigned int i = 0; i < n; i++)
+		ret = obl::ternary_op((std::int32_t) i == idx, v[i], ret);
+
+	return ret;
+}
+
+std::uint32_t __attribute__((noinline)) scalar_prefix_sum(const std::int32_t *v, unsigned int n, std::uint32_t idx)
+{
+	std::uint32_t ret = 0;
+
+	for(unsigned int i = 0; i < n; i++)
+		ret += obl::ternary_op(i < idx, v[i], 0);
+
+	return ret;
+}
+
+std::int32_t __attribute__((noinline)) scalar_update(std::int32_t *v, unsigned int n, std::int32_t idx, std::int32_t replacement, bool to_init, bool write)
+{
+	std::int32_t ret = -1;
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		std::int32_t tmp = v[i];
+
+		ret = obl::ternary_op((std::int32_t) i == idx, tmp, ret);
+		tmp = obl::ternary_op(to_init, -1, tmp);
+		v[i] = obl::ternary_op(((std::int32_t) i == idx) & write, replacement, tmp);
+	}
+
+	return ret;
+}
+
+template<typename F>
+double time_calls(F f)
+{
+	tt st = hres::now();
+
+	for(int c = 0; c < calls; c++)
+		f(c);
+
+	tt nd = hres::now();
+
+	return (double)(nd - st).count() / calls;
+}
+
+int main()
+{
+	std::cout << "kernel,n,scalar,simd\n";
+
+	for(unsigned int n : sizes)
+	{
+		std::vector<std::int32_t> v(n), w(n);
+		std::vector<std::int32_t> idx(1024);
+
+		for(unsigned int i = 0; i < n; i++)
+			v[i] = w[i] = rand() % 1000;
+
+		// out of range indices included, like dummy characters
+		for(unsigned int i = 0; i < idx.size(); i++)
+			idx[i] = rand() % (n + 2);
+
+		for(unsigned int i = 0; i < idx.size(); i++)
+		{
+			assert(scalar_select(v.data(), n, idx[i]) == obl::scan_select(v.data(), n, idx[i]));
+			assert(scalar_prefix_sum(v.data(), n, idx[i]) == obl::scan_prefix_sum(v.data(), n, idx[i]));
+			assert(scalar_update(v.data(), n, idx[i], i, false, i & 1) == obl::scan_update(w.data(), n, idx[i], i, false, i & 1));
+			assert(v == w);
+		}
+
+		volatile std::int64_t sink = 0;
+
+		double s = time_calls([&](int c) { sink += scalar_select(v.data(), n, idx[c & 1023]); });
+		double o = time_calls([&](int c) { sink += obl::scan_select(v.data(), n, idx[c & 1023]); });
+		std::cout << "select," << n << "," << s << "," << o << std::endl;
+
+		s = time_calls([&](int c) { sink += scalar_prefix_sum(v.data(), n, idx[c & 1023]); });
+		o = time_calls([&](int c) { sink += obl::scan_prefix_sum(v.data(), n, idx[c & 1023]); });
+		std::cout << "prefix_sum," << n << "," << s << "," << o << std::endl;
+
+		s = time_calls([&](int c) { sink += scalar_update(v.data(), n, idx[c & 1023], c, false, true); });
+		o = time_calls([&](int c) { sink += obl::scan_update(w.data(), n, idx[c & 1023], c, false, true); });
+		std::cout << "update," << n << "," << s << "," << o << std::endl;
+	}
+
+	return 0;
+}
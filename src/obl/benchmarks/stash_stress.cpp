@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "obl/oram.h"
+#include "obl/circuit.h"
+#include "obl/ro_circuit.h"
+
+#include "obl/primitives.h"
+
+/*
+	Stash overflow stress test for the deterministic reverse-lexicographic eviction.
+	Every engine is instantiated with an oversized stash, then hammered with random
+	accesses while recording the stash occupancy after each access. The block fetched
+	by the next access is inserted before the evictions run, so the smallest safe S is
+	the peak occupancy + 1.
+	Output is CSV: name,Z,N,accesses,peak,safe_S
+*/
+
+const int pow_lower = 12;
+const int pow_upper = 16;
+const unsigned int stress_stash = 128;
+const std::uint64_t access_mult = 16;
+
+void stress_oram(std::string, unsigned int, obl::circuit_oram *);
+
+int main()
+{
+	for (int p = pow_lower; p <= pow_upper; p += 2)
+	{
+		std::size_t N = 1 << p;
+
+		for (unsigned int Z = 2; Z <= 4; Z++)
+		{
+			obl::circuit_oram *rram;
+
+			rram = new obl::circuit_oram(N, sizeof(std::int64_t), Z, stress_stash);
+			stress_oram("circuit", Z, rram);
+			delete rram;
+
+			rram = new obl::ro_circuit_oram(N, sizeof(std::int64_t), Z, stress_stash);
+			stress_oram("ro_circuit", Z, rram);
+			delete rram;
+		}
+	}
+}
+
+void stress_oram(std::string oname, unsigned int Z, obl::circuit_oram *rram)
+{
+	std::size_t N = rram->get_N();
+	std::vector<obl::leaf_id> map(N);
+	std::uint64_t accesses = access_mult * N;
+	unsigned int peak = 0;
+
+	for (unsigned int i = 0; i < N; i++)
+	{
+		std::int64_t value = i;
+		obl::leaf_id next_leef;
+		obl::gen_rand((std::uint8_t *)&next_leef, sizeof(obl::leaf_id));
+
+		rram->write(i, (std::uint8_t *)&value, next_leef);
+		map[i] = next_leef;
+
+		unsigned int occ = rram->stash_occupancy();
+		peak = occ > peak ? occ : peak;
+	}
+
+	for (std::uint64_t i = 0; i < accesses; i++)
+	{
+		std::int64_t value_out;
+		obl::leaf_id next_leef;
+		unsigned int rnd_bid;
+
+		obl::gen_rand((std::uint8_t *)&next_leef, sizeof(obl::leaf_id));
+		obl::gen_rand((std::uint8_t *)&rnd_bid, sizeof(obl::block_id));
+		rnd_bid = (rnd_bid >> 1) % N;
+
+		rram->access(rnd_bid, map[rnd_bid], nullptr, (std::uint8_t *)&value_out, next_leef);
+		map[rnd_bid] = next_leef;
+
+		assert(value_out == rnd_bid);
+
+		unsigned int occ = rram->stash_occupancy();
+		peak = occ > peak ? occ : peak;
+	}
+
+	std::cout << oname << "," << Z << "," << N << "," << accesses << "," << peak << "," << peak + 1 << std::endl;
+	std::cerr << oname << " Z=" << Z << " stressed for " << N << std::endl;
+}
@@ -5,6 +5,7 @@
 #include "obl/taostore_circuit_2_p.h"
 #include "obl/shadow_mose.h"
 #include "obl/taostore_factory.hpp"
+#include "obl/numa_factory.hpp"
 #include "obl/path.h"
 #include "obl/rec.h"
 #include "obl/rec_standard.h"
@@ -255,6 +256,13 @@ int main()
     //     delete rram;
     // }
     // {
+    //     // position map levels round robin over nodes, mose slices spread with their workers
+    //     obl::numa_factory of(new obl::mose_factory(3, 8, 4), {obl::NUMA_SPREAD, 0, 4});
+    //     rram = new obl::recursive_oram_standard(N, sizeof(buffer), 5, &of);
+    //     parallel_test("rec_mose_numa", rram);
+    //     delete rram;
+    // }
+    // {
     //     obl::shadow_mose_factory of(3, 8, 12, 2);
     //     sram = new obl::shadow_mose(N, sizeof(buffer), 6, &of);
     //     parallel_test("shadow_mose", sram);
@@ -0,0 +1,94 @@
+#include "obl/bitslice.h"
+#include "obl/primitives.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace obl
+{
+	static inline std::uint64_t match_word(const std::uint64_t *planes, unsigned int words, unsigned int enc_bit, std::uint64_t target, unsigned int w)
+	{
+		std::uint64_t eq = ~0ULL;
+
+		for(unsigned int b = 0; b < enc_bit; b++)
+		{
+			std::uint64_t t = 0 - ((target >> b) & 1);
+			eq &= ~(planes[b * words + w] ^ t);
+		}
+
+		return eq;
+	}
+
+#ifdef __AVX2__
+
+	// per-byte popcount through a nibble lookup, summed into the four 64-bit lanes
+	static inline __m256i popcount_epi64(__m256i v)
+	{
+		const __m256i lut = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		const __m256i low = _mm256_set1_epi8(0x0F);
+
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+
+		return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+	}
+
+	int bitslice_rank(const std::uint64_t *planes, unsigned int words, unsigned int enc_bit, std::uint64_t target, unsigned int limit)
+	{
+		const __m256i ones = _mm256_set1_epi64x(-1);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i sixty_four = _mm256_set1_epi64x(64);
+		const __m256i step = _mm256_set1_epi64x(4 * 64);
+
+		// remaining symbols at the beginning of each of the four words
+		__m256i rem = _mm256_sub_epi64(_mm256_set1_epi64x(limit), _mm256_setr_epi64x(0, 64, 128, 192));
+		__m256i acc = zero;
+		unsigned int w = 0;
+
+		for(; w + 4 <= words; w += 4)
+		{
+			__m256i eq = ones;
+
+			for(unsigned int b = 0; b < enc_bit; b++)
+			{
+				__m256i t = _mm256_set1_epi64x(0 - ((target >> b) & 1));
+				__m256i p = _mm256_loadu_si256((const __m256i *)(planes + b * words + w));
+				eq = _mm256_andnot_si256(_mm256_xor_si256(p, t), eq);
+			}
+
+			// variable shifts by 64 or more yield 0, so only full words need clamping
+			__m256i count = _mm256_sub_epi64(sixty_four, rem);
+			count = _mm256_blendv_epi8(count, zero, _mm256_cmpgt_epi64(zero, count));
+			__m256i mask = _mm256_srlv_epi64(ones, count);
+
+			acc = _mm256_add_epi64(acc, popcount_epi64(_mm256_and_si256(eq, mask)));
+			rem = _mm256_sub_epi64(rem, step);
+		}
+
+		__m128i r = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		int res = _mm_cvtsi128_si64(r) + _mm_extract_epi64(r, 1);
+
+		for(; w < words; w++)
+			res += __builtin_popcountll(match_word(planes, words, enc_bit, target, w) & prefix_mask(w, limit));
+
+		return res;
+	}
+
+#else
+
+	int bitslice_rank(const std::uint64_t *planes, unsigned int words, unsigned int enc_bit, std::uint64_t target, unsigned int limit)
+	{
+		int res = 0;
+
+		for(unsigned int w = 0; w < words; w++)
+			res += __builtin_popcountll(match_word(planes, words, enc_bit, target, w) & prefix_mask(w, limit));
+
+		return res;
+	}
+
+#endif
+
+} // namespace obl
@@ -1,6 +1,8 @@
 #include "obl/circuit.h"
+#include "obl/circuit_types.hpp"
 #include "obl/utils.h"
 #include "obl/primitives.h"
+#include "obl/stash_scan.h"
 
 #include "obl/oassert.h"
 
@@ -13,23 +15,13 @@
 namespace obl
 {
 
-	struct circuit_block_t
-	{
-		block_id bid;
-		leaf_id lid;
-		std::uint8_t payload[];
-	};
-
-	struct circuit_bucket_t
-	{
-		obl_aes_gcm_128bit_iv_t iv;
-		bool reach_l, reach_r;
-		obl_aes_gcm_128bit_tag_t mac __attribute__((aligned(8)));
-		// since payload is going to be a multiple of 16 bytes, the struct will be memory aligned!
-		uint8_t payload[];
-	};
-
-	circuit_oram::circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S) : tree_oram(N, B, Z)
+	circuit_oram::circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, huge_page_t huge) : tree_oram(N, B, Z),
+#ifdef SGX_ENCLAVE_ENABLED
+		tree(sgx_host_allocator(huge))
+#else
+		stash_bid(huge_allocator(huge)), stash_lid(huge_allocator(huge)), stash(huge_allocator(huge)),
+		tree(huge_allocator(huge)), fetched_path(huge_allocator(huge))
+#endif
 	{
 		// align structs to 8-bytes
 		/*
@@ -39,13 +31,22 @@ namespace obl
 		block_size = pad_bytes(sizeof(block_t) + this->B, 8);
 		bucket_size = pad_bytes(sizeof(bucket_t) + this->Z * block_size, 8);
 
-		// stash allocation
+		// stash allocation, metadata padded to a multiple of the SIMD width
 		this->S = S;
-		stash.set_entry_size(block_size);
+		S_pad = (S + STASH_LANES - 1) / STASH_LANES * STASH_LANES;
+		payload_size = block_size - sizeof(block_t);
+
+		stash_bid.reserve(S_pad);
+		stash_lid.reserve(S_pad);
+		stash.set_entry_size(payload_size);
 		stash.reserve(this->S);
+		stash_mask = new std::uint64_t[mask_words(S_pad)];
 
-		for (unsigned int i = 0; i < this->S; i++)
-			stash[i].bid = DUMMY;
+		for (unsigned int i = 0; i < S_pad; i++)
+		{
+			stash_bid[i] = i < this->S ? DUMMY : STASH_PAD;
+			stash_lid[i] = 0;
+		}
 
 		// ORAM tree allocation
 		tree.set_entry_size(bucket_size);
@@ -63,6 +64,8 @@ namespace obl
 		// allocate data struct for integrity checking
 		adata = new auth_data_t[L + 1];
 
+		numa.mode = NUMA_OFF;
+
 		init();
 	}
 
@@ -70,7 +73,9 @@ namespace obl
 	{
 		std::memset(_crypt_buffer, 0x00, sizeof(Aes) + 16);
 
-		std::memset(&stash[0], 0x00, block_size * S);
+		std::memset(&stash_bid[0], 0x00, sizeof(block_id) * S_pad);
+		std::memset(&stash_lid[0], 0x00, sizeof(leaf_id) * S_pad);
+		std::memset(&stash[0], 0x00, payload_size * S);
 		std::memset(&fetched_path[0], 0x00, block_size * (L + 1) * Z);
 
 		free(_crypt_buffer);
@@ -78,6 +83,7 @@ namespace obl
 		delete[] longest_jump_down;
 		delete[] closest_src_bucket;
 		delete[] next_dst_bucket;
+		delete[] stash_mask;
 	}
 
 	void circuit_oram::init()
@@ -317,6 +323,52 @@ namespace obl
 		return max_d;
 	}
 
+	void circuit_oram::stash_swap(bool cond, block_t *bl, unsigned int i)
+	{
+		// masked xor swap, inlined since it runs S times per stash scan
+		std::uint32_t m32 = 0 - (std::uint32_t)cond;
+		std::uint64_t m64 = 0 - (std::uint64_t)cond;
+
+		std::uint32_t tb = (bl->bid ^ stash_bid[i]) & m32;
+		std::uint32_t tl = (bl->lid ^ stash_lid[i]) & m32;
+		bl->bid ^= tb;
+		stash_bid[i] ^= tb;
+		bl->lid ^= tl;
+		stash_lid[i] ^= tl;
+
+		// payload_size is a multiple of 8, see block_size
+		std::uint64_t *a = (std::uint64_t *)bl->payload;
+		std::uint64_t *b = (std::uint64_t *)&stash[i];
+
+		for (std::size_t w = 0; w < (payload_size >> 3); w++)
+		{
+			std::uint64_t t = (a[w] ^ b[w]) & m64;
+			a[w] ^= t;
+			b[w] ^= t;
+		}
+	}
+
+	void circuit_oram::stash_extract(block_id bid, block_t *bl)
+	{
+		// at most one entry matches, but all of them are touched
+		stash_match_mask(&stash_bid[0], S_pad, bid, stash_mask);
+
+		for (unsigned int i = 0; i < S; i++)
+			stash_swap(mask_bit(stash_mask, i), bl, i);
+	}
+
+	bool circuit_oram::stash_insert(block_t *bl)
+	{
+		// the first free entry takes the block, the padding is never free
+		stash_match_mask(&stash_bid[0], S_pad, DUMMY, stash_mask);
+		bool inserted = mask_keep_first(stash_mask, mask_words(S_pad));
+
+		for (unsigned int i = 0; i < S; i++)
+			stash_swap(mask_bit(stash_mask, i), bl, i);
+
+		return inserted;
+	}
+
 	void circuit_oram::deepest(leaf_id path)
 	{
 		// allow -1 indexing for stash
@@ -326,7 +378,7 @@ namespace obl
 		std::int64_t closest_src_bucket = -1;
 		std::int64_t goal = -1;
 
-		goal = get_max_depth_bucket(&stash[0], S, path);
+		goal = stash_max_depth(&stash_bid[0], &stash_lid[0], S_pad, path, L);
 		ljd[-1] = goal;
 		csb[-1] = BOTTOM;
 
@@ -391,11 +443,11 @@ namespace obl
 
 		bool fill_hold = ndb[-1] != BOTTOM;
 
+		// every entry is only compared with its own metadata, so the mask can be computed upfront
+		stash_depth_mask(&stash_bid[0], &stash_lid[0], S_pad, path, L, ljd[-1], stash_mask);
+
 		for (unsigned int i = 0; i < S; i++)
-		{
-			bool deepest_block = (get_max_depth(stash[i].lid, path, L) == ljd[-1]) & fill_hold & (stash[i].bid != DUMMY);
-			swap(deepest_block, _hold, (std::uint8_t *)&stash[i], block_size);
-		}
+			stash_swap(mask_bit(stash_mask, i) & fill_hold, hold, i);
 
 		dst = ndb[-1];
 
@@ -452,11 +504,7 @@ namespace obl
 
 		// search for the requested element by traversing the buckets in the stash
 		// -- all of them, in order to avoid leakage in the number of entries in the stash
-		for (unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(bid == sbid, _fetched, (std::uint8_t *)&stash[i], block_size);
-		}
+		stash_extract(bid, fetched);
 
 		fetched->bid = bid;
 		fetched->lid = next_lif;
@@ -468,13 +516,7 @@ namespace obl
 			std::memcpy(fetched->payload, data_in, B);
 
 		// evict the created block to the stash
-		bool already_evicted = false;
-		for (unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(!already_evicted & (sbid == DUMMY), _fetched, (std::uint8_t *)&stash[i], block_size);
-			already_evicted = already_evicted | (sbid == DUMMY);
-		}
+		bool already_evicted = stash_insert(fetched);
 
 		// if this fails, it means that the stash overflowed and you cannot insert any new element!
 		assert(already_evicted);
@@ -485,8 +527,8 @@ namespace obl
 			CIRCUIT ORAM DETERMINISTIC EVICTION
 		*/
 
-		evict(2 * access_counter);
-		evict(2 * access_counter + 1);
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
 
 		// increment the access counter
 		++access_counter;
@@ -511,11 +553,7 @@ namespace obl
 
 		// search for the requested element by traversing the buckets in the stash
 		// -- all of them, in order to avoid leakage in the number of entries in the stash
-		for (unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(bid == sbid, _fetched, (std::uint8_t *)&stash[i], block_size);
-		}
+		stash_extract(bid, fetched);
 
 		std::memcpy(data_out, fetched->payload, B);
 	}
@@ -531,13 +569,7 @@ namespace obl
 		std::memcpy(fetched->payload, data_in, B);
 
 		// evict the created block to the stash
-		bool already_evicted = false;
-		for (unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(!already_evicted & (sbid == DUMMY), _fetched, (std::uint8_t *)&stash[i], block_size);
-			already_evicted = already_evicted | (sbid == DUMMY);
-		}
+		bool already_evicted = stash_insert(fetched);
 
 		// if this fails, it means that the stash overflowed and you cannot insert any new element!
 		assert(already_evicted);
@@ -547,8 +579,8 @@ namespace obl
 		/*
 			CIRCUIT ORAM DETERMINISTIC EVICTION
 		*/
-		evict(2 * access_counter);
-		evict(2 * access_counter + 1);
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
 
 		// increment the access counter
 		++access_counter;
@@ -565,20 +597,106 @@ namespace obl
 		std::memcpy(fetched->payload, data_in, B);
 
 		// evict the created block to the stash
-		bool already_evicted = false;
+		bool already_evicted = stash_insert(fetched);
+
+		assert(already_evicted);
+
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
+
+		++access_counter;
+	}
+
+	unsigned int circuit_oram::stash_occupancy()
+	{
+		unsigned int occ = 0;
+
+		// always scan the whole stash
 		for (unsigned int i = 0; i < S; i++)
+			occ += stash_bid[i] != DUMMY;
+
+		return occ;
+	}
+
+	void circuit_oram::numa_bind(const numa_policy_t &policy)
+	{
+		numa = policy;
+
+		if (policy.mode == NUMA_OFF)
+			return;
+
+		// interleave the top levels, which every thread crosses on each access
+		int top = policy.interleave_levels > L + 1 ? L + 1 : policy.interleave_levels;
+		std::size_t top_buckets = top > 0 ? (1ULL << top) - 1 : 0;
+
+		// hugetlb pages can only be bound whole
+		std::size_t page = tree_page_size();
+
+		if (top_buckets > 0)
+			numa_interleave_memory(&tree[0], top_buckets * bucket_size, page);
+
+		if (top_buckets < capacity)
+			numa_bind_memory(&tree[top_buckets], (capacity - top_buckets) * bucket_size, policy.node, page);
+
+		numa_bind_memory(&stash_bid[0], S_pad * sizeof(block_id), policy.node);
+		numa_bind_memory(&stash_lid[0], S_pad * sizeof(leaf_id), policy.node);
+		numa_bind_memory(&stash[0], S * payload_size, policy.node);
+		numa_bind_memory(&fetched_path[0], (L + 1) * Z * block_size, policy.node);
+	}
+
+	std::size_t circuit_oram::tree_page_size()
+	{
+#ifdef SGX_ENCLAVE_ENABLED
+		return 0; // host memory, not under our control
+#else
+		return tree.get_allocator().page_size();
+#endif
+	}
+
+	bool circuit_oram::grow(std::size_t new_N)
+	{
+		std::uint64_t n_pow = next_two_power(new_N);
+		if (n_pow <= 1)
+			n_pow = 2;
+
+		if (new_N < N)
+			return false;
+
+		N = new_N;
+
+		if (n_pow <= capacity + 1)
+			return true;
+
+		/*
+			In the binary heap layout a new level only appends buckets, so every bucket
+			keeps its index. Leaf ids are drawn on the full leaf_id width, so the blocks
+			already in the tree are still on a prefix of their path and stay valid.
+			Buckets of the old leaf level are stored with both children unreachable,
+			hence the new buckets are never decrypted before an eviction writes them.
+		*/
+		while (capacity + 1 < n_pow)
 		{
-			block_id sbid = stash[i].bid;
-			swap(!already_evicted & (sbid == DUMMY), _fetched, (std::uint8_t *)&stash[i], block_size);
-			already_evicted = already_evicted | (sbid == DUMMY);
+			capacity = (capacity << 1) + 1;
+			++L;
 		}
 
-		assert(already_evicted);
+		tree.reserve(capacity);
+		fetched_path.reserve((L + 1) * Z);
 
-		evict(2 * access_counter);
-		evict(2 * access_counter + 1);
+		delete[] adata;
+		delete[] longest_jump_down;
+		delete[] closest_src_bucket;
+		delete[] next_dst_bucket;
 
-		++access_counter;
+		longest_jump_down = new std::int64_t[L + 2];
+		closest_src_bucket = new std::int64_t[L + 2];
+		next_dst_bucket = new std::int64_t[L + 2];
+		adata = new auth_data_t[L + 1];
+
+		// the reallocated tree lost its memory policy
+		numa_bind(numa);
+
+		return true;
 	}
 
 } // namespace obl
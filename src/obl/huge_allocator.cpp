@@ -0,0 +1,213 @@
+#include "obl/huge_allocator.h"
+
+#ifndef SGX_ENCLAVE_ENABLED
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define HUGE_2M_SHIFT 21
+#define HUGE_1G_SHIFT 30
+
+// in-band header of malloc blocks, as in line_allocator
+#define LINE_SIZE 64
+
+namespace obl
+{
+
+	struct huge_header_t
+	{
+		void *base;		 // start of the mapping or of the posix_memalign block
+		std::size_t len; // length of the mapping, 0 for posix_memalign
+	};
+
+	/*
+		Headers of page-aligned blocks live out of band, so that the payload starts on the
+		(huge) page boundary and a payload of a whole number of pages takes no more.
+	*/
+	static std::mutex mapped_lock;
+
+	// never destroyed, ORAMs may still be released by other static destructors
+	static std::map<void*, huge_header_t> &mapped_blocks()
+	{
+		static std::map<void*, huge_header_t> *mapped = new std::map<void*, huge_header_t>();
+		return *mapped;
+	}
+
+	static std::size_t round_up(std::size_t s, std::size_t pg)
+	{
+		return (s + pg - 1) & ~(pg - 1);
+	}
+
+	static bool thp_available()
+	{
+		char buff[128];
+		FILE *fp = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+
+		if (fp == nullptr)
+			return false;
+
+		bool ok = std::fgets(buff, sizeof(buff), fp) != nullptr;
+		std::fclose(fp);
+
+		return ok && std::strstr(buff, "[never]") == nullptr;
+	}
+
+	static void *map_hugetlb(std::size_t len, int shift)
+	{
+		void *ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+
+		return ptr == MAP_FAILED ? nullptr : ptr;
+	}
+
+	// over-map by 2 MB and trim, so the mapping is huge-page aligned and THP can back it
+	static void *map_thp(std::size_t len)
+	{
+		const std::size_t huge = 1ULL << HUGE_2M_SHIFT;
+		std::uint8_t *raw = (std::uint8_t *)mmap(nullptr, len + huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (raw == MAP_FAILED)
+			return nullptr;
+
+		std::uint8_t *aligned = (std::uint8_t *)round_up((std::uintptr_t)raw, huge);
+
+		if (aligned != raw)
+			munmap(raw, aligned - raw);
+		if (aligned + len != raw + len + huge)
+			munmap(aligned + len, (raw + len + huge) - (aligned + len));
+
+		if (madvise(aligned, len, MADV_HUGEPAGE) != 0)
+		{
+			munmap(aligned, len);
+			return nullptr;
+		}
+
+		return aligned;
+	}
+
+} // namespace obl
+
+huge_allocator::huge_allocator(obl::huge_page_t mode)
+{
+	this->mode = mode;
+	pg_size = sysconf(_SC_PAGESIZE);
+}
+
+void *huge_allocator::allocate(std::size_t s)
+{
+	using namespace obl;
+
+	// plain malloc, 64-byte aligned with the original pointer right before the block
+	if (mode == HUGE_OFF)
+	{
+		std::uint8_t *raw = (std::uint8_t *)std::malloc(s + LINE_SIZE + sizeof(void *));
+
+		if (raw == nullptr)
+			return nullptr;
+
+		std::uint8_t *aligned = (std::uint8_t *)(((std::uintptr_t)raw + sizeof(void *) + LINE_SIZE - 1) & ~(std::uintptr_t)(LINE_SIZE - 1));
+		((void **)aligned)[-1] = raw;
+		pg_size = sysconf(_SC_PAGESIZE);
+
+		return aligned;
+	}
+
+	/*
+		Otherwise the payload gets pages of its own: it starts on a page boundary and is
+		padded to the next one, so that numa_bind_memory can bind it whole without moving
+		anybody else's data.
+	*/
+	std::size_t page = sysconf(_SC_PAGESIZE);
+	std::size_t total = round_up(s == 0 ? 1 : s, page);
+	std::uint8_t *base = nullptr;
+	std::size_t len = 0;
+
+	switch (mode)
+	{
+	// small arrays (stash, path buffer) are not worth a whole huge page
+	case HUGE_1G:
+		len = round_up(total, 1ULL << HUGE_1G_SHIFT);
+		base = total >= (1ULL << HUGE_1G_SHIFT) ? (std::uint8_t *)map_hugetlb(len, HUGE_1G_SHIFT) : nullptr;
+		if (base != nullptr)
+		{
+			pg_size = 1ULL << HUGE_1G_SHIFT;
+			break;
+		}
+		// fall through
+	case HUGE_2M:
+		len = round_up(total, 1ULL << HUGE_2M_SHIFT);
+		base = total >= (1ULL << HUGE_2M_SHIFT) ? (std::uint8_t *)map_hugetlb(len, HUGE_2M_SHIFT) : nullptr;
+		if (base != nullptr)
+		{
+			pg_size = 1ULL << HUGE_2M_SHIFT;
+			break;
+		}
+		// fall through
+	case HUGE_THP:
+		if (total >= (1ULL << HUGE_2M_SHIFT) && thp_available())
+		{
+			len = round_up(total, 1ULL << HUGE_2M_SHIFT);
+			base = (std::uint8_t *)map_thp(len);
+			if (base != nullptr)
+			{
+				pg_size = 1ULL << HUGE_2M_SHIFT;
+				break;
+			}
+		}
+		// fall through
+	default:
+		len = 0;
+		if (posix_memalign((void **)&base, page, total) != 0)
+			base = nullptr;
+		pg_size = page;
+	}
+
+	if (base == nullptr)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lck(mapped_lock);
+	mapped_blocks()[base] = {base, len};
+
+	return base;
+}
+
+void huge_allocator::deallocate(void *ptr)
+{
+	if (ptr == nullptr)
+		return;
+
+	obl::huge_header_t hdr = {nullptr, 0};
+
+	{
+		std::lock_guard<std::mutex> lck(obl::mapped_lock);
+		std::map<void*, obl::huge_header_t> &mapped = obl::mapped_blocks();
+		auto it = mapped.find(ptr);
+
+		if (it != mapped.end())
+		{
+			hdr = it->second;
+			mapped.erase(it);
+		}
+	}
+
+	// not page aligned: a malloc block with its header in band
+	if (hdr.base == nullptr)
+		std::free(((void **)ptr)[-1]);
+	else if (hdr.len == 0)
+		std::free(hdr.base);
+	else
+		munmap(hdr.base, hdr.len);
+}
+
+#endif
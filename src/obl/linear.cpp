@@ -1,119 +1,203 @@
 #include "obl/linear.h"
 #include "obl/primitives.h"
+#include "obl/stash_scan.h"
+#include "obl/utils.h"
+
+#include <cstring>
+#include <cstdlib>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #define DUMMY -1
+// matches neither a block, a free slot (DUMMY) nor padding (STASH_PAD)
+#define NO_MATCH -3
+
+#define LINE_SIZE 64
+#define SLOT_ALIGN 32
 
 #include "obl/oassert.h"
 
 namespace obl {
-	
-	struct linear_block_t {
-		block_id bid;
-		std::uint8_t payload[];
-	};
-	
-	linear_oram::linear_oram(std::size_t N, std::size_t B): tree_oram(N, B, 0)
+
+	void *line_allocator::allocate(std::size_t s)
 	{
-		block_size = sizeof(block_t) + this->B;
-		S = N;
-		
-		stash.set_entry_size(block_size);
-		stash.reserve(S);
+		std::uint8_t *raw = (std::uint8_t*) std::malloc(s + LINE_SIZE + sizeof(void*));
+
+		if(raw == nullptr)
+			return nullptr;
+
+		// keep the original pointer right before the aligned block
+		std::uint8_t *aligned = (std::uint8_t*) (((std::uint64_t) raw + sizeof(void*) + LINE_SIZE - 1) & ~(std::uint64_t)(LINE_SIZE - 1));
+		((void**) aligned)[-1] = raw;
 
-		for(unsigned int i = 0; i < S; i++)
-			stash[i].bid = DUMMY;
+		return aligned;
 	}
-	
-	void linear_oram::access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif)
+
+	void line_allocator::deallocate(void *ptr)
 	{
-		std::uint8_t _fetched[block_size];
-		block_t *fetched = (block_t*) _fetched;
+		std::free(((void**) ptr)[-1]);
+	}
 
-		fetched->bid = DUMMY;
+	// dst = sel ? src : dst, size is a multiple of SLOT_ALIGN
+#ifdef __AVX2__
+	static inline void blend(bool sel, std::uint8_t *dst, const std::uint8_t *src, std::size_t size)
+	{
+		__m256i m = _mm256_set1_epi64x(ternary_op(sel, -1ULL, 0));
 
-		// single scan over the stash
-		for(unsigned int i = 0; i < S; i++)
+		for(std::size_t i = 0; i < size; i += SLOT_ALIGN)
 		{
-			block_id sbid = stash[i].bid;
-			swap(sbid == bid, (std::uint8_t*) &stash[i], _fetched, block_size);
+			__m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+			__m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_blendv_epi8(d, s, m));
 		}
-		
-		std::memcpy(data_out, fetched->payload, B);
+	}
+#else
+	static inline void blend(bool sel, std::uint8_t *dst, const std::uint8_t *src, std::size_t size)
+	{
+		std::uint64_t m = ternary_op(sel, -1ULL, 0);
+		std::uint64_t *d = (std::uint64_t*) dst;
+		const std::uint64_t *s = (const std::uint64_t*) src;
 
-		// assemble block to write into the stash
-		if(data_in != nullptr)
-			std::memcpy(fetched->payload, data_in, B);
+		for(std::size_t i = 0; i < size / sizeof(std::uint64_t); i++)
+			d[i] ^= (d[i] ^ s[i]) & m;
+	}
+#endif
 
-		fetched->bid = bid;
+	linear_oram::linear_oram(std::size_t N, std::size_t B): tree_oram(N, B, 0)
+	{
+		S = N;
+		S_pad = (S + STASH_LANES - 1) / STASH_LANES * STASH_LANES;
+		slot_size = pad_bytes(this->B, SLOT_ALIGN);
 
-		// evict the created block to the stash
-		bool already_evicted = false;
-		for(unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(sbid == DUMMY, _fetched, (std::uint8_t*) &stash[i], block_size);
-			already_evicted = already_evicted | (sbid == DUMMY);
-		}
+		bids.reserve(S_pad);
+		payloads.set_entry_size(slot_size);
+		payloads.reserve(S_pad);
+
+		for(unsigned int i = 0; i < S_pad; i++)
+			bids[i] = i < S ? DUMMY : STASH_PAD;
 
-		assert(already_evicted);
+		std::memset(&payloads[0], 0x00, S_pad * slot_size);
+
+		match_mask = new std::uint64_t[mask_words(S_pad)];
+		free_mask = new std::uint64_t[mask_words(S_pad)];
 	}
 
-	void linear_oram::access_r(block_id bid, leaf_id lif, std::uint8_t *data_out)
+	linear_oram::~linear_oram()
 	{
-		std::uint8_t _fetched[block_size];
-		block_t *fetched = (block_t*) _fetched;
+		delete[] match_mask;
+		delete[] free_mask;
+	}
+
+	/*
+		One pass over the id array finds the block, a second one the first free slot;
+		the write goes to the latter only if the block is missing. Then a single pass
+		over the payloads reads the selected slot and, if data_in is given, overwrites it.
+		bid < 0 (dummy access) selects no slot.
+	*/
+	void linear_oram::scan(block_id bid, std::uint8_t *data_in, std::uint8_t *data_out)
+	{
+		unsigned int words = mask_words(S_pad);
+		bool valid = bid >= 0;
+		std::uint64_t found = 0;
+
+		std::uint8_t in[slot_size];
+		std::uint8_t out[slot_size];
+
+		stash_match_mask(&bids[0], S_pad, ternary_op(valid, bid, NO_MATCH), match_mask);
 
-		fetched->bid = DUMMY;
+		for(unsigned int w = 0; w < words; w++)
+			found |= match_mask[w];
 
-		// single scan over the stash
-		for(unsigned int i = 0; i < S; i++)
+		stash_match_mask(&bids[0], S_pad, DUMMY, free_mask);
+		bool has_free = mask_keep_first(free_mask, words);
+
+		std::uint64_t insert = ternary_op(valid & (found == 0), -1ULL, 0);
+
+		for(unsigned int w = 0; w < words; w++)
+			match_mask[w] |= free_mask[w] & insert;
+
+		std::memset(out, 0x00, slot_size);
+
+		if(data_in != nullptr)
 		{
-			block_id sbid = stash[i].bid;
-			swap(sbid == bid, (std::uint8_t*) &stash[i], _fetched, block_size);
+			// if this fails the ORAM is full and the block cannot be inserted
+			assert(!valid || found != 0 || has_free);
+
+			std::memcpy(in, data_in, B);
+			std::memset(in + B, 0x00, slot_size - B);
+
+			for(unsigned int i = 0; i < S_pad; i++)
+			{
+				bool sel = mask_bit(match_mask, i);
+				std::uint8_t *slot = &payloads[i];
+
+				blend(sel, out, slot, slot_size);
+				blend(sel, slot, in, slot_size);
+				bids[i] = ternary_op(sel, bid, bids[i]);
+			}
+		}
+		else
+		{
+			for(unsigned int i = 0; i < S_pad; i++)
+				blend(mask_bit(match_mask, i), out, &payloads[i], slot_size);
 		}
 
-		std::memcpy(data_out, fetched->payload, B);
+		if(data_out != nullptr)
+			std::memcpy(data_out, out, B);
 	}
 
-	void linear_oram::access_w(block_id bid, leaf_id lif, std::uint8_t *data_in, leaf_id next_lif)
+	void linear_oram::access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif)
 	{
-		std::uint8_t _fetched[block_size];
-		block_t *fetched = (block_t*) _fetched;
-
-		// build the block to write!
-		fetched->bid = bid;
-		std::memcpy(fetched->payload, data_in, B);
+		scan(bid, data_in, data_out);
+	}
 
-		// evict the created block to the stash
-		bool already_evicted = false;
-		for(unsigned int i = 0; i < S; i++)
-		{
-			block_id sbid = stash[i].bid;
-			swap(sbid == DUMMY, _fetched, (std::uint8_t*) &stash[i], block_size);
-			already_evicted = already_evicted | (sbid == DUMMY);
-		}
+	// blocks are updated in place, so the fetch leaves the block where it is
+	void linear_oram::access_r(block_id bid, leaf_id lif, std::uint8_t *data_out)
+	{
+		scan(bid, nullptr, data_out);
+	}
 
-		// if this fails, it means that the stash overflowed and you cannot insert any new element!
-		assert(fetched->bid == DUMMY);
+	void linear_oram::access_w(block_id bid, leaf_id lif, std::uint8_t *data_in, leaf_id next_lif)
+	{
+		scan(bid, data_in, nullptr);
 	}
 
 	void linear_oram::write(block_id bid, std::uint8_t *data_in, leaf_id next_lif)
 	{
-		std::uint8_t _fetched[block_size];
-		block_t *fetched = (block_t*) _fetched;
+		scan(bid, data_in, nullptr);
+	}
+
+	bool linear_oram::grow(std::size_t new_N)
+	{
+		if(new_N < N)
+			return false;
+
+		unsigned int new_S_pad = (new_N + STASH_LANES - 1) / STASH_LANES * STASH_LANES;
+
+		bids.reserve(new_S_pad);
+		payloads.reserve(new_S_pad);
 
-		// build the block to write!
-		fetched->bid = bid;
-		std::memcpy(fetched->payload, data_in, B);
+		// old padding becomes free space
+		for(unsigned int i = S; i < new_S_pad; i++)
+			bids[i] = i < new_N ? DUMMY : STASH_PAD;
 
-		// evict the created block to the stash
-		for(unsigned int i = 0; i < S; i++)
+		std::memset(&payloads[S_pad], 0x00, (new_S_pad - S_pad) * slot_size);
+
+		if(mask_words(new_S_pad) != mask_words(S_pad))
 		{
-			block_id sbid = stash[i].bid;
-			swap(sbid == DUMMY, _fetched, (std::uint8_t*) &stash[i], block_size);
+			delete[] match_mask;
+			delete[] free_mask;
+			match_mask = new std::uint64_t[mask_words(new_S_pad)];
+			free_mask = new std::uint64_t[mask_words(new_S_pad)];
 		}
 
-		assert(fetched->bid == DUMMY);
+		N = new_N;
+		S = new_N;
+		S_pad = new_S_pad;
+
+		return true;
 	}
-	
+
 }
@@ -8,6 +8,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 
 #define DUMMY -1
 #define BOTTOM -2
@@ -71,7 +72,8 @@ namespace obl
             rram[i] = new circuit_oram(N, chunk_sizes[i], Z, S);
             // rram[i] = new taostore_circuit_2(N, chunk_sizes[i], Z, S, 4);
 
-        thpool = threadpool_create(T_NUM, QUEUE_SIZE, 0);
+        shadow = nullptr;
+        init_pools();
     }
     mose::mose(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int T_NUM, taostore_circuit_factory *fact) : tree_oram(N, B, Z)
     {
@@ -80,14 +82,8 @@ namespace obl
 			Since AES-GCM is basically an AES-CTR mode, and AES-CTR mode is a "stream-cipher",
 			you actually don't need to pad everything to 16 bytes which is AES block size
 		*/
-        if (B<(1<<9))
-            this->T_NUM = 1;
-        else if (B>=(1<<9) && B<(1<<11))
-            this->T_NUM = 4;
-        else if (B>=(1<<11) && B<(1<<13))
-            this->T_NUM = 5;
-        else
-            this->T_NUM = 2;
+        // as many slices as the cost model finds worth it, at most T_NUM
+        this->T_NUM = mose_threads(fact->get_model(), N, B, Z, S, T_NUM);
 
         chunk_sizes = new unsigned int[this->T_NUM];
         chunk_idx = new unsigned int[this->T_NUM];
@@ -114,7 +110,8 @@ namespace obl
             // rram[i] = new circuit_oram(N, chunk_sizes[i], Z, S);
             rram[i] = fact->spawn_oram(N,chunk_sizes[i]);
 
-        thpool = threadpool_create(T_NUM, QUEUE_SIZE, 0);
+        shadow = nullptr;
+        init_pools();
     }
 
     mose::mose(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, unsigned int T_NUM, taostore_circuit_2_parallel_factory *fact) : tree_oram(N, B, Z)
@@ -146,8 +143,61 @@ namespace obl
         for (unsigned int i = 0; i < this->T_NUM; i++) 
             shadow[i] = (taostore_oram_parallel*) fact->spawn_oram(N,chunk_sizes[i]);
         
+        rram = nullptr;
+        init_pools();
+    }
+
+    void mose::init_pools()
+    {
+        no_pools = 1;
+        thpool = new threadpool_t *[1];
+        thpool[0] = threadpool_create(T_NUM, QUEUE_SIZE, 0);
+
+        pool_of = new unsigned int[T_NUM];
+        for (unsigned int i = 0; i < T_NUM; i++)
+            pool_of[i] = 0;
+    }
+
+    void mose::numa_bind(const numa_policy_t &policy)
+    {
+        if (policy.mode == NUMA_OFF)
+            return;
+
+        int nodes = numa_node_count();
+        int first = policy.node < 0 ? numa_current_node() : policy.node;
+        unsigned int spread = policy.mode == NUMA_SPREAD ? std::min((unsigned int)nodes, T_NUM) : 1;
+
+        // the pools are idle between accesses, rebuild them with one per node
+        for (unsigned int p = 0; p < no_pools; p++)
+        {
+            int err = threadpool_destroy(thpool[p], threadpool_graceful);
+            assert(err == 0);
+        }
+        delete[] thpool;
 
-        thpool = threadpool_create(T_NUM, QUEUE_SIZE, 0);
+        no_pools = spread;
+        thpool = new threadpool_t *[no_pools];
+        for (unsigned int p = 0; p < no_pools; p++)
+        {
+            unsigned int workers = T_NUM / no_pools + (p < T_NUM % no_pools);
+            int node = (first + p) % nodes;
+
+            thpool[p] = threadpool_create(workers, QUEUE_SIZE, 0);
+            threadpool_bind_node(thpool[p], node);
+        }
+
+        numa_policy_t sub = policy;
+        sub.mode = NUMA_BIND;
+        for (unsigned int i = 0; i < T_NUM; i++)
+        {
+            pool_of[i] = i % no_pools;
+            sub.node = (first + pool_of[i]) % nodes;
+
+            if (rram != nullptr)
+                rram[i]->numa_bind(sub);
+            else
+                shadow[i]->numa_bind(sub);
+        }
     }
 
     void mose::set_position_map(unsigned int C){
@@ -158,15 +208,24 @@ namespace obl
     mose::~mose()
     {
         int err;
-        err = threadpool_destroy(thpool, threadpool_graceful);
-        assert(err == 0);
+        for (unsigned int p = 0; p < no_pools; p++)
+        {
+            err = threadpool_destroy(thpool[p], threadpool_graceful);
+            assert(err == 0);
+        }
+        delete[] thpool;
+        delete[] pool_of;
         pthread_cond_destroy(&cond_sign);
         pthread_mutex_destroy(&cond_lock);
-        delete block_idx;
-        delete chunk_sizes;
-        delete chunk_idx;
-        for (unsigned int i = 0; i < T_NUM; i++)
-            delete rram[i];
+        delete[] chunk_sizes;
+        delete[] chunk_idx;
+        if (rram != nullptr)
+        {
+            for (unsigned int i = 0; i < T_NUM; i++)
+                delete rram[i];
+            delete[] rram;
+            delete[] args;
+        }
     }
 
     void mose::access_wrap(void *object)
@@ -268,7 +327,7 @@ namespace obl
         barrier = 0;
         for (unsigned int i = 0; i < T_NUM; i++)
         {
-            threadpool_add(thpool, access_wrap, (void *)&args[i], 0);
+            threadpool_add(thpool[pool_of[i]], access_wrap, (void *)&args[i], 0);
         }
         pthread_mutex_lock(&cond_lock);
         while (barrier != T_NUM)
@@ -286,7 +345,7 @@ namespace obl
         for (unsigned int i = 0; i < T_NUM; i++)
         {
             args_w[i] = {&args, i};
-            threadpool_add(thpool, shadow_access_wrap, (void *)&args_w[i], 0);
+            threadpool_add(thpool[pool_of[i]], shadow_access_wrap, (void *)&args_w[i], 0);
         }
         pthread_mutex_lock(&lock);
         while (args.barrier != T_NUM)
@@ -302,7 +361,7 @@ namespace obl
         barrier = 0;
         for (unsigned int i = 0; i < T_NUM; i++)
         {
-            threadpool_add(thpool, access_w_wrap, (void *)&args[i], 0);
+            threadpool_add(thpool[pool_of[i]], access_w_wrap, (void *)&args[i], 0);
         }
         pthread_mutex_lock(&cond_lock);
         while (barrier != T_NUM)
@@ -320,7 +379,7 @@ namespace obl
         barrier = 0;
         for (unsigned int i = 0; i < T_NUM; i++)
         {
-            threadpool_add(thpool, access_r_wrap, (void *)&args[i], 0);
+            threadpool_add(thpool[pool_of[i]], access_r_wrap, (void *)&args[i], 0);
         }
         pthread_mutex_lock(&cond_lock);
         while (barrier != T_NUM)
@@ -337,7 +396,7 @@ namespace obl
         barrier = 0;
         for (unsigned int i = 0; i < T_NUM; i++)
         {
-            threadpool_add(thpool, write_wrap, (void *)&args[i], 0);
+            threadpool_add(thpool[pool_of[i]], write_wrap, (void *)&args[i], 0);
         }
         pthread_mutex_lock(&cond_lock);
         while (barrier != T_NUM)
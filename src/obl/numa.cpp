@@ -0,0 +1,153 @@
+#include "obl/numa.h"
+
+#ifndef SGX_ENCLAVE_ENABLED
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace obl
+{
+
+#ifndef SGX_ENCLAVE_ENABLED
+
+	// parse a sysfs list like "0-3,8-11" and call f on every entry
+	template<typename F>
+	static bool parse_sysfs_list(const char *path, F f)
+	{
+		char buff[1024];
+		FILE *fp = std::fopen(path, "r");
+
+		if (fp == nullptr)
+			return false;
+
+		bool ok = std::fgets(buff, sizeof(buff), fp) != nullptr;
+		std::fclose(fp);
+
+		if (!ok)
+			return false;
+
+		char *tok = buff;
+		while (*tok != '\0' && *tok != '\n')
+		{
+			char *end;
+			long lo = std::strtol(tok, &end, 10);
+			long hi = lo;
+
+			if (end == tok)
+				return false;
+
+			if (*end == '-')
+			{
+				tok = end + 1;
+				hi = std::strtol(tok, &end, 10);
+			}
+
+			for (long i = lo; i <= hi; i++)
+				f((int)i);
+
+			tok = *end == ',' ? end + 1 : end;
+		}
+
+		return true;
+	}
+
+	int numa_node_count()
+	{
+		int nodes = 0;
+
+		if (!parse_sysfs_list("/sys/devices/system/node/online", [&nodes](int n) { nodes = n + 1 > nodes ? n + 1 : nodes; }))
+			return 1;
+
+		return nodes > 0 ? nodes : 1;
+	}
+
+	int numa_current_node()
+	{
+		unsigned int cpu, node;
+
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+			return 0;
+
+		return (int)node;
+	}
+
+	static bool mbind_range(void *addr, std::size_t len, int mode, unsigned long *mask, unsigned long maxnode, std::size_t align)
+	{
+		std::uintptr_t page = align != 0 ? align : sysconf(_SC_PAGESIZE);
+		std::uintptr_t start = ((std::uintptr_t)addr + page - 1) & ~(page - 1);
+		std::uintptr_t end = ((std::uintptr_t)addr + len) & ~(page - 1);
+
+		// rounding out would rebind whatever else lives on the first and last page
+		if (end <= start)
+			return false;
+
+		// MPOL_MF_MOVE also migrates the pages that were already touched, e.g. the root bucket
+		return syscall(SYS_mbind, start, end - start, mode, mask, maxnode, MPOL_MF_MOVE) == 0;
+	}
+
+	bool numa_bind_memory(void *addr, std::size_t len, int node, std::size_t align)
+	{
+		const int bits = sizeof(unsigned long) * 8;
+		unsigned long mask[4] = {0};
+
+		if (node < 0)
+			node = numa_current_node();
+
+		if (len == 0 || node >= 4 * bits)
+			return false;
+
+		mask[node / bits] = 1UL << (node % bits);
+
+		return mbind_range(addr, len, MPOL_BIND, mask, 4 * bits + 1, align);
+	}
+
+	bool numa_interleave_memory(void *addr, std::size_t len, std::size_t align)
+	{
+		const int bits = sizeof(unsigned long) * 8;
+		unsigned long mask[4] = {0};
+		int nodes = numa_node_count();
+
+		if (len == 0 || nodes > 4 * bits)
+			return false;
+
+		for (int i = 0; i < nodes; i++)
+			mask[i / bits] |= 1UL << (i % bits);
+
+		return mbind_range(addr, len, MPOL_INTERLEAVE, mask, 4 * bits + 1, align);
+	}
+
+	bool numa_bind_thread(pthread_t thread, int node)
+	{
+		char path[64];
+		cpu_set_t cpus;
+
+		if (node < 0)
+			node = numa_current_node();
+
+		CPU_ZERO(&cpus);
+		std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+		if (!parse_sysfs_list(path, [&cpus](int c) { CPU_SET(c, &cpus); }))
+			return false;
+
+		return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpus) == 0;
+	}
+
+#else
+
+	int numa_node_count() { return 1; }
+	int numa_current_node() { return 0; }
+	bool numa_bind_memory(void *addr, std::size_t len, int node, std::size_t align) { return false; }
+	bool numa_interleave_memory(void *addr, std::size_t len, std::size_t align) { return false; }
+	bool numa_bind_thread(pthread_t thread, int node) { return false; }
+
+#endif
+
+} // namespace obl
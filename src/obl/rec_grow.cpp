@@ -0,0 +1,153 @@
+#include "obl/rec_grow.h"
+#include "obl/primitives.h"
+
+#include "obl/oassert.h"
+
+#define DUMMY_LEAF -1
+
+namespace obl
+{
+
+	constexpr leaf_id sign_bit = (1ULL << (sizeof(leaf_id) * 8 - 1)) - 1;
+
+	// this is to avoid generating randomly a -1!
+	static inline leaf_id leaf_abs(leaf_id x)
+	{
+		return x & sign_bit;
+	}
+
+	static inline bool full_top(const rec_map_view_t &m, std::size_t C, int levs, int top)
+	{
+		return levs == 0 ? C >= (std::size_t)m.rmap_csize : top == m.rmap_bits;
+	}
+
+	/*
+		Doubling C adds one most significant bit to every bid. It is absorbed by the
+		in-enclave pos_map: old bids keep their rec_bid at every level, while the new
+		half of the pos_map is DUMMY_LEAF and gets initialized on first touch.
+		Once pos_map is full, its content becomes the first block of a new top
+		recursion level, and pos_map restarts with a single bit.
+	*/
+	static void double_capacity(rec_map_view_t &m)
+	{
+		bool full = full_top(m, m.C, m.rmap_levs, m.top_bits);
+
+		if (!full)
+		{
+			if (m.rmap_levs > 0)
+				++m.top_bits;
+		}
+		else
+		{
+			leaf_id fresh[2];
+			leaf_id empty_chunk[m.rmap_csize];
+
+			for (int i = 0; i < m.rmap_csize; i++)
+				empty_chunk[i] = DUMMY_LEAF;
+
+			gen_rand((std::uint8_t *)fresh, sizeof(leaf_id) * 2);
+			fresh[0] = leaf_abs(fresh[0]);
+			fresh[1] = leaf_abs(fresh[1]);
+
+			tree_oram *top = m.allocator->spawn_oram(2, sizeof(leaf_id) * m.rmap_csize);
+			top->write(0, (std::uint8_t *)m.pos_map, fresh[0]);
+			top->write(1, (std::uint8_t *)empty_chunk, fresh[1]);
+
+			for (int i = 0; i < m.rmap_csize; i++)
+				m.pos_map[i] = DUMMY_LEAF;
+			m.pos_map[0] = fresh[0];
+			m.pos_map[1] = fresh[1];
+
+			// prepend the new level
+			tree_oram **n_rmap = new tree_oram *[m.rmap_levs + 1];
+			int *n_lev_bits = new int[m.rmap_levs + 1];
+			pthread_mutex_t *n_locks = new pthread_mutex_t[m.rmap_levs + 2];
+
+			n_rmap[0] = top;
+			n_lev_bits[0] = m.top_bits;
+
+			for (int i = 0; i < m.rmap_levs; i++)
+			{
+				n_rmap[i + 1] = m.rmap[i];
+				n_lev_bits[i + 1] = m.lev_bits[i];
+			}
+
+			for (int i = 0; i <= m.rmap_levs; i++)
+				pthread_mutex_destroy(&m.rmap_locks[i]);
+			for (int i = 0; i < m.rmap_levs + 2; i++)
+				pthread_mutex_init(&n_locks[i], NULL);
+
+			delete[] m.rmap;
+			delete[] m.lev_bits;
+			delete[] m.rmap_locks;
+
+			m.rmap = n_rmap;
+			m.lev_bits = n_lev_bits;
+			m.rmap_locks = n_locks;
+
+			++m.rmap_levs;
+			m.top_bits = 1;
+		}
+
+		// every level below the top gets one more bit of rec_bid
+		for (int i = full ? 1 : 0; i < m.rmap_levs; i++)
+		{
+			bool grown = m.rmap[i]->grow(m.rmap[i]->get_N() << 1);
+			assert(grown);
+		}
+
+		m.C <<= 1;
+	}
+
+	bool rec_map_can_grow(const rec_map_view_t &m, std::size_t new_C)
+	{
+		std::size_t C = m.C;
+		int levs = m.rmap_levs;
+		int top = m.top_bits;
+		bool spawned = false;
+		bool spawned_grows = false;
+
+		if (C >= new_C)
+			return true;
+
+		// levels already there grow on every doubling
+		for (int i = 0; i < m.rmap_levs; i++)
+			if (!m.rmap[i]->can_grow())
+				return false;
+
+		// replay the doublings: a spawned level grows on any later one
+		for (; C < new_C; C <<= 1)
+		{
+			spawned_grows |= spawned;
+
+			if (!full_top(m, C, levs, top))
+			{
+				if (levs > 0)
+					++top;
+			}
+			else
+			{
+				spawned = true;
+				++levs;
+				top = 1;
+			}
+		}
+
+		if (!spawned_grows)
+			return true;
+
+		// ask the factory what it would spawn for a new top level
+		tree_oram *probe = m.allocator->spawn_oram(2, sizeof(leaf_id) * m.rmap_csize);
+		bool ok = probe->can_grow();
+		delete probe;
+
+		return ok;
+	}
+
+	void rec_map_grow(rec_map_view_t &m, std::size_t new_C)
+	{
+		while (m.C < new_C)
+			double_capacity(m);
+	}
+
+} // namespace obl
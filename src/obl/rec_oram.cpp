@@ -1,5 +1,9 @@
 #include "obl/rec_standard.h"
+#include "obl/rec_grow.h"
 #include "obl/primitives.h"
+#include "obl/scan.h"
+
+#include "obl/oassert.h"
 
 #define DUMMY_LEAF -1
 
@@ -41,9 +45,15 @@ namespace obl
 		/*if(rmap_levs == 1)
 			rmap_bits = rmap_opt;*/
 
+		this->allocator = allocator;
+
 		std::uint32_t *temp_N = new std::uint32_t[rmap_levs];
 		std::uint32_t *temp_size = new std::uint32_t[rmap_levs];
 		rmap_locks = new pthread_mutex_t[rmap_levs + 1];
+
+		top_bits = rmap_levs == 1 ? rmap_opt : rmap_bits;
+		lev_bits = new int[rmap_levs];
+
 		if (rmap_levs > 0)
 		{
 			rmap = new tree_oram *[rmap_levs];
@@ -64,6 +74,7 @@ namespace obl
 					rec_N <<= rmap_bits;
 
 				pthread_mutex_init(&rmap_locks[i], NULL);
+				lev_bits[i] = tmp_rmap;
 				temp_N[i] = rec_N;
 				temp_size[i] = sizeof(leaf_id) * (1 << tmp_rmap);
 				// rmap[i] = allocator->spawn_oram(rec_N, sizeof(leaf_id) * (1 << tmp_rmap));
@@ -81,12 +92,16 @@ namespace obl
 		oram = allocator->spawn_oram(this->N, B);
 		for (int i = rmap_levs-1; i >=0; i--)
 			rmap[i] = allocator->spawn_oram(temp_N[i],temp_size[i]);
+
+		delete[] temp_N;
+		delete[] temp_size;
 	}
 
 	recursive_oram_standard::~recursive_oram_standard()
 	{
 
 		delete[] pos_map;
+		delete[] lev_bits;
 		delete oram;
 
 		if (rmap != nullptr)
@@ -104,18 +119,8 @@ namespace obl
 
 	leaf_id recursive_oram_standard::scan_map(leaf_id *map, int idx, leaf_id replacement, bool to_init)
 	{
-		leaf_id leef = DUMMY_LEAF;
-
-		for (int i = 0; i < rmap_csize; i++)
-		{
-			leaf_id tmp = map[i];
-
-			leef = ternary_op(i == idx, tmp, leef);
-			tmp = ternary_op(to_init, DUMMY_LEAF, tmp);
-			map[i] = ternary_op(i == idx, replacement, tmp);
-		}
-
-		return leef;
+		// DUMMY_LEAF is the -1 scan_update resets to
+		return scan_update(map, rmap_csize, idx, replacement, to_init, true);
 	}
 
 	void recursive_oram_standard::access(block_id bid, std::uint8_t *data_in, std::uint8_t *data_out)
@@ -136,7 +141,7 @@ namespace obl
 		block_id rec_bid = 0;
 
 		// to inject optimization
-		int local_bits = rmap_levs == 1 ? rmap_opt : rmap_bits;
+		int local_bits = top_bits;
 
 		/* Access the constant size position map */
 		gen_rand((std::uint8_t *)&ev_leef, sizeof(leaf_id));
@@ -172,10 +177,7 @@ namespace obl
 			rem_bid = rem_bid - n_bid * ch_len;
 
 			// is the current iteration to optimize?
-			if (i == rmap_levs - 2)
-				local_bits = rmap_opt;
-			else
-				local_bits = rmap_bits;
+			local_bits = lev_bits[i];
 
 			ch_len = ch_len >> local_bits;
 			if (ch_len == 0)
@@ -203,4 +205,190 @@ namespace obl
 		oram->access(bid, leef, data_in, data_out, ev_leef);
 		pthread_mutex_unlock(&rmap_locks[rmap_levs]);
 	}
+
+	struct rec_batch_entry_t
+	{
+		block_id rec_bid; // block of the current level holding the entry of this bid
+		block_id rem_bid;
+		int n_bid; // index inside that block
+		leaf_id leef, ev_leef;
+		bool to_initialize;
+
+		// filled while scanning the current level
+		leaf_id next_leef, next_ev_leef;
+		bool next_init;
+	};
+
+	inline leaf_id rand_leaf()
+	{
+		leaf_id l;
+		gen_rand((std::uint8_t *)&l, sizeof(leaf_id));
+		return leaf_abs(l);
+	}
+
+	// same as scan_map, for all the entries of the batch stored in node
+	void recursive_oram_standard::scan_map_batch(leaf_id *map, rec_batch_entry_t *e, unsigned int k, block_id node, bool node_valid, bool to_init)
+	{
+		for (int i = 0; i < rmap_csize; i++)
+		{
+			leaf_id tmp = map[i];
+			leaf_id fresh = rand_leaf();
+			bool hit = false;
+
+			// entries sharing the child get the same leaf and the same remapping
+			for (unsigned int j = 0; j < k; j++)
+			{
+				bool sel = node_valid & (e[j].rec_bid == node) & (e[j].n_bid == i);
+				e[j].next_leef = ternary_op(sel, tmp, e[j].next_leef);
+				e[j].next_ev_leef = ternary_op(sel, fresh, e[j].next_ev_leef);
+				e[j].next_init = ternary_op(sel, to_init, e[j].next_init);
+				hit = hit | sel;
+			}
+
+			tmp = ternary_op(to_init, DUMMY_LEAF, tmp);
+			map[i] = ternary_op(hit, fresh, tmp);
+		}
+	}
+
+	void recursive_oram_standard::access_batch(const block_id *bids, unsigned int k, std::uint8_t **data_in, std::uint8_t **data_out, std::size_t span)
+	{
+		if (k == 0)
+			return;
+
+		if (span == 0 || span > C)
+			span = C;
+
+		rec_batch_entry_t *e = new rec_batch_entry_t[k];
+		bool *leader = new bool[k];
+		unsigned int *rank = new unsigned int[k];
+		leaf_id tmp_pos_map[rmap_csize];
+
+		int local_bits = top_bits;
+		std::size_t ch_len = C >> local_bits;
+		if (ch_len == 0)
+			ch_len = 1;
+
+		/* Access the constant size position map, shared by the whole batch */
+		for (unsigned int j = 0; j < k; j++)
+		{
+			e[j].rec_bid = 0;
+			e[j].rem_bid = bids[j];
+			e[j].n_bid = bids[j] >> __builtin_ctzll(ch_len);
+		}
+
+		pthread_mutex_lock(&rmap_locks[0]);
+		scan_map_batch(pos_map, e, k, 0, true, false);
+
+		for (unsigned int j = 0; j < k; j++)
+		{
+			e[j].to_initialize = e[j].next_leef == DUMMY_LEAF;
+			e[j].leef = ternary_op(!e[j].to_initialize, e[j].next_leef, rand_leaf());
+			e[j].ev_leef = e[j].next_ev_leef;
+		}
+
+		/* Access recursive ORAMs, once per distinct block */
+		for (int i = 0; i < rmap_levs; i++)
+		{
+			// rec_bid at this level is bid >> shift, so a window of span bids covers at most
+			// ceil((span - 1) / 2^shift) + 1 blocks: this is the public number of accesses
+			int shift = __builtin_ctzll(ch_len);
+			std::size_t slots = ((span - 1 + (1ULL << shift) - 1) >> shift) + 1;
+			slots = slots > k ? k : slots;
+			slots = slots > rmap[i]->get_N() ? rmap[i]->get_N() : slots;
+
+			for (unsigned int j = 0; j < k; j++)
+			{
+				e[j].rec_bid = (e[j].rec_bid << local_bits) | e[j].n_bid;
+				e[j].rem_bid = e[j].rem_bid - e[j].n_bid * ch_len;
+			}
+
+			local_bits = lev_bits[i];
+			ch_len = ch_len >> local_bits;
+			if (ch_len == 0)
+				ch_len = 1;
+
+			// oblivious deduplication, the first entry of each block leads its slot
+			unsigned int leaders = 0;
+			for (unsigned int j = 0; j < k; j++)
+			{
+				bool first = true;
+				for (unsigned int h = 0; h < k; h++)
+					first = first & !((h < j) & (e[h].rec_bid == e[j].rec_bid));
+
+				leader[j] = first;
+				rank[j] = leaders;
+				leaders += first;
+
+				e[j].n_bid = e[j].rem_bid >> __builtin_ctzll(ch_len);
+				e[j].next_leef = DUMMY_LEAF;
+				e[j].next_ev_leef = DUMMY_LEAF;
+				e[j].next_init = false;
+			}
+
+			// only fails if the bids do not fit in span
+			assert(leaders <= slots);
+
+			for (std::size_t t = 0; t < slots; t++)
+			{
+				// padding slots perform a dummy access: DUMMY is never stored, so reading it
+				// fetches nothing and writing it back inserts nothing
+				block_id node = DUMMY_LEAF;
+				leaf_id leef = rand_leaf();
+				leaf_id ev_leef = rand_leaf();
+				bool init = false;
+				bool valid = false;
+
+				for (unsigned int j = 0; j < k; j++)
+				{
+					bool sel = leader[j] & (rank[j] == t);
+					node = ternary_op(sel, e[j].rec_bid, node);
+					leef = ternary_op(sel, e[j].leef, leef);
+					ev_leef = ternary_op(sel, e[j].ev_leef, ev_leef);
+					init = ternary_op(sel, e[j].to_initialize, init);
+					valid = valid | sel;
+				}
+
+				rmap[i]->access_r(node, leef, (std::uint8_t *)tmp_pos_map);
+				scan_map_batch(tmp_pos_map, e, k, node, valid, init);
+				rmap[i]->access_w(node, leef, (std::uint8_t *)tmp_pos_map, ev_leef);
+			}
+
+			pthread_mutex_lock(&rmap_locks[i + 1]);
+			pthread_mutex_unlock(&rmap_locks[i]);
+
+			for (unsigned int j = 0; j < k; j++)
+			{
+				e[j].to_initialize = e[j].next_init | (e[j].next_leef == DUMMY_LEAF);
+				e[j].leef = ternary_op(!e[j].to_initialize, e[j].next_leef, rand_leaf());
+				e[j].ev_leef = e[j].next_ev_leef;
+			}
+		}
+
+		for (unsigned int j = 0; j < k; j++)
+			oram->access(bids[j], e[j].leef, data_in == nullptr ? nullptr : data_in[j], data_out[j], e[j].ev_leef);
+		pthread_mutex_unlock(&rmap_locks[rmap_levs]);
+
+		delete[] e;
+		delete[] leader;
+		delete[] rank;
+	}
+
+	bool recursive_oram_standard::grow(std::size_t new_N)
+	{
+		rec_map_view_t m = {C, rmap_levs, rmap_csize, rmap_bits, top_bits, lev_bits, rmap, rmap_locks, pos_map, allocator};
+		std::size_t new_C = next_two_power(new_N);
+
+		// check first: a half-grown recursion cannot be rolled back
+		if (new_N < N || !oram->can_grow() || !rec_map_can_grow(m, new_C))
+			return false;
+
+		rec_map_grow(m, new_C);
+
+		N = new_N;
+
+		bool grown = oram->grow(new_N);
+		assert(grown);
+
+		return true;
+	}
 } // namespace obl
@@ -0,0 +1,66 @@
+#include "obl/ro_circuit.h"
+#include "obl/circuit_types.hpp"
+#include "obl/utils.h"
+#include "obl/primitives.h"
+
+#include "obl/oassert.h"
+
+#include <cstring>
+
+#define DUMMY -1
+
+namespace obl
+{
+
+	ro_circuit_oram::ro_circuit_oram(std::size_t N, std::size_t B, unsigned int Z, unsigned int S, huge_page_t huge) : circuit_oram(N, B, Z, S, huge)
+	{
+		assert(S >= ro_circuit_min_stash(Z));
+	}
+
+	void ro_circuit_oram::access(block_id bid, leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, leaf_id next_lif)
+	{
+		access_r(bid, lif, data_out);
+
+		// read-only access: the block goes back with the payload just fetched
+		if (data_in == nullptr)
+			data_in = data_out;
+
+		access_w(bid, lif, data_in, next_lif);
+	}
+
+	void ro_circuit_oram::access_w(block_id bid, leaf_id lif, std::uint8_t *data_in, leaf_id next_lif)
+	{
+		std::uint8_t _fetched[block_size];
+		block_t *fetched = (block_t *)_fetched;
+
+		fetched->bid = bid;
+		fetched->lid = next_lif;
+		std::memcpy(fetched->payload, data_in, B);
+
+		// evict the created block to the stash
+		bool already_evicted = stash_insert(fetched);
+
+		assert(already_evicted);
+
+		/*
+			EVICTION ON THE READ PATH
+			fetched_path still holds the decrypted buckets of lif, so the eviction
+			costs no additional fetch and is merged into the mandatory write-back.
+			A second pass keeps the stash close to the standard two-path schedule
+		*/
+		for (int k = 0; k < 2; k++)
+		{
+			deepest(lif);
+			target();
+			eviction(lif);
+		}
+
+		wb_path(lif, leaf_idx_split);
+
+		// one deterministic eviction instead of two
+		evict(rev_lex_leaf(access_counter, L));
+
+		++access_counter;
+	}
+
+} // namespace obl
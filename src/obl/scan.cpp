@@ -0,0 +1,177 @@
+#include "obl/scan.h"
+#include "obl/primitives.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace obl
+{
+
+#ifdef __AVX2__
+
+	static inline std::int32_t hor_or(__m256i v)
+	{
+		__m128i r = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		r = _mm_or_si128(r, _mm_shuffle_epi32(r, 0x4E));
+		r = _mm_or_si128(r, _mm_shuffle_epi32(r, 0xB1));
+		return _mm_cvtsi128_si32(r);
+	}
+
+	static inline std::uint32_t hor_add(__m256i v)
+	{
+		__m128i r = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		r = _mm_add_epi32(r, _mm_shuffle_epi32(r, 0x4E));
+		r = _mm_add_epi32(r, _mm_shuffle_epi32(r, 0xB1));
+		return _mm_cvtsi128_si32(r);
+	}
+
+	std::int32_t scan_select(const std::int32_t *v, unsigned int n, std::int32_t idx)
+	{
+		const __m256i step = _mm256_set1_epi32(8);
+		__m256i vidx = _mm256_set1_epi32(idx);
+		__m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i val = _mm256_setzero_si256();
+		__m256i hit = _mm256_setzero_si256();
+		unsigned int i = 0;
+
+		// at most one lane ever matches, so OR-ing the masked entries selects it
+		for(; i + 8 <= n; i += 8)
+		{
+			__m256i eq = _mm256_cmpeq_epi32(iota, vidx);
+			__m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+
+			val = _mm256_or_si256(val, _mm256_and_si256(x, eq));
+			hit = _mm256_or_si256(hit, eq);
+			iota = _mm256_add_epi32(iota, step);
+		}
+
+		std::int32_t ret = hor_or(val);
+		std::int32_t found = hor_or(hit);
+
+		for(; i < n; i++)
+		{
+			std::int32_t eq = 0 - (std::int32_t)((std::int32_t) i == idx);
+			ret |= v[i] & eq;
+			found |= eq;
+		}
+
+		return ternary_op(found != 0, ret, -1);
+	}
+
+	std::uint32_t scan_prefix_sum(const std::int32_t *v, unsigned int n, std::uint32_t idx)
+	{
+		// public bound, so that the signed lane compares below are exact
+		std::int32_t lim = ternary_op(idx > n, n, idx);
+
+		const __m256i step = _mm256_set1_epi32(8);
+		__m256i vlim = _mm256_set1_epi32(lim);
+		__m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i acc = _mm256_setzero_si256();
+		unsigned int i = 0;
+
+		for(; i + 8 <= n; i += 8)
+		{
+			__m256i lt = _mm256_cmpgt_epi32(vlim, iota);
+			__m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+
+			acc = _mm256_add_epi32(acc, _mm256_and_si256(x, lt));
+			iota = _mm256_add_epi32(iota, step);
+		}
+
+		std::uint32_t ret = hor_add(acc);
+
+		for(; i < n; i++)
+			ret += v[i] & (0 - (std::uint32_t)((std::int32_t) i < lim));
+
+		return ret;
+	}
+
+	std::int32_t scan_update(std::int32_t *v, unsigned int n, std::int32_t idx, std::int32_t replacement, bool to_init, bool write)
+	{
+		const __m256i step = _mm256_set1_epi32(8);
+		__m256i vidx = _mm256_set1_epi32(idx);
+		__m256i vrepl = _mm256_set1_epi32(replacement);
+		__m256i vinit = _mm256_set1_epi32(0 - (std::int32_t) to_init);
+		__m256i vwrite = _mm256_set1_epi32(0 - (std::int32_t) write);
+		__m256i dummy = _mm256_set1_epi32(-1);
+		__m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i val = _mm256_setzero_si256();
+		__m256i hit = _mm256_setzero_si256();
+		unsigned int i = 0;
+
+		for(; i + 8 <= n; i += 8)
+		{
+			__m256i eq = _mm256_cmpeq_epi32(iota, vidx);
+			__m256i x = _mm256_loadu_si256((__m256i *)(v + i));
+
+			val = _mm256_or_si256(val, _mm256_and_si256(x, eq));
+			hit = _mm256_or_si256(hit, eq);
+
+			x = _mm256_blendv_epi8(x, dummy, vinit);
+			x = _mm256_blendv_epi8(x, vrepl, _mm256_and_si256(eq, vwrite));
+			_mm256_storeu_si256((__m256i *)(v + i), x);
+
+			iota = _mm256_add_epi32(iota, step);
+		}
+
+		std::int32_t ret = hor_or(val);
+		std::int32_t found = hor_or(hit);
+
+		for(; i < n; i++)
+		{
+			bool eq = (std::int32_t) i == idx;
+			std::int32_t tmp = v[i];
+
+			ret |= tmp & (0 - (std::int32_t) eq);
+			found |= 0 - (std::int32_t) eq;
+
+			tmp = ternary_op(to_init, -1, tmp);
+			v[i] = ternary_op(eq & write, replacement, tmp);
+		}
+
+		return ternary_op(found != 0, ret, -1);
+	}
+
+#else
+
+	std::int32_t scan_select(const std::int32_t *v, unsigned int n, std::int32_t idx)
+	{
+		std::int32_t ret = -1;
+
+		for(unsigned int i = 0; i < n; i++)
+			ret = ternary_op((std::int32_t) i == idx, v[i], ret);
+
+		return ret;
+	}
+
+	std::uint32_t scan_prefix_sum(const std::int32_t *v, unsigned int n, std::uint32_t idx)
+	{
+		std::uint32_t ret = 0;
+
+		for(unsigned int i = 0; i < n; i++)
+			ret += ternary_op(i < idx, v[i], 0);
+
+		return ret;
+	}
+
+	std::int32_t scan_update(std::int32_t *v, unsigned int n, std::int32_t idx, std::int32_t replacement, bool to_init, bool write)
+	{
+		std::int32_t ret = -1;
+
+		for(unsigned int i = 0; i < n; i++)
+		{
+			bool eq = (std::int32_t) i == idx;
+			std::int32_t tmp = v[i];
+
+			ret = ternary_op(eq, tmp, ret);
+			tmp = ternary_op(to_init, -1, tmp);
+			v[i] = ternary_op(eq & write, replacement, tmp);
+		}
+
+		return ret;
+	}
+
+#endif
+
+} // namespace obl
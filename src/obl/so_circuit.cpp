@@ -503,8 +503,8 @@ namespace obl {
 		/*
 			CIRCUIT ORAM DETERMINISTIC EVICTION
 		*/
-		evict(2*access_counter);
-		evict(2*access_counter + 1);
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
 
 		// increment the access counter
 		++access_counter;
@@ -564,8 +564,8 @@ namespace obl {
 		/*
 			CIRCUIT ORAM DETERMINISTIC EVICTION
 		*/
-		evict(2*access_counter);
-		evict(2*access_counter + 1);
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
 
 		// increment the access counter
 		++access_counter;
@@ -583,8 +583,8 @@ namespace obl {
 		new_block->bid = bid;
 		stash.push_back(std::move(new_block));
 
-		evict(2*access_counter);
-		evict(2*access_counter + 1);
+		evict(rev_lex_leaf(2 * access_counter, L));
+		evict(rev_lex_leaf(2 * access_counter + 1, L));
 
 		++access_counter;
 	
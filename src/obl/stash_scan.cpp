@@ -0,0 +1,153 @@
+#include "obl/stash_scan.h"
+#include "obl/primitives.h"
+
+#include "obl/oassert.h"
+
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace obl
+{
+	/*
+		get_max_depth is ctz((lid ^ path) | (1 << L)). Isolating the lowest set bit instead
+		of counting trailing zeros keeps everything in SIMD registers: equal depth <=> equal
+		isolated bit, and since isolated bits are powers of two the maximum depth is just
+		the highest bit of their OR.
+	*/
+
+#ifdef __AVX2__
+
+	static inline __m256i isolated_depth(__m256i l, __m256i vpath, __m256i vroot)
+	{
+		__m256i x = _mm256_or_si256(_mm256_xor_si256(l, vpath), vroot);
+		return _mm256_and_si256(x, _mm256_sub_epi32(_mm256_setzero_si256(), x));
+	}
+
+	static inline std::uint64_t lane_bits(__m256i cmp)
+	{
+		return (std::uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+	}
+
+	std::int64_t stash_max_depth(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L)
+	{
+		__m256i vpath = _mm256_set1_epi32(path);
+		__m256i vroot = _mm256_set1_epi32((std::int32_t)(1U << L));
+		__m256i none = _mm256_set1_epi32(-1);
+		__m256i acc = _mm256_setzero_si256();
+
+		assert(n % STASH_LANES == 0);
+
+		for (unsigned int i = 0; i < n; i += STASH_LANES)
+		{
+			__m256i b = _mm256_loadu_si256((const __m256i *)(bid + i));
+			__m256i l = _mm256_loadu_si256((const __m256i *)(lid + i));
+
+			__m256i valid = _mm256_cmpgt_epi32(b, none);
+			acc = _mm256_or_si256(acc, _mm256_and_si256(isolated_depth(l, vpath, vroot), valid));
+		}
+
+		__m128i r = _mm_or_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		r = _mm_or_si128(r, _mm_shuffle_epi32(r, 0x4E));
+		r = _mm_or_si128(r, _mm_shuffle_epi32(r, 0xB1));
+		std::uint32_t bits = _mm_cvtsi128_si32(r);
+
+		return ternary_op(bits != 0, 31 - __builtin_clz(bits | 1), -1);
+	}
+
+	void stash_depth_mask(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L, std::int64_t depth, std::uint64_t *mask)
+	{
+		__m256i vpath = _mm256_set1_epi32(path);
+		__m256i vroot = _mm256_set1_epi32((std::int32_t)(1U << L));
+		__m256i none = _mm256_set1_epi32(-1);
+		// an isolated bit is never 0, so a negative depth matches nothing
+		__m256i vdepth = _mm256_set1_epi32((std::int32_t)ternary_op(depth >= 0, 1U << (depth & 31), 0));
+
+		assert(n % STASH_LANES == 0);
+		std::memset(mask, 0x00, mask_words(n) * sizeof(std::uint64_t));
+
+		for (unsigned int i = 0; i < n; i += STASH_LANES)
+		{
+			__m256i b = _mm256_loadu_si256((const __m256i *)(bid + i));
+			__m256i l = _mm256_loadu_si256((const __m256i *)(lid + i));
+
+			__m256i hit = _mm256_and_si256(_mm256_cmpeq_epi32(isolated_depth(l, vpath, vroot), vdepth), _mm256_cmpgt_epi32(b, none));
+			mask[i >> 6] |= lane_bits(hit) << (i & 63);
+		}
+	}
+
+	void stash_match_mask(const block_id *bid, unsigned int n, block_id target, std::uint64_t *mask)
+	{
+		__m256i vtarget = _mm256_set1_epi32(target);
+
+		assert(n % STASH_LANES == 0);
+		std::memset(mask, 0x00, mask_words(n) * sizeof(std::uint64_t));
+
+		for (unsigned int i = 0; i < n; i += STASH_LANES)
+		{
+			__m256i b = _mm256_loadu_si256((const __m256i *)(bid + i));
+			mask[i >> 6] |= lane_bits(_mm256_cmpeq_epi32(b, vtarget)) << (i & 63);
+		}
+	}
+
+#else
+
+	static inline std::uint32_t isolated_depth(leaf_id l, leaf_id path, int L)
+	{
+		std::uint32_t x = ((std::uint32_t)(l ^ path)) | (1U << L);
+		return x & (0 - x);
+	}
+
+	std::int64_t stash_max_depth(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L)
+	{
+		std::uint32_t bits = 0;
+
+		for (unsigned int i = 0; i < n; i++)
+			bits |= isolated_depth(lid[i], path, L) & (0 - (std::uint32_t)(bid[i] >= 0));
+
+		return ternary_op(bits != 0, 31 - __builtin_clz(bits | 1), -1);
+	}
+
+	void stash_depth_mask(const block_id *bid, const leaf_id *lid, unsigned int n, leaf_id path, int L, std::int64_t depth, std::uint64_t *mask)
+	{
+		std::uint32_t target = ternary_op(depth >= 0, 1U << (depth & 31), 0);
+
+		std::memset(mask, 0x00, mask_words(n) * sizeof(std::uint64_t));
+
+		for (unsigned int i = 0; i < n; i++)
+		{
+			std::uint64_t hit = (isolated_depth(lid[i], path, L) == target) & (bid[i] >= 0);
+			mask[i >> 6] |= hit << (i & 63);
+		}
+	}
+
+	void stash_match_mask(const block_id *bid, unsigned int n, block_id target, std::uint64_t *mask)
+	{
+		std::memset(mask, 0x00, mask_words(n) * sizeof(std::uint64_t));
+
+		for (unsigned int i = 0; i < n; i++)
+			mask[i >> 6] |= ((std::uint64_t)(bid[i] == target)) << (i & 63);
+	}
+
+#endif
+
+	bool mask_keep_first(std::uint64_t *mask, unsigned int words)
+	{
+		// all ones once the first bit has been kept
+		std::uint64_t found = 0;
+
+		for (unsigned int w = 0; w < words; w++)
+		{
+			std::uint64_t m = mask[w] & ~found;
+			std::uint64_t low = m & (0 - m);
+
+			mask[w] = low;
+			found |= 0 - (std::uint64_t)(low != 0);
+		}
+
+		return found != 0;
+	}
+
+} // namespace obl
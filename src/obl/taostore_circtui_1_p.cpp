@@ -302,7 +302,7 @@ namespace obl
     void taostore_circuit_1_parallel::access_thread(request_p_t &_req)
     {
         std::uint8_t _fetched[block_size];
-        std::int32_t evict_leaf;
+        std::uint64_t evict_leaf;
         std::uint64_t access_counter_1;
         std::uint64_t access_counter_2;
         std::uint64_t access_counter_3;
@@ -313,8 +313,8 @@ namespace obl
 
         evict_leaf = evict_path++;
 
-        access_counter_2 = eviction(2 * evict_leaf);
-        access_counter_3 = eviction(2 * evict_leaf + 1);
+        access_counter_2 = eviction(rev_lex_leaf(2 * evict_leaf, L));
+        access_counter_3 = eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 
         if (access_counter_1 % K == 0)
             write_back();
@@ -488,7 +488,7 @@ namespace obl
     void taostore_circuit_1_parallel::write(block_id bid, std::uint8_t *data_in, leaf_id next_lif)
     {
         std::uint8_t _fetched[block_size];
-        std::uint32_t evict_leaf;
+        std::uint64_t evict_leaf;
         std::uint64_t paths;
 
         block_t *fetched = (block_t *)_fetched;
@@ -524,8 +524,8 @@ namespace obl
 
         evict_leaf = evict_path++;
 
-        eviction(2 * evict_leaf);
-        eviction(2 * evict_leaf + 1);
+        eviction(rev_lex_leaf(2 * evict_leaf, L));
+        eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 
         paths = access_counter++;
 
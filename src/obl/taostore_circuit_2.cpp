@@ -220,7 +220,7 @@ namespace obl
 		std::uint8_t _fetched[block_size];
 		block_t *fetched = (block_t *)_fetched;
 
-		leaf_id evict_leaf;
+		std::uint64_t evict_leaf;
 		bool already_evicted = false;
 
 		std::uint64_t access_counter_1;
@@ -267,11 +267,11 @@ namespace obl
 
 		evict_leaf = evict_path++;
 
-		access_counter_2 = eviction(2 * evict_leaf);
+		access_counter_2 = eviction(rev_lex_leaf(2 * evict_leaf, L));
 		if (access_counter_2 % K == 0)
 			write_back();
 
-		access_counter_3 = eviction(2 * evict_leaf + 1);
+		access_counter_3 = eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 		if (access_counter_3 % K == 0)
 			write_back();
 	}
@@ -477,7 +477,7 @@ namespace obl
 		std::uint8_t _fetched[block_size];
 		block_t *fetched = (block_t *)_fetched;
 
-		leaf_id evict_leaf;
+		std::uint64_t evict_leaf;
 		bool already_evicted = false;
 		std::uint64_t access_counter_1;
 		std::uint64_t access_counter_2;
@@ -515,8 +515,8 @@ namespace obl
 
 		evict_leaf = evict_path++;
 
-		access_counter_1 = eviction(2 * evict_leaf);
-		access_counter_2 = eviction(2 * evict_leaf + 1);
+		access_counter_1 = eviction(rev_lex_leaf(2 * evict_leaf, L));
+		access_counter_2 = eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 
 		if (access_counter_1 % K == 0)
 			write_back();
@@ -226,7 +226,7 @@ namespace obl
 	void taostore_circuit_2_parallel::access_thread(request_p_t &_req)
 	{
 		std::uint8_t _fetched[block_size];
-		std::int32_t evict_leaf;
+		std::uint64_t evict_leaf;
 		std::uint64_t access_counter_1;
 		std::uint64_t access_counter_2;
 		std::uint64_t access_counter_3;
@@ -240,11 +240,11 @@ namespace obl
 
 		evict_leaf = evict_path++;
 
-		access_counter_2 = eviction(2 * evict_leaf);
+		access_counter_2 = eviction(rev_lex_leaf(2 * evict_leaf, L));
 		if (access_counter_2 % K == 0)
 			write_back();
 
-		access_counter_3 = eviction(2 * evict_leaf + 1);
+		access_counter_3 = eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 
 		if (access_counter_3 % K == 0)
 			write_back();
@@ -458,7 +458,7 @@ namespace obl
 	void taostore_circuit_2_parallel::write(block_id bid, std::uint8_t *data_in, leaf_id next_lif)
 	{
 		std::uint8_t _fetched[block_size];
-		std::uint32_t evict_leaf;
+		std::uint64_t evict_leaf;
 		std::uint64_t paths;
 
 		block_t *fetched = (block_t *)_fetched;
@@ -493,8 +493,8 @@ namespace obl
 
 		evict_leaf = evict_path++;
 
-		eviction(2 * evict_leaf);
-		eviction(2 * evict_leaf + 1);
+		eviction(rev_lex_leaf(2 * evict_leaf, L));
+		eviction(rev_lex_leaf(2 * evict_leaf + 1, L));
 
 		paths = access_counter++;
 
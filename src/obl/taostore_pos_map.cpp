@@ -1,6 +1,10 @@
 #include "obl/taostore_pos_map.h"
+#include "obl/rec_grow.h"
 #include "obl/rec.h"
 #include "obl/primitives.h"
+#include "obl/scan.h"
+
+#include "obl/oassert.h"
 
 #define DUMMY_LEAF -1
 
@@ -42,9 +46,15 @@ namespace obl
         /*if(rmap_levs == 1)
 			rmap_bits = rmap_opt;*/
 
+        this->allocator = allocator;
+
         rmap_locks = new pthread_mutex_t[rmap_levs + 1];
         for (int i = 0; i < rmap_levs + 1; i++)
             rmap_locks[i] = PTHREAD_MUTEX_INITIALIZER;
+
+        top_bits = rmap_levs == 1 ? rmap_opt : rmap_bits;
+        lev_bits = new int[rmap_levs];
+
         if (rmap_levs > 0)
         {
             rmap = new tree_oram *[rmap_levs];
@@ -64,6 +74,7 @@ namespace obl
                 else
                     rec_N <<= rmap_bits;
 
+                lev_bits[i] = tmp_rmap;
                 rmap[i] = allocator->spawn_oram(rec_N, sizeof(leaf_id) * (1 << tmp_rmap));
             }
         }
@@ -78,6 +89,7 @@ namespace obl
     taostore_position_map::~taostore_position_map()
     {
         delete[] pos_map;
+        delete[] lev_bits;
         if (rmap_locks != nullptr)
             delete[] rmap_locks;
         if (rmap != nullptr)
@@ -91,18 +103,8 @@ namespace obl
 
     leaf_id taostore_position_map::scan_map(leaf_id *map, int idx, leaf_id replacement, bool to_init, bool fake)
     {
-        leaf_id leef = DUMMY_LEAF;
-
-        for (int i = 0; i < rmap_csize; i++)
-        {
-            leaf_id tmp = map[i];
-
-            leef = ternary_op(i == idx, tmp, leef);
-            tmp = ternary_op(to_init, DUMMY_LEAF, tmp);
-            map[i] = ternary_op((i == idx) & !fake, replacement, tmp);
-        }
-
-        return leef;
+        // DUMMY_LEAF is the -1 scan_update resets to
+        return scan_update(map, rmap_csize, idx, replacement, to_init, !fake);
     }
 
     leaf_id taostore_position_map::access(block_id bid, bool fake, leaf_id *_ev_leef)
@@ -124,7 +126,7 @@ namespace obl
         block_id rec_bid = 0;
 
         // to inject optimization
-        int local_bits = rmap_levs == 1 ? rmap_opt : rmap_bits;
+        int local_bits = top_bits;
 
         /* Access the constant size position map */
         gen_rand((std::uint8_t *)&ev_leef, sizeof(leaf_id));
@@ -160,10 +162,7 @@ namespace obl
             rem_bid = rem_bid - n_bid * ch_len;
 
             // is the current iteration to optimize?
-            if (i == rmap_levs - 2)
-                local_bits = rmap_opt;
-            else
-                local_bits = rmap_bits;
+            local_bits = lev_bits[i];
 
             ch_len = ch_len >> local_bits;
             if (ch_len == 0)
@@ -194,4 +193,19 @@ namespace obl
 
         return leef;
     }
+
+    bool taostore_position_map::grow(std::size_t new_N)
+    {
+        rec_map_view_t m = {C, rmap_levs, rmap_csize, rmap_bits, top_bits, lev_bits, rmap, rmap_locks, pos_map, allocator};
+        std::size_t new_C = next_two_power(new_N);
+
+        if (new_N < N || !rec_map_can_grow(m, new_C))
+            return false;
+
+        rec_map_grow(m, new_C);
+
+        N = new_N;
+
+        return true;
+    }
 } // namespace obl
@@ -0,0 +1,146 @@
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+// sais.hpp and the enclave kernels define the same tree helpers
+namespace prep
+{
+#include "sais/sais.hpp"
+}
+
+#include "substring/kbwt.hpp"
+
+#include "obl/circuit.h"
+#include "obl/rec_standard.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <cassert>
+
+#define LEN 3000
+#define RUN 60
+#define DUMMY 200
+
+// k-step BWT (prep algorithm 3) against a naive search over the suffix array
+
+static unsigned int next_two_power(unsigned int v)
+{
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+
+    return v + 1;
+}
+
+// rows of sa whose suffix starts with p, as [lo, lo + count)
+static void naive_range(std::vector<unsigned char> &t, std::vector<std::uint32_t> &sa, std::vector<unsigned char> &p, std::uint32_t &lo, std::uint32_t &count)
+{
+    lo = 0;
+    count = 0;
+
+    for (std::size_t j = 0; j < sa.size(); j++)
+    {
+        bool less = false;
+        bool equal = true;
+
+        for (std::size_t i = 0; i < p.size(); i++)
+        {
+            std::size_t pos = sa[j] + i;
+
+            // the terminator sorts first
+            if (pos >= t.size() || t[pos] != p[i])
+            {
+                equal = false;
+                less = pos >= t.size() || t[pos] < p[i];
+                break;
+            }
+        }
+
+        count += equal;
+        lo += less;
+    }
+}
+
+int main()
+{
+    srand(7);
+
+    for (std::uint32_t alpha = 2; alpha <= 5; alpha++)
+        for (std::uint32_t k = 1; k <= 4; k++)
+            for (std::uint32_t s_rate : {7u, 32u})
+            {
+                std::vector<unsigned char> t(LEN);
+
+                for (auto &c : t)
+                    c = rand() % alpha;
+
+                std::vector<std::uint32_t> sa(LEN + 1);
+                prep::sais<unsigned char, std::uint32_t>(t.data(), LEN, alpha, sa.data());
+
+                // same layout as kstep_bwt in prep
+                std::uint64_t no_bits = __builtin_ctz(next_two_power(alpha + 1));
+                std::size_t table_size = prep::kmer_table_size(alpha, k);
+
+                std::vector<std::uint32_t> C(table_size);
+                prep::kmer_bucket_index<unsigned char, std::uint32_t>(t.data(), LEN, alpha, k, C.data());
+
+                std::size_t per_word = 64 / (k * no_bits);
+                std::size_t window_text_size = (s_rate + per_word - 1) / per_word;
+                std::size_t counts_size = (sizeof(std::uint32_t) * table_size + 7) & ~((std::size_t)7);
+                std::size_t sample_size = sizeof(std::uint64_t) * window_text_size + counts_size;
+                std::size_t no_samples = ((LEN + 1) / s_rate) + ((LEN + 1) % s_rate == 0 ? 0 : 1);
+
+                std::vector<std::uint8_t> blob(no_samples * sample_size);
+                prep::sampled_kbwt<unsigned char, std::uint32_t>(t.data(), sa.data(), LEN, alpha, k, s_rate, no_bits, sample_size, blob.data());
+
+                obl::coram_factory allocator(3, 8);
+                obl::recursive_oram_standard index(no_samples, sample_size, 8, &allocator);
+                std::vector<std::uint8_t> placeholder(sample_size);
+
+                for (std::size_t i = 0; i < no_samples; i++)
+                    index.access(i, &blob[i * sample_size], placeholder.data());
+
+                for (int r = 0; r < RUN; r++)
+                {
+                    std::uint32_t qlen = 1 + rand() % 9;
+                    std::vector<unsigned char> q(qlen);
+
+                    // some queries are copied from the text, so that most of them match
+                    std::size_t from = rand() % (LEN - qlen);
+
+                    for (std::uint32_t i = 0; i < qlen; i++)
+                        q[i] = r % 2 == 0 ? t[from + i] : rand() % alpha;
+
+                    // dummy characters are skipped by the query
+                    if (r % 3 == 0)
+                        q[rand() % qlen] = DUMMY;
+
+                    std::vector<unsigned char> real;
+
+                    for (auto c : q)
+                        if (c != DUMMY)
+                            real.push_back(c);
+
+                    std::uint32_t lo, count, start, end;
+                    naive_range(t, sa, real, lo, count);
+
+                    kbwt_query<std::uint32_t, unsigned char>(&index, C.data(), LEN, s_rate, sample_size, no_bits, k, alpha, q.data(), qlen, &start, &end);
+
+                    if (count > 0)
+                    {
+                        assert(start == lo);
+                        assert(end == lo + count - 1);
+                    }
+                    else
+                        assert(end + 1 == start);
+                }
+
+                std::cerr << "alpha " << alpha << ", k " << k << ", sample rate " << s_rate << ": OK" << std::endl;
+            }
+
+    return 0;
+}
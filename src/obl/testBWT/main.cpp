@@ -23,7 +23,11 @@
 
 #include <cstdint>
 #include "obl/rec.h"
+#include "obl/bitslice.h"
 #include "obl/circuit.h"
+#include "obl/ro_circuit.h"
+#include "obl/adaptive_factory.h"
+#include "obl/numa_factory.hpp"
 #include "obl/path.h"
 #include "obl/so_path.h"
 #include "obl/so_circuit.h"
@@ -298,35 +302,6 @@ inline std::size_t get_subroot(std::size_t N)
     return (NN >> 2) + offset;
 }
 
-// Static functions
-
-static int partial_rank(std::uint16_t *ch, int limit, int sample_rate, std::int16_t target, int enc_bit)
-{
-    int p_rank = 0;
-
-    int hword = 0;
-    int shift_right = 0;
-    std::uint16_t mask = (1 << enc_bit) - 1;
-
-    for (int i = 0; i < sample_rate; i++)
-    {
-        std::uint16_t current = (ch[hword] >> shift_right) & mask;
-
-        shift_right += enc_bit;
-        if (shift_right > 16) // this is a known, public parameter, so you don't need to hide this if
-        {
-            ++hword;
-            shift_right -= 16;
-            current = current | (ch[hword] << (enc_bit - shift_right));
-            current = current & mask;
-        }
-
-        p_rank += obl::ternary_op((current == target) & (i < limit), 1, 0);
-    }
-
-    return p_rank;
-}
-
 // Implementation
 
 template <typename Int, typename Char>
@@ -338,6 +313,10 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
     Int start, end;
     std::uint8_t buffer[s_size];
 
+    // the bwt window follows the occurrences, bit-sliced
+    std::size_t ch_offset = (sizeof(Int) * alpha + 7) & ~((std::size_t)7);
+    unsigned int words = obl::bitslice_words(s_rate);
+
     --qlen;
 
     start = linear_scan<Int>(C, (Int)q[qlen], alpha);
@@ -359,8 +338,8 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
         Int *acc = (Int *)buffer;
         Int sample_offset = linear_scan<Int>(acc, char_index, alpha - 1);
 
-        std::uint16_t *ch = (std::uint16_t *)(acc + alpha);
-        Int next_start = base_offset + sample_offset + partial_rank(ch, inner_offset, s_rate, char_index, enc_bit);
+        std::uint64_t *planes = (std::uint64_t *)(buffer + ch_offset);
+        Int next_start = base_offset + sample_offset + obl::bitslice_rank(planes, words, enc_bit, char_index, inner_offset);
 
         // process end
         inner_offset = (end % s_rate) + 1;
@@ -371,8 +350,8 @@ void vbwt_query(obl::recursive_oram *index, Int *C,
         acc = (Int *)buffer;
         sample_offset = linear_scan<Int>(acc, char_index, alpha - 1);
 
-        ch = (std::uint16_t *)(acc + alpha);
-        Int next_end = base_offset + sample_offset + partial_rank(ch, inner_offset, s_rate, char_index, enc_bit) - 1;
+        planes = (std::uint64_t *)(buffer + ch_offset);
+        Int next_end = base_offset + sample_offset + obl::bitslice_rank(planes, words, enc_bit, char_index, inner_offset) - 1;
 
         // support for dummy characters
         bool dummy_char = (char_index < 0) | (char_index >= alpha);
@@ -599,7 +578,7 @@ subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
     switch (cfg.base_oram)
     {
     case OBL_CIRCUIT_ORAM:
-        allocator = new obl::coram_factory(cfg.Z, cfg.stash_size);
+        allocator = new obl::coram_factory(cfg.Z, cfg.stash_size, (obl::huge_page_t)cfg.huge_pages);
         break;
 
     case OBL_PATH_ORAM:
@@ -628,9 +607,33 @@ subtol_context_t *init_subtol_context(void *fb, char *pwd, subtol_config_t &cfg)
     case ASYNCHMOSE:
         allocator = new obl::asynch_mose_factory(cfg.Z, cfg.stash_size, cfg.tnum);
         break;
+    case RO_CIRCUIT_ORAM:
+        if (cfg.stash_size < obl::ro_circuit_min_stash(cfg.Z))
+        {
+            printf("ro_circuit needs a stash of at least %u blocks with Z = %u\n", obl::ro_circuit_min_stash(cfg.Z), cfg.Z);
+            invalid = true;
+        }
+        else
+            allocator = new obl::ro_coram_factory(cfg.Z, cfg.stash_size, (obl::huge_page_t)cfg.huge_pages);
+        break;
+    case ADAPTIVE_ORAM:
+    {
+        obl::oram_cost_model_t model;
+        obl::adaptive_factory::calibrate(model);
+        allocator = new obl::adaptive_factory(model, cfg.mem_budget == 0 ? (std::size_t)-1 : (std::size_t)cfg.mem_budget << 20, cfg.tnum);
+        break;
+    }
     default:
         invalid = true;
     }
+
+    if (invalid)
+        return nullptr;
+
+    // every ORAM of the index, position map levels included, goes through the placement policy
+    if (!invalid && cfg.numa_mode != obl::NUMA_OFF)
+        allocator = new obl::numa_factory(allocator, {(obl::numa_mode_t)cfg.numa_mode, cfg.numa_node, (int)cfg.numa_interleave});
+
     // create subtol context
     subtol_context_t *session = nullptr;
 
@@ -689,6 +692,11 @@ void configure(std::uint8_t *cfg)
     session.cfg.csize = cfg32[5];
     session.cfg.sa_block = cfg32[6];
     session.cfg.tnum = cfg32[7];
+    session.cfg.numa_mode = cfg32[8];
+    session.cfg.numa_node = (std::int32_t)cfg32[9];
+    session.cfg.numa_interleave = cfg32[10];
+    session.cfg.huge_pages = cfg32[11];
+    session.cfg.mem_budget = cfg32[12];
     session.status = 2;
 }
 
@@ -753,11 +761,11 @@ int main(int argc, char *argv[])
 
     create_session();
 
-    std::uint32_t *cfg = new std::uint32_t[8];
+    std::uint32_t *cfg = new std::uint32_t[13];
 
     cfg[0] = oram;
     cfg[1] = 3; //Z
-    cfg[2] = 8; //S
+    cfg[2] = oram == RO_CIRCUIT_ORAM ? obl::ro_circuit_min_stash(3) : 8; //S
 
     cfg[3] = 0;
     cfg[4] = 0; //A
@@ -766,6 +774,47 @@ int main(int argc, char *argv[])
     cfg[6] = 16;
     cfg[7] = tnum;
 
+    // NUMA=bind|spread[:node[:interleaved top levels]], node -1 is the node of this thread
+    cfg[8] = obl::NUMA_OFF;
+    cfg[9] = (std::uint32_t)-1;
+    cfg[10] = 0;
+
+    if (getenv("NUMA") != NULL)
+    {
+        char mode[16] = "";
+        int node = -1, levels = 0;
+
+        sscanf(getenv("NUMA"), "%15[a-z]:%d:%d", mode, &node, &levels);
+
+        if (strcmp(mode, "bind") == 0)
+            cfg[8] = obl::NUMA_BIND;
+        else if (strcmp(mode, "spread") == 0)
+            cfg[8] = obl::NUMA_SPREAD;
+
+        cfg[9] = (std::uint32_t)node;
+        cfg[10] = levels;
+    }
+
+    // HUGE=thp|2m|1g, pages backing the circuit ORAM trees
+    cfg[11] = obl::HUGE_OFF;
+
+    if (getenv("HUGE") != NULL)
+    {
+        if (strcmp(getenv("HUGE"), "thp") == 0)
+            cfg[11] = obl::HUGE_THP;
+        else if (strcmp(getenv("HUGE"), "2m") == 0)
+            cfg[11] = obl::HUGE_2M;
+        else if (strcmp(getenv("HUGE"), "1g") == 0)
+            cfg[11] = obl::HUGE_1G;
+    }
+
+    // base pages are page aligned only when they are to be NUMA-bound
+    if (cfg[11] == obl::HUGE_OFF && cfg[8] != obl::NUMA_OFF)
+        cfg[11] = obl::HUGE_ALIGNED;
+
+    // MEM=<MB>, memory budget of the adaptive ORAM, unbounded if missing
+    cfg[12] = getenv("MEM") != NULL ? atoi(getenv("MEM")) : 0;
+
     configure((std::uint8_t *)cfg);
 
     fp = fopen(filename, "rb");
@@ -11,7 +11,9 @@ enum obl_oram_t {
 	SHADOW_DORAM_V2,
 	ASYNCH_DORAM,
 	MOSE,
-	ASYNCHMOSE
+	ASYNCHMOSE,
+	RO_CIRCUIT_ORAM,
+	ADAPTIVE_ORAM
 };
 
 struct subtol_config_t {
@@ -26,6 +28,14 @@ struct subtol_config_t {
 	unsigned int csize;
 	unsigned int sa_block;
 	unsigned int tnum;
+	// NUMA placement of the trees and of the engine workers, see obl/numa.h
+	unsigned int numa_mode;
+	int numa_node;
+	unsigned int numa_interleave;
+	// pages backing the circuit ORAM trees, an obl::huge_page_t
+	unsigned int huge_pages;
+	// memory budget of the adaptive ORAM in MB, 0 = unbounded
+	unsigned int mem_budget;
 };
 
 #endif // SUBTOL_CONFIG_H
@@ -0,0 +1,198 @@
+#include "obl/circuit.h"
+#include "obl/rec.h"
+#include "obl/rec_standard.h"
+#include "obl/primitives.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <cassert>
+
+#define P 16
+#define N (1 << P)
+#define CSIZE 4
+#define K 16
+#define RUN (1 << 11)
+
+using namespace std;
+
+using hres = chrono::high_resolution_clock;
+using _nano = chrono::nanoseconds;
+
+struct buffer
+{
+	std::uint8_t _buffer[32];
+
+	bool operator==(const buffer &rhs) const
+	{
+		return !memcmp(_buffer, rhs._buffer, sizeof(_buffer));
+	}
+};
+
+// counts the paths read by every ORAM of a recursion
+static unsigned long path_reads = 0;
+
+class counting_oram : public obl::circuit_oram
+{
+public:
+	counting_oram(std::size_t n, std::size_t b) : obl::circuit_oram(n, b, 3, 8) {}
+
+	void access(obl::block_id bid, obl::leaf_id lif, std::uint8_t *data_in, std::uint8_t *data_out, obl::leaf_id next_lif)
+	{
+		path_reads++;
+		obl::circuit_oram::access(bid, lif, data_in, data_out, next_lif);
+	}
+
+	void access_r(obl::block_id bid, obl::leaf_id lif, std::uint8_t *data_out)
+	{
+		path_reads++;
+		obl::circuit_oram::access_r(bid, lif, data_out);
+	}
+};
+
+class counting_factory : public obl::oram_factory
+{
+public:
+	obl::tree_oram *spawn_oram(std::size_t n, std::size_t b)
+	{
+		return new counting_oram(n, b);
+	}
+	bool is_taostore() { return false; }
+};
+
+// K consecutive bids starting at a random offset, visited in a random order
+void random_window(obl::block_id *bids)
+{
+	unsigned int start;
+	obl::gen_rand((std::uint8_t *)&start, sizeof(start));
+	start = start % (N - K);
+
+	for (int j = 0; j < K; j++)
+		bids[j] = start + j;
+
+	for (int j = K - 1; j > 0; j--)
+	{
+		unsigned int r;
+		obl::gen_rand((std::uint8_t *)&r, sizeof(r));
+		std::swap(bids[j], bids[r % (j + 1)]);
+	}
+}
+
+int main()
+{
+	vector<buffer> mirror_data(N);
+	obl::coram_factory of(3, 8);
+	obl::recursive_oram *rram = new obl::recursive_oram_standard(N, sizeof(buffer), CSIZE, &of);
+
+	buffer values[K], values_out[K];
+	std::uint8_t *in[K], *out[K];
+	obl::block_id bids[K];
+
+	for (int j = 0; j < K; j++)
+	{
+		in[j] = (std::uint8_t *)&values[j];
+		out[j] = (std::uint8_t *)&values_out[j];
+	}
+
+	// initialize half of the blocks one by one, the other half in batches
+	for (unsigned int i = 0; i < N / 2; i++)
+	{
+		obl::gen_rand((std::uint8_t *)&values[0], sizeof(buffer));
+		rram->access(i, in[0], out[0]);
+		mirror_data[i] = values[0];
+	}
+
+	for (unsigned int i = N / 2; i < N; i += K)
+	{
+		for (int j = 0; j < K; j++)
+		{
+			bids[j] = i + j;
+			obl::gen_rand((std::uint8_t *)&values[j], sizeof(buffer));
+			mirror_data[i + j] = values[j];
+		}
+
+		rram->access_batch(bids, K, in, out, K);
+	}
+
+	cerr << "finished init" << endl;
+
+	// batched writes and reads, checked against the mirror
+	for (int r = 0; r < RUN; r++)
+	{
+		random_window(bids);
+
+		for (int j = 0; j < K; j++)
+			obl::gen_rand((std::uint8_t *)&values[j], sizeof(buffer));
+
+		rram->access_batch(bids, K, in, out, K);
+
+		for (int j = 0; j < K; j++)
+		{
+			assert(values_out[j] == mirror_data[bids[j]]);
+			mirror_data[bids[j]] = values[j];
+		}
+
+		random_window(bids);
+		rram->access_batch(bids, K, nullptr, out);
+
+		for (int j = 0; j < K; j++)
+			assert(values_out[j] == mirror_data[bids[j]]);
+	}
+
+	// single accesses still see the batched updates
+	for (unsigned int i = 0; i < N; i += 7)
+	{
+		rram->access(i, nullptr, out[0]);
+		assert(values_out[0] == mirror_data[i]);
+	}
+
+	// a window close to the end is moved back instead of wrapping around, so it costs as
+	// many accesses as any other window of K bids
+	counting_factory cf;
+	obl::recursive_oram *cram = new obl::recursive_oram_standard(N, sizeof(buffer), CSIZE, &cf);
+	obl::block_id cursors[2] = {N / 2 + 3, N - 3};
+	unsigned long reads[2];
+
+	for (int c = 0; c < 2; c++)
+	{
+		obl::block_id first = obl::batch_window(cursors[c], K, N);
+		assert(first <= cursors[c] && first + K <= N);
+
+		for (int j = 0; j < K; j++)
+			bids[j] = first + j;
+
+		path_reads = 0;
+		cram->access_batch(bids, K, nullptr, out, K);
+		reads[c] = path_reads;
+	}
+
+	assert(reads[0] == reads[1]);
+	delete cram;
+
+	// batch vs one-by-one on consecutive windows
+	auto start = hres::now();
+	for (int r = 0; r < RUN; r++)
+	{
+		random_window(bids);
+		for (int j = 0; j < K; j++)
+			rram->access(bids[j], nullptr, out[j]);
+	}
+	_nano single = hres::now() - start;
+
+	start = hres::now();
+	for (int r = 0; r < RUN; r++)
+	{
+		random_window(bids);
+		rram->access_batch(bids, K, nullptr, out, K);
+	}
+	_nano batch = hres::now() - start;
+
+	cout << "single: " << single.count() / 1000000000.0 << "s" << endl;
+	cout << "batch: " << batch.count() / 1000000000.0 << "s" << endl;
+
+	delete rram;
+
+	return 0;
+}
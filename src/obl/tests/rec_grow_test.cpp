@@ -0,0 +1,110 @@
+#include "obl/circuit.h"
+#include "obl/path.h"
+#include "obl/rec.h"
+#include "obl/rec_standard.h"
+#include "obl/primitives.h"
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <cassert>
+
+#define N_START (1 << 2)
+#define N_END (1 << 16)
+#define CSIZE 3
+#define RUN (1 << 12)
+
+using namespace std;
+struct buffer
+{
+	std::uint8_t _buffer[32];
+
+	bool operator==(const buffer &rhs) const
+	{
+		return !memcmp(_buffer, rhs._buffer, sizeof(_buffer));
+	}
+};
+
+// random reads over the whole range, checked against the mirror
+void check(obl::recursive_oram *rram, vector<buffer> &mirror_data, std::size_t N)
+{
+	buffer value_out;
+	unsigned int rnd_bid;
+
+	for (int j = 0; j < RUN; j++)
+	{
+		obl::gen_rand((std::uint8_t *)&rnd_bid, sizeof(obl::block_id));
+		rnd_bid = (rnd_bid >> 1) % N;
+		rram->access(rnd_bid, nullptr, (std::uint8_t *)&value_out);
+		assert(value_out == mirror_data[rnd_bid]);
+	}
+}
+
+int main()
+{
+	vector<buffer> mirror_data(N_END);
+	obl::coram_factory of(3, 8);
+	obl::recursive_oram *rram = new obl::recursive_oram_standard(N_START, sizeof(buffer), CSIZE, &of);
+	buffer value, value_out;
+	std::size_t N = N_START;
+
+	for (unsigned int i = 0; i < N; i++)
+	{
+		obl::gen_rand((std::uint8_t *)&value, sizeof(buffer));
+		rram->access(i, (std::uint8_t *)&value, (std::uint8_t *)&value_out);
+		mirror_data[i] = value;
+	}
+
+	check(rram, mirror_data, N);
+
+	// grow one power of two at a time, plus a non power of two step
+	while (N < N_END)
+	{
+		std::size_t new_N = N == (1 << 9) ? 3 * N : 2 * N;
+		if (new_N > N_END)
+			new_N = N_END;
+
+		bool grown = rram->grow(new_N);
+		assert(grown);
+
+		// old content is still there, before and after appending
+		check(rram, mirror_data, N);
+
+		for (unsigned int i = N; i < new_N; i++)
+		{
+			obl::gen_rand((std::uint8_t *)&value, sizeof(buffer));
+			rram->access(i, (std::uint8_t *)&value, (std::uint8_t *)&value_out);
+			mirror_data[i] = value;
+		}
+
+		N = new_N;
+		check(rram, mirror_data, N);
+
+		cerr << "grown to " << N << endl;
+	}
+
+	delete rram;
+
+	// path ORAM cannot grow: grow must fail before touching the recursion
+	obl::path_factory pf(4, 150, 3);
+	N = 1 << 10;
+	rram = new obl::recursive_oram_standard(N, sizeof(buffer), CSIZE, &pf);
+
+	for (unsigned int i = 0; i < N; i++)
+	{
+		obl::gen_rand((std::uint8_t *)&value, sizeof(buffer));
+		rram->access(i, (std::uint8_t *)&value, (std::uint8_t *)&value_out);
+		mirror_data[i] = value;
+	}
+
+	bool grown = rram->grow(N << 3);
+	assert(!grown);
+
+	check(rram, mirror_data, N);
+	cerr << "path ORAM refused to grow, content intact" << endl;
+
+	delete rram;
+
+	return 0;
+}
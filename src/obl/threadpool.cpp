@@ -36,6 +36,7 @@
 #include <unistd.h>
 
 #include "obl/threadpool.h"
+#include "obl/numa.h"
 
 typedef enum {
     immediate_shutdown = 1,
@@ -196,6 +197,23 @@ int threadpool_add(threadpool_t *pool, void (*function)(void *),
     return err;
 }
 
+int threadpool_bind_node(threadpool_t *pool, int node)
+{
+    int i, err = 0;
+
+    if(pool == NULL) {
+        return threadpool_invalid;
+    }
+
+    for(i = 0; i < pool->thread_count; i++) {
+        if(!obl::numa_bind_thread(pool->threads[i], node)) {
+            err = threadpool_thread_failure;
+        }
+    }
+
+    return err;
+}
+
 int threadpool_destroy(threadpool_t *pool, int flags)
 {
     int i, err = 0;
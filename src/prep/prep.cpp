@@ -5,6 +5,8 @@
 #include <cstring>
 #include <fstream>
 #include <cassert>
+#include <cstdlib>
+#include <thread>
 
 #include <sys/types.h>
 #include <fcntl.h>
@@ -14,6 +16,8 @@
 #include <openssl/evp.h>
 
 #include "sais.hpp"
+#include "psais.hpp"
+#include "uint40.hpp"
 
 const std::size_t outbuf_size = 65536 * 4; // 256 kB
 const int pbkdf2_work_factor = 16384;
@@ -28,9 +32,18 @@ void map_uchar(unsigned char*, std::size_t, std::size_t*, int&);
 // append encrypted data to the output file
 void append_blob(EVP_CIPHER_CTX*, std::filebuf&, std::uint8_t*, std::uint8_t*, std::size_t);
 
-void sa_psi(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, bool);
-void nicholas_bwt(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, bool);
-void vanilla_bwt(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, std::uint64_t, bool);
+// Int is the type of the indices, the narrowest of 32, 40 and 64 bits fitting the text
+template<typename Int>
+void preprocess(int, EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, int, char**, bool, int);
+
+template<typename Int>
+void sa_psi(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, bool, int);
+template<typename Int>
+void nicholas_bwt(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, bool, int);
+template<typename Int>
+void vanilla_bwt(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, std::uint64_t, bool, int);
+template<typename Int>
+void kstep_bwt(EVP_CIPHER_CTX*, unsigned char*, std::size_t, int, std::filebuf&, std::uint64_t, std::uint64_t, bool, int);
 
 int main(int argc, char *argv[])
 {
@@ -40,17 +53,27 @@ int main(int argc, char *argv[])
 
 	if(argc < 6)
 	{
-		std::cerr << "usage: ./prep <input_txt> <output_bin> <passwd>\n\t<algo> <suffix_array:y/n> [sampling_rate]" << std::endl << std::endl;
+		std::cerr << "usage: ./prep <input_txt> <output_bin> <passwd>\n\t<algo> <suffix_array:y/n> [sampling_rate] [k]" << std::endl << std::endl;
 		std::cerr << "algorithms:" << std::endl;
 		std::cerr << "0 => SA-PSI" << std::endl;
 		std::cerr << "1 => Nicholas BWT" << std::endl;
 		std::cerr << "2 => Sampled vanilla BWT (requires sampling rate)" << std::endl;
+		std::cerr << "3 => Sampled k-step BWT (requires sampling rate and k)" << std::endl;
 		return 1;
 	}
 
 	algo = std::atoi(argv[4]);
 	suffix_array_on = std::strcmp(argv[5], "y") == 0;
 
+	// PREP_THREADS overrides the number of hardware threads
+	int threads = std::thread::hardware_concurrency();
+
+	if(std::getenv("PREP_THREADS") != NULL)
+		threads = std::atoi(std::getenv("PREP_THREADS"));
+
+	if(threads < 1)
+		threads = 1;
+
 	// key generation - PBKDF2
 	std::uint8_t aes_key[16];
 	std::uint8_t pbkdf2_salt[pbkdf2_salt_size];
@@ -96,7 +119,8 @@ int main(int argc, char *argv[])
 	map_uchar(text, length, freq, alpha);
 
 	std::cout << "String length: " << std::dec << length << std::endl;
-	std::cout << "Alphabet size: " << alpha << std::endl << std::endl;
+	std::cout << "Alphabet size: " << alpha << std::endl;
+	std::cout << "Threads: " << threads << std::endl << std::endl;
 	
 	// create map file and compact frequencies
 	for(int i = 0; i < 256; i++)
@@ -138,8 +162,18 @@ int main(int argc, char *argv[])
 		header[0] = max_occ * alpha;
 	}
 	
+	// all ones is the -1 of sais, so the largest index must stay below it
+	std::size_t int_size;
+
+	if(header[0] < 0xFFFFFFFFull - 1)
+		int_size = sizeof(std::uint32_t);
+	else if(header[0] < 0xFFFFFFFFFFull - 1)
+		int_size = sizeof(uint40_t);
+	else
+		int_size = sizeof(std::uint64_t);
+
 	header[1] = alpha;
-	header[2] = sizeof(std::uint32_t); // Int type of sais
+	header[2] = int_size; // Int type of sais
 	header[3] = pbkdf2_salt_size; // salt size for PBKDF2
 
 	outfile.sputn((char*) &algorithm_def, sizeof(std::uint64_t));
@@ -155,26 +189,16 @@ int main(int argc, char *argv[])
 	EVP_EncryptUpdate(actr, NULL, &out_size, pbkdf2_salt, pbkdf2_salt_size);
 
 	// Up to here, preprocessing is the same for the three algorithms, now differentiate
-	int sampling_rate;
-
-	switch(algo)
+	switch(int_size)
 	{
-		case 0:
-			sa_psi(actr, text, length, alpha, outfile, suffix_array_on);
-			break;
-		case 1:
-			nicholas_bwt(actr, text, length, alpha, outfile, suffix_array_on);
+		case sizeof(std::uint32_t):
+			preprocess<std::uint32_t>(algo, actr, text, length, alpha, outfile, argc, argv, suffix_array_on, threads);
 			break;
-		case 2:
-			if(argc != 7)
-				std::cerr << "error: sampling rate required" << std::endl;
-			else {
-				sampling_rate = std::atoi(argv[6]);
-				vanilla_bwt(actr, text, length, alpha, outfile, sampling_rate, suffix_array_on);
-			}
+		case sizeof(uint40_t):
+			preprocess<uint40_t>(algo, actr, text, length, alpha, outfile, argc, argv, suffix_array_on, threads);
 			break;
 		default:
-			std::cerr << "error: unknown algo" << std::endl;
+			preprocess<std::uint64_t>(algo, actr, text, length, alpha, outfile, argc, argv, suffix_array_on, threads);
 	}
 
 	// extract gmac
@@ -257,7 +281,7 @@ void map_uchar(unsigned char *txt, std::size_t len, std::size_t *C, int &alpha)
 		}
 	
 	// assign new tags to characters
-	for(unsigned int i = 0; i < len; i++)
+	for(std::size_t i = 0; i < len; i++)
 		txt[i] = map[txt[i]];
 }
 
@@ -280,6 +304,40 @@ void* map_file(const char *filename, off_t &length)
 	return ptr;
 }
 
+template<typename Int>
+void preprocess(int algo, EVP_CIPHER_CTX *actr, unsigned char *text, std::size_t length, int alpha, std::filebuf &outfile, int argc, char *argv[], bool suffix_array_on, int threads)
+{
+	int sampling_rate;
+
+	switch(algo)
+	{
+		case 0:
+			sa_psi<Int>(actr, text, length, alpha, outfile, suffix_array_on, threads);
+			break;
+		case 1:
+			nicholas_bwt<Int>(actr, text, length, alpha, outfile, suffix_array_on, threads);
+			break;
+		case 2:
+			if(argc != 7)
+				std::cerr << "error: sampling rate required" << std::endl;
+			else {
+				sampling_rate = std::atoi(argv[6]);
+				vanilla_bwt<Int>(actr, text, length, alpha, outfile, sampling_rate, suffix_array_on, threads);
+			}
+			break;
+		case 3:
+			if(argc != 8)
+				std::cerr << "error: sampling rate and k required" << std::endl;
+			else {
+				sampling_rate = std::atoi(argv[6]);
+				kstep_bwt<Int>(actr, text, length, alpha, outfile, sampling_rate, std::atoi(argv[7]), suffix_array_on, threads);
+			}
+			break;
+		default:
+			std::cerr << "error: unknown algo" << std::endl;
+	}
+}
+
 void append_blob(EVP_CIPHER_CTX *actr, std::filebuf &fb, std::uint8_t *data, std::size_t len, std::uint8_t *enc_data, std::size_t enc_buff)
 {
 	int written_bytes;
@@ -298,18 +356,19 @@ void append_blob(EVP_CIPHER_CTX *actr, std::filebuf &fb, std::uint8_t *data, std
 	}
 }
 
-void sa_psi(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, bool sa_on)
+template<typename Int>
+void sa_psi(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, bool sa_on, int threads)
 {
 	std::uint8_t *enc_data = new uint8_t[outbuf_size];
 
 	// preprocessing -- C array
-	std::uint32_t *C = new std::uint32_t[alphabet_size + 1];
-	bucket_index<unsigned char, std::uint32_t>(text, length, alphabet_size, C);
+	Int *C = new Int[alphabet_size + 1];
+	bucket_index<unsigned char, Int>(text, length, alphabet_size, C);
 	std::cout << "Created C array for indexing" << std::endl;
 
 	// preprocessing -- suffix array
-	std::uint32_t *buffer1 = new std::uint32_t[length+1];
-	sais<unsigned char, std::uint32_t>(text, length, alphabet_size, buffer1);
+	Int *buffer1 = new Int[length+1];
+	parallel_sa<unsigned char, Int>(text, length, alphabet_size, buffer1, threads);
 	std::cout << "Suffix array generated" << std::endl;
 
 	// text no more needed
@@ -318,31 +377,31 @@ void sa_psi(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alp
 	// If you want, write here your suffix array (stored in buffer1)
 	if(sa_on)
 	{
-		append_blob(cc, fb, (std::uint8_t*) buffer1, (length+1) * sizeof(std::uint32_t), enc_data, outbuf_size);
+		append_blob(cc, fb, (std::uint8_t*) buffer1, (length+1) * sizeof(Int), enc_data, outbuf_size);
 		std::cout << "Suffix-array written to file" << std::endl;
 	}
 
 	// write the C array
-	append_blob(cc, fb, (std::uint8_t*) C, (alphabet_size + 1) * sizeof(std::uint32_t), enc_data, outbuf_size);
+	append_blob(cc, fb, (std::uint8_t*) C, (alphabet_size + 1) * sizeof(Int), enc_data, outbuf_size);
 	delete[] C;
 
 	// preprocessing -- psi array
-	std::uint32_t *buffer2 = new std::uint32_t[length+1];
-	inverse_sa<std::uint32_t>(buffer1, buffer2, length);
-	build_psi<std::uint32_t>(buffer1, buffer2, buffer1, length);
-	flatten<std::uint32_t>(buffer1, buffer2, 0, length+1);
+	Int *buffer2 = new Int[length+1];
+	parallel_inverse_sa<Int>(buffer1, buffer2, length, threads);
+	parallel_build_psi<Int>(buffer1, buffer2, buffer1, length, threads);
+	parallel_flatten<Int>(buffer1, buffer2, 0, length+1, threads);
 	std::cout << "PSI array built and flattened" << std::endl << std::endl;
 
 	delete[] buffer1;
 
 	// write the PSI array level by level
-	std::int64_t hlen = 1;
-	std::uint32_t ll = length + 1;
+	std::size_t hlen = 1;
+	std::size_t ll = length + 1;
 	while(ll != 0)
 	{
 		std::size_t ch_s = ll > hlen ? hlen : ll;
 
-		append_blob(cc, fb, (std::uint8_t*) &buffer2[hlen-1], ch_s * sizeof(std::uint32_t), enc_data, outbuf_size);
+		append_blob(cc, fb, (std::uint8_t*) &buffer2[hlen-1], ch_s * sizeof(Int), enc_data, outbuf_size);
 
 		// next level of the heap
 		ll -= ch_s;
@@ -354,19 +413,20 @@ void sa_psi(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alp
 	delete[] enc_data;
 }
 
-void nicholas_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, bool sa_on)
+template<typename Int>
+void nicholas_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, bool sa_on, int threads)
 {
 	std::uint8_t *enc_data = new uint8_t[outbuf_size];
 
 	// preprocessing -- C array
-	std::uint32_t *C = new std::uint32_t[alphabet_size + 1];
-	bucket_index<unsigned char, std::uint32_t>(text, length, alphabet_size, C);
+	Int *C = new Int[alphabet_size + 1];
+	bucket_index<unsigned char, Int>(text, length, alphabet_size, C);
 
 	for(int i = 0; i < alphabet_size; i++)
 		C[i] = C[i+1] - C[i];
 
 	// find max occurrence character
-	std::uint32_t max_freq = 0;
+	Int max_freq = 0;
 	for(int i = 0; i < alphabet_size; i++)
 		if(C[i] > max_freq)
 			max_freq = C[i];
@@ -374,14 +434,14 @@ void nicholas_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, i
 	std::size_t Np = alphabet_size * max_freq + 1;
 
 	// preprocessing -- suffix array
-	std::uint32_t *buffer1 = new std::uint32_t[Np];
-	sais<unsigned char, std::uint32_t>(text, length, alphabet_size, buffer1);
+	Int *buffer1 = new Int[Np];
+	parallel_sa<unsigned char, Int>(text, length, alphabet_size, buffer1, threads);
 	std::cout << "Suffix array generated" << std::endl;
 
 	// build BWT
-	std::uint32_t terminator_offset = 0; // shut down compiler warnings
+	Int terminator_offset = 0; // shut down compiler warnings
 	unsigned char *bwt = new unsigned char[length+1];
-	build_bwt<unsigned char, std::uint32_t>(text, buffer1, bwt, length, &terminator_offset);
+	parallel_build_bwt<unsigned char, Int>(text, buffer1, bwt, length, &terminator_offset, threads);
 	std::cout << "BWT computed" << std::endl;
 
 	// text no more needed
@@ -390,31 +450,31 @@ void nicholas_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, i
 	// this is the right time to write the suffix array if you want
 	if(sa_on)
 	{
-		append_blob(cc, fb, (std::uint8_t*) buffer1, Np * sizeof(std::uint32_t), enc_data, outbuf_size);
+		append_blob(cc, fb, (std::uint8_t*) buffer1, Np * sizeof(Int), enc_data, outbuf_size);
 		std::cout << "Suffix-array written to file" << std::endl;
 	}
 
 	delete[] buffer1;
 
 	// write C to file
-	append_blob(cc, fb, (std::uint8_t*) C, alphabet_size * sizeof(std::uint32_t), enc_data, outbuf_size);
+	append_blob(cc, fb, (std::uint8_t*) C, alphabet_size * sizeof(Int), enc_data, outbuf_size);
 
-	std::uint32_t **indices = new std::uint32_t*[alphabet_size];
+	Int **indices = new Int*[alphabet_size];
 	for(int i = 0; i < alphabet_size; i++)
-	 	indices[i] = new std::uint32_t[max_freq];
+	 	indices[i] = new Int[max_freq];
 
-	write_index<unsigned char, std::uint32_t>(bwt, length, alphabet_size, terminator_offset, indices);
+	write_index<unsigned char, Int>(bwt, length, alphabet_size, terminator_offset, indices);
 
 	// get rid of the useless BWT
 	delete[] bwt;
 
-	std::uint32_t *heap = new std::uint32_t[max_freq];
+	Int *heap = new Int[max_freq];
 
 	for(int i = 0; i < alphabet_size; i++)
 	{
-		flatten<std::uint32_t>(indices[i], heap, 0, C[i]);
+		parallel_flatten<Int>(indices[i], heap, 0, C[i], threads);
 		delete[] indices[i];
-		append_blob(cc, fb, (std::uint8_t*) heap, max_freq * sizeof(std::uint32_t), enc_data, outbuf_size);
+		append_blob(cc, fb, (std::uint8_t*) heap, max_freq * sizeof(Int), enc_data, outbuf_size);
 	}
 	std::cout << "Indices built and flattened" << std::endl << std::endl;
 
@@ -425,22 +485,23 @@ void nicholas_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, i
 	delete[] enc_data;
 }
 
-void vanilla_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, std::uint64_t s_rate, bool sa_on)
+template<typename Int>
+void vanilla_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, std::uint64_t s_rate, bool sa_on, int threads)
 {
 	std::uint8_t *enc_data = new uint8_t[outbuf_size];
 
 	// preprocessing -- C array
-	std::uint32_t *C = new std::uint32_t[alphabet_size + 1];
-	bucket_index<unsigned char, std::uint32_t>(text, length, alphabet_size, C);
+	Int *C = new Int[alphabet_size + 1];
+	bucket_index<unsigned char, Int>(text, length, alphabet_size, C);
 
 	// build suffix array
-	std::uint32_t *suffix_array = new std::uint32_t[length+1];
-	sais<unsigned char, std::uint32_t>(text, length, alphabet_size, suffix_array);
+	Int *suffix_array = new Int[length+1];
+	parallel_sa<unsigned char, Int>(text, length, alphabet_size, suffix_array, threads);
 
 	// build the bwt
 	unsigned char *bwt = new unsigned char[length+1];
-	std::uint32_t terminator = 0; // shut down silly compiler warnings
-	build_bwt<unsigned char, std::uint32_t>(text, suffix_array, bwt, length, &terminator);
+	Int terminator = 0; // shut down silly compiler warnings
+	parallel_build_bwt<unsigned char, Int>(text, suffix_array, bwt, length, &terminator, threads);
 
 	// text no more needed
 	munmap(text, length);
@@ -448,7 +509,7 @@ void vanilla_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, in
 	// if you need to write to file the suffix array, that's a good moment
 	if(sa_on)
 	{
-		append_blob(cc, fb, (std::uint8_t*) suffix_array, (length+1) * sizeof(std::uint32_t), enc_data, outbuf_size);
+		append_blob(cc, fb, (std::uint8_t*) suffix_array, (length+1) * sizeof(Int), enc_data, outbuf_size);
 		std::cout << "Suffix-array written to file" << std::endl;
 	}
 
@@ -460,23 +521,23 @@ void vanilla_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, in
 
 	std::cerr << "# bits per character: " << no_bits << std::endl;
 
-	// get # of 16-bit words required to hold data
-	int compressed_window = s_rate * no_bits;
-	int window_text_size = (compressed_window / 16) + (compressed_window % 16 == 0 ? 0 : 1);
+	// get # of 64-bit words of each bitplane
+	int window_text_size = (s_rate + 63) / 64;
 
-	std::cerr << "# 16-bit words per sample: " << window_text_size << std::endl << std::endl;
+	std::cerr << "# 64-bit words per bitplane: " << window_text_size << std::endl << std::endl;
 
 	// get the total number of samples
-	int no_samples = ((length+1) / s_rate) + ((length+1) % s_rate == 0 ? 0 : 1);
+	std::size_t no_samples = ((length+1) / s_rate) + ((length+1) % s_rate == 0 ? 0 : 1);
 
 	// establish sample size and allocate memory blob
-	std::size_t sample_size = sizeof(std::uint16_t) * window_text_size + sizeof(std::uint32_t) * alpha;
+	std::size_t counts_size = (sizeof(Int) * alpha + 7) & ~((std::size_t) 7);
+	std::size_t sample_size = sizeof(std::uint64_t) * no_bits * window_text_size + counts_size;
 	std::size_t blob_size = no_samples * sample_size;
 	std::uint8_t *blob = new std::uint8_t[blob_size];
 	//std::uint8_t *blob = (std::uint8_t*) malloc(blob_size);
 
 	// preprocess
-	sampled_bwt<unsigned char, std::uint32_t>(bwt, length, alpha, terminator, s_rate, no_bits, sample_size, blob);
+	parallel_sampled_bwt<unsigned char, Int>(bwt, length, alpha, terminator, s_rate, no_bits, sample_size, blob, threads);
 	delete[] bwt;
 
 	// append further metadata
@@ -489,7 +550,83 @@ void vanilla_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, in
 	fb.sputn((char*) metadata, sizeof(std::uint64_t) * 3);
 	EVP_EncryptUpdate(cc, NULL, &out_size, (std::uint8_t*) metadata, sizeof(std::uint64_t) * 3);
 
-	append_blob(cc, fb, (std::uint8_t*) C, sizeof(std::uint32_t) * (alpha + 1), enc_data, outbuf_size);
+	append_blob(cc, fb, (std::uint8_t*) C, sizeof(Int) * (alpha + 1), enc_data, outbuf_size);
+
+	// final copy into file
+	append_blob(cc, fb, (std::uint8_t*) blob, blob_size, enc_data, outbuf_size);
+
+	delete[] blob;
+	delete[] C;
+
+	delete[] enc_data;
+}
+
+template<typename Int>
+void kstep_bwt(EVP_CIPHER_CTX *cc, unsigned char *text, std::size_t length, int alphabet_size, std::filebuf &fb, std::uint64_t s_rate, std::uint64_t k, bool sa_on, int threads)
+{
+	std::uint8_t *enc_data = new uint8_t[outbuf_size];
+
+	// get number of bits to encode each character
+	int alpha = alphabet_size;
+	int no_bits = __builtin_ctz(next_two_power(alpha+1)); // number of bits for each character and terminator
+
+	// a row code must fit a 64-bit word, k-mer tables are meant for small alphabets
+	std::size_t table_size = kmer_table_size(alpha, k);
+	assert(k >= 1 && k * no_bits <= 32);
+	assert(table_size <= (1 << 16));
+
+	std::cerr << "# bits per character: " << no_bits << std::endl;
+	std::cerr << "# k-mer table entries: " << table_size << std::endl;
+
+	// preprocessing -- k-mer C array
+	Int *C = new Int[table_size];
+	kmer_bucket_index<unsigned char, Int>(text, length, alpha, k, C);
+
+	// build suffix array
+	Int *suffix_array = new Int[length+1];
+	parallel_sa<unsigned char, Int>(text, length, alpha, suffix_array, threads);
+
+	// if you need to write to file the suffix array, that's a good moment
+	if(sa_on)
+	{
+		append_blob(cc, fb, (std::uint8_t*) suffix_array, (length+1) * sizeof(Int), enc_data, outbuf_size);
+		std::cout << "Suffix-array written to file" << std::endl;
+	}
+
+	// get # of 64-bit words required to hold data
+	std::size_t per_word = 64 / (k * no_bits);
+	std::size_t window_text_size = (s_rate + per_word - 1) / per_word;
+
+	std::cerr << "# 64-bit words per sample: " << window_text_size << std::endl << std::endl;
+
+	// get the total number of samples
+	std::size_t no_samples = ((length+1) / s_rate) + ((length+1) % s_rate == 0 ? 0 : 1);
+
+	// establish sample size and allocate memory blob
+	std::size_t counts_size = (sizeof(Int) * table_size + 7) & ~((std::size_t) 7);
+	std::size_t sample_size = sizeof(std::uint64_t) * window_text_size + counts_size;
+	std::size_t blob_size = no_samples * sample_size;
+	std::uint8_t *blob = new std::uint8_t[blob_size];
+
+	// preprocess -- rows need the text, so the suffix array replaces the bwt here
+	parallel_sampled_kbwt<unsigned char, Int>(text, suffix_array, length, alpha, k, s_rate, no_bits, sample_size, blob, threads);
+	delete[] suffix_array;
+
+	// text no more needed
+	munmap(text, length);
+
+	// append further metadata
+	int out_size;
+	std::uint64_t metadata[4];
+	metadata[0] = s_rate;
+	metadata[1] = no_bits;
+	metadata[2] = sample_size;
+	metadata[3] = k;
+
+	fb.sputn((char*) metadata, sizeof(std::uint64_t) * 4);
+	EVP_EncryptUpdate(cc, NULL, &out_size, (std::uint8_t*) metadata, sizeof(std::uint64_t) * 4);
+
+	append_blob(cc, fb, (std::uint8_t*) C, sizeof(Int) * table_size, enc_data, outbuf_size);
 
 	// final copy into file
 	append_blob(cc, fb, (std::uint8_t*) blob, blob_size, enc_data, outbuf_size);
@@ -15,28 +15,24 @@ void vbwt_query(void *index, Int *C,
 
 // Static functions
 
-static int partial_rank(std::uint16_t *ch, int limit, std::int16_t target, int enc_bit)
+// bwt window stored bit-sliced, see sampled_bwt
+static int partial_rank(std::uint64_t *planes, int limit, int s_rate, std::int16_t target, int enc_bit)
 {
 	int p_rank = 0;
+	int words = (s_rate + 63) / 64;
 
-	int hword = 0;
-	int shift_right = 0;
-	std::uint16_t mask = (1 << enc_bit) - 1;
-
-	for(int i = 0; i < limit; i++)
+	for(int w = 0; w * 64 < limit; w++)
 	{
-		std::uint16_t current = (ch[hword] >> shift_right) & mask;
+		std::uint64_t eq = ~0ULL;
 
-		shift_right += enc_bit;
-		if(shift_right > 16)
-		{
-			++hword;
-			shift_right -= 16;
-			current |= ((ch[hword] << (enc_bit - shift_right)) & mask);
-		}
+		for(int b = 0; b < enc_bit; b++)
+			eq &= ((target >> b) & 1) ? planes[b * words + w] : ~planes[b * words + w];
+
+		int rem = limit - w * 64;
+		if(rem < 64)
+			eq &= (1ULL << rem) - 1;
 
-		if(current == target)
-			++p_rank;
+		p_rank += __builtin_popcountll(eq);
 	}
 
 	return p_rank;
@@ -67,6 +63,7 @@ void vbwt_query(void *index, Int *C,
 	
 	// avoid compiler complaints
 	std::uint8_t *u_index = (std::uint8_t*) index;
+	std::size_t ch_offset = (sizeof(Int) * alpha + 7) & ~((std::size_t) 7);
 
 	while(qlen != -1)
 	{
@@ -81,16 +78,16 @@ void vbwt_query(void *index, Int *C,
 		Int outer_offset = start / s_rate;
 
 		std::uint32_t *acc = (Int*)(u_index + (outer_offset * s_size));
-		std::uint16_t *ch = (std::uint16_t*)(acc + alpha);
-		start = C[(Int) q[qlen]] + acc[(Int) q[qlen]] + partial_rank(ch, inner_offset, (Int) q[qlen], enc_bit);
+		std::uint64_t *planes = (std::uint64_t*)((std::uint8_t*) acc + ch_offset);
+		start = C[(Int) q[qlen]] + acc[(Int) q[qlen]] + partial_rank(planes, inner_offset, s_rate, (Int) q[qlen], enc_bit);
 
 		// process end
 		inner_offset = (end % s_rate) + 1;
 		outer_offset = end / s_rate;
 
 		acc = (Int*)(u_index + (outer_offset * s_size));
-		ch = (std::uint16_t*)(acc + alpha);
-		end = C[(Int) q[qlen]] + acc[(Int) q[qlen]] + partial_rank(ch, inner_offset, (Int) q[qlen], enc_bit) - 1;
+		planes = (std::uint64_t*)((std::uint8_t*) acc + ch_offset);
+		end = C[(Int) q[qlen]] + acc[(Int) q[qlen]] + partial_rank(planes, inner_offset, s_rate, (Int) q[qlen], enc_bit) - 1;
 
 		--qlen;
 	}